@@ -64,7 +64,7 @@
 #define configTICK_RATE_HZ                       ((TickType_t)1000)
 #define configMAX_PRIORITIES                     ( 56 )
 #define configMINIMAL_STACK_SIZE                 ((uint16_t)128)
-#define configTOTAL_HEAP_SIZE                    ((size_t)3072)
+#define configTOTAL_HEAP_SIZE                    ((size_t)4864)
 #define configMAX_TASK_NAME_LEN                  ( 16 )
 #define configUSE_TRACE_FACILITY                 1
 #define configUSE_16_BIT_TICKS                   0
@@ -73,6 +73,7 @@
 #define configUSE_RECURSIVE_MUTEXES              1
 #define configUSE_COUNTING_SEMAPHORES            1
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION  0
+#define configCHECK_FOR_STACK_OVERFLOW           2
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES                    0
@@ -151,6 +152,19 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+/* Tickless idle hooks in freertos.c: put the external flash into deep power-down */
+#if configUSE_TICKLESS_IDLE == 1
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+void PreSleepProcessing(uint32_t ulExpectedIdleTime);
+void PostSleepProcessing(uint32_t ulExpectedIdleTime);
+#endif
+#define configPRE_SLEEP_PROCESSING                PreSleepProcessing
+#define configPOST_SLEEP_PROCESSING               PostSleepProcessing
+#endif /* configUSE_TICKLESS_IDLE == 1 */
+/* Event trace hooks (trace.h), defined only with TRACE_ENABLED */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+#include "trace.h"
+#endif
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
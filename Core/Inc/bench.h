@@ -0,0 +1,75 @@
+/**
+ * @file bench.h
+ * @brief On-target microbenchmark suite
+ *
+ * @details Runs a fixed set of kernels (W5500 register and burst access, UDP
+ *          round trip, external flash, memcpy, CRC, printf, context switch),
+ *          times every call with the DWT cycle counter and sends min/mean/max
+ *          per kernel to the benchmark collector (Tools/bench_collect.py).
+ *
+ *          Datagram (big-endian):
+ *            header  magic 'B', version, record count,
+ *                    flags (bit0: last, bit1: RAMFUNC_ENABLED),
+ *                    run_id u32, core clock Hz u32
+ *            record  name[16], param u32, iterations u16, failures u16,
+ *                    min u32, mean u32, max u32 (cycles, call overhead removed)
+ *
+ *          The UDP round trip kernel sends BENCH_ECHO_MAGIC probes that the
+ *          collector echoes back.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Benchmark build mode: build with -DBENCH_ENABLED=1 to run the suite at startup */
+#ifndef BENCH_ENABLED
+#define BENCH_ENABLED           0
+#endif
+
+#define BENCH_MAGIC             0x42    /* 'B' */
+#define BENCH_ECHO_MAGIC        0x45    /* 'E' */
+#define BENCH_VERSION           1
+#define BENCH_NAME_LEN          16
+#define BENCH_HEADER_SIZE       12
+#define BENCH_RECORD_SIZE       36
+#define BENCH_RECORDS_PER_PACKET 8
+#define BENCH_BUF_SIZE          1024    /* Largest burst / memcpy / CRC size */
+#define BENCH_RTT_TIMEOUT_MS    100
+
+typedef struct {
+    const char *name;
+    uint32_t param;
+    uint16_t iterations;
+    uint16_t failures;
+    uint32_t min_cycles;
+    uint32_t mean_cycles;
+    uint32_t max_cycles;
+} bench_result_t;
+
+/**
+ * @brief Run every kernel and send the results
+ * @return Number of kernels run, negative if the results could not be sent
+ * @note  Call from the network task once the W5500 is initialized and before
+ *        other services use the shared UDP socket.
+ */
+int32_t bench_run_all(void);
+
+#if BENCH_ENABLED
+/* Same socket calls through the C++ facade (bench_socket.cpp), to compare
+   against the C wrappers */
+bool bench_socket_udp_tx(uint8_t sn, const uint8_t *data, uint16_t len, const uint8_t *ip, uint16_t port);
+uint16_t bench_socket_rx_size(uint8_t sn);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BENCH_H
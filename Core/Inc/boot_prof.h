@@ -0,0 +1,83 @@
+/**
+ * @file boot_prof.h
+ * @brief Boot-time profiler and fast-boot switch
+ *
+ * @details Timestamps each init phase with the DWT cycle counter, from main()
+ *          to the first datagram on the wire. Cycles are converted with the
+ *          core clock in effect when each segment started, so the HSI part
+ *          before SystemClock_Config() is counted at 8 MHz. Code before main()
+ *          (reset handler, .data/.bss init) is not covered.
+ *
+ *          Phases may be reached from different tasks and in any order (the
+ *          PHY link comes up in parallel with service init); each keeps the
+ *          first time it was marked. CYCCNT wraps after 59.6 s at 72 MHz, so
+ *          a phase first reached later than that is misreported.
+ *
+ *          Results are printed once the first datagram is sent and can be
+ *          read back with the get_boot_profile RPC.
+ */
+
+#ifndef BOOT_PROF_H
+#define BOOT_PROF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Production fast boot: build with -DBOOT_FAST_ENABLED=1 to drop the boot
+   diagnostics (SPI register dumps, raw SPI test, readback prints) */
+#ifndef BOOT_FAST_ENABLED
+#define BOOT_FAST_ENABLED       0
+#endif
+
+#if BOOT_FAST_ENABLED
+#define BOOT_LOG(...)           ((void)0)
+#else
+#define BOOT_LOG(...)           printf(__VA_ARGS__)
+#endif
+
+/* Boot phases in nominal order: X(id, name) */
+#define BOOT_PHASE_TABLE(X) \
+    X(HAL_INIT,     "hal_init")     /* HAL_Init() done */ \
+    X(CLOCK,        "clock")        /* PLL at 72 MHz */ \
+    X(PERIPH,       "periph")       /* MX_xxx_Init() done, W5500 released from reset */ \
+    X(KERNEL,       "kernel")       /* First task running */ \
+    X(W5500_READY,  "w5500_ready")  /* VERSIONR answers */ \
+    X(NET_CONFIG,   "net_config")   /* Socket buffers and addresses applied */ \
+    X(SERVICES,     "services")     /* Modbus and RPC sockets listening */ \
+    X(LINK_UP,      "link_up")      /* PHY auto-negotiation complete */ \
+    X(FIRST_TX,     "first_tx")     /* First datagram handed to the W5500 */
+
+typedef enum {
+#define BOOT_PHASE_ENUM(id, name) BOOT_PHASE_##id,
+    BOOT_PHASE_TABLE(BOOT_PHASE_ENUM)
+#undef BOOT_PHASE_ENUM
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/**
+ * @brief Start the boot clock; call first thing in main()
+ */
+void boot_prof_start(void);
+
+/**
+ * @brief Record that a phase was reached (only the first call counts)
+ */
+void boot_prof_mark(boot_phase_t phase);
+
+/**
+ * @brief Whether a phase has been reached
+ */
+bool boot_prof_reached(boot_phase_t phase);
+
+/**
+ * @brief Microseconds from main() to the phase, 0 if not reached yet
+ */
+uint32_t boot_prof_get_us(boot_phase_t phase);
+
+/**
+ * @brief Print the phase timeline (compiled out with BOOT_FAST_ENABLED)
+ */
+void boot_prof_report(void);
+
+#endif // BOOT_PROF_H
@@ -0,0 +1,114 @@
+/**
+ * @file capture.h
+ * @brief Timer input-capture subsystem for pulse and loop-detector timing
+ *
+ * @details TIM2 runs free at 1 MHz. Each detector input feeds two capture
+ *          channels, one per edge, so every pulse is timestamped to 1 us
+ *          without any interrupt:
+ *
+ *          Lane   Pin   Rising edge        Falling edge (DMA request)
+ *          0      PA0   CH1 (TI1 direct)   CH2 (TI1 indirect)
+ *          1      PA3   CH3 (TI4 indirect) CH4 (TI4 direct)
+ *
+ *          Every falling edge triggers a TIM DMA burst (DMA1 Channel 7) that
+ *          copies CCR1..CCR4 into a circular ring. capture_poll() walks the
+ *          new ring entries, extends the 16-bit values to 64-bit microseconds
+ *          against a software-extended counter, and hands the decoded pulses
+ *          (width, period, duty) to the consumer in one batch.
+ *
+ * @note  The 16-bit counter wraps every 65.5 ms, so capture_poll() must run at
+ *        least every CAPTURE_POLL_MAX_MS.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CAPTURE_LANES           2
+#define CAPTURE_RING_SNAPSHOTS  32      /**< Falling edges buffered between polls */
+#define CAPTURE_BATCH_SIZE      16      /**< Pulses handed over per callback */
+#define CAPTURE_POLL_MAX_MS     50      /**< Longest allowed gap between polls */
+#define CAPTURE_MAX_PERIOD_US   60000000UL  /**< Longer gaps report period 0 */
+
+/**
+ * @brief One decoded pulse (rising edge to falling edge)
+ */
+typedef struct {
+    uint64_t rise_us;           /**< Rising edge, local capture time */
+    uint32_t width_us;          /**< High time */
+    uint32_t period_us;         /**< Since the previous rising edge, 0 if unknown */
+    uint16_t duty_permille;     /**< width / period, 0 if period unknown */
+    uint8_t  lane;
+} capture_pulse_t;
+
+typedef void (*capture_batch_fn)(const capture_pulse_t *pulses, uint8_t count);
+
+/**
+ * @brief Start the capture DMA ring and TIM2 channels
+ * @param on_batch Receives decoded pulses from capture_poll()
+ * @return true on success
+ * @note  MX_DMA_Init() and MX_TIM2_Init() must have run
+ */
+bool capture_init(capture_batch_fn on_batch);
+
+/**
+ * @brief Decode new captures and deliver them in batches
+ * @note  Call from one task, at least every CAPTURE_POLL_MAX_MS
+ */
+void capture_poll(void);
+
+/**
+ * @brief Current local capture time in microseconds (64-bit)
+ * @note  Same task as capture_poll()
+ */
+uint64_t capture_now_us(void);
+
+/**
+ * @brief Current local capture time, from any task
+ * @note  Reads the extension without advancing it; capture_poll() must still run
+ */
+uint64_t capture_read_us(void);
+
+/**
+ * @brief Extend a raw TIM2 count latched within the last 65 ms (e.g. by an
+ *        interrupt handler) to local capture time; any task
+ */
+uint64_t capture_extend_raw_us(uint16_t raw);
+
+/**
+ * @brief Feed a (network time, local capture time) pair
+ * @details The first pair sets the offset; later pairs also estimate the rate
+ *          difference between the local crystal and the network clock.
+ * @note  The time functions below may be called from any task.
+ */
+void capture_time_sync(uint64_t network_us, uint64_t local_us);
+
+/**
+ * @brief Convert a local capture timestamp to network time
+ * @return Local time unchanged until the first capture_time_sync()
+ */
+uint64_t capture_to_network_us(uint64_t local_us);
+
+/**
+ * @brief Convert network time to a local capture timestamp
+ */
+uint64_t capture_from_network_us(uint64_t network_us);
+
+/**
+ * @brief True once capture_time_sync() has been called
+ */
+bool capture_time_synced(void);
+
+/**
+ * @brief Local clock rate error against network time, in parts per billion
+ */
+int32_t capture_get_rate_ppb(void);
+
+/**
+ * @brief Total number of decoded pulses
+ */
+uint32_t capture_get_pulse_count(void);
+
+#endif // CAPTURE_H
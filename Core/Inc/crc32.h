@@ -0,0 +1,25 @@
+/**
+ * @file crc32.h
+ * @brief CRC-32 (IEEE 802.3, reflected, as used by zlib and Python's binascii)
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+
+#define CRC32_INIT  0xFFFFFFFFUL
+
+/**
+ * @brief Continue a CRC over more data
+ * @param crc Running value, start with CRC32_INIT
+ * @return Running value; the final CRC is the return value XOR 0xFFFFFFFF
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, uint32_t len);
+
+/**
+ * @brief CRC-32 of one buffer
+ */
+uint32_t crc32(const void *data, uint32_t len);
+
+#endif // CRC32_H
@@ -0,0 +1,33 @@
+/**
+ * @file dwt_cycles.h
+ * @brief DWT cycle counter access (Cortex-M3)
+ *
+ * @details CYCCNT counts core clock cycles (13.9 ns at 72 MHz) and wraps after
+ *          59.6 s. Differences of two reads are valid across one wrap.
+ */
+
+#ifndef DWT_CYCLES_H
+#define DWT_CYCLES_H
+
+#include "main.h"
+
+/**
+ * @brief Enable the cycle counter (idempotent)
+ */
+static inline void dwt_cycles_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+}
+
+static inline uint32_t dwt_cycles_now(void) {
+    return DWT->CYCCNT;
+}
+
+static inline uint32_t dwt_cycles_to_us(uint32_t cycles) {
+    return cycles / (SystemCoreClock / 1000000U);
+}
+
+#endif // DWT_CYCLES_H
@@ -41,6 +41,40 @@ static const uint8_t ETH_CONFIG_DNS[4]     = {8, 8, 8, 8};
 #define ETH_CONFIG_UDP_TARGET_PORT      8000                   // Target port for UDP hello world
 #define ETH_CONFIG_UDP_MESSAGE          "hello world"          // UDP message to send
 
+// === Modbus TCP Server Configuration ===
+#define ETH_CONFIG_MODBUS_PORT          502    // Modbus TCP listening port
+#define ETH_CONFIG_MODBUS_SOCKET_FIRST  4      // First Modbus socket (OPC UA/HTTP slots, not implemented yet)
+#define ETH_CONFIG_MODBUS_SOCKET_COUNT  2      // Number of simultaneous Modbus masters
+
+// === RPC Command Channel Configuration ===
+#define ETH_CONFIG_RPC_SOCKET           3      // UDP socket for the RPC channel (MQTT slot, not implemented yet)
+#define ETH_CONFIG_RPC_CACHE_SIZE       4      // Replies kept for duplicate (retried) requests
+
+// === Traffic Summary Publishing ===
+#define ETH_CONFIG_TRAFFIC_TARGET_IP    {192, 168, 100, 131}  // Collector for aggregated traffic summaries
+#define ETH_CONFIG_TRAFFIC_TARGET_PORT  8001                   // Sent from ETH_CONFIG_UDP_SOCKET (Task03)
+
+// === Benchmark Collector ===
+#define ETH_CONFIG_BENCH_TARGET_IP      {192, 168, 100, 131}  // Host running Tools/bench_collect.py
+#define ETH_CONFIG_BENCH_TARGET_PORT    8002                   // Results and UDP round-trip echo
+
+// === iperf Throughput Server ===
+#define ETH_CONFIG_IPERF_SOCKET         2      // Spare socket for iperf runs (ICMP slot, not implemented yet)
+#define ETH_CONFIG_IPERF_PORT           5001   // iperf2 default port
+
+// === Synchronised Sampling ===
+#define ETH_CONFIG_SYNC_SOCKET          1      // Multicast SYNC/START/STOP (TFTP slot, not implemented yet)
+#define ETH_CONFIG_SYNC_DATA_SOCKET     0      // Sample upload (DHCP slot, static addressing in use)
+#define ETH_CONFIG_SYNC_GROUP           {239, 255, 0, 89}     // Multicast group shared by master and nodes
+#define ETH_CONFIG_SYNC_PORT            8003
+#define ETH_CONFIG_SYNC_COLLECTOR_IP    {192, 168, 100, 131}  // Host running Tools/sync_collect.py
+#define ETH_CONFIG_SYNC_COLLECTOR_PORT  8004
+
+// === Log Shipping ===
+#define ETH_CONFIG_LOG_SOCKET           6      // TCP to the collector (general TCP slot, shared with hello_world_send_tcp())
+#define ETH_CONFIG_LOG_TARGET_IP        {192, 168, 100, 131}  // rsyslog, syslog-ng or Tools/log_collect.py
+#define ETH_CONFIG_LOG_TARGET_PORT      601                    // syslog over TCP (RFC 6587)
+
 // === Global configuration structure ===
 extern wiz_NetInfo g_network_info;
 
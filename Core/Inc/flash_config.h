@@ -5,7 +5,8 @@
  * This file serves as the central configuration point for the W25Q128JVSIQ flash memory
  * driver and related modules. It defines:
  * 
- * 1. Memory layout for the 16MB W25Q128JVSIQ flash chip
+ * 1. Memory layout for the 16MB W25Q128JVSIQ flash chip (LOG, USER and RESERVED
+ *    scale up on the 32/64MB W25Q256/W25Q512)
  * 2. Centralized macros and constants for flash operations
  * 3. Interface references for the driver modules
  * 4. Status and error codes for flash operations
@@ -29,12 +30,17 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "../../Middlewares/In_House/drivers/flash/w25q128.h"
+#include "../../Middlewares/In_House/flash/w25q128.h"
 
 /*---------------------------------------------------------------------------*/
 /* Flash Operation Configuration Parameters                                   */
 /*---------------------------------------------------------------------------*/
 
+/* Build configuration */
+#ifndef FLASH_DRIVER_ENABLED
+#define FLASH_DRIVER_ENABLED      0     /**< Set to 1 once SPI1 and the flash sources are part of the build */
+#endif
+
 /* Debug configuration */
 #define FLASH_DEBUG_ENABLED       0     /**< Set to 1 to enable debug messages */
 
@@ -57,16 +63,59 @@
 #define FLASH_USE_MUTEX           1     /**< Use mutex for thread safety */
 #define FLASH_MUTEX_TIMEOUT       1000  /**< Mutex acquisition timeout */
 
+/* Power management */
+#ifndef FLASH_DPD_IDLE_MS
+#define FLASH_DPD_IDLE_MS         50    /**< Idle time before deep power-down, 0 = never */
+#endif
+
+/* Wear tracking */
+#ifndef FLASH_WEAR_FLUSH_MS
+#define FLASH_WEAR_FLUSH_MS       600000UL  /**< Longest time erase counts stay in RAM */
+#endif
+#define FLASH_WEAR_ENDURANCE      100000UL  /**< Rated erase cycles per sector */
+
 /*---------------------------------------------------------------------------*/
 /* W25Q128 Flash Characteristics                                            */
 /*---------------------------------------------------------------------------*/
 
-/* Use W25Q128's constants directly from the driver */
-#define FLASH_TOTAL_SIZE      W25_FLASH_SIZE        /* 16MB (128Mbit) */
+/* Use W25Q128's constants directly from the driver. The capacity is detected
+   at init (16, 32 or 64MB); the regions marked "scales" below follow it, the
+   firmware, metadata, config and EEPROM regions stay where the bootloader
+   expects them. */
+#define FLASH_TOTAL_SIZE      w25q128_get_size()    /* 16MB on the W25Q128, until init */
+#define FLASH_SIZE_SCALE      (FLASH_TOTAL_SIZE / W25_FLASH_SIZE)   /* 1, 2 or 4 */
 #define FLASH_SECTOR_SIZE     W25_SECTOR_SIZE       /* 4KB sector */
 #define FLASH_BLOCK32K_SIZE   W25_BLOCK32K_SIZE     /* 32KB block */
 #define FLASH_BLOCK64K_SIZE   W25_BLOCK64K_SIZE     /* 64KB block */
-#define FLASH_PAGE_SIZE       W25_PAGE_SIZE        /* 256-byte page (write unit) */
+#define FLASH_PROGRAM_PAGE_SIZE W25_PAGE_SIZE      /* 256-byte page (write unit); FLASH_PAGE_SIZE is taken by the HAL */
+
+/*---------------------------------------------------------------------------*/
+/* Partition Table                                                           */
+/*---------------------------------------------------------------------------*/
+
+/* Region boundaries are read from the partition table (w25q128_part.h),
+   cached in RAM at boot; the addresses below are its defaults, written on
+   first boot. LOG and USER can grow into RESERVED at runtime. The firmware
+   area (BOOT, slots, META) is marked fixed: the bootloader has it built in. */
+typedef enum {
+    FLASH_PART_BOOT = 0,
+    FLASH_PART_FW_A,
+    FLASH_PART_FW_B,
+    FLASH_PART_FW_C,
+    FLASH_PART_META,
+    FLASH_PART_CONFIG,
+    FLASH_PART_EEPROM,
+    FLASH_PART_LOG,
+    FLASH_PART_USER_DATA,
+    FLASH_PART_RESERVED,
+    FLASH_PART_COUNT
+} flash_part_id_t;
+
+extern uint32_t w25q128_part_base(flash_part_id_t id);
+extern uint32_t w25q128_part_size(flash_part_id_t id);
+
+/* Two copies in the last two sectors of META, outside the remapped range */
+#define PART_TABLE_ADDR       (META_DEFAULT_ADDR + META_DEFAULT_SIZE - 2 * FLASH_SECTOR_SIZE)
 
 /*---------------------------------------------------------------------------*/
 /* Firmware Storage - 3MB total                                             */
@@ -76,23 +125,28 @@
 #define FIRMWARE_BASE_ADDR    0x000000UL
 
 /* Factory bootloader - 256KB, protected from overwrite */
-#define BOOT_ADDR             (FIRMWARE_BASE_ADDR)
-#define BOOT_SIZE             (256UL * 1024)
+#define BOOT_DEFAULT_ADDR     (FIRMWARE_BASE_ADDR)
+#define BOOT_DEFAULT_SIZE     (256UL * 1024)
+#define BOOT_ADDR             w25q128_part_base(FLASH_PART_BOOT)
+#define BOOT_SIZE             w25q128_part_size(FLASH_PART_BOOT)
 
 /* Firmware slot size - 768KB per slot to accommodate larger firmware */
-#define FW_SLOT_SIZE          (768UL * 1024)
+#define FW_SLOT_DEFAULT_SIZE  (768UL * 1024)
+#define FW_SLOT_SIZE          w25q128_part_size(FLASH_PART_FW_A)
 
 /* Three firmware slots (current, update target, and fallback) */
-#define FW_SLOT_A_ADDR        (BOOT_ADDR + BOOT_SIZE)              /* 0x040000 - Active firmware */
-#define FW_SLOT_B_ADDR        (FW_SLOT_A_ADDR + FW_SLOT_SIZE)      /* 0x100000 - OTA update target */
-#define FW_SLOT_C_ADDR        (FW_SLOT_B_ADDR + FW_SLOT_SIZE)      /* 0x1C0000 - Fallback image */
+#define FW_SLOT_A_ADDR        w25q128_part_base(FLASH_PART_FW_A)  /* 0x040000 - Active firmware */
+#define FW_SLOT_B_ADDR        w25q128_part_base(FLASH_PART_FW_B)  /* 0x100000 - OTA update target */
+#define FW_SLOT_C_ADDR        w25q128_part_base(FLASH_PART_FW_C)  /* 0x1C0000 - Fallback image */
 
 /*---------------------------------------------------------------------------*/
-/* Metadata Storage - 128KB total with redundancy                           */
+/* Metadata Storage - 256KB: three 32KB copies, partition table at the top  */
 /*---------------------------------------------------------------------------*/
 
 /* Metadata region base */
-#define META_BASE_ADDR        0x280000UL
+#define META_DEFAULT_ADDR     0x280000UL
+#define META_DEFAULT_SIZE     (256UL * 1024)
+#define META_BASE_ADDR        w25q128_part_base(FLASH_PART_META)
 
 /* Each copy is 32KB (aligned to erase blocks for reliability) */
 #define META_COPY_SIZE        (32UL * 1024)
@@ -113,8 +167,10 @@
 /* Configuration Storage - 256KB                                             */
 /*---------------------------------------------------------------------------*/
 
-#define CONFIG_BASE_ADDR      0x2C0000UL
-#define CONFIG_SIZE           (256UL * 1024)
+#define CONFIG_DEFAULT_ADDR   0x2C0000UL
+#define CONFIG_DEFAULT_SIZE   (256UL * 1024)
+#define CONFIG_BASE_ADDR      w25q128_part_base(FLASH_PART_CONFIG)
+#define CONFIG_SIZE           w25q128_part_size(FLASH_PART_CONFIG)
 #define CONFIG_COPY1_ADDR     (CONFIG_BASE_ADDR)
 #define CONFIG_COPY2_ADDR     (CONFIG_BASE_ADDR + (CONFIG_SIZE / 2))
 
@@ -122,34 +178,66 @@
 /* EEPROM Emulation - 512KB with wear leveling                              */
 /*---------------------------------------------------------------------------*/
 
-#define EEPROM_BASE_ADDR      0x300000UL
-#define EEPROM_SIZE           (512UL * 1024)
+#define EEPROM_DEFAULT_ADDR   0x300000UL
+#define EEPROM_DEFAULT_SIZE   (512UL * 1024)
+#define EEPROM_BASE_ADDR      w25q128_part_base(FLASH_PART_EEPROM)
+#define EEPROM_SIZE           w25q128_part_size(FLASH_PART_EEPROM)
 
 /* EEPROM emulation is divided into sectors for wear leveling */
 #define EEPROM_SECTOR_COUNT   (EEPROM_SIZE / FLASH_SECTOR_SIZE)
 #define EEPROM_HEADER_SIZE    8           /* Bytes for sector header (counter, status) */
 
 /*---------------------------------------------------------------------------*/
-/* Logging Area - 1MB circular buffer                                        */
+/* Logging Area - 1MB circular buffer per 16MB of flash (scales, can grow)   */
 /*---------------------------------------------------------------------------*/
 
-#define LOG_BASE_ADDR         0x380000UL
-#define LOG_SIZE              (1UL * 1024 * 1024)
+#define LOG_DEFAULT_ADDR      0x380000UL
+#define LOG_DEFAULT_SIZE      (1UL * 1024 * 1024 * FLASH_SIZE_SCALE)
+#define LOG_BASE_ADDR         w25q128_part_base(FLASH_PART_LOG)
+#define LOG_SIZE              w25q128_part_size(FLASH_PART_LOG)
 #define LOG_HEADER_SIZE       16          /* Log header size (timestamp, type, etc.) */
 
 /*---------------------------------------------------------------------------*/
-/* User Data Storage - 8MB                                                   */
+/* User Data Storage - 8MB, everything between log and reserved (scales)     */
 /*---------------------------------------------------------------------------*/
 
-#define USER_DATA_BASE_ADDR   0x480000UL
-#define USER_DATA_SIZE        (8UL * 1024 * 1024)
+#define USER_DATA_BASE_ADDR   w25q128_part_base(FLASH_PART_USER_DATA)   /* 0x480000 on 16MB */
+#define USER_DATA_SIZE        w25q128_part_size(FLASH_PART_USER_DATA)
+/* Holds the file store (w25q128_fs.h) */
 
 /*---------------------------------------------------------------------------*/
-/* Reserved Area - 3MB for future expansion                                  */
+/* Reserved Area - 3.5MB at the end of the chip                              */
 /*---------------------------------------------------------------------------*/
 
-#define RESERVED_BASE_ADDR    0xC80000UL
-#define RESERVED_SIZE         (3UL * 1024 * 1024)
+/* The 3MB region for future expansion plus the 512KB tail the 16MB map never
+   assigned, so RESERVED stays at 0xC80000 and USER_DATA at 8MB on a W25Q128.
+   The remap and wear areas below fit in that tail. */
+#define RESERVED_DEFAULT_SIZE (3UL * 1024 * 1024 + 512UL * 1024)
+#define RESERVED_BASE_ADDR    w25q128_part_base(FLASH_PART_RESERVED)    /* 0xC80000 on 16MB */
+#define RESERVED_SIZE         w25q128_part_size(FLASH_PART_RESERVED)
+
+/* Bad-sector remapping (w25q128_remap.h): table and spares at the top of
+   RESERVED, for sectors from CONFIG up to RESERVED */
+#define REMAP_SPARE_COUNT     32
+#define REMAP_TABLE_ADDR      (FLASH_TOTAL_SIZE - 2 * FLASH_SECTOR_SIZE)     /* Two copies */
+#define REMAP_SPARE_BASE_ADDR (REMAP_TABLE_ADDR - REMAP_SPARE_COUNT * FLASH_SECTOR_SIZE)
+#define REMAP_REGION_START    CONFIG_BASE_ADDR
+#define REMAP_REGION_END      RESERVED_BASE_ADDR
+
+/* Erase counters (w25q128_wear.h): two banks of one u32 per sector plus a
+   header sector, below the remap spares (10 sectors on 16MB, 34 on 64MB) */
+#define WEAR_BANK_SIZE        ((FLASH_TOTAL_SIZE / FLASH_SECTOR_SIZE) * 4 + FLASH_SECTOR_SIZE)
+#define WEAR_AREA_SIZE        (2 * WEAR_BANK_SIZE)
+#define WEAR_BASE_ADDR        (REMAP_SPARE_BASE_ADDR - WEAR_AREA_SIZE)
+
+/* Growing a partition leaves at least this much RESERVED: the remap and wear
+   areas and the benchmark scratch sector at its bottom */
+#define RESERVED_MIN_SIZE     ((REMAP_SPARE_COUNT + 3) * FLASH_SECTOR_SIZE + WEAR_AREA_SIZE)
+
+/* Streaming scratch (iperf.h flash payload): the free part of RESERVED between
+   the benchmark sector and the wear area, none once shrunk to RESERVED_MIN_SIZE */
+#define SCRATCH_BASE_ADDR     (RESERVED_BASE_ADDR + FLASH_SECTOR_SIZE)
+#define SCRATCH_SIZE          (WEAR_BASE_ADDR - SCRATCH_BASE_ADDR)
 
 /*---------------------------------------------------------------------------*/
 /* Flash Management Macros                                                   */
@@ -192,7 +280,8 @@ typedef enum {
     FLASH_STATUS_PROTECTED = -4,     /**< Flash area is protected */
     FLASH_STATUS_NOT_ALIGNED = -5,   /**< Address not aligned properly */
     FLASH_STATUS_CRC_ERROR = -6,     /**< Data integrity check failed */
-    FLASH_STATUS_NO_MEMORY = -7      /**< Insufficient memory for operation */
+    FLASH_STATUS_NO_MEMORY = -7,     /**< Insufficient memory for operation */
+    FLASH_STATUS_NOT_FOUND = -8      /**< No such file or record */
 } flash_status_t;
 
 /*---------------------------------------------------------------------------*/
@@ -206,6 +295,9 @@ typedef enum {
 extern bool w25q128_init(void);
 extern bool w25q128_eeprom_init(void);
 extern bool w25q128_log_init(void);
+extern bool w25q128_remap_init(void);
+extern bool w25q128_part_init(void);
+extern bool w25q128_wear_init(void);
 extern bool w25q128_meta_init(void);
 
 #endif /* FLASH_CONFIG_H */
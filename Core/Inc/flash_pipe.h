@@ -0,0 +1,62 @@
+/**
+ * @file flash_pipe.h
+ * @brief Moves data between W5500 socket buffers and the flash, both buses busy
+ *
+ * @details The W5500 (SPI2) and the flash (SPI1) have their own buses and DMA
+ *          channels. Data goes through two page-sized RAM buffers: while one
+ *          chunk crosses one bus, the next crosses the other, and the CPU only
+ *          starts transfers and swaps buffers.
+ *
+ *          Flash to socket (image or asset serving, log replay): chunk n+1 is
+ *          read from flash on SPI1 DMA while chunk n is written into the
+ *          socket TX buffer on SPI2 DMA.
+ *
+ *          Socket to flash (OTA): the chip programs chunk n while chunk n+1
+ *          is read out of the socket RX buffer on SPI2 DMA. The page itself
+ *          is short on the bus next to the program time it overlaps.
+ *
+ *          Both keep to the socket zero-copy conventions (w5500_socket.h):
+ *          the caller owns the buffer pointers and commits them. Flash
+ *          addresses are logical and go through w25q128_remap.h: each page
+ *          is read back once its program completes, before the next one
+ *          starts. Inside the remapped region (REMAP_REGION_START ..
+ *          REMAP_REGION_END) a failing sector moves to a spare like any
+ *          other remapped write. Outside it, which includes the firmware
+ *          slots and the RESERVED scratch iperf streams into, nothing is
+ *          remapped and a failed verify aborts the transfer.
+ *
+ *          The transfer runs at about the rate of the slower side instead of
+ *          the sum of both. On the host build DMA completes in the call, so
+ *          there the two sides add up.
+ *
+ * @note  Needs the flash driver (FLASH_DRIVER_ENABLED). Call from one task at
+ *        a time: the buffers are shared.
+ */
+
+#ifndef FLASH_PIPE_H
+#define FLASH_PIPE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_config.h"
+
+#define FLASH_PIPE_CHUNK            FLASH_PROGRAM_PAGE_SIZE     /* One program page per step */
+
+/**
+ * @brief Copy len bytes of flash at addr into the socket TX buffer at ptr
+ * @param ptr TX pointer, from w5500_socket_tx_begin() or a previous call
+ * @return ptr advanced by len
+ */
+uint16_t flash_pipe_to_socket(uint8_t sock, uint16_t ptr, uint32_t addr, uint16_t len);
+
+/**
+ * @brief Program len bytes from the socket RX buffer at ptr into flash at addr
+ * @param ptr RX pointer, from w5500_socket_rx_begin() or a previous call
+ * @note  Each sector is erased when the write reaches its first byte; a write
+ *        starting inside a sector expects the rest of it erased.
+ * @return false if an erase or program failed and was not remapped (no spare,
+ *         or addr outside the remapped region)
+ */
+bool flash_pipe_from_socket(uint8_t sock, uint16_t ptr, uint32_t addr, uint16_t len);
+
+#endif // FLASH_PIPE_H
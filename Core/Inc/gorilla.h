@@ -0,0 +1,81 @@
+/**
+ * @file gorilla.h
+ * @brief Streaming time-series compression for telemetry datagrams
+ *
+ * @details Records of a 32-bit timestamp and up to GORILLA_MAX_CHANNELS 32-bit
+ *          values are packed into a bit stream, MSB first, after the Gorilla
+ *          scheme (Pelkonen et al., VLDB 2015):
+ *
+ *          Timestamp, delta-of-delta D against the previous two (mod 2^32):
+ *              '0'                     D == 0
+ *              '10'   + 7 bits         D in [-64, 63]
+ *              '110'  + 9 bits         D in [-256, 255]
+ *              '1110' + 12 bits        D in [-2048, 2047]
+ *              '1111' + 32 bits        anything else
+ *
+ *          Integer channel, delta d against the previous value (mod 2^32):
+ *              '0'                     d == 0
+ *              '1' + varint(zigzag(d) - 1), 4-bit groups from the least
+ *                                      significant: continue bit, 3 data bits
+ *
+ *          XOR channel (bit patterns such as floats), x = value ^ previous:
+ *              '0'                     x == 0
+ *              '10' + bits             x fits the previous window of
+ *                                      meaningful bits
+ *              '11' + lead:5 + (len - 1):5 + len bits, a new window
+ *
+ *          The state starts from zero (timestamp, delta, values, no window)
+ *          at gorilla_begin(), so each datagram decodes on its own: the first
+ *          two records pay for the full timestamp, after which a steady
+ *          cadence costs one bit per record and a quiet channel one bit per
+ *          value. Tools/gorilla.py is the decoder.
+ *
+ * @note  All state lives in the caller's gorilla_stream_t; nothing is
+ *        allocated and the stack use is small.
+ */
+
+#ifndef GORILLA_H
+#define GORILLA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define GORILLA_MAX_CHANNELS    4
+#define GORILLA_NO_WINDOW       0xFF    /* XOR channel has no window yet */
+
+typedef struct {
+    uint8_t  *buf;
+    uint16_t cap;               /**< Bytes */
+    uint32_t bits;              /**< Written so far */
+    uint16_t count;             /**< Records in the stream */
+    uint8_t  channels;
+    uint8_t  xor_mask;          /**< Bit n set: channel n is XOR-coded, else delta */
+    uint32_t prev_ts;
+    uint32_t prev_delta;
+    uint32_t prev[GORILLA_MAX_CHANNELS];
+    uint8_t  lead[GORILLA_MAX_CHANNELS];    /**< XOR window */
+    uint8_t  len[GORILLA_MAX_CHANNELS];
+} gorilla_stream_t;
+
+/**
+ * @brief Start a stream in buf (one datagram payload)
+ * @param channels 1 .. GORILLA_MAX_CHANNELS values per record
+ * @param xor_mask Channels to XOR-code; the others are delta-coded integers
+ */
+void gorilla_begin(gorilla_stream_t *s, uint8_t *buf, uint16_t cap, uint8_t channels, uint8_t xor_mask);
+
+/**
+ * @brief Append one record
+ * @param values s->channels values
+ * @return false, with the stream unchanged, if the record does not fit
+ */
+bool gorilla_put(gorilla_stream_t *s, uint32_t ts, const uint32_t *values);
+
+/**
+ * @brief Bytes used so far (the last one padded with zero bits)
+ */
+static inline uint16_t gorilla_size(const gorilla_stream_t *s) {
+    return (uint16_t)((s->bits + 7) / 8);
+}
+
+#endif // GORILLA_H
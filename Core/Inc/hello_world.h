@@ -6,6 +6,10 @@
 #ifndef HELLO_WORLD_H
 #define HELLO_WORLD_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #include <stdint.h>
 
 /**
@@ -16,10 +20,15 @@ int32_t hello_world_send_udp(void);
 
 /**
  * @brief Send TCP hello world message to specific target
+ * @note  Implemented with the C++ socket facade (hello_world_tcp.cpp)
  * @param dest_ip Destination IP address (4 bytes)
  * @param dest_port Destination port
  * @return Number of bytes sent or negative error code
  */
 int32_t hello_world_send_tcp(const uint8_t* dest_ip, uint16_t dest_port);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // HELLO_WORLD_H
\ No newline at end of file
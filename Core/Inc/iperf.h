@@ -0,0 +1,136 @@
+/**
+ * @file iperf.h
+ * @brief iperf2-compatible throughput server and client on the W5500
+ *
+ * @details Measures TCP and UDP throughput with a stock iperf2 on the other
+ *          end, on one spare socket (ETH_CONFIG_IPERF_SOCKET):
+ *
+ *          Mode     Device                       Host
+ *          TCP_RX   server, listens (default)    iperf -c <device>
+ *          UDP_RX   server                       iperf -c <device> -u -b 2M
+ *          TCP_TX   client for duration_s        iperf -s
+ *          UDP_TX   client at rate_kbps          iperf -s -u
+ *
+ *          Runs are started over RPC (Tools/rpc_client.py iperf ...). After a
+ *          client run the server mode in effect before it is restored.
+ *
+ *          Payload is discarded or generated in place in the W5500 buffers:
+ *          received data is dropped by moving Sn_RX_RD, and sent data is the
+ *          TX ring, filled with the iperf pattern once per run, so only
+ *          pointers cross SPI. The UDP datagram headers are still read and
+ *          written. IPERF_FLAG_SPI_PAYLOAD also moves every payload byte over
+ *          SPI (through a small scratch buffer, no further copy), which is
+ *          what an application consuming or producing the data pays.
+ *          IPERF_FLAG_FLASH_PAYLOAD (TCP only) streams it between the socket
+ *          and the RESERVED scratch area (SCRATCH_BASE_ADDR) through
+ *          flash_pipe.h instead, as an OTA download or image upload would:
+ *          TCP_RX programs the received stream into the scratch (erasing it
+ *          as it goes), TCP_TX sends its contents. Both wrap after one
+ *          firmware slot's worth, or at the end of the scratch if smaller.
+ *          The firmware slots are never touched.
+ *
+ *          Wire format follows iperf 2.1: a 16-byte UDP header (id, tv_sec,
+ *          tv_usec, id2) and, for UDP_RX, the server report answered to the
+ *          client's final datagram. Client headers are sent with no flags, so
+ *          the peer treats the test as a plain stream. UDP jitter (RFC 1889)
+ *          uses arrival times taken once per poll, so its resolution is the
+ *          Task00 period.
+ *
+ *          The poll works for at most IPERF_POLL_SLICE_MS per call, which
+ *          bounds the latency added to Modbus and RPC while a run is active.
+ */
+
+#ifndef IPERF_H
+#define IPERF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Build with -DIPERF_ENABLED=0 to drop the server and its socket */
+#ifndef IPERF_ENABLED
+#define IPERF_ENABLED               1
+#endif
+
+#define IPERF_POLL_SLICE_MS         10      /* Longest time spent in one iperf_poll() */
+#define IPERF_CONNECT_TIMEOUT_MS    3000    /* TCP_TX connection attempt */
+#define IPERF_FIN_RETRIES           10      /* UDP_TX final datagrams without a report */
+#define IPERF_FIN_WAIT_MS           250     /* Wait for the report after each one */
+#define IPERF_DEFAULT_DURATION_S    10
+#define IPERF_DEFAULT_UDP_LEN       1470    /* iperf -u default datagram size */
+#define IPERF_MIN_UDP_LEN           64
+#define IPERF_MAX_UDP_LEN           1472    /* One Ethernet frame */
+
+/* Run flags */
+#define IPERF_FLAG_SPI_PAYLOAD      0x01    /* Move payload bytes over SPI too */
+#define IPERF_FLAG_FLASH_PAYLOAD    0x02    /* TCP: payload to or from the flash scratch */
+
+typedef enum {
+    IPERF_MODE_OFF = 0,
+    IPERF_MODE_TCP_RX,
+    IPERF_MODE_UDP_RX,
+    IPERF_MODE_TCP_TX,
+    IPERF_MODE_UDP_TX,
+    IPERF_MODE_COUNT
+} iperf_mode_t;
+
+typedef enum {
+    IPERF_STATE_IDLE = 0,       /**< Off, or server waiting for a client */
+    IPERF_STATE_CONNECTING,     /**< TCP_TX connection in progress */
+    IPERF_STATE_RUNNING,        /**< Data flowing */
+    IPERF_STATE_FINISHING,      /**< UDP_TX waiting for the server report */
+    IPERF_STATE_DONE,           /**< Last run complete, results below */
+    IPERF_STATE_FAILED          /**< Last run aborted (connect, timeout, reset) */
+} iperf_state_t;
+
+/**
+ * @brief Results of the current or last run
+ * @note  For UDP_TX, lost/out_of_order/jitter come from the server report
+ *        and stay 0 if none arrived.
+ */
+typedef struct {
+    uint8_t  mode;              /**< iperf_mode_t of the run */
+    uint8_t  state;             /**< iperf_state_t */
+    uint8_t  flags;             /**< IPERF_FLAG_xxx of the run */
+    uint32_t bytes;             /**< Payload bytes, UDP headers included */
+    uint32_t elapsed_ms;
+    uint32_t kbps;              /**< bytes * 8 / elapsed_ms */
+    uint32_t datagrams;         /**< UDP: datagrams sent by the client */
+    uint32_t lost;
+    uint32_t out_of_order;
+    uint32_t jitter_us;
+    uint32_t runs;              /**< Completed runs since boot */
+} iperf_stats_t;
+
+/**
+ * @brief Start the TCP server on ETH_CONFIG_IPERF_PORT
+ * @return true if the socket is listening
+ */
+bool iperf_init(void);
+
+/**
+ * @brief Switch the server mode or start a client run
+ * @param mode       Server mode (OFF, TCP_RX, UDP_RX) or client run (TCP_TX, UDP_TX)
+ * @param ip         Server address for client runs, ignored otherwise
+ * @param port       Port to listen on or connect to, 0 for ETH_CONFIG_IPERF_PORT
+ * @param duration_s Client run length, 0 for IPERF_DEFAULT_DURATION_S
+ * @param len        UDP_TX datagram size, 0 for IPERF_DEFAULT_UDP_LEN
+ * @param rate_kbps  UDP_TX target rate, 0 for as fast as possible
+ * @param flags      IPERF_FLAG_xxx
+ * @return true if the parameters are valid and the socket could be opened
+ */
+bool iperf_start(iperf_mode_t mode, const uint8_t *ip, uint16_t port, uint16_t duration_s,
+                 uint16_t len, uint32_t rate_kbps, uint8_t flags);
+
+/**
+ * @brief Service the iperf socket
+ * @note  Call periodically from the same task as the other socket services.
+ *        Idle cost is one SIR register read.
+ */
+void iperf_poll(void);
+
+/**
+ * @brief Get the results of the current or last run
+ */
+void iperf_get_stats(iperf_stats_t *stats);
+
+#endif // IPERF_H
@@ -0,0 +1,83 @@
+/**
+ * @file log_ship.h
+ * @brief Ships the flash log (w25q128_log.h) to a remote syslog collector
+ *
+ * @details Records are sent as RFC 5424 messages over TCP with octet-counting
+ *          framing (RFC 6587), so rsyslog, syslog-ng or Tools/log_collect.py
+ *          can receive them directly:
+ *
+ *              LEN <PRI>1 - HOST fw - - [meta sequenceId="SEQ" sysUpTime="T"] MSG
+ *
+ *          PRI is LOG_SHIP_FACILITY * 8 + the record severity, HOST the
+ *          device IP and T the record tick in hundredths of a second (there
+ *          is no wall clock, so TIMESTAMP is the nil value).
+ *
+ *          One batch of whole records, at most LOG_SHIP_BATCH_MAX bytes (one
+ *          TCP segment), is in flight at a time. When the W5500 TX buffer has
+ *          drained, the peer has acknowledged it and the cursor moves past
+ *          it. The cursor is written to the log's journal sector every
+ *          LOG_SHIP_PERSIST_MS, so after a reset, a dropped connection or a
+ *          collector outage shipping resumes from the last acknowledged
+ *          record. Delivery is at least once; sequenceId lets the collector
+ *          drop repeats. Records overwritten before they could be shipped are
+ *          counted as lost.
+ *
+ *          A batch only starts while the egress path is idle: no iperf run or
+ *          synchronised sampling run active and no other socket with data
+ *          waiting in its TX buffer. Logs therefore never compete with
+ *          real-time traffic, and catch up in the gaps.
+ *
+ * @note  Uses ETH_CONFIG_LOG_SOCKET. Call log_ship_poll() from one task only.
+ */
+
+#ifndef LOG_SHIP_H
+#define LOG_SHIP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_config.h"
+
+/* Needs the flash log; build with -DLOG_SHIP_ENABLED=0 to keep the log local */
+#ifndef LOG_SHIP_ENABLED
+#define LOG_SHIP_ENABLED            FLASH_DRIVER_ENABLED
+#endif
+
+#define LOG_SHIP_BATCH_MAX          1460    /* One TCP segment (MSS) */
+#define LOG_SHIP_FRAME_MAX          208     /* Framed message with the longest record */
+#define LOG_SHIP_RETRY_MS           5000    /* Reconnect interval while the collector is away */
+#define LOG_SHIP_CONNECT_TIMEOUT_MS 3000
+#define LOG_SHIP_PERSIST_MS         10000   /* Cursor journal writes at most this often */
+#define LOG_SHIP_FACILITY           16      /* local0 */
+#define LOG_SHIP_APP_NAME           "fw"
+
+typedef enum {
+    LOG_SHIP_STATE_IDLE = 0,    /**< Not connected, waiting to retry */
+    LOG_SHIP_STATE_CONNECTING,
+    LOG_SHIP_STATE_CONNECTED
+} log_ship_state_t;
+
+typedef struct {
+    uint8_t  state;             /**< log_ship_state_t */
+    uint32_t cursor;            /**< Next record to ship (all before it acknowledged) */
+    uint32_t shipped;           /**< Records acknowledged since boot */
+    uint32_t batches;
+    uint32_t lost;              /**< Records overwritten or damaged before shipping */
+    uint32_t deferred;          /**< Polls that had records but found the egress busy */
+    uint32_t connects;
+} log_ship_stats_t;
+
+/**
+ * @brief Load the persisted cursor
+ * @note  Call after w25q128_log_init()
+ */
+void log_ship_init(void);
+
+/**
+ * @brief Connect, ship a batch if the egress path is idle, persist the cursor
+ * @note  Call every 100 ms or so, after the W5500 is up
+ */
+void log_ship_poll(void);
+
+void log_ship_get_stats(log_ship_stats_t *stats);
+
+#endif // LOG_SHIP_H
@@ -0,0 +1,92 @@
+/**
+ * @file modbus_map.h
+ * @brief Modbus TCP register and coil map
+ *
+ * @details The whole Modbus address space is declared in the two tables below.
+ *          Blocks are laid out back to back from address 0 in declaration
+ *          order, so addresses never overlap. Each block points at the live
+ *          application variable that backs it - there is no shadow register
+ *          image - and modbus_map.c checks every block size against its
+ *          storage at compile time.
+ *
+ *          X(name, count, storage, access)
+ *            name    : block name, generates MODBUS_REG_<name> / MODBUS_COIL_<name>
+ *            count   : number of 16-bit registers (or coils) in the block
+ *            storage : lvalue backing the block (scalar or array)
+ *            access  : MODBUS_ACCESS_RO or MODBUS_ACCESS_RW
+ *
+ *          Multi-register values are stored low word first (native order).
+ */
+
+#ifndef MODBUS_MAP_H
+#define MODBUS_MAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MODBUS_ACCESS_RO    0
+#define MODBUS_ACCESS_RW    1
+
+/* Number of user holding registers / coils exposed to masters */
+#define MODBUS_USER_REG_COUNT   16
+#define MODBUS_USER_COIL_COUNT  16
+
+/*============================================================================*/
+/* REGISTER MAP (holding registers FC03/06/16, input registers FC04)          */
+/*============================================================================*/
+#define MODBUS_REGISTER_MAP(X)                                                  \
+    X(UPTIME_MS,     2,                     uwTick,               MODBUS_ACCESS_RO) \
+    X(TASK00,        2,                     task00,               MODBUS_ACCESS_RO) \
+    X(TASK01,        2,                     task01,               MODBUS_ACCESS_RO) \
+    X(TASK02,        2,                     task02,               MODBUS_ACCESS_RO) \
+    X(TASK03,        2,                     task03,               MODBUS_ACCESS_RO) \
+    X(MB_REQUESTS,   2,                     modbus_stat_requests, MODBUS_ACCESS_RO) \
+    X(MB_EXCEPTIONS, 2,                     modbus_stat_exceptions, MODBUS_ACCESS_RO) \
+    X(USER,          MODBUS_USER_REG_COUNT, modbus_user_regs,     MODBUS_ACCESS_RW)
+
+/*============================================================================*/
+/* COIL MAP (FC01/05/15, discrete inputs FC02)                                */
+/*============================================================================*/
+#define MODBUS_COIL_MAP(X)                                                      \
+    X(USER,          MODBUS_USER_COIL_COUNT, modbus_user_coils,   MODBUS_ACCESS_RW)
+
+/* Start address of every block, e.g. MODBUS_REG_TASK00 */
+enum {
+#define MODBUS_MAP_ENUM(name, count, storage, access) \
+    MODBUS_REG_##name, MODBUS_REG_##name##_LAST = MODBUS_REG_##name + (count) - 1,
+    MODBUS_REGISTER_MAP(MODBUS_MAP_ENUM)
+#undef MODBUS_MAP_ENUM
+    MODBUS_REG_COUNT
+};
+
+enum {
+#define MODBUS_MAP_ENUM(name, count, storage, access) \
+    MODBUS_COIL_##name, MODBUS_COIL_##name##_LAST = MODBUS_COIL_##name + (count) - 1,
+    MODBUS_COIL_MAP(MODBUS_MAP_ENUM)
+#undef MODBUS_MAP_ENUM
+    MODBUS_COIL_COUNT
+};
+
+/**
+ * @brief One contiguous block of the map
+ */
+typedef struct {
+    uint16_t start;     /**< First Modbus address of the block */
+    uint16_t count;     /**< Registers (or coils) in the block */
+    void *storage;      /**< Backing storage: uint16_t[] or packed uint8_t[] */
+    uint8_t access;     /**< MODBUS_ACCESS_RO / MODBUS_ACCESS_RW */
+} modbus_block_t;
+
+/* Storage owned by the Modbus module */
+extern volatile uint32_t modbus_stat_requests;
+extern volatile uint32_t modbus_stat_exceptions;
+extern uint16_t modbus_user_regs[MODBUS_USER_REG_COUNT];
+extern uint8_t modbus_user_coils[(MODBUS_USER_COIL_COUNT + 7) / 8];
+
+/* Tables generated from the maps above */
+extern const modbus_block_t modbus_register_blocks[];
+extern const uint8_t modbus_register_block_count;
+extern const modbus_block_t modbus_coil_blocks[];
+extern const uint8_t modbus_coil_block_count;
+
+#endif /* MODBUS_MAP_H */
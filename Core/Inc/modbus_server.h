@@ -0,0 +1,57 @@
+/**
+ * @file modbus_server.h
+ * @brief Modbus TCP server on the W5500
+ *
+ * @details Serves the register/coil map declared in modbus_map.h to several
+ *          masters at once, one W5500 socket per master. Responses are built
+ *          directly in the socket TX buffer; no full-frame copy is made in MCU RAM.
+ *
+ *          Supported function codes: 01, 02, 03, 04, 05, 06, 15, 16.
+ */
+
+#ifndef MODBUS_SERVER_H
+#define MODBUS_SERVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Modbus function codes */
+#define MODBUS_FC_READ_COILS            0x01
+#define MODBUS_FC_READ_DISCRETE_INPUTS  0x02
+#define MODBUS_FC_READ_HOLDING_REGS     0x03
+#define MODBUS_FC_READ_INPUT_REGS       0x04
+#define MODBUS_FC_WRITE_SINGLE_COIL     0x05
+#define MODBUS_FC_WRITE_SINGLE_REG      0x06
+#define MODBUS_FC_WRITE_MULTIPLE_COILS  0x0F
+#define MODBUS_FC_WRITE_MULTIPLE_REGS   0x10
+
+/* Modbus exception codes */
+#define MODBUS_EX_ILLEGAL_FUNCTION      0x01
+#define MODBUS_EX_ILLEGAL_DATA_ADDRESS  0x02
+#define MODBUS_EX_ILLEGAL_DATA_VALUE    0x03
+
+/* Protocol limits (Modbus Application Protocol v1.1b3) */
+#define MODBUS_MBAP_SIZE                7
+#define MODBUS_MAX_PDU_SIZE             253
+#define MODBUS_MAX_READ_REGS            125
+#define MODBUS_MAX_READ_COILS           2000
+#define MODBUS_MAX_WRITE_REGS           123
+#define MODBUS_MAX_WRITE_COILS          1968
+
+/* Interval for the full socket state sweep (reopen closed sockets, etc.) */
+#define MODBUS_SERVER_SWEEP_MS          100
+
+/**
+ * @brief Open and listen on all Modbus sockets
+ * @return true if every socket is listening
+ */
+bool modbus_server_init(void);
+
+/**
+ * @brief Service pending Modbus requests
+ * @note  Call periodically (every 1 ms) from a single task. Idle cost is one
+ *        SIR register read.
+ */
+void modbus_server_poll(void);
+
+#endif // MODBUS_SERVER_H
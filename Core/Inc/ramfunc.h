@@ -0,0 +1,35 @@
+/**
+ * @file ramfunc.h
+ * @brief Placement of hot routines in SRAM
+ *
+ * @details At 72 MHz the flash needs two wait states, and every prefetch
+ *          miss (each taken branch in a tight loop) pays them. Functions
+ *          marked RAMFUNC go to the .ramfunc section, which the startup code
+ *          copies from flash to SRAM before main(), and run without wait
+ *          states. FreeRTOS's tick and context switch and newlib's memcpy
+ *          are placed there by name in STM32F103C8TX_FLASH.ld.
+ *
+ *          Every byte here comes out of the 20 KB of RAM: keep RAMFUNC for
+ *          short loops that dominate a measured path, and check the cost
+ *          with Tools/ram_budget.py. The linker enforces _Ramfunc_Budget.
+ *
+ *          Calls between flash and RAM go through a linker veneer (the two
+ *          regions are further apart than a BL can reach), so RAMFUNC code
+ *          should be leaf code or call other RAMFUNC code.
+ */
+
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+/* Build with -DRAMFUNC_ENABLED=0 to keep RAMFUNC code in flash (A/B benchmarks) */
+#ifndef RAMFUNC_ENABLED
+#define RAMFUNC_ENABLED         1
+#endif
+
+#if RAMFUNC_ENABLED && defined(__arm__)
+#define RAMFUNC                 __attribute__((section(".ramfunc"), noinline))
+#else
+#define RAMFUNC
+#endif
+
+#endif // RAMFUNC_H
@@ -0,0 +1,113 @@
+/* Generated by Tools/rpc_gen.py from Tools/rpc_schema.json - do not edit */
+#ifndef RPC_SCHEMA_H
+#define RPC_SCHEMA_H
+
+#include <stdint.h>
+
+#define RPC_SCHEMA_VERSION      1
+#define RPC_MAGIC               0x52
+#define RPC_PORT                5005
+#define RPC_HEADER_SIZE         8
+#define RPC_MAX_PAYLOAD         96
+
+/* Status codes */
+#define RPC_STATUS_OK               0
+#define RPC_STATUS_BAD_REQUEST      1
+#define RPC_STATUS_UNKNOWN_OP       2
+#define RPC_STATUS_UNKNOWN_KEY      3
+#define RPC_STATUS_UNSUPPORTED      4
+#define RPC_STATUS_FAILED           5
+
+/* Opcodes */
+typedef enum {
+    RPC_OP_PING = 0,
+    RPC_OP_GET_CONFIG = 1,
+    RPC_OP_SET_CONFIG = 2,
+    RPC_OP_GET_METRICS = 3,
+    RPC_OP_FLASH_READ = 4,
+    RPC_OP_FLASH_ERASE = 5,
+    RPC_OP_FLASH_WRITE = 6,
+    RPC_OP_REBOOT = 7,
+    RPC_OP_GET_BOOT_PROFILE = 8,
+    RPC_OP_IPERF = 9,
+    RPC_OP_GET_IPERF = 10,
+    RPC_OP_SYNC = 11,
+    RPC_OP_SYNC_START = 12,
+    RPC_OP_GET_SYNC = 13,
+    RPC_OP_GET_FLASH_POWER = 14,
+    RPC_OP_GET_PARTITION = 15,
+    RPC_OP_GROW_PARTITION = 16,
+    RPC_OP_GET_WEAR = 17,
+    RPC_OP_TRACE = 18,
+    RPC_OP_GET_TRACE = 19,
+    RPC_OP_COUNT
+} rpc_op_t;
+
+/* Configuration keys: X(id, name, size) */
+#define RPC_CONFIG_KEY_TABLE(X) \
+    X(0, net_mac, 6) \
+    X(1, net_ip, 4) \
+    X(2, net_subnet, 4) \
+    X(3, net_gateway, 4) \
+    X(4, net_dns, 4) \
+    X(5, task00_period_ms, 2) \
+    X(6, task01_period_ms, 2) \
+    X(7, task02_period_ms, 2) \
+    X(8, task03_period_ms, 2)
+
+typedef enum {
+    RPC_KEY_NET_MAC = 0,
+    RPC_KEY_NET_IP = 1,
+    RPC_KEY_NET_SUBNET = 2,
+    RPC_KEY_NET_GATEWAY = 3,
+    RPC_KEY_NET_DNS = 4,
+    RPC_KEY_TASK00_PERIOD_MS = 5,
+    RPC_KEY_TASK01_PERIOD_MS = 6,
+    RPC_KEY_TASK02_PERIOD_MS = 7,
+    RPC_KEY_TASK03_PERIOD_MS = 8,
+    RPC_KEY_COUNT
+} rpc_config_key_t;
+
+/* Operation flags */
+#define RPC_FLAG_CACHED         0x01    /**< Reply cached so retries are not re-executed */
+
+/**
+ * @brief RPC handler
+ * @param req Request payload (after the header)
+ * @param req_len Request payload length
+ * @param reply Reply payload buffer (RPC_MAX_PAYLOAD bytes)
+ * @return Reply payload length, or -RPC_STATUS_x on error
+ */
+typedef int16_t (*rpc_handler_t)(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+
+typedef struct {
+    rpc_handler_t handler;
+    uint8_t flags;
+} rpc_op_entry_t;
+
+/* Handlers implemented in rpc_server.c */
+int16_t rpc_handle_ping(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_get_config(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_set_config(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_get_metrics(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_flash_read(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_flash_erase(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_flash_write(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_reboot(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_get_boot_profile(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_iperf(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_get_iperf(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_sync(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_sync_start(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_get_sync(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_get_flash_power(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_get_partition(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_grow_partition(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_get_wear(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_trace(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+int16_t rpc_handle_get_trace(const uint8_t *req, uint16_t req_len, uint8_t *reply);
+
+/* Jump table indexed by opcode (rpc_dispatch.c) */
+extern const rpc_op_entry_t rpc_op_table[RPC_OP_COUNT];
+
+#endif /* RPC_SCHEMA_H */
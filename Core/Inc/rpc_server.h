@@ -0,0 +1,44 @@
+/**
+ * @file rpc_server.h
+ * @brief Binary RPC command channel over UDP
+ *
+ * @details Runtime configuration and control without rebuilding the firmware.
+ *          The wire format, opcodes and configuration keys are defined once in
+ *          Tools/rpc_schema.json; rpc_schema.h and the handler jump table in
+ *          rpc_dispatch.c are generated from it by Tools/rpc_gen.py.
+ *
+ *          Datagram: 8-byte header (magic, version, op, status, request_id)
+ *          followed by the op payload, all big-endian. Replies echo the header
+ *          with the status filled in. Replies to state-changing ops are cached
+ *          per (source, request_id), so a retried request returns the original
+ *          reply instead of executing twice.
+ */
+
+#ifndef RPC_SERVER_H
+#define RPC_SERVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Delay between the reboot reply and the actual reset */
+#define RPC_REBOOT_DELAY_MS     100
+
+/**
+ * @brief Open the RPC socket
+ * @return true on success
+ */
+bool rpc_server_init(void);
+
+/**
+ * @brief Service pending RPC requests
+ * @note  Call periodically from the same task as the other socket services
+ */
+void rpc_server_poll(void);
+
+/**
+ * @brief Get RPC statistics
+ */
+uint32_t rpc_server_get_request_count(void);
+uint32_t rpc_server_get_retry_count(void);
+
+#endif // RPC_SERVER_H
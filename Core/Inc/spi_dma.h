@@ -0,0 +1,46 @@
+/**
+ * @file spi_dma.h
+ * @brief Register-level SPI transfers on DMA1, started and finished separately
+ *
+ * @details The split-phase companion of spi_pump.h: spi_dma_start() sets up
+ *          the channels and returns while the bytes move, so the CPU can
+ *          start a transfer on the other bus before calling spi_dma_wait().
+ *          Chip select stays with the caller, as with the pump.
+ *
+ *          Instance   RX channel      TX channel
+ *          SPI1       DMA1 channel 2  DMA1 channel 3
+ *          SPI2       DMA1 channel 4  DMA1 channel 5
+ *
+ *          Completion is polled, no interrupts are used. A transmit-only
+ *          transfer leaves the RX channel off and drops the overrun it causes
+ *          at the end, as the pump does.
+ */
+
+#ifndef SPI_DMA_H
+#define SPI_DMA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "main.h"
+
+/**
+ * @brief Start a full-duplex transfer of len bytes and return
+ * @param tx Bytes to send, or NULL to send 0x00
+ * @param rx Buffer for received bytes, or NULL to discard them
+ * @note  Both buffers must stay valid until spi_dma_wait()
+ */
+void spi_dma_start(SPI_TypeDef *spi, const uint8_t *tx, uint8_t *rx, uint16_t len);
+
+/**
+ * @brief Wait for the transfer started on spi and release its channels
+ */
+void spi_dma_wait(SPI_TypeDef *spi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPI_DMA_H
@@ -0,0 +1,38 @@
+/**
+ * @file spi_pump.h
+ * @brief Register-level SPI byte pump shared by the W5500 and W25Q128 drivers
+ *
+ * @details Replaces HAL_SPI_Transmit/Receive/TransmitReceive on the hot
+ *          paths: no handle locking, state machine or per-byte timeout
+ *          checks, and the loops run from RAM (ramfunc.h). Chip select stays
+ *          with the caller.
+ *
+ *          Transmit-only transfers keep the shift register and DR both full,
+ *          so the clock runs without gaps between bytes; received bytes are
+ *          discarded and the overrun they cause is cleared at the end.
+ *          Transfers that receive keep one byte in flight, so an interrupt
+ *          between bytes cannot overrun the receiver.
+ */
+
+#ifndef SPI_PUMP_H
+#define SPI_PUMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "main.h"
+
+/**
+ * @brief Full-duplex transfer of len bytes
+ * @param tx Bytes to send, or NULL to send 0x00
+ * @param rx Buffer for received bytes, or NULL to discard them
+ */
+void spi_pump_xfer(SPI_TypeDef *spi, const uint8_t *tx, uint8_t *rx, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPI_PUMP_H
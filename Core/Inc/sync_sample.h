@@ -0,0 +1,172 @@
+/**
+ * @file sync_sample.h
+ * @brief Multicast-triggered synchronised ADC sampling across nodes
+ *
+ * @details One node is the master; it multicasts SYNC pulses and START/STOP
+ *          commands to ETH_CONFIG_SYNC_GROUP. All nodes, the master included,
+ *          then sample ADC1 and ADC2 simultaneously on a common grid
+ *
+ *              sample i at network time start_us + i * period_us
+ *
+ *          so runs on adjacent intersections line up sample for sample.
+ *
+ *          Network time is the capture time base (capture.h), aligned to the
+ *          master's: the W5500 INTn line (PA8, EXTI) latches TIM2 when the
+ *          master's SYNC frame leaves (SENDOK) and when it arrives at a node
+ *          (RECV). Each SYNC carries the master's send time of the previous
+ *          one, and the node feeds (that time, its own receive time) to
+ *          capture_time_sync(), which tracks offset and crystal rate. Both
+ *          timestamps are taken in hardware-bounded interrupt latency, not
+ *          in the poll, so task scheduling does not enter the alignment.
+ *
+ *          TIM4 CC4 triggers the ADC pair (regular simultaneous dual mode);
+ *          DMA1 Channel 1 writes the 32-bit results into a circular ring.
+ *          TIM4 is armed in the poll shortly before the start instant and
+ *          its counter is nudged by at most SYNC_SAMPLE_SLEW_MAX_US per poll
+ *          to keep the edges on the network grid as the clock model moves.
+ *          A node that hears START late, or syncs late, joins at the next
+ *          grid index, so its samples still line up.
+ *
+ *          Samples go to the collector (Tools/sync_collect.py) in DATA
+ *          datagrams from ETH_CONFIG_SYNC_DATA_SOCKET. All messages start
+ *          with SYNC_SAMPLE_MAGIC and a type byte, fields big-endian:
+ *
+ *          SYNC   type, seq:u16, prev_tx_us:u64                       (12 bytes)
+ *          START  type, seq:u16, run_id:u32, start_us:u64,
+ *                 period_us:u32, count:u32                           (24 bytes)
+ *          STOP   type, seq:u16, run_id:u32                           (8 bytes)
+ *          DATA   type, flags:u8, channels:u8, n:u16, error_us:u16,
+ *                 run_id:u32, first_index:u32, period_us:u32,
+ *                 first_us:u64, then n samples as the DMA wrote them
+ *                 (32-bit little-endian: ADC1 in bits 0-11, ADC2 in 16-27)
+ *                 or, with SYNC_SAMPLE_DATA_PACKED, one gorilla.h stream of
+ *                 n records: timestamp i - first_index, values ADC1, ADC2
+ *
+ * @note  Uses sockets ETH_CONFIG_SYNC_SOCKET and ETH_CONFIG_SYNC_DATA_SOCKET,
+ *        TIM4, ADC1/ADC2, DMA1 Channel 1 and EXTI line 8.
+ */
+
+#ifndef SYNC_SAMPLE_H
+#define SYNC_SAMPLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Build with -DSYNC_SAMPLE_ENABLED=0 to drop the module, its sockets and TIM4 use */
+#ifndef SYNC_SAMPLE_ENABLED
+#define SYNC_SAMPLE_ENABLED             1
+#endif
+
+#define SYNC_SAMPLE_MAGIC               0x53    /* 'S' */
+#define SYNC_SAMPLE_DEFAULT_SYNC_MS     1000    /* Master SYNC interval */
+#define SYNC_SAMPLE_DEFAULT_DELAY_MS    500     /* START lead time */
+#define SYNC_SAMPLE_START_REPEATS       3       /* START/STOP sent this often ... */
+#define SYNC_SAMPLE_START_GAP_MS        50      /* ... this far apart */
+#define SYNC_SAMPLE_MIN_PERIOD_US       100     /* Ring drained every poll up to 10 kS/s */
+#define SYNC_SAMPLE_MAX_PERIOD_US       65536   /* TIM4 at 1 MHz, 16 bits */
+#define SYNC_SAMPLE_RING                128     /* DMA ring, samples (4 bytes each) */
+#define SYNC_SAMPLE_BLOCK               64      /* Samples per DATA datagram */
+#define SYNC_SAMPLE_FLUSH_MS            100     /* Partial blocks sent after this */
+#define SYNC_SAMPLE_ARM_WINDOW_US       30000   /* TIM4 armed this close to the first edge */
+#define SYNC_SAMPLE_ARM_MARGIN_US       200     /* Closer than this: join at the next index */
+#define SYNC_SAMPLE_SLEW_MAX_US         4       /* Phase correction per poll */
+#define SYNC_SAMPLE_OUTLIER_US          500     /* SYNC pairs further off are skipped ... */
+#define SYNC_SAMPLE_OUTLIER_LIMIT       3       /* ... unless this many in a row (clock step) */
+
+/* Build with -DSYNC_SAMPLE_PACKED=0 to send raw DMA words. Packed blocks carry
+   the same samples in roughly a third of the bytes on a quiet signal. */
+#ifndef SYNC_SAMPLE_PACKED
+#define SYNC_SAMPLE_PACKED              1
+#endif
+
+/* SENDOK on the master to RECV on a node through one switch: one minimum
+   frame (5.8 us at 100 Mbit/s) plus switch latency. Calibrate by sampling the
+   same signal on two nodes. */
+#ifndef SYNC_SAMPLE_PATH_DELAY_US
+#define SYNC_SAMPLE_PATH_DELAY_US       8
+#endif
+
+/* DATA flags */
+#define SYNC_SAMPLE_DATA_OVERRUN        0x01    /* Samples lost before this block */
+#define SYNC_SAMPLE_DATA_LAST           0x02    /* Run complete */
+#define SYNC_SAMPLE_DATA_PACKED         0x04    /* Samples gorilla-coded */
+
+typedef enum {
+    SYNC_ROLE_OFF = 0,
+    SYNC_ROLE_NODE,
+    SYNC_ROLE_MASTER,
+    SYNC_ROLE_COUNT
+} sync_role_t;
+
+typedef enum {
+    SYNC_STATE_IDLE = 0,        /**< No run */
+    SYNC_STATE_PENDING,         /**< Run received, waiting for sync or the start */
+    SYNC_STATE_SAMPLING,        /**< TIM4 armed or running */
+    SYNC_STATE_DONE,            /**< Run complete or stopped */
+    SYNC_STATE_MISSED           /**< Run ended before this node could join */
+} sync_state_t;
+
+typedef enum {
+    SYNC_MSG_SYNC = 1,
+    SYNC_MSG_START,
+    SYNC_MSG_STOP,
+    SYNC_MSG_DATA
+} sync_msg_t;
+
+typedef struct {
+    uint8_t  role;              /**< sync_role_t */
+    uint8_t  state;             /**< sync_state_t */
+    bool     synced;            /**< Clock aligned to the master (always true on the master) */
+    uint32_t run_id;
+    uint32_t syncs;             /**< SYNC pairs applied (node) or sent (master) */
+    uint32_t outliers;          /**< SYNC pairs skipped */
+    int32_t  rate_ppb;          /**< Local crystal against the master */
+    int32_t  error_us;          /**< Last SYNC: predicted minus master time */
+    uint32_t max_error_us;      /**< Largest |error_us| since the role was set */
+    uint32_t samples;           /**< Samples sent in the current or last run */
+    uint32_t blocks;
+    uint32_t overruns;          /**< Ring overruns (samples lost) */
+} sync_sample_stats_t;
+
+/**
+ * @brief Calibrate the ADCs and join the group as a node
+ * @return true if the sockets are open
+ */
+bool sync_sample_init(void);
+
+/**
+ * @brief Change role
+ * @param role           OFF closes the sockets
+ * @param sync_ms        Master SYNC interval, 0 for SYNC_SAMPLE_DEFAULT_SYNC_MS
+ * @param collector_ip   DATA destination, NULL to keep the current one
+ * @param collector_port DATA port, 0 to keep the current one
+ * @return true if the sockets could be opened
+ */
+bool sync_sample_set_role(sync_role_t role, uint16_t sync_ms, const uint8_t *collector_ip,
+                          uint16_t collector_port);
+
+/**
+ * @brief Start (master only) a run on all nodes
+ * @param delay_ms  Lead time, 0 for SYNC_SAMPLE_DEFAULT_DELAY_MS
+ * @param period_us Sample period, 0 to stop the current run
+ * @param count     Samples per node, 0 until stopped
+ * @param run_id    Receives the new run ID (may be NULL)
+ * @return false if not master or the period is out of range
+ */
+bool sync_sample_start(uint16_t delay_ms, uint32_t period_us, uint32_t count, uint32_t *run_id);
+
+/**
+ * @brief Service the sockets, arm TIM4, trim its phase and send samples
+ * @note  Call from the same task as the other socket services, every 1 ms
+ *        or so: the ring holds SYNC_SAMPLE_RING periods.
+ */
+void sync_sample_poll(void);
+
+/**
+ * @brief W5500 INTn falling edge (EXTI line 8): latch the capture clock
+ */
+void sync_sample_irq(void);
+
+void sync_sample_get_stats(sync_sample_stats_t *stats);
+
+#endif // SYNC_SAMPLE_H
@@ -0,0 +1,159 @@
+/**
+ * @file trace.h
+ * @brief Scheduler and ISR event trace, streamed over UDP or ITM
+ *
+ * @details Events come from the FreeRTOS trace hooks (task switched in, task
+ *          made ready, task created), from markers at ISR entry and exit and
+ *          from spans around the waits that matter for latency: flash busy
+ *          polling, the flash driver mutex, SPI DMA and W5500 SEND. Each
+ *          event is 8 bytes, stamped with DWT CYCCNT:
+ *
+ *              cycles u32, type u8, id u8, arg u16
+ *
+ *          id is the FreeRTOS task number (uxTCBNumber) for task events, the
+ *          exception number (IPSR) for ISR events and a trace_span_t for
+ *          spans. Recording takes a few dozen cycles with interrupts masked;
+ *          it only writes the RAM ring. trace_poll() drains the ring from
+ *          Task00:
+ *
+ *          - UDP: datagrams of up to TRACE_UDP_EVENTS events from the RPC
+ *            socket to the collector (Tools/trace_collect.py), big-endian:
+ *
+ *                magic u8 'T', version u8, count u8, flags u8,
+ *                seq u32, clock_hz u32, dropped u32, then the events
+ *
+ *            With TRACE_FLAG_NAMES set the entries are task names instead,
+ *            {id u8, name[15]}; they are sent at start and every
+ *            TRACE_NAMES_MS so a late collector can label the tasks.
+ *          - ITM: each event as two little-endian words on stimulus port
+ *            TRACE_ITM_PORT (cycles, then type | id << 8 | arg << 16), task
+ *            names as text lines "T<id> <name>" and the clock as "C<hz>" on
+ *            TRACE_ITM_NAME_PORT. Capture the SWO stream to a file with the
+ *            probe software and pass it to the collector with --itm.
+ *
+ *          When the ring is full, events are counted and dropped, and the
+ *          next one recorded is a TRACE_EV_DROPPED with the count, so gaps
+ *          show in the trace.
+ *
+ * @note  This header is included by FreeRTOSConfig.h and must stay free of
+ *        device and kernel headers. The hooks cost cycles in every context
+ *        switch and 1.5 KB of RAM: build with -DTRACE_ENABLED=1 to compile
+ *        them in.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Build with -DTRACE_ENABLED=1 to compile in the recorder and its hooks */
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED               0
+#endif
+
+#define TRACE_RING_EVENTS           128     /* Power of two, 8 bytes each */
+#define TRACE_MAX_TASKS             12      /* Task numbers 1..11 get names */
+#define TRACE_NAME_LEN              16      /* configMAX_TASK_NAME_LEN */
+#define TRACE_UDP_EVENTS            32      /* Events per datagram */
+#define TRACE_UDP_PORT              8003    /* Default collector port */
+#define TRACE_FLUSH_MS              20      /* Send a partial datagram after this long */
+#define TRACE_NAMES_MS              1000
+#define TRACE_ITM_PORT              1       /* Event words */
+#define TRACE_ITM_NAME_PORT         2       /* Task name and clock lines */
+
+#define TRACE_MAGIC                 0x54    /* 'T' */
+#define TRACE_VERSION               1
+#define TRACE_HEADER_SIZE           16
+#define TRACE_EVENT_SIZE            8
+#define TRACE_FLAG_NAMES            0x01
+
+/* Outputs, for trace_start() */
+#define TRACE_OUT_UDP               0x01
+#define TRACE_OUT_ITM               0x02
+
+typedef enum {
+    TRACE_EV_TASK_IN = 0,       /**< id = task number now running */
+    TRACE_EV_TASK_READY,        /**< id = task number made ready */
+    TRACE_EV_ISR_ENTER,         /**< id = exception number */
+    TRACE_EV_ISR_EXIT,
+    TRACE_EV_SPAN_BEGIN,        /**< id = trace_span_t */
+    TRACE_EV_SPAN_END,
+    TRACE_EV_DROPPED,           /**< arg = events lost before this one */
+    TRACE_EV_COUNT
+} trace_event_t;
+
+typedef enum {
+    TRACE_SPAN_FLASH_BUSY = 0,  /**< Polling the flash BUSY bit */
+    TRACE_SPAN_FLASH_LOCK,      /**< Waiting for the flash driver mutex */
+    TRACE_SPAN_SPI_DMA,         /**< Waiting for a DMA transfer, arg = SPI bus 1 or 2 */
+    TRACE_SPAN_W5500_SEND,      /**< Waiting for SENDOK, arg = socket */
+    TRACE_SPAN_COUNT
+} trace_span_t;
+
+typedef struct {
+    uint8_t  out;               /**< TRACE_OUT_ bits, 0 when stopped */
+    uint32_t recorded;
+    uint32_t dropped;           /**< Ring full */
+    uint32_t sent;              /**< Events handed to the output */
+    uint32_t datagrams;         /**< UDP datagrams sent */
+} trace_stats_t;
+
+#if TRACE_ENABLED
+
+/**
+ * @brief Append one event to the ring; any context, interrupts may be masked
+ */
+void trace_record(uint8_t type, uint8_t id, uint16_t arg);
+
+/**
+ * @brief Remember the name of task number id (traceTASK_CREATE)
+ */
+void trace_task_create(uint8_t id, const char *name);
+
+/* FreeRTOS hooks (FreeRTOSConfig.h); pxCurrentTCB and the TCB fields are
+ * visible where the kernel expands them */
+#define traceTASK_SWITCHED_IN() \
+    trace_record(TRACE_EV_TASK_IN, (uint8_t)pxCurrentTCB->uxTCBNumber, 0)
+#define traceMOVED_TASK_TO_READY_STATE(pxTCB) \
+    trace_record(TRACE_EV_TASK_READY, (uint8_t)(pxTCB)->uxTCBNumber, 0)
+#define traceTASK_CREATE(pxNewTCB) \
+    trace_task_create((uint8_t)(pxNewTCB)->uxTCBNumber, (pxNewTCB)->pcTaskName)
+
+/* First and last statement of an instrumented handler */
+#define TRACE_ISR_ENTER()           trace_record(TRACE_EV_ISR_ENTER, (uint8_t)__get_IPSR(), 0)
+#define TRACE_ISR_EXIT()            trace_record(TRACE_EV_ISR_EXIT, (uint8_t)__get_IPSR(), 0)
+
+#define TRACE_SPAN_BEGIN(span, arg) trace_record(TRACE_EV_SPAN_BEGIN, (span), (uint16_t)(arg))
+#define TRACE_SPAN_END(span, arg)   trace_record(TRACE_EV_SPAN_END, (span), (uint16_t)(arg))
+
+#else
+
+#define TRACE_ISR_ENTER()           ((void)0)
+#define TRACE_ISR_EXIT()            ((void)0)
+#define TRACE_SPAN_BEGIN(span, arg) ((void)0)
+#define TRACE_SPAN_END(span, arg)   ((void)0)
+
+#endif /* TRACE_ENABLED */
+
+/**
+ * @brief Start streaming, or stop with out = 0
+ * @param out  TRACE_OUT_UDP and/or TRACE_OUT_ITM
+ * @param ip   Collector for UDP
+ * @param port Collector port, 0 for TRACE_UDP_PORT
+ * @return false if out is invalid, or ITM was asked for and is not enabled
+ * @note  Empties the ring: the stream starts with task names and new events.
+ *        UDP output stops by itself when a send fails (collector gone).
+ */
+bool trace_start(uint8_t out, const uint8_t *ip, uint16_t port);
+
+/**
+ * @brief Send what the ring holds
+ * @note  Call from the task that runs rpc_server_poll(): UDP output uses the
+ *        RPC socket.
+ */
+void trace_poll(void);
+
+void trace_get_stats(trace_stats_t *stats);
+
+#endif // TRACE_H
@@ -0,0 +1,126 @@
+/**
+ * @file traffic_agg.h
+ * @brief On-device traffic aggregation engine
+ *
+ * @details Turns per-vehicle detection events into per-lane interval summaries
+ *          (count, occupancy, headway, speed histogram) so only the summaries
+ *          go upstream.
+ *
+ *          Memory is fixed: each window is a ring of pre-allocated buckets and
+ *          the rolling value of a window is the sum of its ring.
+ *
+ *          Window   Bucket   Buckets   Published
+ *          1 s      1 s      1         every second
+ *          1 min    10 s     6         on every minute boundary
+ *          15 min   1 min    15        on every quarter-hour boundary
+ *
+ *          Producers (capture ISR, sensor task) call traffic_agg_submit(); events
+ *          are queued and folded into the buckets by traffic_agg_tick().
+ */
+
+#ifndef TRAFFIC_AGG_H
+#define TRAFFIC_AGG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Engine dimensions */
+#define TRAFFIC_AGG_LANES           2       /**< Detector lanes */
+#define TRAFFIC_AGG_SPEED_BINS      8       /**< Speed histogram bins */
+#define TRAFFIC_AGG_EVENT_QUEUE     32      /**< Pending events (power of 2) */
+#define TRAFFIC_AGG_MAX_HEADWAY_MS  60000   /**< Longer gaps are not counted as headway */
+
+/* Upper edges of the speed bins in km/h; the last bin is open-ended */
+#define TRAFFIC_AGG_SPEED_EDGES     {10, 20, 30, 40, 50, 60, 80}
+
+/* Summary datagram ("T", version 1, big-endian) */
+#define TRAFFIC_AGG_MAGIC           0x54
+#define TRAFFIC_AGG_VERSION         1
+#define TRAFFIC_AGG_HEADER_SIZE     8
+#define TRAFFIC_AGG_LANE_SIZE       (12 + 2 * TRAFFIC_AGG_SPEED_BINS)
+#define TRAFFIC_AGG_PACKET_SIZE     (TRAFFIC_AGG_HEADER_SIZE + TRAFFIC_AGG_LANES * TRAFFIC_AGG_LANE_SIZE)
+
+typedef enum {
+    TRAFFIC_WINDOW_1S = 0,
+    TRAFFIC_WINDOW_1MIN,
+    TRAFFIC_WINDOW_15MIN,
+    TRAFFIC_WINDOW_COUNT
+} traffic_window_t;
+
+/**
+ * @brief One vehicle detection
+ */
+typedef struct {
+    uint32_t timestamp_ms;      /**< Arrival time (HAL_GetTick domain) */
+    uint16_t occupancy_ms;      /**< Time the detector was occupied */
+    uint16_t speed_kmh_x10;     /**< Speed in 0.1 km/h, 0 if not measured */
+    uint8_t  lane;              /**< 0 .. TRAFFIC_AGG_LANES-1 */
+} traffic_event_t;
+
+/**
+ * @brief Per-lane window statistics
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t occupancy_ms;
+    uint32_t headway_sum_ms;
+    uint32_t headway_count;
+    uint32_t speed_sum_x10;
+    uint32_t speed_count;
+    uint32_t speed_hist[TRAFFIC_AGG_SPEED_BINS];
+} traffic_lane_stats_t;
+
+/**
+ * @brief Window summary as published
+ */
+typedef struct {
+    traffic_window_t window;
+    uint32_t end_ms;            /**< Window end time (HAL_GetTick domain) */
+    uint32_t length_ms;
+    traffic_lane_stats_t lane[TRAFFIC_AGG_LANES];
+} traffic_summary_t;
+
+typedef void (*traffic_publish_fn)(const traffic_summary_t *summary);
+
+/**
+ * @brief Reset all windows and start aggregating at now_ms
+ * @param publish Called for every completed window, may be NULL
+ */
+void traffic_agg_init(uint32_t now_ms, traffic_publish_fn publish);
+
+/**
+ * @brief Queue a detection event
+ * @return false if the queue is full (event dropped)
+ * @note  Safe from one ISR or task producer; the consumer is traffic_agg_tick()
+ */
+bool traffic_agg_submit(const traffic_event_t *event);
+
+/**
+ * @brief Fold queued events into the buckets and close elapsed windows
+ * @note  Call periodically (at least every few seconds) from one task
+ */
+void traffic_agg_tick(uint32_t now_ms);
+
+/**
+ * @brief Get the rolling statistics of a window (including the open bucket)
+ */
+void traffic_agg_get_window(traffic_window_t window, traffic_summary_t *out);
+
+/**
+ * @brief Encode a summary into the compact datagram format
+ * @param buf At least TRAFFIC_AGG_PACKET_SIZE bytes
+ * @return Encoded length
+ */
+uint16_t traffic_agg_encode(const traffic_summary_t *summary, uint8_t *buf);
+
+/**
+ * @brief Publisher that sends encoded summaries to the traffic collector over UDP
+ */
+void traffic_agg_publish_udp(const traffic_summary_t *summary);
+
+/**
+ * @brief Number of events dropped because the queue was full
+ */
+uint32_t traffic_agg_get_dropped(void);
+
+#endif // TRAFFIC_AGG_H
@@ -0,0 +1,315 @@
+/**
+ * @file bench.c
+ * @brief On-target microbenchmark suite implementation
+ */
+
+#include "bench.h"
+
+#if BENCH_ENABLED
+
+#include "dwt_cycles.h"
+#include "ramfunc.h"
+#include "crc32.h"
+#include "w5500_socket.h"
+#include "eth_config.h"
+#include "flash_config.h"
+#include "cmsis_os.h"
+#include "wizchip_conf.h"
+#include "w5500.h"
+#include "w5500_regs.h"
+#include <string.h>
+#include <stdio.h>
+
+#define BENCH_SOCKET        ETH_CONFIG_UDP_SOCKET
+
+typedef bool (*bench_fn)(uint32_t param);
+
+static uint8_t bench_buf[BENCH_BUF_SIZE];
+static uint8_t bench_dst[BENCH_BUF_SIZE];
+static uint8_t bench_packet[BENCH_HEADER_SIZE + BENCH_RECORDS_PER_PACKET * BENCH_RECORD_SIZE];
+static const uint8_t bench_target_ip[4] = ETH_CONFIG_BENCH_TARGET_IP;
+static volatile uint32_t bench_sink;
+
+// ============================================================================
+// KERNELS
+// ============================================================================
+
+static bool bench_empty(uint32_t param) {
+    return true;
+}
+
+static bool bench_w5500_reg_read(uint32_t param) {
+    bench_sink = getVERSIONR();
+    return true;
+}
+
+/* Same register through the compile-time map (w5500_regs.hpp) */
+static bool bench_w5500_reg_read_map(uint32_t param) {
+    bench_sink = w5500_reg_get_versionr();
+    return true;
+}
+
+/* 16-bit counter: one frame per byte, sampled until stable (ioLibrary) */
+static bool bench_w5500_rsr(uint32_t param) {
+    bench_sink = getSn_RX_RSR(BENCH_SOCKET);
+    return true;
+}
+
+/* 16-bit counter: one burst per sample */
+static bool bench_w5500_rsr_map(uint32_t param) {
+    bench_sink = w5500_reg_get_sn_rx_rsr(BENCH_SOCKET);
+    return true;
+}
+
+static bool bench_w5500_reg_write(uint32_t param) {
+    WIZCHIP_WRITE(Sn_DPORT(BENCH_SOCKET), (uint8_t)param);
+    return true;
+}
+
+static bool bench_w5500_burst_read(uint32_t param) {
+    WIZCHIP_READ_BUF((WIZCHIP_TXBUF_BLOCK(BENCH_SOCKET) << 3), bench_buf, (uint16_t)param);
+    return true;
+}
+
+static bool bench_w5500_burst_write(uint32_t param) {
+    WIZCHIP_WRITE_BUF((WIZCHIP_TXBUF_BLOCK(BENCH_SOCKET) << 3), bench_buf, (uint16_t)param);
+    return true;
+}
+
+/* First byte 0: neither a result nor an echo probe, the collector drops it */
+static bool bench_udp_tx(uint32_t param) {
+    bench_buf[0] = 0;
+    return w5500_socket_sendto(BENCH_SOCKET, bench_buf, (uint16_t)param, bench_target_ip,
+                               ETH_CONFIG_BENCH_TARGET_PORT) > 0;
+}
+
+static bool bench_udp_tx_cpp(uint32_t param) {
+    bench_buf[0] = 0;
+    return bench_socket_udp_tx(BENCH_SOCKET, bench_buf, (uint16_t)param, bench_target_ip,
+                               ETH_CONFIG_BENCH_TARGET_PORT);
+}
+
+static bool bench_sock_rsr(uint32_t param) {
+    bench_sink = w5500_socket_get_rx_buf_size(BENCH_SOCKET);
+    return true;
+}
+
+static bool bench_sock_rsr_cpp(uint32_t param) {
+    bench_sink = bench_socket_rx_size(BENCH_SOCKET);
+    return true;
+}
+
+static bool bench_udp_rtt(uint32_t param) {
+    bench_buf[0] = BENCH_ECHO_MAGIC;
+    if (w5500_socket_sendto(BENCH_SOCKET, bench_buf, (uint16_t)param, bench_target_ip,
+                            ETH_CONFIG_BENCH_TARGET_PORT) <= 0) {
+        return false;
+    }
+
+    uint32_t start = HAL_GetTick();
+    while ((HAL_GetTick() - start) < BENCH_RTT_TIMEOUT_MS) {
+        if (w5500_socket_get_rx_buf_size(BENCH_SOCKET) > 0) {
+            uint8_t ip[4];
+            uint16_t port;
+            int32_t len = w5500_socket_recvfrom(BENCH_SOCKET, bench_dst, sizeof(bench_dst), ip, &port);
+            return (len == (int32_t)param && bench_dst[0] == BENCH_ECHO_MAGIC);
+        }
+    }
+    return false;
+}
+
+#if FLASH_DRIVER_ENABLED
+/* Scratch sector at the start of the reserved region */
+#define BENCH_FLASH_ADDR    RESERVED_BASE_ADDR
+
+static bool bench_flash_read(uint32_t param) {
+    return w25q128_read_bytes(BENCH_FLASH_ADDR, bench_buf, param);
+}
+
+static bool bench_flash_program(uint32_t param) {
+    static uint32_t offset = 0;
+    bool ok = w25q128_write_page(BENCH_FLASH_ADDR + offset, bench_buf, param);
+    offset = (offset + FLASH_PROGRAM_PAGE_SIZE) % FLASH_SECTOR_SIZE;
+    return ok;
+}
+
+static bool bench_flash_erase(uint32_t param) {
+    return w25q128_erase_sector(BENCH_FLASH_ADDR);
+}
+#endif /* FLASH_DRIVER_ENABLED */
+
+static bool bench_memcpy(uint32_t param) {
+    memcpy(bench_dst, bench_buf, param);
+    return true;
+}
+
+static bool bench_crc32(uint32_t param) {
+    bench_sink = crc32(bench_buf, param);
+    return true;
+}
+
+static bool bench_printf(uint32_t param) {
+    printf("bench %lu\n", (unsigned long)param);
+    return true;
+}
+
+static bool bench_snprintf(uint32_t param) {
+    snprintf((char *)bench_dst, sizeof(bench_dst), "T%lu:%u.%03u", (unsigned long)param, 12u, 345u);
+    return true;
+}
+
+static bool bench_ctx_switch(uint32_t param) {
+    osThreadYield();
+    return true;
+}
+
+/*
+ * Kernel table: X(name, function, param, iterations)
+ */
+#if FLASH_DRIVER_ENABLED
+#define BENCH_FLASH_KERNELS(X) \
+    X("flash_read",    bench_flash_read,    256,  50) \
+    X("flash_program", bench_flash_program, 256,  16) \
+    X("flash_erase",   bench_flash_erase,   4096, 4)
+#else
+#define BENCH_FLASH_KERNELS(X)
+#endif
+
+#define BENCH_KERNELS(X) \
+    X("w5500_rd",      bench_w5500_reg_read,    1,    200) \
+    X("w5500_rd_map",  bench_w5500_reg_read_map, 1,   200) \
+    X("w5500_rsr",     bench_w5500_rsr,         2,    200) \
+    X("w5500_rsr_map", bench_w5500_rsr_map,     2,    200) \
+    X("w5500_wr",      bench_w5500_reg_write,   1,    200) \
+    X("w5500_brd",     bench_w5500_burst_read,  16,   50) \
+    X("w5500_brd",     bench_w5500_burst_read,  64,   50) \
+    X("w5500_brd",     bench_w5500_burst_read,  256,  50) \
+    X("w5500_brd",     bench_w5500_burst_read,  1024, 20) \
+    X("w5500_bwr",     bench_w5500_burst_write, 16,   50) \
+    X("w5500_bwr",     bench_w5500_burst_write, 64,   50) \
+    X("w5500_bwr",     bench_w5500_burst_write, 256,  50) \
+    X("w5500_bwr",     bench_w5500_burst_write, 1024, 20) \
+    X("sock_rsr",      bench_sock_rsr,          2,    200) \
+    X("sock_rsr_cpp",  bench_sock_rsr_cpp,      2,    200) \
+    X("udp_tx",        bench_udp_tx,            32,   50) \
+    X("udp_tx_cpp",    bench_udp_tx_cpp,        32,   50) \
+    X("udp_rtt",       bench_udp_rtt,           32,   20) \
+    X("udp_rtt",       bench_udp_rtt,           512,  20) \
+    BENCH_FLASH_KERNELS(X) \
+    X("memcpy",        bench_memcpy,            64,   200) \
+    X("memcpy",        bench_memcpy,            1024, 100) \
+    X("crc32",         bench_crc32,             64,   200) \
+    X("crc32",         bench_crc32,             1024, 50) \
+    X("printf",        bench_printf,            0,    20) \
+    X("snprintf",      bench_snprintf,          0,    100) \
+    X("ctx_switch",    bench_ctx_switch,        0,    200)
+
+typedef struct {
+    const char *name;
+    bench_fn fn;
+    uint32_t param;
+    uint16_t iterations;
+} bench_kernel_t;
+
+static const bench_kernel_t bench_kernels[] = {
+#define BENCH_KERNEL_ENTRY(name, fn, param, iter) {name, fn, param, iter},
+    BENCH_KERNELS(BENCH_KERNEL_ENTRY)
+#undef BENCH_KERNEL_ENTRY
+};
+
+#define BENCH_KERNEL_COUNT  (sizeof(bench_kernels) / sizeof(bench_kernels[0]))
+
+// ============================================================================
+// HARNESS
+// ============================================================================
+
+static void bench_run(const bench_kernel_t *k, uint32_t overhead, bench_result_t *r) {
+    uint64_t total = 0;
+
+    r->name = k->name;
+    r->param = k->param;
+    r->iterations = k->iterations;
+    r->failures = 0;
+    r->min_cycles = UINT32_MAX;
+    r->max_cycles = 0;
+
+    for (uint16_t i = 0; i < k->iterations; i++) {
+        uint32_t start = dwt_cycles_now();
+        bool ok = k->fn(k->param);
+        uint32_t cycles = dwt_cycles_now() - start;
+
+        cycles = (cycles > overhead) ? cycles - overhead : 0;
+        if (!ok) r->failures++;
+        if (cycles < r->min_cycles) r->min_cycles = cycles;
+        if (cycles > r->max_cycles) r->max_cycles = cycles;
+        total += cycles;
+    }
+    r->mean_cycles = (uint32_t)(total / k->iterations);
+}
+
+static uint8_t* bench_put32(uint8_t *p, uint32_t v) {
+    *p++ = (uint8_t)(v >> 24); *p++ = (uint8_t)(v >> 16); *p++ = (uint8_t)(v >> 8); *p++ = (uint8_t)v;
+    return p;
+}
+
+static bool bench_send(const bench_result_t *results, uint8_t count, uint32_t run_id, bool last) {
+    uint8_t *p = bench_packet;
+
+    *p++ = BENCH_MAGIC;
+    *p++ = BENCH_VERSION;
+    *p++ = count;
+    *p++ = (last ? 0x01 : 0x00) | (RAMFUNC_ENABLED ? 0x02 : 0x00);
+    p = bench_put32(p, run_id);
+    p = bench_put32(p, SystemCoreClock);
+
+    for (uint8_t i = 0; i < count; i++) {
+        const bench_result_t *r = &results[i];
+        memset(p, 0, BENCH_NAME_LEN);
+        strncpy((char *)p, r->name, BENCH_NAME_LEN);
+        p += BENCH_NAME_LEN;
+        p = bench_put32(p, r->param);
+        *p++ = (uint8_t)(r->iterations >> 8); *p++ = (uint8_t)r->iterations;
+        *p++ = (uint8_t)(r->failures >> 8);   *p++ = (uint8_t)r->failures;
+        p = bench_put32(p, r->min_cycles);
+        p = bench_put32(p, r->mean_cycles);
+        p = bench_put32(p, r->max_cycles);
+    }
+
+    return w5500_socket_sendto(BENCH_SOCKET, bench_packet, (uint16_t)(p - bench_packet),
+                               (uint8_t *)bench_target_ip, ETH_CONFIG_BENCH_TARGET_PORT) > 0;
+}
+
+int32_t bench_run_all(void) {
+    static bench_result_t results[BENCH_RECORDS_PER_PACKET];
+    static bench_result_t calib;
+    uint8_t pending = 0;
+    bool sent = true;
+
+    dwt_cycles_init();
+    for (uint16_t i = 0; i < BENCH_BUF_SIZE; i++) bench_buf[i] = (uint8_t)i;
+
+    if (!w5500_socket_check_ready()) return -1;
+    if (w5500_socket_open(BENCH_SOCKET, W5500_SOCK_UDP, 0) != W5500_SOCK_OK) return -2;
+
+    /* Cost of the timing itself, removed from every sample */
+    static const bench_kernel_t calib_kernel = {"empty", bench_empty, 0, 100};
+    bench_run(&calib_kernel, 0, &calib);
+
+    uint32_t run_id = dwt_cycles_now();
+    printf("Benchmark: %u kernels, overhead %lu cycles\n", (unsigned)BENCH_KERNEL_COUNT,
+           (unsigned long)calib.min_cycles);
+
+    for (uint8_t k = 0; k < BENCH_KERNEL_COUNT; k++) {
+        bench_run(&bench_kernels[k], calib.min_cycles, &results[pending]);
+        bool last = (k == BENCH_KERNEL_COUNT - 1);
+        if (++pending == BENCH_RECORDS_PER_PACKET || last) {
+            sent &= bench_send(results, pending, run_id, last);
+            pending = 0;
+        }
+    }
+
+    w5500_socket_close(BENCH_SOCKET);
+    return sent ? (int32_t)BENCH_KERNEL_COUNT : -3;
+}
+
+#endif /* BENCH_ENABLED */
@@ -0,0 +1,27 @@
+/**
+ * @file bench_socket.cpp
+ * @brief C++ socket facade kernels for the benchmark suite
+ */
+
+#include "bench.h"
+
+#if BENCH_ENABLED
+
+#include "w5500_socket.hpp"
+
+/* The socket is opened by bench_run_all(); borrow it for one call */
+bool bench_socket_udp_tx(uint8_t sn, const uint8_t *data, uint16_t len, const uint8_t *ip, uint16_t port) {
+    auto sock = w5500::UdpSocket::adopt(sn);
+    bool ok = static_cast<bool>(sock.send_to({data, len}, {{ip[0], ip[1], ip[2], ip[3]}, port}));
+    sock.release();
+    return ok;
+}
+
+uint16_t bench_socket_rx_size(uint8_t sn) {
+    auto sock = w5500::UdpSocket::adopt(sn);
+    uint16_t size = sock.rx_size();
+    sock.release();
+    return size;
+}
+
+#endif /* BENCH_ENABLED */
@@ -0,0 +1,69 @@
+/**
+ * @file boot_prof.c
+ * @brief Boot-time profiler
+ */
+
+#include "boot_prof.h"
+#include "dwt_cycles.h"
+#include "cmsis_os.h"
+
+#if !BOOT_FAST_ENABLED
+static const char *const boot_phase_names[BOOT_PHASE_COUNT] = {
+#define BOOT_PHASE_NAME(id, name) name,
+    BOOT_PHASE_TABLE(BOOT_PHASE_NAME)
+#undef BOOT_PHASE_NAME
+};
+#endif
+
+static uint32_t boot_us[BOOT_PHASE_COUNT];     /* 0 = not reached */
+static uint32_t boot_elapsed_us;
+static uint32_t boot_carry_cycles;             /* Remainder below 1 us, kept across segments */
+static uint32_t boot_last_cycles;
+static uint32_t boot_last_mhz;
+
+void boot_prof_start(void) {
+    dwt_cycles_init();
+    boot_last_cycles = dwt_cycles_now();
+    boot_last_mhz = SystemCoreClock / 1000000U;
+}
+
+void boot_prof_mark(boot_phase_t phase) {
+    if (phase >= BOOT_PHASE_COUNT || boot_us[phase] != 0 || boot_last_mhz == 0) return;
+
+    osKernelLock();             /* Phases are marked from several tasks; no-op before the scheduler */
+    uint32_t now = dwt_cycles_now();
+    uint32_t cycles = (now - boot_last_cycles) + boot_carry_cycles;
+    boot_elapsed_us += cycles / boot_last_mhz;
+    boot_carry_cycles = cycles % boot_last_mhz;
+    boot_last_cycles = now;
+    boot_last_mhz = SystemCoreClock / 1000000U;
+
+    if (boot_us[phase] == 0) {
+        boot_us[phase] = (boot_elapsed_us != 0) ? boot_elapsed_us : 1;
+    }
+    osKernelUnlock();
+}
+
+bool boot_prof_reached(boot_phase_t phase) {
+    return phase < BOOT_PHASE_COUNT && boot_us[phase] != 0;
+}
+
+uint32_t boot_prof_get_us(boot_phase_t phase) {
+    return (phase < BOOT_PHASE_COUNT) ? boot_us[phase] : 0;
+}
+
+void boot_prof_report(void) {
+#if !BOOT_FAST_ENABLED
+    uint32_t prev = 0;
+    printf("Boot profile (us since main):\n");
+    for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+        if (boot_us[i] == 0) {
+            printf("  %-12s       -\n", boot_phase_names[i]);
+            continue;
+        }
+        printf("  %-12s %8lu  +%lu\n", boot_phase_names[i], (unsigned long)boot_us[i],
+               (unsigned long)((boot_us[i] > prev) ? boot_us[i] - prev : 0));
+        if (boot_us[i] > prev) prev = boot_us[i];
+    }
+#endif
+}
@@ -0,0 +1,249 @@
+/**
+ * @file capture.c
+ * @brief Timer input-capture subsystem implementation
+ */
+
+#include "capture.h"
+#include "tim.h"
+#include <string.h>
+
+#define CAPTURE_RING_HALFWORDS  (CAPTURE_RING_SNAPSHOTS * 4)
+
+/* CCR index of each lane's edges inside a DMA burst snapshot (CCR1..CCR4) */
+static const uint8_t capture_rise_reg[CAPTURE_LANES] = {0, 2};
+static const uint8_t capture_fall_reg[CAPTURE_LANES] = {1, 3};
+
+typedef struct {
+    uint16_t last_rise16;       /**< Last rising-edge CCR value seen */
+    uint16_t last_fall16;       /**< Last falling-edge CCR value seen */
+    uint64_t rise_us;           /**< Extended time of last_rise16 */
+    uint64_t prev_rise_us;      /**< Rising edge of the previous pulse */
+    bool rise_valid;
+    bool prev_rise_valid;
+} capture_lane_t;
+
+extern DMA_HandleTypeDef hdma_tim2_ch2_ch4;
+
+static volatile uint16_t capture_ring[CAPTURE_RING_HALFWORDS];
+static uint16_t capture_rd = 0;             /* Next snapshot to decode */
+static capture_lane_t capture_lane[CAPTURE_LANES];
+
+static capture_pulse_t capture_batch[CAPTURE_BATCH_SIZE];
+static uint8_t capture_batch_len = 0;
+static capture_batch_fn capture_on_batch = NULL;
+static uint32_t capture_pulses = 0;
+
+/* Software extension of the 16-bit counter */
+static uint16_t capture_last_cnt = 0;
+static uint64_t capture_now = 0;
+
+/* Network time alignment */
+static bool capture_synced = false;
+static uint64_t capture_ref_local = 0;
+static uint64_t capture_ref_net = 0;
+static int32_t capture_rate_ppb = 0;
+
+/* The extension is advanced by Task01 and the network model updated by the
+   sync service; both are read from other tasks. Short IRQ-off sections keep
+   each multi-word update consistent for readers. */
+#define CAPTURE_LOCK()      uint32_t capture_primask = __get_PRIMASK(); __disable_irq()
+#define CAPTURE_UNLOCK()    __set_PRIMASK(capture_primask)
+
+// ============================================================================
+// TIME BASE
+// ============================================================================
+
+uint64_t capture_now_us(void) {
+    CAPTURE_LOCK();
+    uint16_t cnt = (uint16_t)TIM2->CNT;
+    capture_now += (uint16_t)(cnt - capture_last_cnt);
+    capture_last_cnt = cnt;
+    uint64_t now = capture_now;
+    CAPTURE_UNLOCK();
+    return now;
+}
+
+uint64_t capture_extend_raw_us(uint16_t raw) {
+    CAPTURE_LOCK();
+    uint16_t cnt = (uint16_t)TIM2->CNT;
+    uint64_t now = capture_now + (uint16_t)(cnt - capture_last_cnt);
+    CAPTURE_UNLOCK();
+    return now - (uint16_t)(cnt - raw);
+}
+
+uint64_t capture_read_us(void) {
+    return capture_extend_raw_us((uint16_t)TIM2->CNT);
+}
+
+/**
+ * @brief Extend a 16-bit capture taken within the last 65.5 ms
+ * @note  Any CCR value not seen by the previous poll is younger than one poll
+ *        interval, which is what makes this unambiguous.
+ */
+static inline uint64_t capture_extend(uint16_t value) {
+    return capture_now - (uint16_t)(capture_last_cnt - value);
+}
+
+void capture_time_sync(uint64_t network_us, uint64_t local_us) {
+    CAPTURE_LOCK();
+    if (capture_synced && local_us > capture_ref_local) {
+        int64_t local_span = (int64_t)(local_us - capture_ref_local);
+        int64_t net_span = (int64_t)(network_us - capture_ref_net);
+        int64_t rate = ((net_span - local_span) * 1000000000LL) / local_span;
+        if (rate > INT32_MAX) rate = INT32_MAX;
+        if (rate < INT32_MIN) rate = INT32_MIN;
+        capture_rate_ppb = (int32_t)rate;
+    }
+    capture_ref_local = local_us;
+    capture_ref_net = network_us;
+    capture_synced = true;
+    CAPTURE_UNLOCK();
+}
+
+uint64_t capture_to_network_us(uint64_t local_us) {
+    CAPTURE_LOCK();
+    uint64_t net = local_us;
+    if (capture_synced) {
+        int64_t dt = (int64_t)(local_us - capture_ref_local);
+        net = capture_ref_net + (uint64_t)(dt + (dt * capture_rate_ppb) / 1000000000LL);
+    }
+    CAPTURE_UNLOCK();
+    return net;
+}
+
+/* First-order inverse: the rate term squared is below 1e-8 for any crystal */
+uint64_t capture_from_network_us(uint64_t network_us) {
+    CAPTURE_LOCK();
+    uint64_t local = network_us;
+    if (capture_synced) {
+        int64_t dt = (int64_t)(network_us - capture_ref_net);
+        local = capture_ref_local + (uint64_t)(dt - (dt * capture_rate_ppb) / 1000000000LL);
+    }
+    CAPTURE_UNLOCK();
+    return local;
+}
+
+bool capture_time_synced(void) {
+    return capture_synced;
+}
+
+int32_t capture_get_rate_ppb(void) {
+    return capture_rate_ppb;
+}
+
+// ============================================================================
+// DECODING
+// ============================================================================
+
+static void capture_flush(void) {
+    if (capture_batch_len && capture_on_batch) capture_on_batch(capture_batch, capture_batch_len);
+    capture_batch_len = 0;
+}
+
+static void capture_emit(uint8_t lane, uint64_t rise_us, uint64_t fall_us) {
+    capture_lane_t *l = &capture_lane[lane];
+    capture_pulse_t *p = &capture_batch[capture_batch_len];
+
+    p->lane = lane;
+    p->rise_us = rise_us;
+    p->width_us = (uint32_t)(fall_us - rise_us);
+    p->period_us = 0;
+    p->duty_permille = 0;
+
+    if (l->prev_rise_valid && (rise_us - l->prev_rise_us) <= CAPTURE_MAX_PERIOD_US) {
+        p->period_us = (uint32_t)(rise_us - l->prev_rise_us);
+        if (p->period_us) p->duty_permille = (uint16_t)(((uint64_t)p->width_us * 1000) / p->period_us);
+    }
+    l->prev_rise_us = rise_us;
+    l->prev_rise_valid = true;
+
+    capture_pulses++;
+    if (++capture_batch_len == CAPTURE_BATCH_SIZE) capture_flush();
+}
+
+/**
+ * @brief Decode one burst snapshot (taken on a falling edge of either lane)
+ */
+static void capture_decode(const volatile uint16_t *snap) {
+    for (uint8_t lane = 0; lane < CAPTURE_LANES; lane++) {
+        capture_lane_t *l = &capture_lane[lane];
+        uint16_t rise16 = snap[capture_rise_reg[lane]];
+        uint16_t fall16 = snap[capture_fall_reg[lane]];
+
+        /* A new rising edge seen first here: the pulse is shorter than a poll */
+        if (rise16 != l->last_rise16) {
+            l->last_rise16 = rise16;
+            l->rise_us = capture_extend(rise16);
+            l->rise_valid = true;
+        }
+
+        if (fall16 != l->last_fall16) {
+            l->last_fall16 = fall16;
+            if (l->rise_valid) {
+                capture_emit(lane, l->rise_us, capture_extend(fall16));
+                l->rise_valid = false;
+            }
+        }
+    }
+}
+
+bool capture_init(capture_batch_fn on_batch) {
+    memset(capture_lane, 0, sizeof(capture_lane));
+    capture_on_batch = on_batch;
+    capture_batch_len = 0;
+    capture_rd = 0;
+
+    if (HAL_DMA_Start(&hdma_tim2_ch2_ch4, (uint32_t)&TIM2->DMAR, (uint32_t)(uintptr_t)capture_ring,
+                      CAPTURE_RING_HALFWORDS) != HAL_OK) {
+        return false;
+    }
+
+    /* Each CC2/CC4 request moves CCR1..CCR4 through DMAR */
+    TIM2->DCR = TIM_DMABASE_CCR1 | TIM_DMABURSTLENGTH_4TRANSFERS;
+    __HAL_TIM_ENABLE_DMA(&htim2, TIM_DMA_CC2 | TIM_DMA_CC4);
+
+    if (HAL_TIM_IC_Start(&htim2, TIM_CHANNEL_1) != HAL_OK ||
+        HAL_TIM_IC_Start(&htim2, TIM_CHANNEL_2) != HAL_OK ||
+        HAL_TIM_IC_Start(&htim2, TIM_CHANNEL_3) != HAL_OK ||
+        HAL_TIM_IC_Start(&htim2, TIM_CHANNEL_4) != HAL_OK) {
+        return false;
+    }
+
+    capture_last_cnt = (uint16_t)TIM2->CNT;
+    capture_now = 0;
+    for (uint8_t lane = 0; lane < CAPTURE_LANES; lane++) {
+        capture_lane[lane].last_rise16 = (uint16_t)(&TIM2->CCR1)[capture_rise_reg[lane]];
+        capture_lane[lane].last_fall16 = (uint16_t)(&TIM2->CCR1)[capture_fall_reg[lane]];
+    }
+    return true;
+}
+
+void capture_poll(void) {
+    capture_now_us();
+
+    /* Only whole snapshots: the DMA may be in the middle of a burst */
+    uint16_t written = (uint16_t)(CAPTURE_RING_HALFWORDS - __HAL_DMA_GET_COUNTER(&hdma_tim2_ch2_ch4));
+    uint16_t wr = written / 4;
+
+    while (capture_rd != wr) {
+        capture_decode(&capture_ring[capture_rd * 4]);
+        capture_rd = (uint16_t)((capture_rd + 1) % CAPTURE_RING_SNAPSHOTS);
+    }
+
+    /* Rising edges still waiting for their falling edge (long pulses) */
+    for (uint8_t lane = 0; lane < CAPTURE_LANES; lane++) {
+        capture_lane_t *l = &capture_lane[lane];
+        uint16_t rise16 = (uint16_t)(&TIM2->CCR1)[capture_rise_reg[lane]];
+        if (rise16 != l->last_rise16) {
+            l->last_rise16 = rise16;
+            l->rise_us = capture_extend(rise16);
+            l->rise_valid = true;
+        }
+    }
+
+    capture_flush();
+}
+
+uint32_t capture_get_pulse_count(void) {
+    return capture_pulses;
+}
@@ -1,4 +1,5 @@
 #include "eth_config.h"
+#include "boot_prof.h"
 
 // Global network configuration structure
 wiz_NetInfo g_network_info;
@@ -15,7 +16,7 @@ void eth_config_init_static(void) {
 
     g_network_info.dhcp = NETINFO_STATIC;
 
-    printf("Initialized g_network_info with static values.\r\n");
+    BOOT_LOG("Initialized g_network_info with static values.\r\n");
 }
 
 /**
@@ -31,12 +32,12 @@ void eth_config_set_netinfo(const wiz_NetInfo* net_info) {
     // Apply static network information all at once
     //wizchip_setnetinfo(&g_network_info);
 
-    HAL_Delay(10);  // Let it settle
-
-
+    // Register writes take effect immediately: no settling delay needed
+#if !BOOT_FAST_ENABLED
     // Read back static network information all at once
     wiz_NetInfo current_info;
     eth_config_get_netinfo(&current_info);
+#endif
 }
 
 
@@ -0,0 +1,71 @@
+/**
+ * @file flash_pipe.c
+ * @brief Socket buffer <-> flash transfers with both SPI buses busy
+ */
+
+#include "flash_pipe.h"
+#include "w5500_socket.h"
+#include "../../Middlewares/In_House/flash/w25q128.h"
+#include "../../Middlewares/In_House/flash/w25q128_remap.h"
+
+#if FLASH_DRIVER_ENABLED
+
+/* One buffer on each bus */
+static uint8_t pipe_buf[2][FLASH_PIPE_CHUNK];
+
+/* Bytes up to the end of the page at addr, at most len */
+static uint16_t flash_pipe_step(uint32_t addr, uint16_t len) {
+    uint16_t n = (uint16_t)(FLASH_PIPE_CHUNK - (addr % FLASH_PIPE_CHUNK));
+    return (n < len) ? n : len;
+}
+
+/*
+ * Lock order: the flash driver is taken first, then the W5500 (scheduler
+ * lock), which is given back before waiting on the flash again.
+ */
+
+uint16_t flash_pipe_to_socket(uint8_t sock, uint16_t ptr, uint32_t addr, uint16_t len) {
+    uint8_t cur = 0;
+    uint16_t n = flash_pipe_step(addr, len);
+    if (n == 0) return ptr;
+
+    w25q128_read_start(w25q128_remap_physical(addr), pipe_buf[cur], n);
+    w25q128_xfer_wait();
+    while (n) {
+        addr += n;
+        len = (uint16_t)(len - n);
+        uint16_t next = flash_pipe_step(addr, len);
+        if (next) w25q128_read_start(w25q128_remap_physical(addr), pipe_buf[cur ^ 1], next);
+        ptr = w5500_socket_tx_write_start(sock, ptr, pipe_buf[cur], n);
+        w5500_socket_xfer_wait();
+        if (next) w25q128_xfer_wait();
+        cur ^= 1;
+        n = next;
+    }
+    return ptr;
+}
+
+bool flash_pipe_from_socket(uint8_t sock, uint16_t ptr, uint32_t addr, uint16_t len) {
+    uint8_t cur = 0;
+    uint16_t n = flash_pipe_step(addr, len);
+    if (n) ptr = w5500_socket_rx_read(sock, ptr, pipe_buf[cur], n);
+
+    while (n) {
+        if ((addr % FLASH_SECTOR_SIZE) == 0 && !w25q128_remap_erase_sector(addr)) return false;
+        uint16_t next = flash_pipe_step(addr + n, (uint16_t)(len - n));
+        if (!w25q128_write_page_start(w25q128_remap_physical(addr), pipe_buf[cur], n)) return false;
+        if (next) {
+            ptr = w5500_socket_rx_read_start(sock, ptr, pipe_buf[cur ^ 1], next);
+            w5500_socket_xfer_wait();
+        }
+        /* Read back while the buffer still holds the page */
+        if (!w25q128_xfer_wait() || !w25q128_remap_check_page(addr, pipe_buf[cur], n)) return false;
+        addr += n;
+        len = (uint16_t)(len - n);
+        cur ^= 1;
+        n = next;
+    }
+    return true;
+}
+
+#endif /* FLASH_DRIVER_ENABLED */
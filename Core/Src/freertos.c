@@ -27,6 +27,21 @@
 /* USER CODE BEGIN Includes */
 #include "w5500_spi.h"
 #include "hello_world.h"
+#include "modbus_server.h"
+#include "rpc_server.h"
+#include "iperf.h"
+#include "sync_sample.h"
+#include "log_ship.h"
+#include "../../Middlewares/In_House/flash/w25q128_log.h"
+#include "../../Middlewares/In_House/flash/w25q128_remap.h"
+#include "../../Middlewares/In_House/flash/w25q128_fs.h"
+#include "../../Middlewares/In_House/flash/w25q128_part.h"
+#include "../../Middlewares/In_House/flash/w25q128_wear.h"
+#include "traffic_agg.h"
+#include "capture.h"
+#include "bench.h"
+#include "boot_prof.h"
+#include "trace.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include "cmsis_os.h"
@@ -55,12 +70,31 @@ uint32_t task02 = 0;
 uint32_t task03 = 0;
 static bool hw_init = false;
 
+/* Task periods in ms, adjustable at runtime through the RPC channel */
+volatile uint16_t task_period_ms[4] = {1, 10, 100, 1000};
+
+/* Stack sizes (FREERTOS.Tasks01 in the .ioc) come from the painted peak of
+   each task on the host build under load (Modbus, RPC, iperf flash and UDP,
+   trace), with every printf standing in as 512 bytes of newlib-nano stack at
+   its call site. x86-64 frames overstate Cortex-M3 ones; add the 64-byte
+   context frame and round up:
+
+       Task00  903 B -> 1280    Task02  695 B -> 1024
+       Task01  279 B ->  512    Task03  855 B -> 1024
+
+   Sync sampling is off on the host; its deepest path is a printf three calls
+   under sync_sample_poll(), well inside Task00's peak.
+
+   The bytes left on the target are in the RPC metrics (stack_free_*): resize
+   from those. configCHECK_FOR_STACK_OVERFLOW = 2 traps an overflow. */
+volatile const char *stack_overflow_task = NULL;    /* For the debugger */
+
 /* USER CODE END Variables */
 /* Definitions for Task00_1ms */
 osThreadId_t Task00_1msHandle;
 const osThreadAttr_t Task00_1ms_attributes = {
   .name = "Task00_1ms",
-  .stack_size = 128 * 4,
+  .stack_size = 320 * 4,
   .priority = (osPriority_t) osPriorityNormal,
 };
 /* Definitions for Task01_10ms */
@@ -74,19 +108,20 @@ const osThreadAttr_t Task01_10ms_attributes = {
 osThreadId_t Task02_100msHandle;
 const osThreadAttr_t Task02_100ms_attributes = {
   .name = "Task02_100ms",
-  .stack_size = 128 * 4,
+  .stack_size = 256 * 4,
   .priority = (osPriority_t) osPriorityNormal,
 };
 /* Definitions for Task03_1000ms */
 osThreadId_t Task03_1000msHandle;
 const osThreadAttr_t Task03_1000ms_attributes = {
   .name = "Task03_1000ms",
-  .stack_size = 128 * 4,
+  .stack_size = 256 * 4,
   .priority = (osPriority_t) osPriorityNormal,
 };
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN FunctionPrototypes */
+static void capture_to_traffic(const capture_pulse_t *pulses, uint8_t count);
 
 /* USER CODE END FunctionPrototypes */
 
@@ -97,6 +132,20 @@ void StartTask03(void *argument);
 
 void MX_FREERTOS_Init(void); /* (MISRA C 2004 rule 8.1) */
 
+/* Hook prototypes */
+void vApplicationStackOverflowHook(xTaskHandle xTask, signed char *pcTaskName);
+
+/* USER CODE BEGIN 4 */
+void vApplicationStackOverflowHook(xTaskHandle xTask, signed char *pcTaskName)
+{
+  /* Checked at every switch away from the task (configCHECK_FOR_STACK_OVERFLOW
+     = 2): its stack is already damaged, so stop before the heap is */
+  (void)xTask;
+  stack_overflow_task = (const char *)pcTaskName;
+  Error_Handler();
+}
+/* USER CODE END 4 */
+
 /**
   * @brief  FreeRTOS initialization
   * @param  None
@@ -156,19 +205,77 @@ void MX_FREERTOS_Init(void) {
 void StartTask00(void *argument)
 {
   /* USER CODE BEGIN StartTask00 */
+  boot_prof_mark(BOOT_PHASE_KERNEL);
 
   /* Infinite loop */
   for(;;)
   {
     if (!hw_init) {
-      w5500_spi_init();
+#if FLASH_DRIVER_ENABLED
+      if (!w25q128_wear_init()) {
+        printf("Task00: no flash erase counters yet, counting from zero\n");
+      }
+      if (!w25q128_remap_init()) {
+        printf("Task00: flash remap table unreadable\n");
+      }
+      if (!w25q128_part_init()) {
+        printf("Task00: flash partition table unusable, using defaults\n");
+      }
+      if (!w25q128_log_init()) {
+        printf("Task00: flash log init failed\n");
+      }
+      if (w25q128_fs_mount(true) != FLASH_STATUS_OK) {
+        printf("Task00: file store mount failed\n");
+      }
+#endif
+      if (!w5500_spi_init()) {
+        printf("Task00: W5500 init failed\n");
+#if FLASH_DRIVER_ENABLED
+        w25q128_log_printf(W25_LOG_ERR, "W5500 init failed");
+#endif
+      }
+      modbus_server_init();
+      rpc_server_init();
+#if IPERF_ENABLED
+      iperf_init();
+#endif
+#if SYNC_SAMPLE_ENABLED
+      sync_sample_init();
+#endif
+#if LOG_SHIP_ENABLED
+      log_ship_init();
+#endif
+      boot_prof_mark(BOOT_PHASE_SERVICES);
+#if BENCH_ENABLED
+      bench_run_all();    // Before hw_init: Task03 shares the UDP socket
+#endif
       hw_init = true;
+#if FLASH_DRIVER_ENABLED
+      w25q128_log_printf(W25_LOG_NOTICE, "boot: services up after %lu ms", (unsigned long)HAL_GetTick());
+#endif
+    }
+
+    modbus_server_poll();
+    rpc_server_poll();
+#if TRACE_ENABLED
+    trace_poll();       // Shares the RPC socket
+#endif
+#if IPERF_ENABLED
+    iperf_poll();
+#endif
+#if SYNC_SAMPLE_ENABLED
+    sync_sample_poll();
+#endif
+
+    // Auto-negotiation finishes in the background; note when it does
+    if (!boot_prof_reached(BOOT_PHASE_LINK_UP) && w5500_spi_link_up()) {
+      boot_prof_mark(BOOT_PHASE_LINK_UP);
     }
 
     task00++;
     //printf("Task00: %lu\n", (unsigned long)task00);
 
-    osDelay(1);
+    osDelay(task_period_ms[0]);
   }
   /* USER CODE END StartTask00 */
 }
@@ -183,14 +290,17 @@ void StartTask00(void *argument)
 void StartTask01(void *argument)
 {
   /* USER CODE BEGIN StartTask01 */
+  capture_init(capture_to_traffic);
+
   /* Infinite loop */
   for(;;)
   {
+    capture_poll();
 
 	task01++;
 	//printf("Task01: %lu\n", (unsigned long)task01);
 
-	osDelay(10);
+	osDelay(task_period_ms[1]);
   }
   /* USER CODE END StartTask01 */
 }
@@ -208,13 +318,20 @@ void StartTask02(void *argument)
   /* Infinite loop */
   for(;;)
   {
+#if LOG_SHIP_ENABLED
+    if (hw_init) log_ship_poll();   // Egress-idle gaps only, see log_ship.h
+#endif
+#if FLASH_DRIVER_ENABLED
+    w25q128_wear_poll();            // Erase counters to flash every FLASH_WEAR_FLUSH_MS
+    w25q128_power_poll();           // Deep power-down after FLASH_DPD_IDLE_MS
+#endif
 
 	task02++;
     //printf("Task02: %lu\n", (unsigned long)task02);
 
 	HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_10);
 
-	osDelay(100);
+	osDelay(task_period_ms[2]);
   }
   /* USER CODE END StartTask02 */
 }
@@ -229,6 +346,16 @@ void StartTask02(void *argument)
 void StartTask03(void *argument)
 {
   /* USER CODE BEGIN StartTask03 */
+  traffic_agg_init(HAL_GetTick(), traffic_agg_publish_udp);
+
+  // First hello as soon as the link is up rather than one period after boot;
+  // without a cable, fall back to the normal schedule
+  uint32_t boot_wait_start = HAL_GetTick();
+  while (!(hw_init && boot_prof_reached(BOOT_PHASE_LINK_UP)) &&
+         (HAL_GetTick() - boot_wait_start) < task_period_ms[3]) {
+    osDelay(1);
+  }
+
   /* Infinite loop */
   for(;;)
   {
@@ -242,13 +369,20 @@ void StartTask03(void *argument)
 	if (hw_init) {  // Only send if W5500 is initialized
 	    int32_t result = hello_world_send_udp();
 	    if (result > 0) {
+	        if (!boot_prof_reached(BOOT_PHASE_FIRST_TX)) {
+	            boot_prof_mark(BOOT_PHASE_FIRST_TX);
+	            boot_prof_report();
+	        }
 	        printf("Task03: UDP sent(%ld bytes)\n", (long)result);
 	    } else {
 	        printf("Task03: UDP error %ld\n", (long)result);
 	    }
 	}
 
-	osDelay(1000);
+	// Fold detection events and publish closed traffic windows (shares the UDP socket)
+	traffic_agg_tick(HAL_GetTick());
+
+	osDelay(task_period_ms[3]);
   }
   /* USER CODE END StartTask03 */
 }
@@ -256,5 +390,44 @@ void StartTask03(void *argument)
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
 
+/**
+ * @brief Turn detector pulses into traffic events (one pulse = one vehicle)
+ */
+static void capture_to_traffic(const capture_pulse_t *pulses, uint8_t count)
+{
+  uint32_t now_ms = HAL_GetTick();
+  uint64_t now_us = capture_now_us();
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t occupancy_ms = pulses[i].width_us / 1000;
+    traffic_event_t ev = {
+      .timestamp_ms = now_ms - (uint32_t)((now_us - pulses[i].rise_us) / 1000),
+      .occupancy_ms = (occupancy_ms > 0xFFFF) ? 0xFFFF : (uint16_t)occupancy_ms,
+      .speed_kmh_x10 = 0,     /* Single loop per lane: no speed */
+      .lane = pulses[i].lane,
+    };
+    traffic_agg_submit(&ev);
+  }
+}
+
+#if configUSE_TICKLESS_IDLE == 1
+/**
+ * @brief Tickless idle entry (configPRE_SLEEP_PROCESSING)
+ */
+void PreSleepProcessing(uint32_t ulExpectedIdleTime)
+{
+#if FLASH_DRIVER_ENABLED
+  w25q128_pre_sleep(ulExpectedIdleTime * portTICK_PERIOD_MS);
+#else
+  (void)ulExpectedIdleTime;
+#endif
+}
+
+void PostSleepProcessing(uint32_t ulExpectedIdleTime)
+{
+  (void)ulExpectedIdleTime;   /* The flash wakes on its next access */
+}
+#endif /* configUSE_TICKLESS_IDLE == 1 */
+
 /* USER CODE END Application */
 
@@ -0,0 +1,122 @@
+/**
+ * @file gorilla.c
+ * @brief Delta-of-delta / XOR / zig-zag varint bit stream encoder
+ */
+
+#include "gorilla.h"
+
+/* Append the low n bits of value, MSB first; the caller has checked the room */
+static void gorilla_write(gorilla_stream_t *s, uint32_t value, uint8_t n) {
+    while (n) {
+        uint8_t used = (uint8_t)(s->bits & 7);
+        uint8_t room = (uint8_t)(8 - used);
+        uint8_t take = (n < room) ? n : room;
+        uint8_t *p = &s->buf[s->bits >> 3];
+        if (used == 0) *p = 0;
+        *p |= (uint8_t)(((value >> (n - take)) & ((1U << take) - 1U)) << (room - take));
+        s->bits += take;
+        n = (uint8_t)(n - take);
+    }
+}
+
+/* Bits of one field; written only when emit is set */
+static inline uint32_t gorilla_field(gorilla_stream_t *s, bool emit, uint32_t value, uint8_t n) {
+    if (emit) gorilla_write(s, value, n);
+    return n;
+}
+
+static uint32_t gorilla_timestamp(gorilla_stream_t *s, bool emit, uint32_t ts) {
+    uint32_t delta = ts - s->prev_ts;
+    int32_t dod = (int32_t)(delta - s->prev_delta);
+    uint32_t bits;
+
+    if (dod == 0) {
+        bits = gorilla_field(s, emit, 0x0, 1);
+    } else if (dod >= -64 && dod <= 63) {
+        bits = gorilla_field(s, emit, 0x2, 2) + gorilla_field(s, emit, (uint32_t)dod, 7);
+    } else if (dod >= -256 && dod <= 255) {
+        bits = gorilla_field(s, emit, 0x6, 3) + gorilla_field(s, emit, (uint32_t)dod, 9);
+    } else if (dod >= -2048 && dod <= 2047) {
+        bits = gorilla_field(s, emit, 0xE, 4) + gorilla_field(s, emit, (uint32_t)dod, 12);
+    } else {
+        bits = gorilla_field(s, emit, 0xF, 4) + gorilla_field(s, emit, (uint32_t)dod, 32);
+    }
+    if (emit) {
+        s->prev_delta = delta;
+        s->prev_ts = ts;
+    }
+    return bits;
+}
+
+static uint32_t gorilla_delta_value(gorilla_stream_t *s, bool emit, uint8_t ch, uint32_t value) {
+    int32_t d = (int32_t)(value - s->prev[ch]);
+    if (emit) s->prev[ch] = value;
+    if (d == 0) return gorilla_field(s, emit, 0x0, 1);
+
+    uint32_t z = (((uint32_t)d << 1) ^ (uint32_t)(d >> 31)) - 1U;   /* zig-zag, 0 taken by '0' */
+    uint32_t bits = gorilla_field(s, emit, 0x1, 1);
+    do {
+        uint32_t group = z & 7U;
+        z >>= 3;
+        bits += gorilla_field(s, emit, (z ? 0x8U : 0x0U) | group, 4);
+    } while (z);
+    return bits;
+}
+
+static uint32_t gorilla_xor_value(gorilla_stream_t *s, bool emit, uint8_t ch, uint32_t value) {
+    uint32_t x = value ^ s->prev[ch];
+    if (emit) s->prev[ch] = value;
+    if (x == 0) return gorilla_field(s, emit, 0x0, 1);
+
+    uint8_t lead = (uint8_t)__builtin_clz(x);
+    uint8_t trail = (uint8_t)__builtin_ctz(x);
+
+    /* Inside the previous window: its length is known to the decoder */
+    if (s->lead[ch] != GORILLA_NO_WINDOW && lead >= s->lead[ch] &&
+        trail >= 32 - s->lead[ch] - s->len[ch]) {
+        uint8_t shift = (uint8_t)(32 - s->lead[ch] - s->len[ch]);
+        return gorilla_field(s, emit, 0x2, 2) + gorilla_field(s, emit, x >> shift, s->len[ch]);
+    }
+
+    uint8_t len = (uint8_t)(32 - lead - trail);
+    uint32_t bits = gorilla_field(s, emit, 0x3, 2) + gorilla_field(s, emit, lead, 5) +
+                    gorilla_field(s, emit, (uint32_t)(len - 1), 5) + gorilla_field(s, emit, x >> trail, len);
+    if (emit) {
+        s->lead[ch] = lead;
+        s->len[ch] = len;
+    }
+    return bits;
+}
+
+/* Size of one record, or write it and advance the state */
+static uint32_t gorilla_record(gorilla_stream_t *s, bool emit, uint32_t ts, const uint32_t *values) {
+    uint32_t bits = gorilla_timestamp(s, emit, ts);
+    for (uint8_t ch = 0; ch < s->channels; ch++) {
+        bits += (s->xor_mask & (1U << ch)) ? gorilla_xor_value(s, emit, ch, values[ch])
+                                           : gorilla_delta_value(s, emit, ch, values[ch]);
+    }
+    return bits;
+}
+
+void gorilla_begin(gorilla_stream_t *s, uint8_t *buf, uint16_t cap, uint8_t channels, uint8_t xor_mask) {
+    s->buf = buf;
+    s->cap = cap;
+    s->bits = 0;
+    s->count = 0;
+    s->channels = (channels > GORILLA_MAX_CHANNELS) ? GORILLA_MAX_CHANNELS : channels;
+    s->xor_mask = xor_mask;
+    s->prev_ts = 0;
+    s->prev_delta = 0;
+    for (uint8_t ch = 0; ch < GORILLA_MAX_CHANNELS; ch++) {
+        s->prev[ch] = 0;
+        s->lead[ch] = GORILLA_NO_WINDOW;
+        s->len[ch] = 0;
+    }
+}
+
+bool gorilla_put(gorilla_stream_t *s, uint32_t ts, const uint32_t *values) {
+    if (s->bits + gorilla_record(s, false, ts, values) > (uint32_t)s->cap * 8U) return false;
+    gorilla_record(s, true, ts, values);
+    s->count++;
+    return true;
+}
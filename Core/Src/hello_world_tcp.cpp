@@ -0,0 +1,33 @@
+/**
+ * @file hello_world_tcp.cpp
+ * @brief TCP Hello World over the C++ socket facade
+ */
+
+#include "hello_world.h"
+#include "w5500_socket.hpp"
+#include "eth_config.h"
+#include "cmsis_os.h"
+#include <string.h>
+
+#define HELLO_TCP_CONNECT_MS    100
+
+int32_t hello_world_send_tcp(const uint8_t* dest_ip, uint16_t dest_port) {
+    const char* message = ETH_CONFIG_UDP_MESSAGE; // Reuse same message
+
+    if (!w5500_socket_check_ready() || !dest_ip) return -1;
+
+    // Closed on every return below
+    auto sock = w5500::TcpSocket::open(ETH_CONFIG_TCP_SOCKET);
+    if (!sock) return -2;
+    if (!sock->connect({{dest_ip[0], dest_ip[1], dest_ip[2], dest_ip[3]}, dest_port})) return -3;
+
+    // Wait for connection
+    for (int i = 0; i < HELLO_TCP_CONNECT_MS && !sock->established(); i++) {
+        osDelay(1);
+    }
+    if (!sock->established()) return -4;
+
+    auto sent = sock->send({(const uint8_t*)message, strlen(message)});
+    (void)sock->disconnect();
+    return sent ? (int32_t)sent.value() : (int32_t)sent.error();
+}
@@ -0,0 +1,659 @@
+/**
+ * @file iperf.c
+ * @brief iperf2-compatible throughput server and client implementation
+ */
+
+#include "iperf.h"
+#include "flash_pipe.h"
+#include "w5500_socket.h"
+#include "eth_config.h"
+#include "dwt_cycles.h"
+#include "main.h"
+#include <string.h>
+#include <stdio.h>
+
+#if IPERF_ENABLED
+
+#define IPERF_SWEEP_MS          100     /* Socket state sweep while idle */
+#define IPERF_UDP_IDLE_MS       2000    /* UDP_RX session given up without a final datagram */
+#define IPERF_CHUNK_SIZE        120     /* SPI scratch, a multiple of the 10-byte pattern */
+#define IPERF_UDP_INFO_SIZE     8       /* W5500 RX header: source IP, port, length */
+#define IPERF_UDP_HDR_SIZE      16      /* id, tv_sec, tv_usec, id2 */
+#define IPERF_CLIENT_HDR_SIZE   24      /* flags, threads, port, buffer len, window, amount */
+#define IPERF_SERVER_HDR_SIZE   40      /* flags, total_len1/2, stop, errors, out of order, datagrams, jitter */
+#define IPERF_HEADER_VERSION1   0x80000000UL
+
+typedef struct {
+    iperf_mode_t mode;
+    uint8_t flags;
+    uint8_t ip[4];                          /* Client runs: server; UDP_RX: current client */
+    uint16_t port;
+    uint32_t duration_ms;
+    uint16_t len;
+    uint32_t rate_kbps;
+} iperf_run_t;
+
+static iperf_run_t iperf_run;
+static iperf_stats_t iperf_stats;
+static iperf_mode_t iperf_server_mode = IPERF_MODE_TCP_RX;
+static uint16_t iperf_server_port = ETH_CONFIG_IPERF_PORT;
+static uint8_t iperf_server_flags = 0;
+
+static uint32_t iperf_start_ms = 0;
+static uint32_t iperf_last_ms = 0;          /* RX: last data; TCP_TX: connect start; UDP_TX: last FIN */
+static uint32_t iperf_last_sweep = 0;
+static uint32_t iperf_seq = 0;              /* UDP_TX: next datagram id */
+static uint8_t iperf_fin_count = 0;
+static uint32_t iperf_flash_off = 0;        /* IPERF_FLAG_FLASH_PAYLOAD: position in the scratch */
+
+/* UDP_RX session */
+static int32_t iperf_last_id = -1;
+static uint64_t iperf_first_us = 0;
+static uint64_t iperf_last_us = 0;
+static uint32_t iperf_last_transit = 0;
+static uint32_t iperf_jitter16 = 0;         /* RFC 1889 jitter, us * 16 */
+static bool iperf_have_transit = false;
+
+/* Microsecond clock extended from CYCCNT; only differences within a run matter */
+static uint64_t iperf_clock_us = 0;
+static uint32_t iperf_clock_cycles = 0;
+static uint32_t iperf_clock_rem = 0;
+
+static uint8_t iperf_chunk[IPERF_CHUNK_SIZE];
+static uint8_t iperf_hdr[IPERF_UDP_INFO_SIZE + IPERF_UDP_HDR_SIZE + IPERF_SERVER_HDR_SIZE];
+static const uint8_t iperf_zero[IPERF_SERVER_HDR_SIZE] = {0};
+
+static const char *const iperf_mode_names[IPERF_MODE_COUNT] = {
+    "off", "TCP RX", "UDP RX", "TCP TX", "UDP TX"
+};
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static inline void iperf_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+static inline uint32_t iperf_get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t iperf_now_us(void) {
+    uint32_t now = dwt_cycles_now();
+    uint32_t per_us = SystemCoreClock / 1000000U;
+    uint32_t cycles = (now - iperf_clock_cycles) + iperf_clock_rem;
+    iperf_clock_cycles = now;
+    iperf_clock_us += cycles / per_us;
+    iperf_clock_rem = cycles % per_us;
+    return iperf_clock_us;
+}
+
+static inline bool iperf_active(void) {
+    return iperf_stats.state == IPERF_STATE_CONNECTING || iperf_stats.state == IPERF_STATE_RUNNING ||
+           iperf_stats.state == IPERF_STATE_FINISHING;
+}
+
+static void iperf_reset_stats(iperf_mode_t mode, uint8_t flags, iperf_state_t state) {
+    uint32_t runs = iperf_stats.runs;
+    memset(&iperf_stats, 0, sizeof(iperf_stats));
+    iperf_stats.mode = (uint8_t)mode;
+    iperf_stats.flags = flags;
+    iperf_stats.state = (uint8_t)state;
+    iperf_stats.runs = runs;
+    iperf_flash_off = 0;
+}
+
+/* Pattern for generated payload, as iperf fills its buffer */
+static void iperf_fill_pattern(void) {
+    for (uint16_t i = 0; i < IPERF_CHUNK_SIZE; i++) iperf_chunk[i] = (uint8_t)('0' + i % 10);
+}
+
+/* Payload bytes over SPI: into the scratch (dropped), or from the pattern */
+static void iperf_rx_payload(uint8_t sock, uint16_t ptr, uint16_t len) {
+    while (len) {
+        uint16_t n = (len > IPERF_CHUNK_SIZE) ? IPERF_CHUNK_SIZE : len;
+        ptr = w5500_socket_rx_read(sock, ptr, iperf_chunk, n);
+        len -= n;
+    }
+}
+
+static uint16_t iperf_tx_pattern(uint8_t sock, uint16_t ptr, uint16_t len) {
+    while (len) {
+        uint16_t n = (len > IPERF_CHUNK_SIZE) ? IPERF_CHUNK_SIZE : len;
+        ptr = w5500_socket_tx_write(sock, ptr, iperf_chunk, n);
+        len -= n;
+    }
+    return ptr;
+}
+
+#if FLASH_DRIVER_ENABLED
+/* Bytes of scratch a run cycles through: an image's worth, or what RESERVED has left */
+static uint32_t iperf_flash_size(void) {
+    return (SCRATCH_SIZE < FW_SLOT_SIZE) ? SCRATCH_SIZE : FW_SLOT_SIZE;
+}
+#endif
+
+/* Payload to or from the flash scratch through flash_pipe.h, wrapping at its end */
+static bool iperf_flash_rx(uint8_t sock, uint16_t ptr, uint16_t len) {
+#if FLASH_DRIVER_ENABLED
+    uint32_t size = iperf_flash_size();
+    while (len) {
+        uint32_t room = size - iperf_flash_off;
+        uint16_t n = (len > room) ? (uint16_t)room : len;
+        if (!flash_pipe_from_socket(sock, ptr, SCRATCH_BASE_ADDR + iperf_flash_off, n)) return false;
+        ptr = (uint16_t)(ptr + n);
+        len = (uint16_t)(len - n);
+        iperf_flash_off = (iperf_flash_off + n) % size;
+    }
+    return true;
+#else
+    (void)sock;
+    (void)ptr;
+    (void)len;
+    return false;
+#endif
+}
+
+static uint16_t iperf_flash_tx(uint8_t sock, uint16_t ptr, uint16_t len) {
+#if FLASH_DRIVER_ENABLED
+    uint32_t size = iperf_flash_size();
+    while (len) {
+        uint32_t room = size - iperf_flash_off;
+        uint16_t n = (len > room) ? (uint16_t)room : len;
+        ptr = flash_pipe_to_socket(sock, ptr, SCRATCH_BASE_ADDR + iperf_flash_off, n);
+        len = (uint16_t)(len - n);
+        iperf_flash_off = (iperf_flash_off + n) % size;
+    }
+#else
+    (void)sock;
+    (void)len;
+#endif
+    return ptr;
+}
+
+/* Fill the whole TX ring once, so in-place runs send the pattern */
+static void iperf_tx_prefill(uint8_t sock) {
+    iperf_fill_pattern();
+    iperf_tx_pattern(sock, w5500_socket_tx_begin(sock), ETH_CONFIG_SOCKET_BUFFER_SIZE);
+}
+
+// ============================================================================
+// RUN LIFECYCLE
+// ============================================================================
+
+static bool iperf_open_server(void) {
+    uint8_t sock = ETH_CONFIG_IPERF_SOCKET;
+    w5500_socket_close(sock);
+    iperf_last_sweep = HAL_GetTick();
+    switch (iperf_server_mode) {
+    case IPERF_MODE_TCP_RX:
+        return w5500_socket_open(sock, W5500_SOCK_TCP, iperf_server_port) == W5500_SOCK_OK &&
+               w5500_socket_listen(sock) == W5500_SOCK_OK;
+    case IPERF_MODE_UDP_RX:
+        return w5500_socket_open(sock, W5500_SOCK_UDP, iperf_server_port) == W5500_SOCK_OK;
+    default:
+        return true;
+    }
+}
+
+static void iperf_finish(iperf_state_t state, uint32_t elapsed_ms) {
+    iperf_stats.state = (uint8_t)state;
+    iperf_stats.elapsed_ms = elapsed_ms;
+    iperf_stats.kbps = elapsed_ms ? (uint32_t)((uint64_t)iperf_stats.bytes * 8U / elapsed_ms) : 0;
+    if (state == IPERF_STATE_DONE) iperf_stats.runs++;
+
+    printf("iperf: %s %lu bytes in %lu ms, %lu kbit/s%s\n", iperf_mode_names[iperf_stats.mode],
+           (unsigned long)iperf_stats.bytes, (unsigned long)elapsed_ms, (unsigned long)iperf_stats.kbps,
+           (state == IPERF_STATE_DONE) ? "" : " (failed)");
+    if (iperf_stats.mode == IPERF_MODE_UDP_RX || iperf_stats.mode == IPERF_MODE_UDP_TX) {
+        printf("iperf: %lu/%lu lost, %lu out of order, jitter %lu us\n",
+               (unsigned long)iperf_stats.lost, (unsigned long)iperf_stats.datagrams,
+               (unsigned long)iperf_stats.out_of_order, (unsigned long)iperf_stats.jitter_us);
+    }
+
+    /* Client runs hand the socket back to the server */
+    if (iperf_run.mode == IPERF_MODE_TCP_TX || iperf_run.mode == IPERF_MODE_UDP_TX) {
+        iperf_run.mode = iperf_server_mode;
+        iperf_run.flags = iperf_server_flags;
+        iperf_run.port = 0;
+        iperf_open_server();
+    }
+}
+
+// ============================================================================
+// TCP
+// ============================================================================
+
+static void iperf_tcp_rx_drain(uint8_t sock) {
+    uint32_t slice_start = HAL_GetTick();
+    do {
+        uint16_t avail = w5500_socket_get_rx_buf_size(sock);
+        if (avail == 0) break;
+        uint16_t ptr = w5500_socket_rx_begin(sock);
+        if (iperf_run.flags & IPERF_FLAG_FLASH_PAYLOAD) {
+            if (!iperf_flash_rx(sock, ptr, avail)) {
+                iperf_finish(IPERF_STATE_FAILED, iperf_last_ms - iperf_start_ms);
+                w5500_socket_disconnect(sock);
+                return;
+            }
+        } else if (iperf_run.flags & IPERF_FLAG_SPI_PAYLOAD) {
+            iperf_rx_payload(sock, ptr, avail);
+        }
+        w5500_socket_rx_commit(sock, (uint16_t)(ptr + avail));
+        iperf_stats.bytes += avail;
+        iperf_last_ms = HAL_GetTick();
+    } while ((HAL_GetTick() - slice_start) < IPERF_POLL_SLICE_MS);
+}
+
+static void iperf_tcp_rx_service(uint8_t sock) {
+    switch (w5500_socket_get_status(sock)) {
+    case SOCK_CLOSED:
+    case SOCK_INIT:
+        if (iperf_stats.state == IPERF_STATE_RUNNING) {
+            iperf_finish(IPERF_STATE_FAILED, iperf_last_ms - iperf_start_ms);     /* Reset by the client */
+        }
+        iperf_open_server();
+        break;
+    case SOCK_ESTABLISHED:
+        if (iperf_stats.state != IPERF_STATE_RUNNING) {
+            iperf_reset_stats(IPERF_MODE_TCP_RX, iperf_run.flags, IPERF_STATE_RUNNING);
+            iperf_start_ms = iperf_last_ms = HAL_GetTick();
+        }
+        iperf_tcp_rx_drain(sock);
+        break;
+    case SOCK_CLOSE_WAIT:
+        if (iperf_stats.state == IPERF_STATE_RUNNING) {
+            iperf_tcp_rx_drain(sock);
+            iperf_finish(IPERF_STATE_DONE, iperf_last_ms - iperf_start_ms);
+        }
+        w5500_socket_disconnect(sock);
+        iperf_open_server();
+        break;
+    default:
+        break;
+    }
+}
+
+static void iperf_tcp_tx_service(uint8_t sock) {
+    uint8_t status = w5500_socket_get_status(sock);
+
+    if (iperf_stats.state == IPERF_STATE_CONNECTING) {
+        if (status == SOCK_ESTABLISHED) {
+            /* Zero client header: the server treats the test as a plain stream */
+            iperf_tx_prefill(sock);
+            w5500_socket_tx_write(sock, w5500_socket_tx_begin(sock), iperf_zero, IPERF_CLIENT_HDR_SIZE);
+            iperf_stats.state = IPERF_STATE_RUNNING;
+            iperf_start_ms = HAL_GetTick();
+        } else if (status == SOCK_CLOSED || (HAL_GetTick() - iperf_last_ms) >= IPERF_CONNECT_TIMEOUT_MS) {
+            iperf_finish(IPERF_STATE_FAILED, 0);
+        }
+        return;
+    }
+
+    uint32_t slice_start = HAL_GetTick();
+    do {
+        uint32_t elapsed = HAL_GetTick() - iperf_start_ms;
+        if (elapsed >= iperf_run.duration_ms) {
+            w5500_socket_disconnect(sock);
+            iperf_finish(IPERF_STATE_DONE, elapsed);
+            return;
+        }
+        if (w5500_socket_get_status(sock) != SOCK_ESTABLISHED) {
+            iperf_finish(IPERF_STATE_FAILED, elapsed);
+            return;
+        }
+
+        uint16_t len = w5500_socket_get_tx_buf_free_size(sock);
+        if (len == 0) break;
+        uint16_t start = w5500_socket_tx_begin(sock);
+        if (iperf_run.flags & (IPERF_FLAG_SPI_PAYLOAD | IPERF_FLAG_FLASH_PAYLOAD)) {
+            uint16_t ptr = start;
+            if (iperf_stats.bytes == 0) ptr = w5500_socket_tx_write(sock, ptr, iperf_zero, IPERF_CLIENT_HDR_SIZE);
+            if (iperf_run.flags & IPERF_FLAG_FLASH_PAYLOAD) {
+                iperf_flash_tx(sock, ptr, (uint16_t)(len - (ptr - start)));
+            } else {
+                iperf_tx_pattern(sock, ptr, (uint16_t)(len - (ptr - start)));
+            }
+        }
+        if (w5500_socket_tx_commit(sock, start, (uint16_t)(start + len)) < 0) {
+            iperf_finish(IPERF_STATE_FAILED, HAL_GetTick() - iperf_start_ms);
+            return;
+        }
+        iperf_stats.bytes += len;
+    } while ((HAL_GetTick() - slice_start) < IPERF_POLL_SLICE_MS);
+}
+
+// ============================================================================
+// UDP
+// ============================================================================
+
+/* Datagram of len bytes whose first IPERF_UDP_HDR_SIZE come from hdr (the
+   rest is the ring, or the pattern with IPERF_FLAG_SPI_PAYLOAD) */
+static int32_t iperf_udp_send(uint8_t sock, const uint8_t *hdr, uint16_t hdr_len, uint16_t len) {
+    uint16_t start = w5500_socket_tx_begin(sock);
+    uint16_t ptr = w5500_socket_tx_write(sock, start, hdr, hdr_len);
+    if (iperf_run.flags & IPERF_FLAG_SPI_PAYLOAD) iperf_tx_pattern(sock, ptr, (uint16_t)(len - hdr_len));
+    return w5500_socket_tx_commit(sock, start, (uint16_t)(start + len));
+}
+
+static void iperf_udp_put_header(uint8_t *p, int32_t id) {
+    uint64_t now = iperf_now_us();
+    iperf_put32(&p[0], (uint32_t)id);
+    iperf_put32(&p[4], (uint32_t)(now / 1000000U));
+    iperf_put32(&p[8], (uint32_t)(now % 1000000U));
+    iperf_put32(&p[12], (id < 0) ? 0xFFFFFFFFUL : 0);     /* id2: upper half of a 64-bit id */
+}
+
+/* Server report answering a final datagram, padded to its length like iperf */
+static void iperf_udp_report(uint8_t sock, const uint8_t *fin, uint16_t len) {
+    if (len < IPERF_UDP_HDR_SIZE + IPERF_SERVER_HDR_SIZE) len = IPERF_UDP_HDR_SIZE + IPERF_SERVER_HDR_SIZE;
+    if (w5500_socket_get_tx_buf_free_size(sock) < len) return;
+
+    uint32_t elapsed_us = (uint32_t)(iperf_last_us - iperf_first_us);
+    uint8_t *p = iperf_hdr;
+    memmove(p, fin, IPERF_UDP_HDR_SIZE);
+    p += IPERF_UDP_HDR_SIZE;
+    iperf_put32(&p[0], IPERF_HEADER_VERSION1);
+    iperf_put32(&p[4], 0);                                  /* total_len1: upper 32 bits */
+    iperf_put32(&p[8], iperf_stats.bytes);
+    iperf_put32(&p[12], elapsed_us / 1000000U);
+    iperf_put32(&p[16], elapsed_us % 1000000U);
+    iperf_put32(&p[20], iperf_stats.lost);
+    iperf_put32(&p[24], iperf_stats.out_of_order);
+    iperf_put32(&p[28], iperf_stats.datagrams);
+    iperf_put32(&p[32], iperf_stats.jitter_us / 1000000U);
+    iperf_put32(&p[36], iperf_stats.jitter_us % 1000000U);
+
+    uint16_t port = iperf_run.port;
+    w5500_socket_setsockopt(sock, SO_DESTIP, iperf_run.ip);
+    w5500_socket_setsockopt(sock, SO_DESTPORT, &port);
+    uint16_t start = w5500_socket_tx_begin(sock);
+    uint16_t ptr = w5500_socket_tx_write(sock, start, iperf_hdr, IPERF_UDP_HDR_SIZE + IPERF_SERVER_HDR_SIZE);
+    for (uint16_t left = (uint16_t)(len - IPERF_UDP_HDR_SIZE - IPERF_SERVER_HDR_SIZE); left; ) {
+        uint16_t n = (left > sizeof(iperf_zero)) ? sizeof(iperf_zero) : left;
+        ptr = w5500_socket_tx_write(sock, ptr, iperf_zero, n);
+        left -= n;
+    }
+    w5500_socket_tx_commit(sock, start, ptr);
+}
+
+/* info: W5500 RX header followed by the iperf header */
+static void iperf_udp_datagram(uint8_t sock, const uint8_t *info, uint16_t len, uint64_t now_us) {
+    const uint8_t *src_ip = info;
+    uint16_t src_port = (uint16_t)((info[4] << 8) | info[5]);
+    const uint8_t *hdr = info + IPERF_UDP_INFO_SIZE;
+    int32_t id = (int32_t)iperf_get32(&hdr[0]);
+    uint32_t id2 = iperf_get32(&hdr[12]);
+    bool same_client = (src_port == iperf_run.port && memcmp(src_ip, iperf_run.ip, 4) == 0);
+
+    /* Final datagrams carry the negated count; 64-bit ids keep it in id/id2 */
+    bool fin = (id2 & 0x80000000UL) || (id2 == 0 && id < 0);
+    if (fin) id = -id;
+
+    if (!fin && (iperf_stats.state != IPERF_STATE_RUNNING || !same_client)) {
+        iperf_reset_stats(IPERF_MODE_UDP_RX, iperf_run.flags, IPERF_STATE_RUNNING);
+        memcpy(iperf_run.ip, src_ip, 4);
+        iperf_run.port = src_port;
+        iperf_first_us = iperf_last_us = now_us;
+        iperf_last_ms = HAL_GetTick();
+        iperf_last_id = -1;
+        iperf_jitter16 = 0;
+        iperf_have_transit = false;
+        same_client = true;
+    }
+    if (!same_client) return;
+
+    if (iperf_stats.state == IPERF_STATE_RUNNING) {
+        /* Gaps count as lost; a late datagram takes one back (as iperf's server) */
+        if (id != iperf_last_id + 1) {
+            if (id > iperf_last_id) {
+                iperf_stats.lost += (uint32_t)(id - iperf_last_id - 1);
+            } else {
+                iperf_stats.out_of_order++;
+                if (iperf_stats.lost) iperf_stats.lost--;
+            }
+        }
+        if (id > iperf_last_id) iperf_last_id = id;
+
+        if (fin) {
+            iperf_stats.datagrams = (uint32_t)id;
+            iperf_finish(IPERF_STATE_DONE, (uint32_t)((iperf_last_us - iperf_first_us) / 1000U));
+        } else {
+            uint32_t sent_us = iperf_get32(&hdr[4]) * 1000000U + iperf_get32(&hdr[8]);
+            uint32_t transit = (uint32_t)now_us - sent_us;
+            if (iperf_have_transit) {
+                int32_t d = (int32_t)(transit - iperf_last_transit);
+                if (d < 0) d = -d;
+                iperf_jitter16 += (uint32_t)d - (iperf_jitter16 >> 4);
+                iperf_stats.jitter_us = iperf_jitter16 >> 4;
+            }
+            iperf_last_transit = transit;
+            iperf_have_transit = true;
+            iperf_stats.bytes += len;
+            iperf_stats.datagrams++;
+            iperf_last_us = now_us;
+            iperf_last_ms = HAL_GetTick();
+        }
+    }
+
+    /* The client resends its final datagram until a report arrives */
+    if (fin && iperf_stats.state == IPERF_STATE_DONE) iperf_udp_report(sock, hdr, len);
+}
+
+static void iperf_udp_rx_service(uint8_t sock) {
+    uint8_t status = w5500_socket_get_status(sock);
+    if (status != SOCK_UDP) {
+        iperf_open_server();
+        return;
+    }
+
+    uint32_t slice_start = HAL_GetTick();
+    do {
+        uint16_t avail = w5500_socket_get_rx_buf_size(sock);
+        if (avail < IPERF_UDP_INFO_SIZE) break;
+        uint16_t ptr = w5500_socket_rx_begin(sock);
+        uint64_t now_us = iperf_now_us();
+
+        while (avail >= IPERF_UDP_INFO_SIZE) {
+            /* RX header and iperf header in one frame */
+            uint16_t n = (avail < IPERF_UDP_INFO_SIZE + IPERF_UDP_HDR_SIZE) ? avail
+                                                                            : IPERF_UDP_INFO_SIZE + IPERF_UDP_HDR_SIZE;
+            w5500_socket_rx_read(sock, ptr, iperf_hdr, n);
+            uint16_t len = (uint16_t)((iperf_hdr[6] << 8) | iperf_hdr[7]);
+            if (avail < IPERF_UDP_INFO_SIZE + len) break;
+
+            if (len >= IPERF_UDP_HDR_SIZE) {
+                if (iperf_run.flags & IPERF_FLAG_SPI_PAYLOAD) {
+                    iperf_rx_payload(sock, (uint16_t)(ptr + IPERF_UDP_INFO_SIZE + IPERF_UDP_HDR_SIZE),
+                                     (uint16_t)(len - IPERF_UDP_HDR_SIZE));
+                }
+                iperf_udp_datagram(sock, iperf_hdr, len, now_us);
+            }
+            ptr += IPERF_UDP_INFO_SIZE + len;
+            avail -= IPERF_UDP_INFO_SIZE + len;
+        }
+        w5500_socket_rx_commit(sock, ptr);
+    } while ((HAL_GetTick() - slice_start) < IPERF_POLL_SLICE_MS);
+
+    if (iperf_stats.state == IPERF_STATE_RUNNING && (HAL_GetTick() - iperf_last_ms) >= IPERF_UDP_IDLE_MS) {
+        iperf_finish(IPERF_STATE_FAILED, (uint32_t)((iperf_last_us - iperf_first_us) / 1000U));
+    }
+}
+
+static void iperf_udp_tx_finish(uint8_t sock) {
+    /* Server report: iperf_hdr gets the W5500 RX header, UDP header and server header */
+    uint16_t avail = w5500_socket_get_rx_buf_size(sock);
+    if (avail >= IPERF_UDP_INFO_SIZE) {
+        uint16_t ptr = w5500_socket_rx_begin(sock);
+        w5500_socket_rx_read(sock, ptr, iperf_hdr, (avail < sizeof(iperf_hdr)) ? avail : sizeof(iperf_hdr));
+        uint16_t len = (uint16_t)((iperf_hdr[6] << 8) | iperf_hdr[7]);
+        w5500_socket_rx_commit(sock, (uint16_t)(ptr + IPERF_UDP_INFO_SIZE + len));
+
+        const uint8_t *report = &iperf_hdr[IPERF_UDP_INFO_SIZE + IPERF_UDP_HDR_SIZE];
+        if (len >= IPERF_UDP_HDR_SIZE + IPERF_SERVER_HDR_SIZE && (iperf_get32(&report[0]) & IPERF_HEADER_VERSION1)) {
+            iperf_stats.lost = iperf_get32(&report[20]);
+            iperf_stats.out_of_order = iperf_get32(&report[24]);
+            iperf_stats.jitter_us = iperf_get32(&report[32]) * 1000000U + iperf_get32(&report[36]);
+            iperf_finish(IPERF_STATE_DONE, iperf_stats.elapsed_ms);
+            return;
+        }
+    }
+
+    if ((HAL_GetTick() - iperf_last_ms) < IPERF_FIN_WAIT_MS && iperf_fin_count > 0) return;
+    if (iperf_fin_count == IPERF_FIN_RETRIES) {
+        iperf_finish(IPERF_STATE_DONE, iperf_stats.elapsed_ms);    /* Throughput is known without it */
+        return;
+    }
+    iperf_udp_put_header(iperf_hdr, -(int32_t)iperf_seq);
+    memset(&iperf_hdr[IPERF_UDP_HDR_SIZE], 0, IPERF_CLIENT_HDR_SIZE);
+    iperf_udp_send(sock, iperf_hdr, IPERF_UDP_HDR_SIZE + IPERF_CLIENT_HDR_SIZE, iperf_run.len);
+    iperf_fin_count++;
+    iperf_last_ms = HAL_GetTick();
+}
+
+static void iperf_udp_tx_service(uint8_t sock) {
+    if (iperf_stats.state == IPERF_STATE_FINISHING) {
+        iperf_udp_tx_finish(sock);
+        return;
+    }
+
+    uint32_t slice_start = HAL_GetTick();
+    do {
+        uint32_t elapsed = HAL_GetTick() - iperf_start_ms;
+        if (elapsed >= iperf_run.duration_ms) {
+            iperf_stats.state = IPERF_STATE_FINISHING;
+            iperf_stats.elapsed_ms = elapsed;
+            iperf_stats.datagrams = iperf_seq;
+            iperf_fin_count = 0;
+            iperf_udp_tx_finish(sock);
+            return;
+        }
+        /* Pace on the total since the start, so a late poll catches up */
+        if (iperf_run.rate_kbps && (uint64_t)iperf_stats.bytes * 8U >= (uint64_t)iperf_run.rate_kbps * elapsed) break;
+        if (w5500_socket_get_tx_buf_free_size(sock) < iperf_run.len) break;
+
+        iperf_udp_put_header(iperf_hdr, (int32_t)iperf_seq);
+        memset(&iperf_hdr[IPERF_UDP_HDR_SIZE], 0, IPERF_CLIENT_HDR_SIZE);
+        if (iperf_udp_send(sock, iperf_hdr, IPERF_UDP_HDR_SIZE + IPERF_CLIENT_HDR_SIZE, iperf_run.len) < 0) {
+            iperf_finish(IPERF_STATE_FAILED, elapsed);
+            return;
+        }
+        iperf_seq++;
+        iperf_stats.bytes += iperf_run.len;
+    } while ((HAL_GetTick() - slice_start) < IPERF_POLL_SLICE_MS);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool iperf_init(void) {
+    dwt_cycles_init();
+    iperf_run.mode = iperf_server_mode;
+    bool ok = iperf_open_server();
+    printf("iperf server on TCP port %d: %s\n", iperf_server_port, ok ? "OK" : "FAILED");
+    return ok;
+}
+
+bool iperf_start(iperf_mode_t mode, const uint8_t *ip, uint16_t port, uint16_t duration_s,
+                 uint16_t len, uint32_t rate_kbps, uint8_t flags) {
+    uint8_t sock = ETH_CONFIG_IPERF_SOCKET;
+    bool client = (mode == IPERF_MODE_TCP_TX || mode == IPERF_MODE_UDP_TX);
+
+    /* A client run must finish first; a server session is cut short */
+    if (mode >= IPERF_MODE_COUNT) return false;
+    if (iperf_active() && (iperf_run.mode == IPERF_MODE_TCP_TX || iperf_run.mode == IPERF_MODE_UDP_TX)) return false;
+    if (port == 0) port = ETH_CONFIG_IPERF_PORT;
+    if (duration_s == 0) duration_s = IPERF_DEFAULT_DURATION_S;
+    if (len == 0) len = IPERF_DEFAULT_UDP_LEN;
+    if (client && (!ip || (ip[0] | ip[1] | ip[2] | ip[3]) == 0)) return false;
+    if (mode == IPERF_MODE_UDP_TX && (len < IPERF_MIN_UDP_LEN || len > IPERF_MAX_UDP_LEN)) return false;
+    if ((flags & IPERF_FLAG_FLASH_PAYLOAD) &&
+        (!FLASH_DRIVER_ENABLED || (mode != IPERF_MODE_TCP_RX && mode != IPERF_MODE_TCP_TX))) return false;
+#if FLASH_DRIVER_ENABLED
+    /* RESERVED shrunk to its minimum leaves no scratch */
+    if ((flags & IPERF_FLAG_FLASH_PAYLOAD) && iperf_flash_size() == 0) return false;
+#endif
+
+    iperf_run.mode = mode;
+    iperf_run.flags = flags;
+    iperf_run.port = port;
+    iperf_run.duration_ms = (uint32_t)duration_s * 1000U;
+    iperf_run.len = len;
+    iperf_run.rate_kbps = rate_kbps;
+    iperf_reset_stats(mode, flags, IPERF_STATE_IDLE);
+
+    if (!client) {
+        iperf_server_mode = mode;
+        iperf_server_port = port;
+        iperf_server_flags = flags;
+        memset(iperf_run.ip, 0, sizeof(iperf_run.ip));
+        iperf_run.port = 0;                 /* Client port, once one connects */
+        if (!iperf_open_server()) {
+            iperf_stats.state = IPERF_STATE_FAILED;
+            return false;
+        }
+        return true;
+    }
+
+    memcpy(iperf_run.ip, ip, sizeof(iperf_run.ip));
+    iperf_now_us();
+    iperf_last_ms = HAL_GetTick();
+    w5500_socket_close(sock);
+
+    if (mode == IPERF_MODE_TCP_TX) {
+        uint8_t io_mode = SOCK_IO_NONBLOCK;
+        if (w5500_socket_open(sock, W5500_SOCK_TCP, 0) != W5500_SOCK_OK ||
+            w5500_socket_ctlsocket(sock, CS_SET_IOMODE, &io_mode) != W5500_SOCK_OK ||
+            w5500_socket_connect(sock, ip, port) == W5500_SOCK_ERROR) {
+            iperf_finish(IPERF_STATE_FAILED, 0);
+            return false;
+        }
+        iperf_stats.state = IPERF_STATE_CONNECTING;
+    } else {
+        if (w5500_socket_open(sock, W5500_SOCK_UDP, 0) != W5500_SOCK_OK) {
+            iperf_finish(IPERF_STATE_FAILED, 0);
+            return false;
+        }
+        w5500_socket_setsockopt(sock, SO_DESTIP, iperf_run.ip);
+        w5500_socket_setsockopt(sock, SO_DESTPORT, &iperf_run.port);
+        iperf_tx_prefill(sock);
+        iperf_seq = 0;
+        iperf_stats.state = IPERF_STATE_RUNNING;
+        iperf_start_ms = HAL_GetTick();
+    }
+    printf("iperf: %s to %d.%d.%d.%d:%d for %d s\n", iperf_mode_names[mode], ip[0], ip[1], ip[2], ip[3],
+           port, duration_s);
+    return true;
+}
+
+void iperf_poll(void) {
+    uint8_t sock = ETH_CONFIG_IPERF_SOCKET;
+    bool event = false;
+
+    if (w5500_socket_get_pending_irq() & (1u << sock)) {
+        w5500_socket_take_irq(sock);
+        event = true;
+    }
+    uint32_t now = HAL_GetTick();
+    if ((now - iperf_last_sweep) >= IPERF_SWEEP_MS) {
+        iperf_last_sweep = now;
+        event = true;
+    }
+    if (!event && !iperf_active()) return;
+
+    switch (iperf_run.mode) {
+    case IPERF_MODE_TCP_RX: iperf_tcp_rx_service(sock); break;
+    case IPERF_MODE_UDP_RX: iperf_udp_rx_service(sock); break;
+    case IPERF_MODE_TCP_TX: iperf_tcp_tx_service(sock); break;
+    case IPERF_MODE_UDP_TX: iperf_udp_tx_service(sock); break;
+    default: break;
+    }
+}
+
+void iperf_get_stats(iperf_stats_t *stats) {
+    *stats = iperf_stats;
+}
+
+#endif /* IPERF_ENABLED */
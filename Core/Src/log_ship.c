@@ -0,0 +1,210 @@
+/**
+ * @file log_ship.c
+ * @brief Flash log shipping to a remote syslog collector
+ */
+
+#include "log_ship.h"
+#include "../../Middlewares/In_House/flash/w25q128_log.h"
+#include "w5500_socket.h"
+#include "eth_config.h"
+#include "iperf.h"
+#include "sync_sample.h"
+#include "main.h"
+#include <string.h>
+#include <stdio.h>
+
+#if LOG_SHIP_ENABLED
+
+#define LOG_SHIP_PREFIX_MAX     4       /* "NNN " octet count, frames stay below 1000 bytes */
+
+static log_ship_stats_t ship_stats;
+static uint32_t ship_inflight = 0;      /* Cursor once the batch in flight is acknowledged */
+static uint16_t ship_batch_records = 0;
+static uint32_t ship_persisted = 0;
+static uint32_t ship_state_ms = 0;      /* Last connect attempt */
+static uint32_t ship_persist_ms = 0;
+
+static char ship_frame[LOG_SHIP_FRAME_MAX];
+static uint8_t ship_msg[W25_LOG_MSG_MAX];
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static bool log_ship_egress_idle(void) {
+#if IPERF_ENABLED
+    iperf_stats_t iperf;
+    iperf_get_stats(&iperf);
+    if (iperf.state == IPERF_STATE_CONNECTING || iperf.state == IPERF_STATE_RUNNING ||
+        iperf.state == IPERF_STATE_FINISHING) {
+        return false;
+    }
+#endif
+#if SYNC_SAMPLE_ENABLED
+    sync_sample_stats_t sync;
+    sync_sample_get_stats(&sync);
+    if (sync.state == SYNC_STATE_SAMPLING) return false;
+#endif
+    for (uint8_t s = 0; s < W5500_MAX_SOCKET; s++) {
+        if (s == ETH_CONFIG_LOG_SOCKET || w5500_socket_get_status(s) == SOCK_CLOSED) continue;
+        if (w5500_socket_get_tx_buf_free_size(s) < ETH_CONFIG_SOCKET_BUFFER_SIZE) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Frame one record as "LEN <PRI>1 - HOST APP - - [meta ...] MSG"
+ * @return Frame length, starting at ship_frame + *start
+ */
+static uint16_t log_ship_format(const w25q128_log_record_t *rec, uint16_t len, uint16_t *start) {
+    const uint8_t *ip = g_network_info.ip;
+    char *msg = &ship_frame[LOG_SHIP_PREFIX_MAX];
+    int n = snprintf(msg, LOG_SHIP_FRAME_MAX - LOG_SHIP_PREFIX_MAX,
+                     "<%u>1 - %u.%u.%u.%u " LOG_SHIP_APP_NAME " - - [meta sequenceId=\"%lu\" sysUpTime=\"%lu\"] ",
+                     (unsigned)(LOG_SHIP_FACILITY * 8 + (rec->level & 7)), ip[0], ip[1], ip[2], ip[3],
+                     (unsigned long)rec->seq, (unsigned long)(rec->time_ms / 10));
+    if (n + len > LOG_SHIP_FRAME_MAX - LOG_SHIP_PREFIX_MAX) len = (uint16_t)(LOG_SHIP_FRAME_MAX - LOG_SHIP_PREFIX_MAX - n);
+    memcpy(&msg[n], ship_msg, len);
+    n += len;
+
+    /* Octet count right-aligned in front of the message */
+    char count[LOG_SHIP_PREFIX_MAX + 1];
+    int c = snprintf(count, sizeof(count), "%d ", n);
+    *start = (uint16_t)(LOG_SHIP_PREFIX_MAX - c);
+    memcpy(&ship_frame[*start], count, (size_t)c);
+    return (uint16_t)(n + c);
+}
+
+static void log_ship_drop(void) {
+    w5500_socket_close(ETH_CONFIG_LOG_SOCKET);
+    ship_inflight = ship_stats.cursor;      /* Unacknowledged batch goes again */
+    ship_stats.state = LOG_SHIP_STATE_IDLE;
+}
+
+// ============================================================================
+// SHIPPING
+// ============================================================================
+
+static void log_ship_connect(uint32_t now) {
+    const uint8_t target[4] = ETH_CONFIG_LOG_TARGET_IP;
+    uint8_t sock = ETH_CONFIG_LOG_SOCKET;
+    uint8_t io_mode = SOCK_IO_NONBLOCK;
+
+    ship_state_ms = now;
+    w5500_socket_close(sock);
+    if (w5500_socket_open(sock, W5500_SOCK_TCP, 0) != W5500_SOCK_OK ||
+        w5500_socket_ctlsocket(sock, CS_SET_IOMODE, &io_mode) != W5500_SOCK_OK ||
+        w5500_socket_connect(sock, target, ETH_CONFIG_LOG_TARGET_PORT) == W5500_SOCK_ERROR) {
+        w5500_socket_close(sock);
+        return;
+    }
+    ship_stats.state = LOG_SHIP_STATE_CONNECTING;
+}
+
+static void log_ship_service(void) {
+    uint8_t sock = ETH_CONFIG_LOG_SOCKET;
+    uint16_t free_size = w5500_socket_get_tx_buf_free_size(sock);
+
+    if (free_size == ETH_CONFIG_SOCKET_BUFFER_SIZE && ship_inflight != ship_stats.cursor) {
+        ship_stats.shipped += ship_batch_records;
+        ship_stats.cursor = ship_inflight;
+    }
+
+    uint32_t oldest = w25q128_log_oldest_seq();
+    if ((int32_t)(ship_stats.cursor - oldest) < 0 && ship_inflight == ship_stats.cursor) {
+        ship_stats.lost += oldest - ship_stats.cursor;
+        ship_stats.cursor = ship_inflight = oldest;
+    }
+
+    if (ship_inflight != ship_stats.cursor) return;                 /* Batch still in flight */
+    if (ship_inflight == w25q128_log_next_seq()) return;            /* Nothing new */
+    if (!log_ship_egress_idle()) {
+        ship_stats.deferred++;
+        return;
+    }
+
+    uint16_t start = w5500_socket_tx_begin(sock);
+    uint16_t ptr = start;
+    uint16_t len = 0;
+    uint32_t seq = ship_inflight;
+    uint16_t records = 0;
+    while (len + LOG_SHIP_FRAME_MAX <= LOG_SHIP_BATCH_MAX && len + LOG_SHIP_FRAME_MAX <= free_size) {
+        w25q128_log_record_t rec;
+        int16_t n = w25q128_log_read(seq, &rec, ship_msg, sizeof(ship_msg));
+        if (n < 0) break;
+        if (rec.seq != seq) ship_stats.lost += rec.seq - seq;
+        uint16_t frame_start;
+        uint16_t frame_len = log_ship_format(&rec, (uint16_t)n, &frame_start);
+        ptr = w5500_socket_tx_write(sock, ptr, (const uint8_t *)&ship_frame[frame_start], frame_len);
+        len = (uint16_t)(len + frame_len);
+        seq = rec.seq + 1;
+        records++;
+    }
+    if (len == 0) return;
+
+    if (w5500_socket_tx_commit(sock, start, ptr) < 0) {
+        log_ship_drop();
+        return;
+    }
+    ship_inflight = seq;
+    ship_batch_records = records;
+    ship_stats.batches++;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void log_ship_init(void) {
+    memset(&ship_stats, 0, sizeof(ship_stats));
+    if (!w25q128_log_cursor_load(&ship_stats.cursor)) ship_stats.cursor = w25q128_log_oldest_seq();
+    ship_inflight = ship_persisted = ship_stats.cursor;
+    ship_state_ms = HAL_GetTick() - LOG_SHIP_RETRY_MS;
+    ship_persist_ms = HAL_GetTick();
+    printf("Log ship: from record %lu (%lu..%lu in flash)\n", (unsigned long)ship_stats.cursor,
+           (unsigned long)w25q128_log_oldest_seq(), (unsigned long)w25q128_log_next_seq() - 1);
+}
+
+void log_ship_poll(void) {
+    uint8_t sock = ETH_CONFIG_LOG_SOCKET;
+    uint32_t now = HAL_GetTick();
+    uint8_t status = w5500_socket_get_status(sock);
+
+    switch (ship_stats.state) {
+    case LOG_SHIP_STATE_IDLE:
+        if ((now - ship_state_ms) >= LOG_SHIP_RETRY_MS) log_ship_connect(now);
+        break;
+    case LOG_SHIP_STATE_CONNECTING:
+        if (status == SOCK_ESTABLISHED) {
+            ship_stats.state = LOG_SHIP_STATE_CONNECTED;
+            ship_stats.connects++;
+            ship_inflight = ship_stats.cursor;
+            printf("Log ship: connected, replaying from record %lu\n", (unsigned long)ship_stats.cursor);
+        } else if (status == SOCK_CLOSED || (now - ship_state_ms) >= LOG_SHIP_CONNECT_TIMEOUT_MS) {
+            log_ship_drop();
+        }
+        break;
+    case LOG_SHIP_STATE_CONNECTED:
+        if (status != SOCK_ESTABLISHED) {
+            printf("Log ship: connection lost at record %lu\n", (unsigned long)ship_stats.cursor);
+            ship_state_ms = now;
+            log_ship_drop();
+            break;
+        }
+        log_ship_service();
+        break;
+    default:
+        break;
+    }
+
+    if (ship_stats.cursor != ship_persisted && (now - ship_persist_ms) >= LOG_SHIP_PERSIST_MS) {
+        ship_persist_ms = now;
+        if (w25q128_log_cursor_store(ship_stats.cursor)) ship_persisted = ship_stats.cursor;
+    }
+}
+
+void log_ship_get_stats(log_ship_stats_t *stats) {
+    *stats = ship_stats;
+}
+
+#endif /* LOG_SHIP_ENABLED */
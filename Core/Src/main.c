@@ -21,15 +21,18 @@
 #include "cmsis_os.h"
 #include "adc.h"
 #include "can.h"
+#include "dma.h"
 #include "i2c.h"
 #include "spi.h"
+#include "tim.h"
 #include "usart.h"
 #include "usb.h"
 #include "gpio.h"
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include "boot_prof.h"
+#include "w5500_spi.h"
 
 
 /* USER CODE END Includes */
@@ -76,6 +79,7 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
+  boot_prof_start();
   count++; // count = 1
   /* USER CODE END 1 */
 
@@ -86,6 +90,7 @@ int main(void)
 
   /* USER CODE BEGIN Init */
   count++; // count = 2
+  boot_prof_mark(BOOT_PHASE_HAL_INIT);
   /* USER CODE END Init */
 
   /* Configure the system clock */
@@ -93,20 +98,29 @@ int main(void)
 
   /* USER CODE BEGIN SysInit */
   count++; // count = 3
+  boot_prof_mark(BOOT_PHASE_CLOCK);
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_ADC1_Init();
   MX_ADC2_Init();
   MX_CAN_Init();
   MX_I2C1_Init();
   MX_SPI2_Init();
+  MX_TIM2_Init();
+  MX_TIM4_Init();
   MX_USART1_UART_Init();
   MX_USB_PCD_Init();
   /* USER CODE BEGIN 2 */
   count++; // count = 4
 
+  // MX_GPIO_Init() left the W5500 in reset; release it now so its PLL lock
+  // and PHY auto-negotiation run while the scheduler and tasks start
+  w5500_spi_reset_release();
+  boot_prof_mark(BOOT_PHASE_PERIPH);
+
 
 
 
@@ -0,0 +1,53 @@
+/**
+ * @file modbus_map.c
+ * @brief Modbus TCP register map tables and compile-time validation
+ */
+
+#include "modbus_map.h"
+#include "main.h"
+
+/* Application variables referenced by the map */
+extern uint32_t task00;
+extern uint32_t task01;
+extern uint32_t task02;
+extern uint32_t task03;
+
+volatile uint32_t modbus_stat_requests = 0;
+volatile uint32_t modbus_stat_exceptions = 0;
+uint16_t modbus_user_regs[MODBUS_USER_REG_COUNT];
+uint8_t modbus_user_coils[(MODBUS_USER_COIL_COUNT + 7) / 8];
+
+/* Every block must be backed by exactly count registers of storage */
+#define MODBUS_MAP_CHECK_REG(name, count, storage, access)                      \
+    _Static_assert(sizeof(storage) == (count) * sizeof(uint16_t),               \
+                   "Modbus register block " #name " does not match its storage"); \
+    _Static_assert((access) == MODBUS_ACCESS_RO || (access) == MODBUS_ACCESS_RW,  \
+                   "Modbus register block " #name " has invalid access");
+MODBUS_REGISTER_MAP(MODBUS_MAP_CHECK_REG)
+
+/* Coils are bit-packed, LSB first */
+#define MODBUS_MAP_CHECK_COIL(name, count, storage, access)                     \
+    _Static_assert(sizeof(storage) == ((count) + 7) / 8,                        \
+                   "Modbus coil block " #name " does not match its storage");   \
+    _Static_assert((access) == MODBUS_ACCESS_RO || (access) == MODBUS_ACCESS_RW,  \
+                   "Modbus coil block " #name " has invalid access");
+MODBUS_COIL_MAP(MODBUS_MAP_CHECK_COIL)
+
+_Static_assert(MODBUS_REG_COUNT <= 0x10000, "Modbus register map exceeds address space");
+_Static_assert(MODBUS_COIL_COUNT <= 0x10000, "Modbus coil map exceeds address space");
+
+#define MODBUS_MAP_ENTRY_REG(name, count, storage, access) \
+    { MODBUS_REG_##name, (count), (void *)&(storage), (access) },
+const modbus_block_t modbus_register_blocks[] = {
+    MODBUS_REGISTER_MAP(MODBUS_MAP_ENTRY_REG)
+};
+const uint8_t modbus_register_block_count =
+    sizeof(modbus_register_blocks) / sizeof(modbus_register_blocks[0]);
+
+#define MODBUS_MAP_ENTRY_COIL(name, count, storage, access) \
+    { MODBUS_COIL_##name, (count), (void *)&(storage), (access) },
+const modbus_block_t modbus_coil_blocks[] = {
+    MODBUS_COIL_MAP(MODBUS_MAP_ENTRY_COIL)
+};
+const uint8_t modbus_coil_block_count =
+    sizeof(modbus_coil_blocks) / sizeof(modbus_coil_blocks[0]);
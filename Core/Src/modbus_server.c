@@ -0,0 +1,388 @@
+/**
+ * @file modbus_server.c
+ * @brief Modbus TCP server implementation
+ */
+
+#include "modbus_server.h"
+#include "modbus_map.h"
+#include "w5500_socket.h"
+#include "eth_config.h"
+#include "main.h"
+#include <string.h>
+#include <stdio.h>
+
+/* Response bytes are staged in a small chunk and burst into the TX buffer */
+#define MODBUS_TX_CHUNK_SIZE    64
+
+typedef struct {
+    uint8_t sock;
+    uint16_t start;                         /* TX pointer of the MBAP header */
+    uint16_t ptr;                           /* TX pointer of the next flush */
+    uint8_t fill;
+    uint8_t chunk[MODBUS_TX_CHUNK_SIZE];
+} modbus_tx_t;
+
+static uint8_t modbus_rx[MODBUS_MBAP_SIZE + MODBUS_MAX_PDU_SIZE];
+static modbus_tx_t modbus_tx;
+static uint32_t modbus_last_sweep = 0;
+
+// ============================================================================
+// RESPONSE ENCODER
+// ============================================================================
+
+static void modbus_tx_flush(modbus_tx_t *tx) {
+    if (tx->fill == 0) return;
+    tx->ptr = w5500_socket_tx_write(tx->sock, tx->ptr, tx->chunk, tx->fill);
+    tx->fill = 0;
+}
+
+static inline void modbus_tx_put(modbus_tx_t *tx, uint8_t byte) {
+    tx->chunk[tx->fill++] = byte;
+    if (tx->fill == MODBUS_TX_CHUNK_SIZE) modbus_tx_flush(tx);
+}
+
+static inline void modbus_tx_put16(modbus_tx_t *tx, uint16_t value) {
+    modbus_tx_put(tx, (uint8_t)(value >> 8));
+    modbus_tx_put(tx, (uint8_t)value);
+}
+
+static void modbus_tx_begin(modbus_tx_t *tx, uint8_t sock) {
+    tx->sock = sock;
+    tx->start = w5500_socket_tx_begin(sock);
+    tx->ptr = (uint16_t)(tx->start + MODBUS_MBAP_SIZE);    /* PDU first, header last */
+    tx->fill = 0;
+}
+
+static void modbus_tx_end(modbus_tx_t *tx, const uint8_t *mbap) {
+    modbus_tx_flush(tx);
+    uint16_t length = (uint16_t)(tx->ptr - tx->start - MODBUS_MBAP_SIZE + 1);
+    uint8_t header[MODBUS_MBAP_SIZE] = {
+        mbap[0], mbap[1],                       /* Transaction id (echoed) */
+        0x00, 0x00,                             /* Protocol id */
+        (uint8_t)(length >> 8), (uint8_t)length,
+        mbap[6]                                 /* Unit id (echoed) */
+    };
+    w5500_socket_tx_write(tx->sock, tx->start, header, MODBUS_MBAP_SIZE);
+    w5500_socket_tx_commit(tx->sock, tx->start, tx->ptr);
+}
+
+// ============================================================================
+// MAP ACCESS
+// ============================================================================
+
+static const modbus_block_t* modbus_find_block(const modbus_block_t *blocks, uint8_t count, uint16_t addr) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (addr >= blocks[i].start && addr < blocks[i].start + blocks[i].count) return &blocks[i];
+    }
+    return NULL;
+}
+
+static bool modbus_range_writable(const modbus_block_t *blocks, uint8_t count, uint16_t addr, uint16_t qty) {
+    uint32_t end = (uint32_t)addr + qty;
+    while (addr < end) {
+        const modbus_block_t *blk = modbus_find_block(blocks, count, addr);
+        if (!blk || blk->access != MODBUS_ACCESS_RW) return false;
+        addr = blk->start + blk->count;
+    }
+    return true;
+}
+
+static inline bool modbus_coil_get(const modbus_block_t *blk, uint16_t addr) {
+    uint16_t bit = (uint16_t)(addr - blk->start);
+    return (((const uint8_t *)blk->storage)[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static inline void modbus_coil_set(const modbus_block_t *blk, uint16_t addr, bool on) {
+    uint16_t bit = (uint16_t)(addr - blk->start);
+    uint8_t *bits = (uint8_t *)blk->storage;
+    if (on) bits[bit >> 3] |= (uint8_t)(1u << (bit & 7));
+    else    bits[bit >> 3] &= (uint8_t)~(1u << (bit & 7));
+}
+
+// ============================================================================
+// FUNCTION HANDLERS
+// Each handler returns 0 on success (response already encoded) or an exception code
+// ============================================================================
+
+static uint8_t modbus_read_registers(modbus_tx_t *tx, uint8_t fc, uint16_t addr, uint16_t qty) {
+    if (qty == 0 || qty > MODBUS_MAX_READ_REGS) return MODBUS_EX_ILLEGAL_DATA_VALUE;
+    if ((uint32_t)addr + qty > MODBUS_REG_COUNT) return MODBUS_EX_ILLEGAL_DATA_ADDRESS;
+
+    modbus_tx_put(tx, fc);
+    modbus_tx_put(tx, (uint8_t)(qty * 2));
+
+    /* Walk the contiguous range block by block */
+    while (qty) {
+        const modbus_block_t *blk = modbus_find_block(modbus_register_blocks, modbus_register_block_count, addr);
+        const volatile uint16_t *regs = (const volatile uint16_t *)blk->storage + (addr - blk->start);
+        uint16_t n = (uint16_t)(blk->start + blk->count - addr);
+        if (n > qty) n = qty;
+        for (uint16_t i = 0; i < n; i++) modbus_tx_put16(tx, regs[i]);
+        addr += n;
+        qty -= n;
+    }
+    return 0;
+}
+
+static uint8_t modbus_read_coils(modbus_tx_t *tx, uint8_t fc, uint16_t addr, uint16_t qty) {
+    if (qty == 0 || qty > MODBUS_MAX_READ_COILS) return MODBUS_EX_ILLEGAL_DATA_VALUE;
+    if ((uint32_t)addr + qty > MODBUS_COIL_COUNT) return MODBUS_EX_ILLEGAL_DATA_ADDRESS;
+
+    modbus_tx_put(tx, fc);
+    modbus_tx_put(tx, (uint8_t)((qty + 7) / 8));
+
+    const modbus_block_t *blk = NULL;
+    uint8_t packed = 0;
+    for (uint16_t i = 0; i < qty; i++, addr++) {
+        if (!blk || addr >= blk->start + blk->count) {
+            blk = modbus_find_block(modbus_coil_blocks, modbus_coil_block_count, addr);
+        }
+        if (modbus_coil_get(blk, addr)) packed |= (uint8_t)(1u << (i & 7));
+        if ((i & 7) == 7) {
+            modbus_tx_put(tx, packed);
+            packed = 0;
+        }
+    }
+    if (qty & 7) modbus_tx_put(tx, packed);
+    return 0;
+}
+
+static uint8_t modbus_write_single_coil(modbus_tx_t *tx, uint16_t addr, uint16_t value) {
+    if (value != 0xFF00 && value != 0x0000) return MODBUS_EX_ILLEGAL_DATA_VALUE;
+    if (!modbus_range_writable(modbus_coil_blocks, modbus_coil_block_count, addr, 1)) {
+        return MODBUS_EX_ILLEGAL_DATA_ADDRESS;
+    }
+    modbus_coil_set(modbus_find_block(modbus_coil_blocks, modbus_coil_block_count, addr), addr, value == 0xFF00);
+
+    modbus_tx_put(tx, MODBUS_FC_WRITE_SINGLE_COIL);
+    modbus_tx_put16(tx, addr);
+    modbus_tx_put16(tx, value);
+    return 0;
+}
+
+static uint8_t modbus_write_single_register(modbus_tx_t *tx, uint16_t addr, uint16_t value) {
+    if (!modbus_range_writable(modbus_register_blocks, modbus_register_block_count, addr, 1)) {
+        return MODBUS_EX_ILLEGAL_DATA_ADDRESS;
+    }
+    const modbus_block_t *blk = modbus_find_block(modbus_register_blocks, modbus_register_block_count, addr);
+    ((volatile uint16_t *)blk->storage)[addr - blk->start] = value;
+
+    modbus_tx_put(tx, MODBUS_FC_WRITE_SINGLE_REG);
+    modbus_tx_put16(tx, addr);
+    modbus_tx_put16(tx, value);
+    return 0;
+}
+
+static uint8_t modbus_write_multiple_coils(modbus_tx_t *tx, uint16_t addr, uint16_t qty,
+                                           const uint8_t *data, uint8_t byte_count) {
+    if (qty == 0 || qty > MODBUS_MAX_WRITE_COILS || byte_count != (qty + 7) / 8) {
+        return MODBUS_EX_ILLEGAL_DATA_VALUE;
+    }
+    if ((uint32_t)addr + qty > MODBUS_COIL_COUNT ||
+        !modbus_range_writable(modbus_coil_blocks, modbus_coil_block_count, addr, qty)) {
+        return MODBUS_EX_ILLEGAL_DATA_ADDRESS;
+    }
+
+    const modbus_block_t *blk = NULL;
+    uint16_t a = addr;
+    for (uint16_t i = 0; i < qty; i++, a++) {
+        if (!blk || a >= blk->start + blk->count) {
+            blk = modbus_find_block(modbus_coil_blocks, modbus_coil_block_count, a);
+        }
+        modbus_coil_set(blk, a, (data[i >> 3] >> (i & 7)) & 1);
+    }
+
+    modbus_tx_put(tx, MODBUS_FC_WRITE_MULTIPLE_COILS);
+    modbus_tx_put16(tx, addr);
+    modbus_tx_put16(tx, qty);
+    return 0;
+}
+
+static uint8_t modbus_write_multiple_registers(modbus_tx_t *tx, uint16_t addr, uint16_t qty,
+                                               const uint8_t *data, uint8_t byte_count) {
+    if (qty == 0 || qty > MODBUS_MAX_WRITE_REGS || byte_count != qty * 2) {
+        return MODBUS_EX_ILLEGAL_DATA_VALUE;
+    }
+    if ((uint32_t)addr + qty > MODBUS_REG_COUNT ||
+        !modbus_range_writable(modbus_register_blocks, modbus_register_block_count, addr, qty)) {
+        return MODBUS_EX_ILLEGAL_DATA_ADDRESS;
+    }
+
+    uint16_t a = addr;
+    uint16_t left = qty;
+    while (left) {
+        const modbus_block_t *blk = modbus_find_block(modbus_register_blocks, modbus_register_block_count, a);
+        volatile uint16_t *regs = (volatile uint16_t *)blk->storage + (a - blk->start);
+        uint16_t n = (uint16_t)(blk->start + blk->count - a);
+        if (n > left) n = left;
+        for (uint16_t i = 0; i < n; i++, data += 2) regs[i] = (uint16_t)((data[0] << 8) | data[1]);
+        a += n;
+        left -= n;
+    }
+
+    modbus_tx_put(tx, MODBUS_FC_WRITE_MULTIPLE_REGS);
+    modbus_tx_put16(tx, addr);
+    modbus_tx_put16(tx, qty);
+    return 0;
+}
+
+// ============================================================================
+// REQUEST DISPATCH
+// ============================================================================
+
+/* Returns false, with nothing sent, while the TX buffer cannot take a reply */
+static bool modbus_handle_request(uint8_t sock, const uint8_t *frame, uint16_t pdu_len) {
+    const uint8_t *pdu = frame + MODBUS_MBAP_SIZE;
+    uint8_t fc = pdu[0];
+    uint8_t ex = MODBUS_EX_ILLEGAL_FUNCTION;
+
+    /* Largest response is 2 + 250 bytes of data plus the MBAP header */
+    if (w5500_socket_get_tx_buf_free_size(sock) < MODBUS_MBAP_SIZE + MODBUS_MAX_PDU_SIZE) return false;
+
+    modbus_stat_requests++;
+    modbus_tx_begin(&modbus_tx, sock);
+
+    uint16_t addr = (uint16_t)((pdu[1] << 8) | pdu[2]);
+    uint16_t arg = (uint16_t)((pdu[3] << 8) | pdu[4]);
+
+    if (pdu_len < 5) {
+        ex = MODBUS_EX_ILLEGAL_DATA_VALUE;
+    } else {
+        switch (fc) {
+        case MODBUS_FC_READ_COILS:
+        case MODBUS_FC_READ_DISCRETE_INPUTS:
+            ex = modbus_read_coils(&modbus_tx, fc, addr, arg);
+            break;
+        case MODBUS_FC_READ_HOLDING_REGS:
+        case MODBUS_FC_READ_INPUT_REGS:
+            ex = modbus_read_registers(&modbus_tx, fc, addr, arg);
+            break;
+        case MODBUS_FC_WRITE_SINGLE_COIL:
+            ex = modbus_write_single_coil(&modbus_tx, addr, arg);
+            break;
+        case MODBUS_FC_WRITE_SINGLE_REG:
+            ex = modbus_write_single_register(&modbus_tx, addr, arg);
+            break;
+        case MODBUS_FC_WRITE_MULTIPLE_COILS:
+        case MODBUS_FC_WRITE_MULTIPLE_REGS:
+            if (pdu_len < 6 || pdu_len != 6 + pdu[5]) {
+                ex = MODBUS_EX_ILLEGAL_DATA_VALUE;
+            } else if (fc == MODBUS_FC_WRITE_MULTIPLE_COILS) {
+                ex = modbus_write_multiple_coils(&modbus_tx, addr, arg, &pdu[6], pdu[5]);
+            } else {
+                ex = modbus_write_multiple_registers(&modbus_tx, addr, arg, &pdu[6], pdu[5]);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (ex) {
+        /* Discard any partial response and send an exception instead */
+        modbus_stat_exceptions++;
+        modbus_tx.ptr = (uint16_t)(modbus_tx.start + MODBUS_MBAP_SIZE);
+        modbus_tx.fill = 0;
+        modbus_tx_put(&modbus_tx, (uint8_t)(fc | 0x80));
+        modbus_tx_put(&modbus_tx, ex);
+    }
+    modbus_tx_end(&modbus_tx, frame);
+    return true;
+}
+
+static void modbus_process_rx(uint8_t sock) {
+    uint16_t avail = w5500_socket_get_rx_buf_size(sock);
+    if (avail < MODBUS_MBAP_SIZE + 1) return;
+
+    uint16_t start_ptr = w5500_socket_rx_begin(sock);
+    uint16_t ptr = start_ptr;
+    uint16_t consumed_ptr = ptr;
+
+    /* Handle every complete frame already in the RX buffer (pipelined requests) */
+    while (avail >= MODBUS_MBAP_SIZE + 1) {
+        w5500_socket_rx_read(sock, ptr, modbus_rx, MODBUS_MBAP_SIZE);
+        uint16_t protocol = (uint16_t)((modbus_rx[2] << 8) | modbus_rx[3]);
+        uint16_t length = (uint16_t)((modbus_rx[4] << 8) | modbus_rx[5]);
+
+        if (protocol != 0 || length < 2 || length > MODBUS_MAX_PDU_SIZE + 1) {
+            /* Not Modbus TCP framing - drop the connection */
+            w5500_socket_disconnect(sock);
+            return;
+        }
+
+        uint16_t frame_len = (uint16_t)(MODBUS_MBAP_SIZE - 1 + length);
+        if (avail < frame_len) break;
+
+        w5500_socket_rx_read(sock, (uint16_t)(ptr + MODBUS_MBAP_SIZE), modbus_rx + MODBUS_MBAP_SIZE, length - 1);
+
+        /* No room for the reply: leave the frame in the RX buffer; SENDOK or
+         * the sweep brings us back once the master has read its responses */
+        if (!modbus_handle_request(sock, modbus_rx, (uint16_t)(length - 1))) break;
+        ptr += frame_len;
+        avail -= frame_len;
+        consumed_ptr = ptr;
+    }
+
+    if (consumed_ptr != start_ptr) w5500_socket_rx_commit(sock, consumed_ptr);
+}
+
+// ============================================================================
+// SOCKET MANAGEMENT
+// ============================================================================
+
+static void modbus_service_socket(uint8_t sock) {
+    switch (w5500_socket_get_status(sock)) {
+    case SOCK_CLOSED:
+        if (w5500_socket_open(sock, W5500_SOCK_TCP, ETH_CONFIG_MODBUS_PORT) == W5500_SOCK_OK) {
+            w5500_socket_listen(sock);
+        }
+        break;
+    case SOCK_INIT:
+        w5500_socket_listen(sock);
+        break;
+    case SOCK_ESTABLISHED:
+        modbus_process_rx(sock);
+        break;
+    case SOCK_CLOSE_WAIT:
+        w5500_socket_disconnect(sock);
+        break;
+    default:
+        break;
+    }
+}
+
+bool modbus_server_init(void) {
+    bool ok = true;
+    for (uint8_t i = 0; i < ETH_CONFIG_MODBUS_SOCKET_COUNT; i++) {
+        uint8_t sock = ETH_CONFIG_MODBUS_SOCKET_FIRST + i;
+        if (w5500_socket_open(sock, W5500_SOCK_TCP, ETH_CONFIG_MODBUS_PORT) != W5500_SOCK_OK ||
+            w5500_socket_listen(sock) != W5500_SOCK_OK) {
+            ok = false;
+        }
+    }
+    modbus_last_sweep = HAL_GetTick();
+    printf("Modbus TCP server on port %d, %d masters: %s\n",
+           ETH_CONFIG_MODBUS_PORT, ETH_CONFIG_MODBUS_SOCKET_COUNT, ok ? "OK" : "FAILED");
+    return ok;
+}
+
+void modbus_server_poll(void) {
+    uint8_t pending = w5500_socket_get_pending_irq();
+
+    for (uint8_t i = 0; i < ETH_CONFIG_MODBUS_SOCKET_COUNT; i++) {
+        uint8_t sock = ETH_CONFIG_MODBUS_SOCKET_FIRST + i;
+        if (pending & (1u << sock)) {
+            w5500_socket_take_irq(sock);
+            modbus_service_socket(sock);
+        }
+    }
+
+    /* Periodic sweep catches state changes that raise no interrupt */
+    uint32_t now = HAL_GetTick();
+    if ((now - modbus_last_sweep) >= MODBUS_SERVER_SWEEP_MS) {
+        modbus_last_sweep = now;
+        for (uint8_t i = 0; i < ETH_CONFIG_MODBUS_SOCKET_COUNT; i++) {
+            modbus_service_socket(ETH_CONFIG_MODBUS_SOCKET_FIRST + i);
+        }
+    }
+}
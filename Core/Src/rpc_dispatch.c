@@ -0,0 +1,26 @@
+/* Generated by Tools/rpc_gen.py from Tools/rpc_schema.json - do not edit */
+
+#include "rpc_schema.h"
+
+const rpc_op_entry_t rpc_op_table[RPC_OP_COUNT] = {
+    [RPC_OP_PING] = { rpc_handle_ping, 0 },
+    [RPC_OP_GET_CONFIG] = { rpc_handle_get_config, 0 },
+    [RPC_OP_SET_CONFIG] = { rpc_handle_set_config, RPC_FLAG_CACHED },
+    [RPC_OP_GET_METRICS] = { rpc_handle_get_metrics, 0 },
+    [RPC_OP_FLASH_READ] = { rpc_handle_flash_read, 0 },
+    [RPC_OP_FLASH_ERASE] = { rpc_handle_flash_erase, RPC_FLAG_CACHED },
+    [RPC_OP_FLASH_WRITE] = { rpc_handle_flash_write, RPC_FLAG_CACHED },
+    [RPC_OP_REBOOT] = { rpc_handle_reboot, RPC_FLAG_CACHED },
+    [RPC_OP_GET_BOOT_PROFILE] = { rpc_handle_get_boot_profile, 0 },
+    [RPC_OP_IPERF] = { rpc_handle_iperf, RPC_FLAG_CACHED },
+    [RPC_OP_GET_IPERF] = { rpc_handle_get_iperf, 0 },
+    [RPC_OP_SYNC] = { rpc_handle_sync, RPC_FLAG_CACHED },
+    [RPC_OP_SYNC_START] = { rpc_handle_sync_start, RPC_FLAG_CACHED },
+    [RPC_OP_GET_SYNC] = { rpc_handle_get_sync, 0 },
+    [RPC_OP_GET_FLASH_POWER] = { rpc_handle_get_flash_power, 0 },
+    [RPC_OP_GET_PARTITION] = { rpc_handle_get_partition, 0 },
+    [RPC_OP_GROW_PARTITION] = { rpc_handle_grow_partition, RPC_FLAG_CACHED },
+    [RPC_OP_GET_WEAR] = { rpc_handle_get_wear, 0 },
+    [RPC_OP_TRACE] = { rpc_handle_trace, RPC_FLAG_CACHED },
+    [RPC_OP_GET_TRACE] = { rpc_handle_get_trace, 0 },
+};
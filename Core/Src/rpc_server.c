@@ -0,0 +1,490 @@
+/**
+ * @file rpc_server.c
+ * @brief Binary RPC command channel implementation
+ */
+
+#include "rpc_server.h"
+#include "rpc_schema.h"
+#include "w5500_socket.h"
+#include "eth_config.h"
+#include "flash_config.h"
+#include "../../Middlewares/In_House/flash/w25q128_log.h"
+#include "../../Middlewares/In_House/flash/w25q128_part.h"
+#include "../../Middlewares/In_House/flash/w25q128_remap.h"
+#include "../../Middlewares/In_House/flash/w25q128_wear.h"
+#include "modbus_map.h"
+#include "boot_prof.h"
+#include "iperf.h"
+#include "sync_sample.h"
+#include "trace.h"
+#include "FreeRTOS.h"
+#include "cmsis_os.h"
+#include "main.h"
+#include <string.h>
+#include <stdio.h>
+
+#define RPC_DATAGRAM_SIZE   (RPC_HEADER_SIZE + RPC_MAX_PAYLOAD)
+
+typedef struct {
+    bool valid;
+    uint8_t ip[4];
+    uint16_t port;
+    uint32_t request_id;
+    uint16_t len;
+    uint8_t data[RPC_DATAGRAM_SIZE];
+} rpc_cache_entry_t;
+
+/* Application state reachable through the channel */
+extern uint32_t task00;
+extern uint32_t task01;
+extern uint32_t task02;
+extern uint32_t task03;
+extern volatile uint16_t task_period_ms[4];
+extern osThreadId_t Task00_1msHandle;
+extern osThreadId_t Task01_10msHandle;
+extern osThreadId_t Task02_100msHandle;
+extern osThreadId_t Task03_1000msHandle;
+
+static uint8_t rpc_rx[RPC_DATAGRAM_SIZE];
+static uint8_t rpc_tx[RPC_DATAGRAM_SIZE];
+static rpc_cache_entry_t rpc_cache[ETH_CONFIG_RPC_CACHE_SIZE];
+static uint8_t rpc_cache_next = 0;
+
+static uint32_t rpc_requests = 0;
+static uint32_t rpc_retries = 0;
+static bool rpc_netinfo_dirty = false;
+static bool rpc_reboot_pending = false;
+static uint32_t rpc_reboot_tick = 0;
+
+/* Value size of every configuration key, generated from the schema */
+static const uint8_t rpc_config_key_size[RPC_KEY_COUNT] = {
+#define RPC_CONFIG_KEY_SIZE(id, name, size) [id] = (size),
+    RPC_CONFIG_KEY_TABLE(RPC_CONFIG_KEY_SIZE)
+#undef RPC_CONFIG_KEY_SIZE
+};
+
+// ============================================================================
+// WIRE HELPERS
+// ============================================================================
+
+static inline void rpc_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v;
+}
+
+static inline void rpc_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+static inline uint32_t rpc_get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint8_t* rpc_config_field(uint8_t key) {
+    switch (key) {
+    case RPC_KEY_NET_MAC:     return g_network_info.mac;
+    case RPC_KEY_NET_IP:      return g_network_info.ip;
+    case RPC_KEY_NET_SUBNET:  return g_network_info.sn;
+    case RPC_KEY_NET_GATEWAY: return g_network_info.gw;
+    case RPC_KEY_NET_DNS:     return g_network_info.dns;
+    default:                  return NULL;
+    }
+}
+
+// ============================================================================
+// HANDLERS (dispatched through rpc_op_table)
+// ============================================================================
+
+int16_t rpc_handle_ping(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    rpc_put32(reply, HAL_GetTick());
+    return 4;
+}
+
+int16_t rpc_handle_get_config(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len != 1) return -RPC_STATUS_BAD_REQUEST;
+    uint8_t key = req[0];
+    if (key >= RPC_KEY_COUNT) return -RPC_STATUS_UNKNOWN_KEY;
+
+    reply[0] = key;
+    uint8_t *field = rpc_config_field(key);
+    if (field) {
+        memcpy(&reply[1], field, rpc_config_key_size[key]);
+    } else {
+        uint16_t period = task_period_ms[key - RPC_KEY_TASK00_PERIOD_MS];
+        reply[1] = (uint8_t)(period >> 8);
+        reply[2] = (uint8_t)period;
+    }
+    return (int16_t)(1 + rpc_config_key_size[key]);
+}
+
+int16_t rpc_handle_set_config(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len < 1) return -RPC_STATUS_BAD_REQUEST;
+    uint8_t key = req[0];
+    if (key >= RPC_KEY_COUNT) return -RPC_STATUS_UNKNOWN_KEY;
+    if (req_len != 1 + rpc_config_key_size[key]) return -RPC_STATUS_BAD_REQUEST;
+
+    uint8_t *field = rpc_config_field(key);
+    if (field) {
+        memcpy(field, &req[1], rpc_config_key_size[key]);
+        rpc_netinfo_dirty = true;       /* Applied after the reply has left */
+    } else {
+        uint16_t period = (uint16_t)((req[1] << 8) | req[2]);
+        if (period == 0) return -RPC_STATUS_BAD_REQUEST;
+        task_period_ms[key - RPC_KEY_TASK00_PERIOD_MS] = period;
+    }
+#if FLASH_DRIVER_ENABLED
+    w25q128_log_printf(W25_LOG_NOTICE, "rpc: config key %u set", key);
+#endif
+    return 0;
+}
+
+int16_t rpc_handle_get_metrics(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    const uint32_t metrics[] = {
+        HAL_GetTick(), task00, task01, task02, task03,
+        (uint32_t)xPortGetFreeHeapSize(),
+        modbus_stat_requests, modbus_stat_exceptions,
+        rpc_requests, rpc_retries,
+        /* Bytes never used (high-water mark), per task */
+        osThreadGetStackSpace(Task00_1msHandle), osThreadGetStackSpace(Task01_10msHandle),
+        osThreadGetStackSpace(Task02_100msHandle), osThreadGetStackSpace(Task03_1000msHandle),
+    };
+    for (uint8_t i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++) rpc_put32(&reply[i * 4], metrics[i]);
+    return (int16_t)sizeof(metrics);
+}
+
+#if FLASH_DRIVER_ENABLED
+/*
+ * Erase and program reach the standby firmware slots and USER_DATA only: the
+ * rest holds the bootloader, the running image and the metadata (partition
+ * and remap tables, spares, wear banks, log cursor) the firmware relies on.
+ */
+static bool rpc_flash_writable(uint32_t addr, uint32_t len) {
+    static const flash_part_id_t parts[] = { FLASH_PART_FW_B, FLASH_PART_FW_C, FLASH_PART_USER_DATA };
+    for (uint8_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        uint32_t base = w25q128_part_base(parts[i]);
+        uint32_t size = w25q128_part_size(parts[i]);
+        if (addr >= base && addr - base < size && len <= size - (addr - base)) return true;
+    }
+    return false;
+}
+
+int16_t rpc_handle_flash_read(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len != 5 || req[4] == 0 || req[4] > RPC_MAX_PAYLOAD) return -RPC_STATUS_BAD_REQUEST;
+    uint32_t addr = rpc_get32(req);
+    if (addr >= FLASH_TOTAL_SIZE || req[4] > FLASH_TOTAL_SIZE - addr) return -RPC_STATUS_BAD_REQUEST;
+    return w25q128_remap_read(addr, reply, req[4]) ? req[4] : -RPC_STATUS_FAILED;
+}
+
+int16_t rpc_handle_flash_erase(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len != 4) return -RPC_STATUS_BAD_REQUEST;
+    uint32_t addr = rpc_get32(req);
+    if (!rpc_flash_writable(SECTOR_ALIGN(addr), FLASH_SECTOR_SIZE)) return -RPC_STATUS_BAD_REQUEST;
+    return w25q128_remap_erase_sector(SECTOR_ALIGN(addr)) ? 0 : -RPC_STATUS_FAILED;
+}
+
+int16_t rpc_handle_flash_write(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len < 5) return -RPC_STATUS_BAD_REQUEST;
+    uint32_t addr = rpc_get32(req);
+    uint16_t len = (uint16_t)(req_len - 4);
+    if ((addr % FLASH_PROGRAM_PAGE_SIZE) + len > FLASH_PROGRAM_PAGE_SIZE) return -RPC_STATUS_BAD_REQUEST;
+    if (!rpc_flash_writable(addr, len)) return -RPC_STATUS_BAD_REQUEST;
+    return w25q128_remap_write_page(addr, &req[4], len) ? 0 : -RPC_STATUS_FAILED;
+}
+
+int16_t rpc_handle_get_flash_power(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    w25q128_power_stats_t stats;
+    w25q128_get_power_stats(&stats);
+    reply[0] = stats.powered_down;
+    const uint32_t values[] = {
+        stats.power_downs, stats.wakeups, stats.resume_us, stats.resume_max_us, stats.down_ms,
+    };
+    for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) rpc_put32(&reply[1 + i * 4], values[i]);
+    return (int16_t)(1 + sizeof(values));
+}
+
+int16_t rpc_handle_get_partition(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len != 1) return -RPC_STATUS_BAD_REQUEST;
+    w25q128_part_info_t info;
+    if (w25q128_part_get((flash_part_id_t)req[0], &info) != FLASH_STATUS_OK) return -RPC_STATUS_BAD_REQUEST;
+    reply[0] = req[0];
+    reply[1] = info.flags;
+    rpc_put32(&reply[2], info.base);
+    rpc_put32(&reply[6], info.size);
+    return 10;
+}
+
+int16_t rpc_handle_grow_partition(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len != 5) return -RPC_STATUS_BAD_REQUEST;
+    flash_status_t st = w25q128_part_grow((flash_part_id_t)req[0], rpc_get32(&req[1]));
+    if (st == FLASH_STATUS_INVALID_PARAM || st == FLASH_STATUS_NO_MEMORY) return -RPC_STATUS_BAD_REQUEST;
+    if (st != FLASH_STATUS_OK) return -RPC_STATUS_FAILED;
+    w25q128_log_printf(W25_LOG_NOTICE, "rpc: partition %u grown to %lu KB, rebooting to migrate", req[0],
+                       (unsigned long)(rpc_get32(&req[1]) / 1024));
+    /* The data moves in w25q128_part_init(), before anything uses the region */
+    rpc_reboot_pending = true;
+    rpc_reboot_tick = HAL_GetTick();
+    return 0;
+}
+
+int16_t rpc_handle_get_wear(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    w25q128_wear_stats_t stats;
+    if (w25q128_wear_get_stats(&stats) != FLASH_STATUS_OK) return -RPC_STATUS_FAILED;
+    rpc_put32(&reply[0], stats.total_erases);
+    rpc_put32(&reply[4], stats.power_on_s);
+    rpc_put32(&reply[8], stats.hottest_addr);
+    rpc_put32(&reply[12], stats.max_count);
+    rpc_put32(&reply[16], stats.mean_count);
+    for (uint8_t i = 0; i < W25_WEAR_BUCKETS; i++) rpc_put16(&reply[20 + i * 2], stats.histogram[i]);
+    rpc_put32(&reply[36], stats.life_hours);
+    rpc_put32(&reply[40], stats.flushes);
+    rpc_put32(&reply[44], stats.dropped);
+    return 48;
+}
+#else
+int16_t rpc_handle_flash_read(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_flash_erase(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_flash_write(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_get_flash_power(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_get_partition(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_grow_partition(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_get_wear(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+#endif /* FLASH_DRIVER_ENABLED */
+
+int16_t rpc_handle_reboot(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+#if FLASH_DRIVER_ENABLED
+    if (!rpc_reboot_pending) w25q128_log_printf(W25_LOG_NOTICE, "rpc: reboot requested");
+#endif
+    rpc_reboot_pending = true;
+    rpc_reboot_tick = HAL_GetTick();
+    return 0;
+}
+
+int16_t rpc_handle_get_boot_profile(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) rpc_put32(&reply[i * 4], boot_prof_get_us((boot_phase_t)i));
+    return (int16_t)(BOOT_PHASE_COUNT * 4);
+}
+
+#if IPERF_ENABLED
+int16_t rpc_handle_iperf(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len != 12 && req_len != 16) return -RPC_STATUS_BAD_REQUEST;
+    if (req[0] >= IPERF_MODE_COUNT) return -RPC_STATUS_BAD_REQUEST;
+    bool ok = iperf_start((iperf_mode_t)req[0], (req_len == 16) ? &req[12] : NULL,
+                          (uint16_t)((req[2] << 8) | req[3]), (uint16_t)((req[4] << 8) | req[5]),
+                          (uint16_t)((req[6] << 8) | req[7]), rpc_get32(&req[8]), req[1]);
+    return ok ? 0 : -RPC_STATUS_FAILED;
+}
+
+int16_t rpc_handle_get_iperf(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    iperf_stats_t stats;
+    iperf_get_stats(&stats);
+    reply[0] = stats.mode;
+    reply[1] = stats.state;
+    reply[2] = stats.flags;
+    const uint32_t values[] = {
+        stats.bytes, stats.elapsed_ms, stats.kbps, stats.datagrams,
+        stats.lost, stats.out_of_order, stats.jitter_us, stats.runs,
+    };
+    for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) rpc_put32(&reply[3 + i * 4], values[i]);
+    return (int16_t)(3 + sizeof(values));
+}
+#else
+int16_t rpc_handle_iperf(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_get_iperf(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+#endif /* IPERF_ENABLED */
+
+#if SYNC_SAMPLE_ENABLED
+int16_t rpc_handle_sync(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len != 5 && req_len != 9) return -RPC_STATUS_BAD_REQUEST;
+    if (req[0] >= SYNC_ROLE_COUNT) return -RPC_STATUS_BAD_REQUEST;
+    bool ok = sync_sample_set_role((sync_role_t)req[0], (uint16_t)((req[1] << 8) | req[2]),
+                                   (req_len == 9) ? &req[5] : NULL, (uint16_t)((req[3] << 8) | req[4]));
+    return ok ? 0 : -RPC_STATUS_FAILED;
+}
+
+int16_t rpc_handle_sync_start(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len != 10) return -RPC_STATUS_BAD_REQUEST;
+    uint32_t run_id;
+    if (!sync_sample_start((uint16_t)((req[0] << 8) | req[1]), rpc_get32(&req[2]), rpc_get32(&req[6]), &run_id)) {
+        return -RPC_STATUS_FAILED;
+    }
+    rpc_put32(reply, run_id);
+    return 4;
+}
+
+int16_t rpc_handle_get_sync(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    sync_sample_stats_t stats;
+    sync_sample_get_stats(&stats);
+    reply[0] = stats.role;
+    reply[1] = stats.state;
+    reply[2] = stats.synced;
+    const uint32_t values[] = {
+        stats.run_id, stats.syncs, stats.outliers, (uint32_t)stats.rate_ppb, (uint32_t)stats.error_us,
+        stats.max_error_us, stats.samples, stats.blocks, stats.overruns,
+    };
+    for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) rpc_put32(&reply[3 + i * 4], values[i]);
+    return (int16_t)(3 + sizeof(values));
+}
+#else
+int16_t rpc_handle_sync(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_sync_start(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_get_sync(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+#endif /* SYNC_SAMPLE_ENABLED */
+
+#if TRACE_ENABLED
+int16_t rpc_handle_trace(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    if (req_len != 3 && req_len != 7) return -RPC_STATUS_BAD_REQUEST;
+    bool ok = trace_start(req[0], (req_len == 7) ? &req[3] : NULL, (uint16_t)((req[1] << 8) | req[2]));
+    return ok ? 0 : -RPC_STATUS_FAILED;
+}
+
+int16_t rpc_handle_get_trace(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    trace_stats_t stats;
+    trace_get_stats(&stats);
+    reply[0] = stats.out;
+    const uint32_t values[] = { stats.recorded, stats.dropped, stats.sent, stats.datagrams };
+    for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) rpc_put32(&reply[1 + i * 4], values[i]);
+    return (int16_t)(1 + sizeof(values));
+}
+#else
+int16_t rpc_handle_trace(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+
+int16_t rpc_handle_get_trace(const uint8_t *req, uint16_t req_len, uint8_t *reply) {
+    return -RPC_STATUS_UNSUPPORTED;
+}
+#endif /* TRACE_ENABLED */
+
+// ============================================================================
+// REQUEST PROCESSING
+// ============================================================================
+
+static rpc_cache_entry_t* rpc_cache_lookup(const uint8_t *ip, uint16_t port, uint32_t request_id) {
+    for (uint8_t i = 0; i < ETH_CONFIG_RPC_CACHE_SIZE; i++) {
+        rpc_cache_entry_t *e = &rpc_cache[i];
+        if (e->valid && e->request_id == request_id && e->port == port && memcmp(e->ip, ip, 4) == 0) return e;
+    }
+    return NULL;
+}
+
+static void rpc_process(uint16_t len, uint8_t *src_ip, uint16_t src_port) {
+    if (len < RPC_HEADER_SIZE || rpc_rx[0] != RPC_MAGIC || rpc_rx[1] != RPC_SCHEMA_VERSION) return;
+
+    uint8_t op = rpc_rx[2];
+    uint32_t request_id = rpc_get32(&rpc_rx[4]);
+    rpc_requests++;
+
+    /* Retry of a state-changing request: replay the original reply */
+    rpc_cache_entry_t *cached = rpc_cache_lookup(src_ip, src_port, request_id);
+    if (cached) {
+        rpc_retries++;
+        w5500_socket_sendto(ETH_CONFIG_RPC_SOCKET, cached->data, cached->len, src_ip, src_port);
+        return;
+    }
+
+    const rpc_op_entry_t *entry = (op < RPC_OP_COUNT) ? &rpc_op_table[op] : NULL;
+    uint8_t *out = rpc_tx;
+    if (entry && (entry->flags & RPC_FLAG_CACHED)) {
+        cached = &rpc_cache[rpc_cache_next];
+        rpc_cache_next = (uint8_t)((rpc_cache_next + 1) % ETH_CONFIG_RPC_CACHE_SIZE);
+        out = cached->data;
+    }
+
+    int16_t result = entry ? entry->handler(&rpc_rx[RPC_HEADER_SIZE], (uint16_t)(len - RPC_HEADER_SIZE),
+                                            &out[RPC_HEADER_SIZE])
+                           : -RPC_STATUS_UNKNOWN_OP;
+    uint16_t reply_len = RPC_HEADER_SIZE + ((result > 0) ? (uint16_t)result : 0);
+
+    memcpy(out, rpc_rx, RPC_HEADER_SIZE);
+    out[3] = (result < 0) ? (uint8_t)(-result) : RPC_STATUS_OK;
+
+    if (cached) {
+        memcpy(cached->ip, src_ip, 4);
+        cached->port = src_port;
+        cached->request_id = request_id;
+        cached->len = reply_len;
+        cached->valid = true;
+    }
+    w5500_socket_sendto(ETH_CONFIG_RPC_SOCKET, out, reply_len, src_ip, src_port);
+}
+
+bool rpc_server_init(void) {
+    memset(rpc_cache, 0, sizeof(rpc_cache));
+    bool ok = (w5500_socket_open(ETH_CONFIG_RPC_SOCKET, W5500_SOCK_UDP, RPC_PORT) == W5500_SOCK_OK);
+    printf("RPC channel on UDP port %d: %s\n", RPC_PORT, ok ? "OK" : "FAILED");
+    return ok;
+}
+
+void rpc_server_poll(void) {
+    if (w5500_socket_get_pending_irq() & (1u << ETH_CONFIG_RPC_SOCKET)) {
+        w5500_socket_take_irq(ETH_CONFIG_RPC_SOCKET);
+
+        while (w5500_socket_get_rx_buf_size(ETH_CONFIG_RPC_SOCKET) > 0) {
+            uint8_t src_ip[4];
+            uint16_t src_port;
+            int32_t len = w5500_socket_recvfrom(ETH_CONFIG_RPC_SOCKET, rpc_rx, sizeof(rpc_rx), src_ip, &src_port);
+            if (len <= 0) break;
+
+            /* Oversized datagram: drain the remainder and drop it */
+            uint16_t remain = 0;
+            w5500_socket_getsockopt(ETH_CONFIG_RPC_SOCKET, SO_REMAINSIZE, &remain);
+            if (remain) {
+                while (remain) {
+                    uint16_t chunk = (remain > sizeof(rpc_rx)) ? sizeof(rpc_rx) : remain;
+                    w5500_socket_recvfrom(ETH_CONFIG_RPC_SOCKET, rpc_rx, chunk, src_ip, &src_port);
+                    remain -= chunk;
+                }
+                continue;
+            }
+            rpc_process((uint16_t)len, src_ip, src_port);
+        }
+    }
+
+    if (rpc_netinfo_dirty) {
+        rpc_netinfo_dirty = false;
+        eth_config_set_netinfo(&g_network_info);
+    }
+    if (rpc_reboot_pending && (HAL_GetTick() - rpc_reboot_tick) >= RPC_REBOOT_DELAY_MS) {
+        NVIC_SystemReset();
+    }
+}
+
+uint32_t rpc_server_get_request_count(void) {
+    return rpc_requests;
+}
+
+uint32_t rpc_server_get_retry_count(void) {
+    return rpc_retries;
+}
@@ -21,7 +21,7 @@
 #include "spi.h"
 
 /* USER CODE BEGIN 0 */
-
+#include "boot_prof.h"
 /* USER CODE END 0 */
 
 SPI_HandleTypeDef hspi2;
@@ -55,6 +55,7 @@ void MX_SPI2_Init(void)
   }
   /* USER CODE BEGIN SPI2_Init 2 */
 
+#if !BOOT_FAST_ENABLED
   printf("========== SPI2_Setting Start ===========\n");
 
   // Enable GPIOB clock (APB2 for F1 series)
@@ -91,11 +92,12 @@ void MX_SPI2_Init(void)
 
   // Dump raw registers for reference
   printf("CR1=0x%04X, CR2=0x%04X\n", cr1, cr2);
+#endif
 
   // Enable SPI
   __HAL_SPI_ENABLE(&hspi2);
 
-  printf("========== SPI2_Setting Finish ==========\n");
+  BOOT_LOG("========== SPI2_Setting Finish ==========\n");
 
   /* USER CODE END SPI2_Init 2 */
 
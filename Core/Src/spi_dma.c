@@ -0,0 +1,77 @@
+/**
+ * @file spi_dma.c
+ * @brief Register-level SPI transfers on DMA1
+ */
+
+#include "spi_dma.h"
+#include "trace.h"
+
+typedef struct {
+    DMA_Channel_TypeDef *rx;
+    DMA_Channel_TypeDef *tx;
+    uint32_t clear;             /* IFCR bits of both channels */
+} spi_dma_channels_t;
+
+static const spi_dma_channels_t spi_dma_spi1 = {
+    DMA1_Channel2, DMA1_Channel3, DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3
+};
+static const spi_dma_channels_t spi_dma_spi2 = {
+    DMA1_Channel4, DMA1_Channel5, DMA_IFCR_CGIF4 | DMA_IFCR_CGIF5
+};
+
+/* Source for tx == NULL, sink for rx == NULL; the address does not increment */
+static uint8_t spi_dma_zero = 0x00;
+
+static inline const spi_dma_channels_t *spi_dma_lookup(SPI_TypeDef *spi) {
+    return (spi == SPI1) ? &spi_dma_spi1 : &spi_dma_spi2;
+}
+
+void spi_dma_start(SPI_TypeDef *spi, const uint8_t *tx, uint8_t *rx, uint16_t len) {
+    const spi_dma_channels_t *ch = spi_dma_lookup(spi);
+    if (len == 0) return;
+    if (!(spi->CR1 & SPI_CR1_SPE)) spi->CR1 |= SPI_CR1_SPE;
+
+    ch->rx->CCR = 0;
+    ch->tx->CCR = 0;
+    DMA1->IFCR = ch->clear;
+    (void)spi->DR;              /* Stale byte and OVR from an earlier transfer */
+    (void)spi->SR;
+
+    /* RX first (RM0008 25.3.9), and at a higher priority so it keeps up with TX */
+    if (rx != NULL) {
+        spi->CR2 |= SPI_CR2_RXDMAEN;
+        ch->rx->CPAR = (uint32_t)&spi->DR;
+        ch->rx->CMAR = (uint32_t)rx;
+        ch->rx->CNDTR = len;
+        ch->rx->CCR = DMA_CCR_PL_1 | DMA_CCR_MINC | DMA_CCR_EN;
+    }
+    ch->tx->CPAR = (uint32_t)&spi->DR;
+    ch->tx->CMAR = (uint32_t)((tx != NULL) ? tx : &spi_dma_zero);
+    ch->tx->CNDTR = len;
+    ch->tx->CCR = DMA_CCR_DIR | ((tx != NULL) ? DMA_CCR_MINC : 0) | DMA_CCR_EN;
+    spi->CR2 |= SPI_CR2_TXDMAEN;
+}
+
+void spi_dma_wait(SPI_TypeDef *spi) {
+    const spi_dma_channels_t *ch = spi_dma_lookup(spi);
+
+    TRACE_SPAN_BEGIN(TRACE_SPAN_SPI_DMA, (spi == SPI1) ? 1 : 2);
+    if (ch->rx->CCR & DMA_CCR_EN) {
+        /* The last byte received ends the transfer */
+        while (ch->rx->CNDTR) {
+        }
+    } else {
+        while (ch->tx->CNDTR) {
+        }
+        while (!(spi->SR & SPI_SR_TXE)) {
+        }
+        while (spi->SR & SPI_SR_BSY) {
+        }
+        (void)spi->DR;          /* DR then SR read clears RXNE and OVR */
+        (void)spi->SR;
+    }
+    spi->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+    ch->rx->CCR = 0;
+    ch->tx->CCR = 0;
+    TRACE_SPAN_END(TRACE_SPAN_SPI_DMA, (spi == SPI1) ? 1 : 2);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file spi_pump.c
+ * @brief Register-level SPI byte pump (runs from RAM)
+ */
+
+#include "spi_pump.h"
+#include "ramfunc.h"
+
+RAMFUNC void spi_pump_xfer(SPI_TypeDef *spi, const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    if (len == 0) return;
+    if (!(spi->CR1 & SPI_CR1_SPE)) spi->CR1 |= SPI_CR1_SPE;
+
+    if (rx == NULL) {
+        /* Transmit only: refill DR as soon as it empties */
+        for (uint32_t i = 0; i < len; i++) {
+            while (!(spi->SR & SPI_SR_TXE)) {
+            }
+            spi->DR = (tx != NULL) ? tx[i] : 0x00;
+        }
+        while (!(spi->SR & SPI_SR_TXE)) {
+        }
+        while (spi->SR & SPI_SR_BSY) {
+        }
+        (void)spi->DR;          /* DR then SR read clears RXNE and OVR */
+        (void)spi->SR;
+        return;
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+        while (!(spi->SR & SPI_SR_TXE)) {
+        }
+        spi->DR = (tx != NULL) ? tx[i] : 0x00;
+        while (!(spi->SR & SPI_SR_RXNE)) {
+        }
+        rx[i] = (uint8_t)spi->DR;
+    }
+    while (spi->SR & SPI_SR_BSY) {
+    }
+}
@@ -0,0 +1,628 @@
+/**
+ * @file sync_sample.c
+ * @brief Multicast-triggered synchronised ADC sampling implementation
+ */
+
+#include "sync_sample.h"
+#include "capture.h"
+#include "gorilla.h"
+#include "w5500_socket.h"
+#include "w5500_regs.h"
+#include "w5500_spi.h"
+#include "eth_config.h"
+#include "adc.h"
+#include "tim.h"
+#include "main.h"
+#include <string.h>
+#include <stdio.h>
+
+#if SYNC_SAMPLE_ENABLED
+
+#define SYNC_UDP_INFO_SIZE      8       /* W5500 RX header: source IP, port, length */
+#define SYNC_SYNC_SIZE          12
+#define SYNC_START_SIZE         24
+#define SYNC_STOP_SIZE          8
+#define SYNC_DATA_HDR_SIZE      28
+#define SYNC_CHANNELS           2       /* ADC1 IN4 and ADC2 IN8, one 32-bit word */
+
+typedef struct {
+    uint32_t run_id;
+    uint64_t start_us;          /* Network time of sample 0 */
+    uint32_t period_us;
+    uint32_t count;             /* 0: until stopped */
+} sync_run_t;
+
+extern DMA_HandleTypeDef hdma_adc1;
+
+static volatile uint32_t sync_ring[SYNC_SAMPLE_RING];
+
+static sync_role_t sync_role = SYNC_ROLE_OFF;
+static sync_state_t sync_state = SYNC_STATE_IDLE;
+static sync_run_t sync_run;
+static sync_sample_stats_t sync_stats;
+static uint8_t sync_collector_ip[4] = ETH_CONFIG_SYNC_COLLECTOR_IP;
+static uint16_t sync_collector_port = ETH_CONFIG_SYNC_COLLECTOR_PORT;
+static uint16_t sync_period_ms = SYNC_SAMPLE_DEFAULT_SYNC_MS;
+
+/* INTn latch: TIM2 count at the first falling edge since the poll cleared it */
+static volatile uint16_t sync_irq_cnt = 0;
+static volatile bool sync_irq_seen = false;
+
+/* Master */
+static uint16_t sync_seq = 0;
+static uint64_t sync_prev_tx_us = 0;        /* Network time the last SYNC left, 0 if unknown */
+static uint32_t sync_last_sync_ms = 0;
+static uint8_t sync_cmd_repeats = 0;        /* START/STOP copies still to send */
+static uint8_t sync_cmd_type = 0;
+static uint32_t sync_cmd_ms = 0;
+
+/* Node */
+static bool sync_rx_armed = false;          /* RX buffer was empty when RECV was cleared */
+static bool sync_last_stamped = false;
+static uint16_t sync_last_seq = 0;
+static uint64_t sync_last_rx_us = 0;        /* Local receive time of SYNC sync_last_seq */
+static uint8_t sync_outlier_run = 0;
+
+/* Sampling */
+static uint32_t sync_first_index = 0;       /* Grid index of the first TIM4 edge */
+static uint32_t sync_consumed = 0;          /* Samples taken from the ring (or lost) since then */
+static uint16_t sync_rd = 0;
+static uint32_t sync_last_send_ms = 0;
+static bool sync_overrun_flag = false;
+
+static uint8_t sync_msg[SYNC_START_SIZE];
+static uint8_t sync_data_hdr[SYNC_DATA_HDR_SIZE];
+#if SYNC_SAMPLE_PACKED
+static gorilla_stream_t sync_pack;
+static uint8_t sync_packed[SYNC_SAMPLE_BLOCK * 4];   /* Never larger than the raw block */
+#endif
+
+static const char *const sync_role_names[SYNC_ROLE_COUNT] = { "off", "node", "master" };
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static inline void sync_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v;
+}
+
+static inline void sync_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+static inline void sync_put64(uint8_t *p, uint64_t v) {
+    sync_put32(p, (uint32_t)(v >> 32));
+    sync_put32(p + 4, (uint32_t)v);
+}
+
+static inline uint16_t sync_get16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t sync_get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t sync_get64(const uint8_t *p) {
+    return ((uint64_t)sync_get32(p) << 32) | sync_get32(p + 4);
+}
+
+static bool sync_send(uint8_t sock, const uint8_t *data, uint16_t len) {
+    if (w5500_socket_get_tx_buf_free_size(sock) < len) return false;
+    uint16_t start = w5500_socket_tx_begin(sock);
+    uint16_t end = w5500_socket_tx_write(sock, start, data, len);
+    return w5500_socket_tx_commit(sock, start, end) == len;
+}
+
+void sync_sample_irq(void) {
+    uint16_t cnt = (uint16_t)TIM2->CNT;
+    if (!sync_irq_seen) {
+        sync_irq_cnt = cnt;
+        sync_irq_seen = true;
+    }
+}
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+    if (GPIO_Pin == W5500_INT_Pin) sync_sample_irq();
+}
+
+// ============================================================================
+// TIM4 TRIGGER
+// ============================================================================
+
+static void sync_timer_stop(void) {
+    TIM4->CR1 &= ~TIM_CR1_CEN;
+    TIM4->CCMR2 = (TIM4->CCMR2 & ~TIM_CCMR2_OC4M) | TIM_CCMR2_OC4M_2;      /* Forced inactive */
+}
+
+/**
+ * @brief Restart the DMA ring and start TIM4 so its first CC4 edge falls on
+ *        first_local, then one edge per period
+ * @details PWM mode 2 raises OC4REF when CNT reaches CCR4. The first cycle
+ *          runs with ARR = CCR4 = delta; the period values wait in the
+ *          preload registers and take over at the first update.
+ */
+static bool sync_timer_arm(uint64_t first_local) {
+    uint32_t top = sync_run.period_us - 1;
+
+    HAL_DMA_Abort(&hdma_adc1);
+    if (HAL_DMA_Start(&hdma_adc1, (uint32_t)&ADC1->DR, (uint32_t)(uintptr_t)sync_ring,
+                      SYNC_SAMPLE_RING) != HAL_OK) {
+        return false;
+    }
+    sync_rd = 0;
+
+    sync_timer_stop();
+    TIM4->CR1 &= ~TIM_CR1_ARPE;
+    TIM4->CCMR2 &= ~TIM_CCMR2_OC4PE;
+    TIM4->EGR = TIM_EGR_UG;                 /* Reset the prescaler phase */
+    TIM4->CCER |= TIM_CCER_CC4E;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    int64_t delta = (int64_t)(first_local - capture_read_us());
+    bool ok = (delta >= 2 && delta <= 0xFFFF);
+    if (ok) {
+        TIM4->CNT = 0;
+        TIM4->ARR = (uint32_t)delta;
+        TIM4->CCR4 = (uint32_t)delta;
+        TIM4->CCMR2 |= TIM_CCMR2_OC4M | TIM_CCMR2_OC4PE;                    /* PWM mode 2 */
+        TIM4->CR1 |= TIM_CR1_ARPE;
+        TIM4->ARR = top;
+        TIM4->CCR4 = top;
+        TIM4->CR1 |= TIM_CR1_CEN;
+    }
+    __set_PRIMASK(primask);
+    return ok;
+}
+
+/**
+ * @brief Move the next TIM4 edge towards its grid time
+ * @note  Runs only after the first edge, when ARR = CCR4 = period - 1. The
+ *        counter is never moved across the edge, so no sample is skipped or
+ *        doubled.
+ */
+static void sync_timer_trim(void) {
+    uint32_t top = sync_run.period_us - 1;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t cnt = TIM4->CNT;
+    uint64_t now = capture_read_us();
+    __set_PRIMASK(primask);
+    if (cnt > top) return;
+
+    uint64_t edge_local = now + (top - cnt);
+    uint64_t edge_net = capture_to_network_us(edge_local);
+    if (edge_net < sync_run.start_us) return;
+    uint64_t index = (edge_net - sync_run.start_us + sync_run.period_us / 2) / sync_run.period_us;
+    int64_t err = (int64_t)(edge_local - capture_from_network_us(sync_run.start_us + index * sync_run.period_us));
+    if (err > SYNC_SAMPLE_SLEW_MAX_US) err = SYNC_SAMPLE_SLEW_MAX_US;
+    if (err < -SYNC_SAMPLE_SLEW_MAX_US) err = -SYNC_SAMPLE_SLEW_MAX_US;
+    if (err == 0) return;
+
+    /* Edge late (err > 0): advance the counter so it reaches top sooner */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    int32_t next = (int32_t)TIM4->CNT + (int32_t)err;
+    if (next >= 1 && next + 2 <= (int32_t)top) TIM4->CNT = (uint32_t)next;
+    __set_PRIMASK(primask);
+}
+
+// ============================================================================
+// RUNS
+// ============================================================================
+
+static void sync_run_begin(uint32_t run_id, uint64_t start_us, uint32_t period_us, uint32_t count) {
+    sync_timer_stop();
+    sync_run.run_id = run_id;
+    sync_run.start_us = start_us;
+    sync_run.period_us = period_us;
+    sync_run.count = count;
+    sync_state = SYNC_STATE_PENDING;
+    sync_stats.run_id = run_id;
+    sync_stats.samples = 0;
+    sync_stats.blocks = 0;
+    sync_stats.overruns = 0;
+}
+
+static void sync_run_end(sync_state_t state) {
+    sync_timer_stop();
+    sync_state = state;
+    printf("Sync: run %lu %s, %lu samples, %lu overruns\n", (unsigned long)sync_run.run_id,
+           (state == SYNC_STATE_MISSED) ? "missed" : "done",
+           (unsigned long)sync_stats.samples, (unsigned long)sync_stats.overruns);
+}
+
+/* Arm TIM4 once the first edge we can still make is within reach */
+static void sync_run_try_arm(void) {
+    if (sync_role == SYNC_ROLE_NODE && !capture_time_synced()) return;
+
+    uint64_t now_net = capture_to_network_us(capture_read_us());
+    uint64_t earliest = now_net + SYNC_SAMPLE_ARM_MARGIN_US;
+    uint32_t index = 0;
+    if (earliest > sync_run.start_us) {
+        index = (uint32_t)((earliest - sync_run.start_us + sync_run.period_us - 1) / sync_run.period_us);
+    }
+    if (sync_run.count && index >= sync_run.count) {
+        sync_run_end(SYNC_STATE_MISSED);
+        return;
+    }
+
+    uint64_t first_net = sync_run.start_us + (uint64_t)index * sync_run.period_us;
+    if (first_net - now_net > SYNC_SAMPLE_ARM_WINDOW_US) return;
+    if (!sync_timer_arm(capture_from_network_us(first_net))) return;
+
+    sync_first_index = index;
+    sync_consumed = 0;
+    sync_overrun_flag = false;
+    sync_last_send_ms = HAL_GetTick();
+    sync_state = SYNC_STATE_SAMPLING;
+    printf("Sync: run %lu armed at index %lu, %lu us period\n", (unsigned long)sync_run.run_id,
+           (unsigned long)index, (unsigned long)sync_run.period_us);
+}
+
+#if SYNC_SAMPLE_PACKED
+/* Encode up to n ring samples into sync_packed; returns how many fit */
+static uint16_t sync_pack_block(uint16_t n) {
+    gorilla_begin(&sync_pack, sync_packed, sizeof(sync_packed), SYNC_CHANNELS, 0);
+    for (uint16_t i = 0; i < n; i++) {
+        uint32_t w = sync_ring[(sync_rd + i) % SYNC_SAMPLE_RING];
+        uint32_t values[SYNC_CHANNELS] = { w & 0xFFF, (w >> 16) & 0xFFF };
+        if (!gorilla_put(&sync_pack, i, values)) break;
+    }
+    return sync_pack.count;
+}
+#endif
+
+static void sync_data_header(uint16_t n, uint8_t flags) {
+    uint32_t index = sync_first_index + sync_consumed;
+    uint32_t err = (uint32_t)((sync_stats.error_us < 0) ? -sync_stats.error_us : sync_stats.error_us);
+    uint8_t *h = sync_data_hdr;
+    h[0] = SYNC_SAMPLE_MAGIC;
+    h[1] = SYNC_MSG_DATA;
+    h[2] = flags;
+    h[3] = SYNC_CHANNELS;
+    sync_put16(&h[4], n);
+    sync_put16(&h[6], (uint16_t)((err > 0xFFFF) ? 0xFFFF : err));
+    sync_put32(&h[8], sync_run.run_id);
+    sync_put32(&h[12], index);
+    sync_put32(&h[16], sync_run.period_us);
+    sync_put64(&h[20], sync_run.start_us + (uint64_t)index * sync_run.period_us);
+}
+
+/* One DATA datagram of up to n samples; returns how many went, 0 if none.
+ * Packed blocks may hold fewer than n when the signal is noisy. */
+static uint16_t sync_send_block(uint16_t n, uint8_t flags) {
+    uint8_t sock = ETH_CONFIG_SYNC_DATA_SOCKET;
+
+#if SYNC_SAMPLE_PACKED
+    uint16_t packed = sync_pack_block(n);
+    if (packed < n) flags &= (uint8_t)~SYNC_SAMPLE_DATA_LAST;
+    n = packed;
+    uint16_t len = (uint16_t)(SYNC_DATA_HDR_SIZE + gorilla_size(&sync_pack));
+    if (w5500_socket_get_tx_buf_free_size(sock) < len) return 0;
+
+    sync_data_header(n, (uint8_t)(flags | SYNC_SAMPLE_DATA_PACKED));
+    uint16_t start = w5500_socket_tx_begin(sock);
+    uint16_t ptr = w5500_socket_tx_write(sock, start, sync_data_hdr, SYNC_DATA_HDR_SIZE);
+    ptr = w5500_socket_tx_write(sock, ptr, sync_packed, gorilla_size(&sync_pack));
+#else
+    /* Header, then n ring words straight from the DMA buffer */
+    uint16_t len = (uint16_t)(SYNC_DATA_HDR_SIZE + n * 4);
+    if (w5500_socket_get_tx_buf_free_size(sock) < len) return 0;
+
+    sync_data_header(n, flags);
+    uint16_t first = (uint16_t)(SYNC_SAMPLE_RING - sync_rd);
+    if (first > n) first = n;
+    uint16_t start = w5500_socket_tx_begin(sock);
+    uint16_t ptr = w5500_socket_tx_write(sock, start, sync_data_hdr, SYNC_DATA_HDR_SIZE);
+    ptr = w5500_socket_tx_write(sock, ptr, (const uint8_t *)(uintptr_t)&sync_ring[sync_rd], (uint16_t)(first * 4));
+    if (n > first) ptr = w5500_socket_tx_write(sock, ptr, (const uint8_t *)(uintptr_t)sync_ring, (uint16_t)((n - first) * 4));
+#endif
+    return (w5500_socket_tx_commit(sock, start, ptr) == len) ? n : 0;
+}
+
+static void sync_run_service(uint32_t now_ms) {
+    uint16_t wr = (uint16_t)((SYNC_SAMPLE_RING - __HAL_DMA_GET_COUNTER(&hdma_adc1)) % SYNC_SAMPLE_RING);
+    uint16_t avail = (uint16_t)((wr + SYNC_SAMPLE_RING - sync_rd) % SYNC_SAMPLE_RING);
+
+    if (sync_consumed || avail) sync_timer_trim();
+
+    /* The ring position alone cannot show a whole lap; the grid can */
+    uint64_t now_net = capture_to_network_us(capture_read_us());
+    uint64_t first_net = sync_run.start_us + (uint64_t)sync_first_index * sync_run.period_us;
+    if (now_net > first_net) {
+        uint64_t due = (now_net - first_net) / sync_run.period_us + 1;
+        uint64_t taken = (uint64_t)sync_consumed + avail;
+        if (due > taken + SYNC_SAMPLE_RING / 2) {
+            sync_consumed += (uint32_t)(((due - taken + SYNC_SAMPLE_RING / 2) / SYNC_SAMPLE_RING) * SYNC_SAMPLE_RING);
+            sync_overrun_flag = true;
+            sync_stats.overruns++;
+        }
+    }
+
+    bool flush = (now_ms - sync_last_send_ms) >= SYNC_SAMPLE_FLUSH_MS;
+    while (true) {
+        bool last = false;
+        uint32_t n = (avail > SYNC_SAMPLE_BLOCK) ? SYNC_SAMPLE_BLOCK : avail;
+        if (sync_run.count) {
+            if (sync_consumed >= sync_run.count) {
+                sync_run_end(SYNC_STATE_DONE);
+                return;
+            }
+            if (sync_consumed + n >= sync_run.count) {
+                n = sync_run.count - sync_consumed;
+                last = true;
+            }
+        }
+        if (n == 0 || !(n == SYNC_SAMPLE_BLOCK || flush || last)) break;
+
+        uint8_t flags = (uint8_t)((sync_overrun_flag ? SYNC_SAMPLE_DATA_OVERRUN : 0) |
+                                  (last ? SYNC_SAMPLE_DATA_LAST : 0));
+        uint16_t sent = sync_send_block((uint16_t)n, flags);
+        if (sent == 0) break;
+        if (sent < n) last = false;
+        n = sent;
+        sync_rd = (uint16_t)((sync_rd + n) % SYNC_SAMPLE_RING);
+        avail = (uint16_t)(avail - n);
+        sync_consumed += n;
+        sync_overrun_flag = false;
+        sync_last_send_ms = now_ms;
+        sync_stats.samples += n;
+        sync_stats.blocks++;
+        if (last) {
+            sync_run_end(SYNC_STATE_DONE);
+            return;
+        }
+    }
+}
+
+// ============================================================================
+// MASTER
+// ============================================================================
+
+/* The INTn edge on SENDOK dates this SYNC; the time goes out with the next one */
+static void sync_master_send_sync(void) {
+    sync_msg[0] = SYNC_SAMPLE_MAGIC;
+    sync_msg[1] = SYNC_MSG_SYNC;
+    sync_put16(&sync_msg[2], sync_seq);
+    sync_put64(&sync_msg[4], sync_prev_tx_us);
+
+    sync_irq_seen = false;
+    bool ok = sync_send(ETH_CONFIG_SYNC_SOCKET, sync_msg, SYNC_SYNC_SIZE);
+    sync_prev_tx_us = (ok && sync_irq_seen) ? capture_to_network_us(capture_extend_raw_us(sync_irq_cnt)) : 0;
+    sync_seq++;
+    if (ok) sync_stats.syncs++;
+}
+
+static void sync_master_send_cmd(void) {
+    sync_msg[0] = SYNC_SAMPLE_MAGIC;
+    sync_msg[1] = sync_cmd_type;
+    sync_put16(&sync_msg[2], sync_seq);
+    sync_put32(&sync_msg[4], sync_run.run_id);
+    uint16_t len = SYNC_STOP_SIZE;
+    if (sync_cmd_type == SYNC_MSG_START) {
+        sync_put64(&sync_msg[8], sync_run.start_us);
+        sync_put32(&sync_msg[16], sync_run.period_us);
+        sync_put32(&sync_msg[20], sync_run.count);
+        len = SYNC_START_SIZE;
+    }
+    sync_send(ETH_CONFIG_SYNC_SOCKET, sync_msg, len);
+}
+
+static void sync_master_poll(uint32_t now_ms) {
+    if (now_ms - sync_last_sync_ms >= sync_period_ms) {
+        sync_last_sync_ms = now_ms;
+        sync_master_send_sync();
+    }
+    if (sync_cmd_repeats && now_ms - sync_cmd_ms >= SYNC_SAMPLE_START_GAP_MS) {
+        sync_cmd_ms = now_ms;
+        sync_cmd_repeats--;
+        sync_master_send_cmd();
+    }
+}
+
+// ============================================================================
+// NODE
+// ============================================================================
+
+/* (master send time + path delay, local receive time) into the clock model */
+static void sync_node_apply(uint64_t master_us, uint64_t rx_local) {
+    if (capture_time_synced()) {
+        int64_t err = (int64_t)(capture_to_network_us(rx_local) - master_us);
+        uint32_t mag = (uint32_t)((err < 0) ? -err : err);
+        if (mag > SYNC_SAMPLE_OUTLIER_US && ++sync_outlier_run < SYNC_SAMPLE_OUTLIER_LIMIT) {
+            sync_stats.outliers++;
+            return;
+        }
+        sync_stats.error_us = (err > INT32_MAX) ? INT32_MAX : (err < INT32_MIN) ? INT32_MIN : (int32_t)err;
+        if (mag > sync_stats.max_error_us) sync_stats.max_error_us = mag;
+    }
+    sync_outlier_run = 0;
+    capture_time_sync(master_us, rx_local);
+    sync_stats.syncs++;
+}
+
+static void sync_node_handle(const uint8_t *m, uint16_t len, bool stamped, uint64_t rx_local) {
+    if (len < 4 || m[0] != SYNC_SAMPLE_MAGIC) return;
+    uint16_t seq = sync_get16(&m[2]);
+
+    switch (m[1]) {
+    case SYNC_MSG_SYNC: {
+        if (len < SYNC_SYNC_SIZE) return;
+        uint64_t prev_tx = sync_get64(&m[4]);
+        if (prev_tx && sync_last_stamped && seq == (uint16_t)(sync_last_seq + 1)) {
+            sync_node_apply(prev_tx + SYNC_SAMPLE_PATH_DELAY_US, sync_last_rx_us);
+        }
+        sync_last_seq = seq;
+        sync_last_stamped = stamped;
+        sync_last_rx_us = rx_local;
+        break;
+    }
+    case SYNC_MSG_START: {
+        if (len < SYNC_START_SIZE) return;
+        uint32_t run_id = sync_get32(&m[4]);
+        uint32_t period_us = sync_get32(&m[16]);
+        if (run_id == sync_run.run_id && sync_state != SYNC_STATE_IDLE) return;     /* Repeat */
+        if (period_us < SYNC_SAMPLE_MIN_PERIOD_US || period_us > SYNC_SAMPLE_MAX_PERIOD_US) return;
+        sync_run_begin(run_id, sync_get64(&m[8]), period_us, sync_get32(&m[20]));
+        break;
+    }
+    case SYNC_MSG_STOP:
+        if (len < SYNC_STOP_SIZE) return;
+        if (sync_get32(&m[4]) == sync_run.run_id &&
+            (sync_state == SYNC_STATE_PENDING || sync_state == SYNC_STATE_SAMPLING)) {
+            sync_run_end(SYNC_STATE_DONE);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Drain the group socket
+ * @details The INTn latch dates the first datagram to arrive after RECV was
+ *          cleared with the buffer empty; any later datagram is handled
+ *          without a timestamp.
+ */
+static void sync_node_receive(void) {
+    uint8_t sock = ETH_CONFIG_SYNC_SOCKET;
+    uint16_t rsr = w5500_socket_get_rx_buf_size(sock);
+    if (rsr == 0) return;
+
+    bool stamped = sync_rx_armed && sync_irq_seen;
+    uint64_t rx_local = stamped ? capture_extend_raw_us(sync_irq_cnt) : 0;
+
+    uint16_t ptr = w5500_socket_rx_begin(sock);
+    while (rsr >= SYNC_UDP_INFO_SIZE) {
+        uint8_t info[SYNC_UDP_INFO_SIZE];
+        w5500_socket_rx_read(sock, ptr, info, SYNC_UDP_INFO_SIZE);
+        uint16_t len = (uint16_t)((info[6] << 8) | info[7]);
+        if ((uint32_t)len + SYNC_UDP_INFO_SIZE > rsr) {
+            ptr = (uint16_t)(ptr + rsr);        /* Malformed: drop the rest */
+            break;
+        }
+        uint16_t n = (len > sizeof(sync_msg)) ? sizeof(sync_msg) : len;
+        w5500_socket_rx_read(sock, (uint16_t)(ptr + SYNC_UDP_INFO_SIZE), sync_msg, n);
+        sync_node_handle(sync_msg, n, stamped, rx_local);
+        stamped = false;
+        ptr = (uint16_t)(ptr + SYNC_UDP_INFO_SIZE + len);
+        rsr = (uint16_t)(rsr - SYNC_UDP_INFO_SIZE - len);
+    }
+    w5500_socket_rx_commit(sock, ptr);
+
+    /* Re-arm: the next edge dates the next datagram only if none is queued */
+    sync_irq_seen = false;
+    w5500_reg_set_sn_ir(sock, Sn_IR_RECV);
+    sync_rx_armed = (w5500_socket_get_rx_buf_size(sock) == 0);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+static bool sync_open(void) {
+    const uint8_t group[4] = ETH_CONFIG_SYNC_GROUP;
+    uint8_t sock = ETH_CONFIG_SYNC_SOCKET;
+    uint16_t port = sync_collector_port;
+
+    if (w5500_socket_open_multicast(sock, group, ETH_CONFIG_SYNC_PORT) != W5500_SOCK_OK) return false;
+    w5500_socket_set_irq_mask(sock, (sync_role == SYNC_ROLE_MASTER) ? Sn_IR_SENDOK : Sn_IR_RECV);
+    sync_irq_seen = false;
+    sync_rx_armed = true;
+
+    if (w5500_socket_open(ETH_CONFIG_SYNC_DATA_SOCKET, W5500_SOCK_UDP, 0) != W5500_SOCK_OK) return false;
+    w5500_socket_setsockopt(ETH_CONFIG_SYNC_DATA_SOCKET, SO_DESTIP, sync_collector_ip);
+    w5500_socket_setsockopt(ETH_CONFIG_SYNC_DATA_SOCKET, SO_DESTPORT, &port);
+    return true;
+}
+
+static void sync_close(void) {
+    w5500_socket_set_irq_mask(ETH_CONFIG_SYNC_SOCKET, 0);
+    w5500_socket_close(ETH_CONFIG_SYNC_SOCKET);
+    w5500_socket_close(ETH_CONFIG_SYNC_DATA_SOCKET);
+}
+
+bool sync_sample_init(void) {
+    /* ADC2 follows ADC1 (regular simultaneous); both then wait for TIM4 CC4 */
+    HAL_ADCEx_Calibration_Start(&hadc1);
+    HAL_ADCEx_Calibration_Start(&hadc2);
+    HAL_ADC_Start(&hadc2);
+    SET_BIT(hadc1.Instance->CR2, ADC_CR2_DMA);
+    HAL_ADC_Start(&hadc1);
+
+    return sync_sample_set_role(SYNC_ROLE_NODE, 0, NULL, 0);
+}
+
+bool sync_sample_set_role(sync_role_t role, uint16_t sync_ms, const uint8_t *collector_ip,
+                          uint16_t collector_port) {
+    if (role >= SYNC_ROLE_COUNT) return false;
+    if (collector_ip) memcpy(sync_collector_ip, collector_ip, 4);
+    if (collector_port) sync_collector_port = collector_port;
+    sync_period_ms = sync_ms ? sync_ms : SYNC_SAMPLE_DEFAULT_SYNC_MS;
+
+    sync_timer_stop();
+    sync_close();
+    sync_role = role;
+    sync_state = SYNC_STATE_IDLE;
+    memset(&sync_stats, 0, sizeof(sync_stats));
+    sync_last_stamped = false;
+    sync_outlier_run = 0;
+    sync_prev_tx_us = 0;
+    sync_cmd_repeats = 0;
+    sync_last_sync_ms = HAL_GetTick() - sync_period_ms;
+
+    bool ok = (role == SYNC_ROLE_OFF) || sync_open();
+    printf("Sync: %s%s\n", sync_role_names[role], ok ? "" : " (socket error)");
+    return ok;
+}
+
+bool sync_sample_start(uint16_t delay_ms, uint32_t period_us, uint32_t count, uint32_t *run_id) {
+    if (sync_role != SYNC_ROLE_MASTER) return false;
+
+    uint32_t now_ms = HAL_GetTick();
+    if (period_us == 0) {
+        if (sync_state == SYNC_STATE_PENDING || sync_state == SYNC_STATE_SAMPLING) sync_run_end(SYNC_STATE_DONE);
+        sync_cmd_type = SYNC_MSG_STOP;
+    } else {
+        if (period_us < SYNC_SAMPLE_MIN_PERIOD_US || period_us > SYNC_SAMPLE_MAX_PERIOD_US) return false;
+        uint64_t start_us = capture_to_network_us(capture_read_us()) +
+                            (uint64_t)(delay_ms ? delay_ms : SYNC_SAMPLE_DEFAULT_DELAY_MS) * 1000U;
+        sync_run_begin(sync_run.run_id + 1, start_us, period_us, count);
+        sync_cmd_type = SYNC_MSG_START;
+    }
+    sync_cmd_repeats = SYNC_SAMPLE_START_REPEATS;
+    sync_cmd_ms = now_ms - SYNC_SAMPLE_START_GAP_MS;
+    if (run_id) *run_id = sync_run.run_id;
+    return true;
+}
+
+void sync_sample_poll(void) {
+    if (sync_role == SYNC_ROLE_OFF) return;
+    uint32_t now_ms = HAL_GetTick();
+
+    if (sync_role == SYNC_ROLE_MASTER) {
+        sync_master_poll(now_ms);
+    } else {
+        sync_node_receive();
+    }
+
+    if (sync_state == SYNC_STATE_PENDING) {
+        sync_run_try_arm();
+    } else if (sync_state == SYNC_STATE_SAMPLING) {
+        sync_run_service(now_ms);
+    }
+}
+
+void sync_sample_get_stats(sync_sample_stats_t *stats) {
+    *stats = sync_stats;
+    stats->role = (uint8_t)sync_role;
+    stats->state = (uint8_t)sync_state;
+    stats->synced = (sync_role == SYNC_ROLE_MASTER) || capture_time_synced();
+    stats->rate_ppb = (sync_role == SYNC_ROLE_MASTER) ? 0 : capture_get_rate_ppb();
+}
+
+#endif /* SYNC_SAMPLE_ENABLED */
@@ -0,0 +1,252 @@
+/**
+ * @file trace.c
+ * @brief Event trace ring and its UDP and ITM outputs
+ */
+
+#include "trace.h"
+#include "ramfunc.h"
+#include "dwt_cycles.h"
+#include "w5500_socket.h"
+#include "eth_config.h"
+#include "main.h"
+#include <string.h>
+#include <stdio.h>
+
+#if TRACE_ENABLED
+
+#define TRACE_RING_MASK         (TRACE_RING_EVENTS - 1)
+#define TRACE_DGRAM_SIZE        (TRACE_HEADER_SIZE + TRACE_UDP_EVENTS * TRACE_EVENT_SIZE)
+#define TRACE_NAME_ENTRY        TRACE_NAME_LEN  /* id u8 + name[15] */
+
+typedef struct {
+    uint32_t cycles;
+    uint8_t  type;
+    uint8_t  id;
+    uint16_t arg;
+} trace_entry_t;
+
+/* Written with interrupts masked; trace_poll() only moves the tail */
+static trace_entry_t trace_ring[TRACE_RING_EVENTS];
+static volatile uint16_t trace_head = 0;
+static volatile uint16_t trace_tail = 0;
+static uint32_t trace_lost = 0;         /* Dropped since the last TRACE_EV_DROPPED */
+static volatile uint8_t trace_out = 0;
+static trace_stats_t trace_stats;
+
+static char trace_names[TRACE_MAX_TASKS][TRACE_NAME_LEN];
+
+static uint8_t trace_ip[4];
+static uint16_t trace_port = TRACE_UDP_PORT;
+static uint32_t trace_seq = 0;
+static uint32_t trace_flush_ms = 0;     /* Last events sent */
+static uint32_t trace_names_ms = 0;
+static bool trace_names_due = false;
+
+static uint8_t trace_dgram[TRACE_DGRAM_SIZE];
+
+_Static_assert((TRACE_RING_EVENTS & TRACE_RING_MASK) == 0, "TRACE_RING_EVENTS must be a power of two");
+_Static_assert(TRACE_HEADER_SIZE + (TRACE_MAX_TASKS - 1) * TRACE_NAME_ENTRY <= TRACE_DGRAM_SIZE,
+               "task names do not fit one datagram");
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+static inline void trace_put(uint32_t cycles, uint8_t type, uint8_t id, uint16_t arg) {
+    trace_entry_t *e = &trace_ring[trace_head & TRACE_RING_MASK];
+    e->cycles = cycles;
+    e->type = type;
+    e->id = id;
+    e->arg = arg;
+    trace_head = (uint16_t)(trace_head + 1);
+}
+
+/* Called from the context switch, which runs from SRAM */
+RAMFUNC void trace_record(uint8_t type, uint8_t id, uint16_t arg) {
+    if (!trace_out) return;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t now = dwt_cycles_now();
+    uint16_t used = (uint16_t)(trace_head - trace_tail);
+    uint16_t need = trace_lost ? 2 : 1;
+    if (used + need > TRACE_RING_EVENTS) {
+        trace_lost++;
+        trace_stats.dropped++;
+    } else {
+        if (trace_lost) {
+            trace_put(now, TRACE_EV_DROPPED, 0, (trace_lost > 0xFFFF) ? 0xFFFF : (uint16_t)trace_lost);
+            trace_lost = 0;
+        }
+        trace_put(now, type, id, arg);
+        trace_stats.recorded++;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+void trace_task_create(uint8_t id, const char *name) {
+    if (id >= TRACE_MAX_TASKS || name == NULL) return;
+    strncpy(trace_names[id], name, TRACE_NAME_LEN - 1);
+    trace_names[id][TRACE_NAME_LEN - 1] = '\0';
+    trace_names_due = true;
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+static inline void trace_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+static bool trace_itm_ready(uint8_t port) {
+    return (ITM->TCR & ITM_TCR_ITMENA_Msk) && (ITM->TER & (1UL << port));
+}
+
+static void trace_itm_word(uint32_t word) {
+    while (ITM->PORT[TRACE_ITM_PORT].u32 == 0) {
+    }
+    ITM->PORT[TRACE_ITM_PORT].u32 = word;
+}
+
+static void trace_itm_text(const char *s) {
+    while (*s) {
+        while (ITM->PORT[TRACE_ITM_NAME_PORT].u32 == 0) {
+        }
+        ITM->PORT[TRACE_ITM_NAME_PORT].u8 = (uint8_t)*s++;
+    }
+}
+
+static void trace_header(uint8_t count, uint8_t flags) {
+    trace_dgram[0] = TRACE_MAGIC;
+    trace_dgram[1] = TRACE_VERSION;
+    trace_dgram[2] = count;
+    trace_dgram[3] = flags;
+    trace_put32(&trace_dgram[4], trace_seq++);
+    trace_put32(&trace_dgram[8], SystemCoreClock);
+    trace_put32(&trace_dgram[12], trace_stats.dropped);
+}
+
+/* A collector that has gone away would stall Task00 in ARP on every send */
+static void trace_udp_send(uint16_t len) {
+    if (w5500_socket_sendto(ETH_CONFIG_RPC_SOCKET, trace_dgram, len, trace_ip, trace_port) < 0) {
+        trace_out &= (uint8_t)~TRACE_OUT_UDP;
+        return;
+    }
+    trace_stats.datagrams++;
+}
+
+static void trace_send_names(void) {
+    uint8_t count = 0;
+    for (uint8_t id = 1; id < TRACE_MAX_TASKS; id++) {
+        if (trace_names[id][0] == '\0') continue;
+        uint8_t *entry = &trace_dgram[TRACE_HEADER_SIZE + count * TRACE_NAME_ENTRY];
+        entry[0] = id;
+        memcpy(&entry[1], trace_names[id], TRACE_NAME_ENTRY - 1);
+        count++;
+    }
+    if (trace_out & TRACE_OUT_UDP) {
+        trace_header(count, TRACE_FLAG_NAMES);
+        trace_udp_send((uint16_t)(TRACE_HEADER_SIZE + count * TRACE_NAME_ENTRY));
+    }
+    if ((trace_out & TRACE_OUT_ITM) && trace_itm_ready(TRACE_ITM_NAME_PORT)) {
+        char line[TRACE_NAME_LEN + 8];
+        snprintf(line, sizeof(line), "C%lu\n", (unsigned long)SystemCoreClock);
+        trace_itm_text(line);
+        for (uint8_t id = 1; id < TRACE_MAX_TASKS; id++) {
+            if (trace_names[id][0] == '\0') continue;
+            snprintf(line, sizeof(line), "T%u %s\n", id, trace_names[id]);
+            trace_itm_text(line);
+        }
+    }
+}
+
+/* Copy up to TRACE_UDP_EVENTS from the ring into the datagram and send them */
+static uint16_t trace_send_events(uint16_t avail) {
+    uint16_t n = (avail < TRACE_UDP_EVENTS) ? avail : TRACE_UDP_EVENTS;
+    uint16_t tail = trace_tail;
+    bool itm = (trace_out & TRACE_OUT_ITM) && trace_itm_ready(TRACE_ITM_PORT);
+
+    for (uint16_t i = 0; i < n; i++) {
+        const trace_entry_t *e = &trace_ring[(tail + i) & TRACE_RING_MASK];
+        uint8_t *p = &trace_dgram[TRACE_HEADER_SIZE + i * TRACE_EVENT_SIZE];
+        trace_put32(p, e->cycles);
+        p[4] = e->type;
+        p[5] = e->id;
+        p[6] = (uint8_t)(e->arg >> 8);
+        p[7] = (uint8_t)e->arg;
+        if (itm) {
+            trace_itm_word(e->cycles);
+            trace_itm_word((uint32_t)e->type | ((uint32_t)e->id << 8) | ((uint32_t)e->arg << 16));
+        }
+    }
+    trace_tail = (uint16_t)(tail + n);
+    trace_stats.sent += n;
+
+    if (trace_out & TRACE_OUT_UDP) {
+        trace_header((uint8_t)n, 0);
+        trace_udp_send((uint16_t)(TRACE_HEADER_SIZE + n * TRACE_EVENT_SIZE));
+    }
+    return n;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool trace_start(uint8_t out, const uint8_t *ip, uint16_t port) {
+    if (out & (uint8_t)~(TRACE_OUT_UDP | TRACE_OUT_ITM)) return false;
+    if ((out & TRACE_OUT_UDP) && ip == NULL) return false;
+    if (out & TRACE_OUT_ITM) {
+        if (!(ITM->TCR & ITM_TCR_ITMENA_Msk)) return false;     // No SWO set up
+        ITM->TER |= (1UL << TRACE_ITM_PORT) | (1UL << TRACE_ITM_NAME_PORT);
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    trace_out = 0;
+    trace_head = 0;
+    trace_tail = 0;
+    trace_lost = 0;
+    if (out) memset(&trace_stats, 0, sizeof(trace_stats));  // Stopping keeps the counters readable
+    __set_PRIMASK(primask);
+    if (!out) return true;
+
+    if (ip != NULL) memcpy(trace_ip, ip, sizeof(trace_ip));
+    trace_port = port ? port : TRACE_UDP_PORT;
+    trace_names_due = true;
+    trace_flush_ms = HAL_GetTick();
+    trace_out = out;
+    return true;
+}
+
+void trace_poll(void) {
+    if (!trace_out) return;
+    uint32_t now = HAL_GetTick();
+
+    if (trace_names_due || (now - trace_names_ms) >= TRACE_NAMES_MS) {
+        trace_names_due = false;
+        trace_names_ms = now;
+        trace_send_names();
+    }
+
+    /* Full datagrams as they fill, the remainder every TRACE_FLUSH_MS; at
+     * most one ring's worth per call so Task00 keeps its period */
+    uint16_t budget = TRACE_RING_EVENTS;
+    while (trace_out && budget) {
+        uint16_t avail = (uint16_t)(trace_head - trace_tail);
+        if (avail == 0) break;
+        if (avail < TRACE_UDP_EVENTS && (now - trace_flush_ms) < TRACE_FLUSH_MS) break;
+        uint16_t n = trace_send_events((avail < budget) ? avail : budget);
+        budget = (uint16_t)(budget - n);
+        trace_flush_ms = now;
+    }
+}
+
+void trace_get_stats(trace_stats_t *stats) {
+    *stats = trace_stats;
+    stats->out = trace_out;
+}
+
+#endif /* TRACE_ENABLED */
@@ -0,0 +1,266 @@
+/**
+ * @file traffic_agg.c
+ * @brief On-device traffic aggregation engine implementation
+ */
+
+#include "traffic_agg.h"
+#include "w5500_socket.h"
+#include "eth_config.h"
+#include <string.h>
+
+/**
+ * @brief Per-lane bucket contents (kept small: 22 buckets x lanes live in RAM)
+ */
+typedef struct {
+    uint16_t count;
+    uint16_t headway_count;
+    uint32_t occupancy_ms;
+    uint32_t headway_sum_ms;
+    uint32_t speed_sum_x10;
+    uint16_t speed_count;
+    uint16_t speed_hist[TRAFFIC_AGG_SPEED_BINS];
+} traffic_bucket_t;
+
+typedef struct {
+    uint32_t bucket_ms;
+    uint8_t bucket_count;
+    traffic_bucket_t (*buckets)[TRAFFIC_AGG_LANES];
+} traffic_tier_config_t;
+
+typedef struct {
+    uint8_t head;
+    uint32_t bucket_start_ms;
+} traffic_tier_state_t;
+
+#define TRAFFIC_1S_BUCKETS      1
+#define TRAFFIC_1MIN_BUCKETS    6
+#define TRAFFIC_15MIN_BUCKETS   15
+
+static traffic_bucket_t traffic_buckets_1s[TRAFFIC_1S_BUCKETS][TRAFFIC_AGG_LANES];
+static traffic_bucket_t traffic_buckets_1min[TRAFFIC_1MIN_BUCKETS][TRAFFIC_AGG_LANES];
+static traffic_bucket_t traffic_buckets_15min[TRAFFIC_15MIN_BUCKETS][TRAFFIC_AGG_LANES];
+
+static const traffic_tier_config_t traffic_tiers[TRAFFIC_WINDOW_COUNT] = {
+    [TRAFFIC_WINDOW_1S]    = {1000,  TRAFFIC_1S_BUCKETS,    traffic_buckets_1s},
+    [TRAFFIC_WINDOW_1MIN]  = {10000, TRAFFIC_1MIN_BUCKETS,  traffic_buckets_1min},
+    [TRAFFIC_WINDOW_15MIN] = {60000, TRAFFIC_15MIN_BUCKETS, traffic_buckets_15min},
+};
+
+static traffic_tier_state_t traffic_state[TRAFFIC_WINDOW_COUNT];
+static const uint16_t traffic_speed_edges[TRAFFIC_AGG_SPEED_BINS - 1] = TRAFFIC_AGG_SPEED_EDGES;
+
+/* Last arrival per lane, for headway */
+static uint32_t traffic_last_arrival_ms[TRAFFIC_AGG_LANES];
+static bool traffic_last_arrival_valid[TRAFFIC_AGG_LANES];
+
+/* Single-producer / single-consumer event queue */
+static traffic_event_t traffic_queue[TRAFFIC_AGG_EVENT_QUEUE];
+static volatile uint8_t traffic_queue_head = 0;
+static volatile uint8_t traffic_queue_tail = 0;
+static uint32_t traffic_dropped = 0;
+
+static traffic_publish_fn traffic_publish = NULL;
+static traffic_summary_t traffic_closed;    /* Static: task stacks are 512 bytes */
+
+_Static_assert((TRAFFIC_AGG_EVENT_QUEUE & (TRAFFIC_AGG_EVENT_QUEUE - 1)) == 0, "Event queue size must be a power of 2");
+_Static_assert(TRAFFIC_AGG_EVENT_QUEUE < 256, "Queue indices are 8-bit");
+
+static inline uint32_t traffic_window_ms(traffic_window_t window) {
+    return traffic_tiers[window].bucket_ms * traffic_tiers[window].bucket_count;
+}
+
+// ============================================================================
+// BUCKET OPERATIONS
+// ============================================================================
+
+static uint8_t traffic_speed_bin(uint16_t speed_kmh_x10) {
+    uint8_t bin = 0;
+    while (bin < TRAFFIC_AGG_SPEED_BINS - 1 && speed_kmh_x10 >= traffic_speed_edges[bin] * 10u) bin++;
+    return bin;
+}
+
+static void traffic_sum(traffic_window_t window, traffic_summary_t *out) {
+    const traffic_tier_config_t *tier = &traffic_tiers[window];
+
+    memset(out, 0, sizeof(*out));
+    out->window = window;
+    out->length_ms = traffic_window_ms(window);
+
+    for (uint8_t b = 0; b < tier->bucket_count; b++) {
+        for (uint8_t l = 0; l < TRAFFIC_AGG_LANES; l++) {
+            const traffic_bucket_t *src = &tier->buckets[b][l];
+            traffic_lane_stats_t *dst = &out->lane[l];
+            dst->count += src->count;
+            dst->occupancy_ms += src->occupancy_ms;
+            dst->headway_sum_ms += src->headway_sum_ms;
+            dst->headway_count += src->headway_count;
+            dst->speed_sum_x10 += src->speed_sum_x10;
+            dst->speed_count += src->speed_count;
+            for (uint8_t s = 0; s < TRAFFIC_AGG_SPEED_BINS; s++) dst->speed_hist[s] += src->speed_hist[s];
+        }
+    }
+}
+
+/**
+ * @brief Close every bucket of a tier that ends at or before t_ms
+ */
+static void traffic_advance(traffic_window_t window, uint32_t t_ms) {
+    const traffic_tier_config_t *tier = &traffic_tiers[window];
+    traffic_tier_state_t *state = &traffic_state[window];
+    uint32_t window_ms = traffic_window_ms(window);
+
+    if ((int32_t)(t_ms - state->bucket_start_ms) < 0) return;    /* Late event: stays in the open bucket */
+
+    uint16_t closed = 0;
+    while ((t_ms - state->bucket_start_ms) >= tier->bucket_ms) {
+        /* Two whole windows closed: everything recorded is published, skip the empty rest */
+        if (++closed > 2u * tier->bucket_count) {
+            state->bucket_start_ms = t_ms - ((t_ms - state->bucket_start_ms) % tier->bucket_ms);
+            break;
+        }
+        uint32_t end_ms = state->bucket_start_ms + tier->bucket_ms;
+
+        /* Buckets are aligned, so on a window boundary the ring holds exactly that window */
+        if ((end_ms % window_ms) == 0 && traffic_publish) {
+            traffic_sum(window, &traffic_closed);
+            traffic_closed.end_ms = end_ms;
+            traffic_publish(&traffic_closed);
+        }
+
+        state->head = (uint8_t)((state->head + 1) % tier->bucket_count);
+        memset(tier->buckets[state->head], 0, sizeof(traffic_bucket_t) * TRAFFIC_AGG_LANES);
+        state->bucket_start_ms = end_ms;
+    }
+}
+
+static void traffic_add(const traffic_event_t *ev) {
+    if (ev->lane >= TRAFFIC_AGG_LANES) return;
+
+    uint32_t headway_ms = 0;
+    if (traffic_last_arrival_valid[ev->lane]) {
+        headway_ms = ev->timestamp_ms - traffic_last_arrival_ms[ev->lane];
+        if (headway_ms > TRAFFIC_AGG_MAX_HEADWAY_MS) headway_ms = 0;
+    }
+    traffic_last_arrival_ms[ev->lane] = ev->timestamp_ms;
+    traffic_last_arrival_valid[ev->lane] = true;
+
+    uint8_t bin = traffic_speed_bin(ev->speed_kmh_x10);
+
+    for (uint8_t w = 0; w < TRAFFIC_WINDOW_COUNT; w++) {
+        traffic_advance((traffic_window_t)w, ev->timestamp_ms);
+
+        traffic_bucket_t *b = &traffic_tiers[w].buckets[traffic_state[w].head][ev->lane];
+        b->count++;
+        b->occupancy_ms += ev->occupancy_ms;
+        if (headway_ms) {
+            b->headway_sum_ms += headway_ms;
+            b->headway_count++;
+        }
+        if (ev->speed_kmh_x10) {
+            b->speed_sum_x10 += ev->speed_kmh_x10;
+            b->speed_count++;
+            b->speed_hist[bin]++;
+        }
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void traffic_agg_init(uint32_t now_ms, traffic_publish_fn publish) {
+    memset(traffic_buckets_1s, 0, sizeof(traffic_buckets_1s));
+    memset(traffic_buckets_1min, 0, sizeof(traffic_buckets_1min));
+    memset(traffic_buckets_15min, 0, sizeof(traffic_buckets_15min));
+    memset(traffic_last_arrival_valid, 0, sizeof(traffic_last_arrival_valid));
+
+    for (uint8_t w = 0; w < TRAFFIC_WINDOW_COUNT; w++) {
+        traffic_state[w].head = 0;
+        traffic_state[w].bucket_start_ms = now_ms - (now_ms % traffic_tiers[w].bucket_ms);
+    }
+
+    traffic_queue_head = traffic_queue_tail = 0;
+    traffic_dropped = 0;
+    traffic_publish = publish;
+}
+
+bool traffic_agg_submit(const traffic_event_t *event) {
+    uint8_t head = traffic_queue_head;
+    uint8_t next = (uint8_t)((head + 1) & (TRAFFIC_AGG_EVENT_QUEUE - 1));
+
+    if (next == traffic_queue_tail) {
+        traffic_dropped++;
+        return false;
+    }
+    traffic_queue[head] = *event;
+    __asm volatile ("" ::: "memory");   /* Entry is written before it is published */
+    traffic_queue_head = next;
+    return true;
+}
+
+void traffic_agg_tick(uint32_t now_ms) {
+    while (traffic_queue_tail != traffic_queue_head) {
+        uint8_t tail = traffic_queue_tail;
+        traffic_add(&traffic_queue[tail]);
+        traffic_queue_tail = (uint8_t)((tail + 1) & (TRAFFIC_AGG_EVENT_QUEUE - 1));
+    }
+
+    for (uint8_t w = 0; w < TRAFFIC_WINDOW_COUNT; w++) {
+        traffic_advance((traffic_window_t)w, now_ms);
+    }
+}
+
+void traffic_agg_get_window(traffic_window_t window, traffic_summary_t *out) {
+    traffic_sum(window, out);
+    out->end_ms = traffic_state[window].bucket_start_ms + traffic_tiers[window].bucket_ms;
+}
+
+uint16_t traffic_agg_encode(const traffic_summary_t *summary, uint8_t *buf) {
+    uint8_t *p = buf;
+
+    *p++ = TRAFFIC_AGG_MAGIC;
+    *p++ = TRAFFIC_AGG_VERSION;
+    *p++ = (uint8_t)summary->window;
+    *p++ = TRAFFIC_AGG_LANES;
+    *p++ = (uint8_t)(summary->end_ms >> 24); *p++ = (uint8_t)(summary->end_ms >> 16);
+    *p++ = (uint8_t)(summary->end_ms >> 8);  *p++ = (uint8_t)summary->end_ms;
+
+    for (uint8_t l = 0; l < TRAFFIC_AGG_LANES; l++) {
+        const traffic_lane_stats_t *s = &summary->lane[l];
+        uint32_t count = (s->count > 0xFFFF) ? 0xFFFF : s->count;
+        uint32_t occupancy_permille = (uint32_t)(((uint64_t)s->occupancy_ms * 1000) / summary->length_ms);
+        uint32_t headway_ms = s->headway_count ? (s->headway_sum_ms / s->headway_count) : 0;
+        uint32_t speed_x10 = s->speed_count ? (s->speed_sum_x10 / s->speed_count) : 0;
+        uint32_t speed_count = (s->speed_count > 0xFFFF) ? 0xFFFF : s->speed_count;
+
+        if (occupancy_permille > 1000) occupancy_permille = 1000;   /* Overlapping presence */
+
+        *p++ = (uint8_t)(count >> 8);               *p++ = (uint8_t)count;
+        *p++ = (uint8_t)(occupancy_permille >> 8);  *p++ = (uint8_t)occupancy_permille;
+        *p++ = (uint8_t)(headway_ms >> 24);         *p++ = (uint8_t)(headway_ms >> 16);
+        *p++ = (uint8_t)(headway_ms >> 8);          *p++ = (uint8_t)headway_ms;
+        *p++ = (uint8_t)(speed_x10 >> 8);           *p++ = (uint8_t)speed_x10;
+        *p++ = (uint8_t)(speed_count >> 8);         *p++ = (uint8_t)speed_count;
+        for (uint8_t s_bin = 0; s_bin < TRAFFIC_AGG_SPEED_BINS; s_bin++) {
+            uint32_t n = (s->speed_hist[s_bin] > 0xFFFF) ? 0xFFFF : s->speed_hist[s_bin];
+            *p++ = (uint8_t)(n >> 8);
+            *p++ = (uint8_t)n;
+        }
+    }
+    return (uint16_t)(p - buf);
+}
+
+void traffic_agg_publish_udp(const traffic_summary_t *summary) {
+    uint8_t target_ip[] = ETH_CONFIG_TRAFFIC_TARGET_IP;
+    static uint8_t packet[TRAFFIC_AGG_PACKET_SIZE];
+    uint16_t len = traffic_agg_encode(summary, packet);
+
+    if (!w5500_socket_check_ready()) return;
+    if (w5500_socket_open(ETH_CONFIG_UDP_SOCKET, W5500_SOCK_UDP, 0) != W5500_SOCK_OK) return;
+    w5500_socket_sendto(ETH_CONFIG_UDP_SOCKET, packet, len, target_ip, ETH_CONFIG_TRAFFIC_TARGET_PORT);
+    w5500_socket_close(ETH_CONFIG_UDP_SOCKET);
+}
+
+uint32_t traffic_agg_get_dropped(void) {
+    return traffic_dropped;
+}
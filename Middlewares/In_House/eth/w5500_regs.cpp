@@ -0,0 +1,27 @@
+/**
+ * @file w5500_regs.cpp
+ * @brief extern "C" wrappers around the W5500 register map
+ */
+
+#include "w5500_regs.h"
+#include "w5500_regs.hpp"
+
+using namespace w5500;
+
+uint8_t  w5500_reg_get_versionr(void)                 { return reg::versionr::read(); }
+uint8_t  w5500_reg_get_phycfgr(void)                  { return reg::phycfgr::read(); }
+uint8_t  w5500_reg_get_sir(void)                      { return reg::sir::read(); }
+
+uint8_t  w5500_reg_get_sn_sr(uint8_t sn)              { return reg::sn_sr::read(sn); }
+uint8_t  w5500_reg_get_sn_cr(uint8_t sn)              { return reg::sn_cr::read(sn); }
+void     w5500_reg_set_sn_cr(uint8_t sn, uint8_t cmd) { reg::sn_cr::write(sn, cmd); }
+uint8_t  w5500_reg_get_sn_ir(uint8_t sn)              { return reg::sn_ir::read(sn); }
+void     w5500_reg_set_sn_ir(uint8_t sn, uint8_t bits) { reg::sn_ir::write(sn, bits); }
+
+uint16_t w5500_reg_get_sn_tx_fsr(uint8_t sn)          { return reg::sn_tx_fsr::read_stable(sn); }
+uint16_t w5500_reg_get_sn_rx_rsr(uint8_t sn)          { return reg::sn_rx_rsr::read_stable(sn); }
+
+uint16_t w5500_reg_get_sn_tx_wr(uint8_t sn)           { return reg::sn_tx_wr::read(sn); }
+void     w5500_reg_set_sn_tx_wr(uint8_t sn, uint16_t ptr) { reg::sn_tx_wr::write(sn, ptr); }
+uint16_t w5500_reg_get_sn_rx_rd(uint8_t sn)           { return reg::sn_rx_rd::read(sn); }
+void     w5500_reg_set_sn_rx_rd(uint8_t sn, uint16_t ptr) { reg::sn_rx_rd::write(sn, ptr); }
@@ -0,0 +1,43 @@
+/**
+ * @file w5500_regs.h
+ * @brief C entry points to the compile-time W5500 register map
+ *
+ * @details Thin extern "C" wrappers around w5500_regs.hpp for the registers
+ *          the socket layer polls. Each call is one SPI frame with a header
+ *          taken from a constant table; 16-bit registers are read in one
+ *          burst. Socket numbers are not range-checked here.
+ */
+
+#ifndef W5500_REGS_H
+#define W5500_REGS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+uint8_t  w5500_reg_get_versionr(void);
+uint8_t  w5500_reg_get_phycfgr(void);
+uint8_t  w5500_reg_get_sir(void);
+
+uint8_t  w5500_reg_get_sn_sr(uint8_t sn);
+uint8_t  w5500_reg_get_sn_cr(uint8_t sn);
+void     w5500_reg_set_sn_cr(uint8_t sn, uint8_t cmd);
+uint8_t  w5500_reg_get_sn_ir(uint8_t sn);
+void     w5500_reg_set_sn_ir(uint8_t sn, uint8_t bits);
+
+/* Free-running counters: read until two samples agree */
+uint16_t w5500_reg_get_sn_tx_fsr(uint8_t sn);
+uint16_t w5500_reg_get_sn_rx_rsr(uint8_t sn);
+
+uint16_t w5500_reg_get_sn_tx_wr(uint8_t sn);
+void     w5500_reg_set_sn_tx_wr(uint8_t sn, uint16_t ptr);
+uint16_t w5500_reg_get_sn_rx_rd(uint8_t sn);
+void     w5500_reg_set_sn_rx_rd(uint8_t sn, uint16_t ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // W5500_REGS_H
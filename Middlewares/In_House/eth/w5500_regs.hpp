@@ -0,0 +1,238 @@
+/**
+ * @file w5500_regs.hpp
+ * @brief Compile-time W5500 register map (C++17, header-only)
+ *
+ * @details Each register is a type carrying its offset, width, block and
+ *          socket number. The 3-byte SPI header (address phase plus control
+ *          byte) is a constexpr member, so an access compiles down to the
+ *          chip select, one pump call for the header and one for the data,
+ *          with no address or block-select arithmetic at run time and no
+ *          calls through the ioLibrary's callback table.
+ *
+ *            uint8_t v  = w5500::reg::versionr::read();
+ *            uint8_t sr = w5500::reg::sn_sr::at<2>::read();    // socket known at compile time
+ *            uint16_t n = w5500::reg::sn_rx_rsr::read_stable(sn); // socket known at run time
+ *
+ *          Multi-byte registers are read and written in one burst (the
+ *          ioLibrary get/set functions issue one frame per byte). Socket
+ *          registers also have run-time socket accessors that index a
+ *          constexpr table of headers; the socket number must be below
+ *          w5500::socket_count.
+ *
+ *          Frames use variable-length data mode framed by CS and run inside
+ *          the W5500 critical section, like WIZCHIP_READ/WIZCHIP_WRITE. C code
+ *          reaches the map through w5500_regs.h.
+ */
+
+#ifndef W5500_REGS_HPP
+#define W5500_REGS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "w5500_spi.h"
+#include "spi_pump.h"
+
+namespace w5500 {
+
+constexpr uint8_t socket_count = 8;
+
+/* Block select: common registers, or one of the three blocks of a socket */
+enum class Block : uint8_t {
+    common = 0,
+    socket = 1,
+    tx_buf = 2,
+    rx_buf = 3,
+};
+
+using header_t = std::array<uint8_t, 3>;
+
+constexpr uint8_t block_select(Block block, uint8_t sn) {
+    return (block == Block::common) ? 0 : static_cast<uint8_t>((sn << 2) + static_cast<uint8_t>(block));
+}
+
+/* Address phase (big-endian offset) and control phase (BSB, RWB, OM = 00) */
+constexpr header_t frame_header(uint16_t addr, Block block, uint8_t sn, bool write) {
+    return {{static_cast<uint8_t>(addr >> 8), static_cast<uint8_t>(addr),
+             static_cast<uint8_t>((block_select(block, sn) << 3) | (write ? 0x04 : 0x00))}};
+}
+
+namespace detail {
+
+/* Registers of 1, 2 or 4 bytes read as integers, the others (addresses) as byte arrays */
+template <uint8_t Width> struct value_for { using type = std::array<uint8_t, Width>; };
+template <> struct value_for<1> { using type = uint8_t; };
+template <> struct value_for<2> { using type = uint16_t; };
+template <> struct value_for<4> { using type = uint32_t; };
+
+/* One SPI frame: W5500 critical section entered and CS held for its lifetime */
+class Frame {
+public:
+    Frame() { w5500_cris_enter(); w5500_cs_select(); }
+    ~Frame() { w5500_cs_deselect(); w5500_cris_exit(); }
+    Frame(const Frame &) = delete;
+    Frame &operator=(const Frame &) = delete;
+};
+
+template <uint8_t Width>
+struct Access {
+    using value_type = typename value_for<Width>::type;
+
+    static void read_bytes(const header_t &hdr, uint8_t *dst) {
+        Frame frame;
+        spi_pump_xfer(W5500_SPI_INSTANCE, hdr.data(), nullptr, hdr.size());
+        spi_pump_xfer(W5500_SPI_INSTANCE, nullptr, dst, Width);
+    }
+
+    /* Header and data go out in one pump call, without gaps in the clock */
+    static void write_bytes(const header_t &hdr, const uint8_t *src) {
+        uint8_t buf[3 + Width];
+        for (std::size_t i = 0; i < 3; i++) buf[i] = hdr[i];
+        for (std::size_t i = 0; i < Width; i++) buf[3 + i] = src[i];
+        Frame frame;
+        spi_pump_xfer(W5500_SPI_INSTANCE, buf, nullptr, sizeof(buf));
+    }
+
+    static value_type read(const header_t &hdr) {
+        uint8_t raw[Width];
+        read_bytes(hdr, raw);
+        value_type v{};
+        if constexpr (Width == 1 || Width == 2 || Width == 4) {
+            for (std::size_t i = 0; i < Width; i++) v = static_cast<value_type>((v << 8) | raw[i]);
+        } else {
+            for (std::size_t i = 0; i < Width; i++) v[i] = raw[i];
+        }
+        return v;
+    }
+
+    static void write(const header_t &hdr, const value_type &v) {
+        uint8_t raw[Width];
+        if constexpr (Width == 1 || Width == 2 || Width == 4) {
+            for (std::size_t i = 0; i < Width; i++) raw[i] = static_cast<uint8_t>(v >> (8 * (Width - 1 - i)));
+        } else {
+            for (std::size_t i = 0; i < Width; i++) raw[i] = v[i];
+        }
+        write_bytes(hdr, raw);
+    }
+
+    /* For counters the chip updates while they are read (Sn_TX_FSR, Sn_RX_RSR):
+       re-read until two samples agree, as the datasheet recommends */
+    static value_type read_stable(const header_t &hdr) {
+        value_type prev = read(hdr);
+        value_type cur;
+        while ((cur = read(hdr)) != prev) prev = cur;
+        return cur;
+    }
+};
+
+template <uint16_t Addr, bool Write, std::size_t... Sn>
+constexpr std::array<header_t, sizeof...(Sn)> socket_headers(std::index_sequence<Sn...>) {
+    return {{frame_header(Addr, Block::socket, static_cast<uint8_t>(Sn), Write)...}};
+}
+
+} // namespace detail
+
+/**
+ * @brief Register descriptor
+ * @tparam Addr  Offset within the block
+ * @tparam Width Size in bytes
+ * @tparam Blk   Block the register lives in
+ * @tparam Sn    Socket number (0 for common registers)
+ */
+template <uint16_t Addr, uint8_t Width, Block Blk = Block::common, uint8_t Sn = 0>
+struct Reg {
+    static_assert(Width > 0, "empty register");
+    static_assert(Sn < socket_count, "socket out of range");
+    static_assert(Blk != Block::common || Sn == 0, "common registers have no socket");
+
+    using access = detail::Access<Width>;
+    using value_type = typename access::value_type;
+
+    static constexpr uint16_t address = Addr;
+    static constexpr uint8_t width = Width;
+    static constexpr header_t read_header = frame_header(Addr, Blk, Sn, false);
+    static constexpr header_t write_header = frame_header(Addr, Blk, Sn, true);
+
+    static value_type read() { return access::read(read_header); }
+    static void write(const value_type &v) { access::write(write_header, v); }
+    static value_type read_stable() { return access::read_stable(read_header); }
+    static void read_bytes(uint8_t (&dst)[Width]) { access::read_bytes(read_header, dst); }
+    static void write_bytes(const uint8_t (&src)[Width]) { access::write_bytes(write_header, src); }
+};
+
+/**
+ * @brief Socket register: at<Sn> for a compile-time socket, or the
+ *        run-time accessors backed by a constexpr header table
+ */
+template <uint16_t Addr, uint8_t Width>
+struct SocketReg {
+    template <uint8_t Sn>
+    using at = Reg<Addr, Width, Block::socket, Sn>;
+
+    using access = detail::Access<Width>;
+    using value_type = typename access::value_type;
+
+    static constexpr auto read_headers =
+        detail::socket_headers<Addr, false>(std::make_index_sequence<socket_count>{});
+    static constexpr auto write_headers =
+        detail::socket_headers<Addr, true>(std::make_index_sequence<socket_count>{});
+
+    static value_type read(uint8_t sn) { return access::read(read_headers[sn]); }
+    static void write(uint8_t sn, const value_type &v) { access::write(write_headers[sn], v); }
+    static value_type read_stable(uint8_t sn) { return access::read_stable(read_headers[sn]); }
+};
+
+/* Register map (W5500 datasheet v1.0.9, section 4). Lower case, so the
+   ioLibrary's register macros (VERSIONR, Sn_SR(n), ...) do not collide */
+namespace reg {
+
+using mr            = Reg<0x0000, 1>;
+using gar           = Reg<0x0001, 4>;
+using subr          = Reg<0x0005, 4>;
+using shar          = Reg<0x0009, 6>;
+using sipr          = Reg<0x000F, 4>;
+using ir            = Reg<0x0015, 1>;
+using imr           = Reg<0x0016, 1>;
+using sir           = Reg<0x0017, 1>;
+using simr          = Reg<0x0018, 1>;
+using rtr           = Reg<0x0019, 2>;
+using rcr           = Reg<0x001B, 1>;
+using phycfgr       = Reg<0x002E, 1>;
+using versionr      = Reg<0x0039, 1>;
+
+using sn_mr         = SocketReg<0x0000, 1>;
+using sn_cr         = SocketReg<0x0001, 1>;
+using sn_ir         = SocketReg<0x0002, 1>;
+using sn_sr         = SocketReg<0x0003, 1>;
+using sn_port       = SocketReg<0x0004, 2>;
+using sn_dhar       = SocketReg<0x0006, 6>;
+using sn_dipr       = SocketReg<0x000C, 4>;
+using sn_dport      = SocketReg<0x0010, 2>;
+using sn_mssr       = SocketReg<0x0012, 2>;
+using sn_tos        = SocketReg<0x0015, 1>;
+using sn_ttl        = SocketReg<0x0016, 1>;
+using sn_rxbuf_size = SocketReg<0x001E, 1>;
+using sn_txbuf_size = SocketReg<0x001F, 1>;
+using sn_tx_fsr     = SocketReg<0x0020, 2>;
+using sn_tx_rd      = SocketReg<0x0022, 2>;
+using sn_tx_wr      = SocketReg<0x0024, 2>;
+using sn_rx_rsr     = SocketReg<0x0026, 2>;
+using sn_rx_rd      = SocketReg<0x0028, 2>;
+using sn_rx_wr      = SocketReg<0x002A, 2>;
+using sn_imr        = SocketReg<0x002C, 1>;
+using sn_frag       = SocketReg<0x002D, 2>;
+using sn_kpalr      = SocketReg<0x002F, 1>;
+
+} // namespace reg
+
+/* Headers must match the ioLibrary's address encoding */
+static_assert(reg::versionr::read_header[0] == 0x00 && reg::versionr::read_header[1] == 0x39 &&
+              reg::versionr::read_header[2] == 0x00, "VERSIONR header");
+static_assert(reg::sn_sr::at<1>::read_header[2] == (((1 + 4 * 1) << 3) | 0x00), "Sn_SR(1) header");
+static_assert(reg::sn_cr::write_headers[7][2] == (((1 + 4 * 7) << 3) | 0x04), "Sn_CR(7) write header");
+
+} // namespace w5500
+
+#endif // W5500_REGS_HPP
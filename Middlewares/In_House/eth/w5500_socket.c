@@ -8,6 +8,9 @@
 #include "wizchip_conf.h"
 #include "socket.h"
 #include "w5500.h"
+#include "w5500_regs.h"
+#include "w5500_spi.h"
+#include "trace.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -24,7 +27,7 @@ static int8_t w5500_socket_get_service_socket(const char* service) {
 }
 
 bool w5500_socket_check_ready(void) {
-    return (getVERSIONR() == 0x04);
+    return (w5500_reg_get_versionr() == 0x04);
 }
 
 int8_t w5500_socket_open_service(const char* service, w5500_sock_type_t type, uint16_t port) {
@@ -52,6 +55,22 @@ int8_t w5500_socket_open(uint8_t sock_num, w5500_sock_type_t type, uint16_t port
     return (result == sock_num) ? W5500_SOCK_OK : W5500_SOCK_ERROR;
 }
 
+int8_t w5500_socket_open_multicast(uint8_t sock_num, const uint8_t* group, uint16_t port) {
+    if (sock_num >= W5500_MAX_SOCKET || !group) return W5500_SOCK_ERROR;
+    if (!w5500_socket_check_ready()) return W5500_SOCK_ERROR;
+
+    // Group address, port and MAC (01:00:5E + low 23 bits) must be set before OPEN
+    uint8_t ip[4] = {group[0], group[1], group[2], group[3]};
+    uint8_t mac[6] = {0x01, 0x00, 0x5E, (uint8_t)(group[1] & 0x7F), group[2], group[3]};
+    close(sock_num);
+    setSn_DIPR(sock_num, ip);
+    setSn_DPORT(sock_num, port);
+    setSn_DHAR(sock_num, mac);
+
+    int8_t result = socket(sock_num, Sn_MR_UDP, port, SF_MULTI_ENABLE);
+    return (result == sock_num) ? W5500_SOCK_OK : W5500_SOCK_ERROR;
+}
+
 int8_t w5500_socket_close(uint8_t sock_num) {
     if (sock_num >= W5500_MAX_SOCKET) return W5500_SOCK_ERROR;
     int8_t result = close(sock_num);
@@ -67,6 +86,7 @@ int8_t w5500_socket_listen(uint8_t sock_num) {
 int8_t w5500_socket_connect(uint8_t sock_num, const uint8_t *dest_ip, uint16_t dest_port) {
     if (sock_num >= W5500_MAX_SOCKET) return W5500_SOCK_ERROR;
     int8_t result = connect(sock_num, (uint8_t *)dest_ip, dest_port);
+    if (result == SOCK_BUSY) return W5500_SOCK_BUSY;    // Non-blocking socket: SYN sent, poll Sn_SR
     return (result == SOCK_OK) ? W5500_SOCK_OK : W5500_SOCK_ERROR;
 }
 
@@ -77,7 +97,7 @@ int8_t w5500_socket_disconnect(uint8_t sock_num) {
 }
 
 bool w5500_socket_is_established(uint8_t sock_num) {
-    return (sock_num < W5500_MAX_SOCKET) && (getSn_SR(sock_num) == SOCK_ESTABLISHED);
+    return (sock_num < W5500_MAX_SOCKET) && (w5500_reg_get_sn_sr(sock_num) == SOCK_ESTABLISHED);
 }
 
 int8_t w5500_socket_ctlsocket(uint8_t sock_num, uint8_t ctl_type, void *arg) {
@@ -112,7 +132,9 @@ int32_t w5500_socket_recv(uint8_t sock_num, uint8_t *buffer, uint16_t maxlen) {
 
 int32_t w5500_socket_sendto(uint8_t sock_num, const uint8_t *buffer, uint16_t len, const uint8_t *dest_ip, uint16_t dest_port) {
     if (sock_num >= W5500_MAX_SOCKET || !buffer) return W5500_SOCK_ERROR;
+    TRACE_SPAN_BEGIN(TRACE_SPAN_W5500_SEND, sock_num);
     int32_t sent = sendto(sock_num, (uint8_t *)buffer, len, (uint8_t *)dest_ip, dest_port);
+    TRACE_SPAN_END(TRACE_SPAN_W5500_SEND, sock_num);
     return (sent >= 0) ? sent : W5500_SOCK_ERROR;
 }
 
@@ -123,13 +145,136 @@ int32_t w5500_socket_recvfrom(uint8_t sock_num, uint8_t *buffer, uint16_t maxlen
 }
 
 uint8_t w5500_socket_get_status(uint8_t sock_num) {
-    return (sock_num < W5500_MAX_SOCKET) ? getSn_SR(sock_num) : 0xFF;
+    return (sock_num < W5500_MAX_SOCKET) ? w5500_reg_get_sn_sr(sock_num) : 0xFF;
 }
 
 uint16_t w5500_socket_get_tx_buf_free_size(uint8_t sock_num) {
-    return (sock_num < W5500_MAX_SOCKET) ? getSn_TX_FSR(sock_num) : 0;
+    return (sock_num < W5500_MAX_SOCKET) ? w5500_reg_get_sn_tx_fsr(sock_num) : 0;
 }
 
 uint16_t w5500_socket_get_rx_buf_size(uint8_t sock_num) {
-    return (sock_num < W5500_MAX_SOCKET) ? getSn_RX_RSR(sock_num) : 0;
+    return (sock_num < W5500_MAX_SOCKET) ? w5500_reg_get_sn_rx_rsr(sock_num) : 0;
+}
+
+// ============================================================================
+// ZERO-COPY BUFFER ACCESS
+// ============================================================================
+
+uint16_t w5500_socket_tx_begin(uint8_t sock_num) {
+    return (sock_num < W5500_MAX_SOCKET) ? w5500_reg_get_sn_tx_wr(sock_num) : 0;
+}
+
+uint16_t w5500_socket_tx_write(uint8_t sock_num, uint16_t ptr, const uint8_t *data, uint16_t len) {
+    if (sock_num >= W5500_MAX_SOCKET || !data || len == 0) return ptr;
+    // Sn_TX_WR is a free-running 16-bit pointer; the chip wraps it onto the socket buffer
+    uint32_t addrsel = ((uint32_t)ptr << 8) + (WIZCHIP_TXBUF_BLOCK(sock_num) << 3);
+    WIZCHIP_WRITE_BUF(addrsel, (uint8_t *)data, len);
+    return (uint16_t)(ptr + len);
+}
+
+int32_t w5500_socket_tx_commit(uint8_t sock_num, uint16_t start_ptr, uint16_t end_ptr) {
+    if (sock_num >= W5500_MAX_SOCKET) return W5500_SOCK_ERROR;
+    uint16_t len = (uint16_t)(end_ptr - start_ptr);
+    if (len == 0) return 0;
+
+    w5500_reg_set_sn_tx_wr(sock_num, end_ptr);
+    w5500_reg_set_sn_cr(sock_num, Sn_CR_SEND);
+    while (w5500_reg_get_sn_cr(sock_num));
+
+    uint8_t ir;
+    int32_t ret = len;
+    TRACE_SPAN_BEGIN(TRACE_SPAN_W5500_SEND, sock_num);
+    while (!((ir = w5500_reg_get_sn_ir(sock_num)) & Sn_IR_SENDOK)) {
+        if (ir & Sn_IR_TIMEOUT) {
+            w5500_reg_set_sn_ir(sock_num, Sn_IR_TIMEOUT);
+            ret = W5500_SOCK_TIMEOUT;
+            break;
+        }
+        if (w5500_reg_get_sn_sr(sock_num) == SOCK_CLOSED) {
+            ret = W5500_SOCK_ERROR;
+            break;
+        }
+    }
+    TRACE_SPAN_END(TRACE_SPAN_W5500_SEND, sock_num);
+    if (ret == len) w5500_reg_set_sn_ir(sock_num, Sn_IR_SENDOK);
+    return ret;
+}
+
+uint16_t w5500_socket_rx_begin(uint8_t sock_num) {
+    return (sock_num < W5500_MAX_SOCKET) ? w5500_reg_get_sn_rx_rd(sock_num) : 0;
+}
+
+uint16_t w5500_socket_rx_read(uint8_t sock_num, uint16_t ptr, uint8_t *buffer, uint16_t len) {
+    if (sock_num >= W5500_MAX_SOCKET || !buffer || len == 0) return ptr;
+    uint32_t addrsel = ((uint32_t)ptr << 8) + (WIZCHIP_RXBUF_BLOCK(sock_num) << 3);
+    WIZCHIP_READ_BUF(addrsel, buffer, len);
+    return (uint16_t)(ptr + len);
+}
+
+int8_t w5500_socket_rx_commit(uint8_t sock_num, uint16_t end_ptr) {
+    if (sock_num >= W5500_MAX_SOCKET) return W5500_SOCK_ERROR;
+    w5500_reg_set_sn_rx_rd(sock_num, end_ptr);
+    w5500_reg_set_sn_cr(sock_num, Sn_CR_RECV);
+    while (w5500_reg_get_sn_cr(sock_num));
+    return W5500_SOCK_OK;
+}
+
+/* Open a buffer frame (W5500 SPI header: address, then block and R/W) and
+   start its data phase on DMA; the frame stays selected and the chip locked */
+/* The critical section is held across the DMA until w5500_socket_xfer_wait(),
+   so a caller already inside one (or locking the kernel around a split-phase
+   transfer) nests here. That relies on w5500_cris_enter/exit nesting
+   (w5500_spi.c): with a bare osKernelUnlock() the inner exit would reopen the
+   scheduler and let another task onto the bus mid-frame. */
+static void w5500_socket_frame_start(uint32_t addrsel, uint8_t rw, const uint8_t *tx, uint8_t *rx, uint16_t len) {
+    uint8_t hdr[3] = {
+        (uint8_t)(addrsel >> 16),
+        (uint8_t)(addrsel >> 8),
+        (uint8_t)((addrsel & 0xFF) | rw | _W5500_SPI_VDM_OP_),
+    };
+    w5500_cris_enter();
+    w5500_cs_select();
+    w5500_spi_writeburst(hdr, sizeof(hdr));
+    if (rx) {
+        w5500_spi_readburst_start(rx, len);
+    } else {
+        w5500_spi_writeburst_start(tx, len);
+    }
+}
+
+uint16_t w5500_socket_tx_write_start(uint8_t sock_num, uint16_t ptr, const uint8_t *data, uint16_t len) {
+    uint32_t addrsel = ((uint32_t)ptr << 8) + (WIZCHIP_TXBUF_BLOCK(sock_num) << 3);
+    w5500_socket_frame_start(addrsel, _W5500_SPI_WRITE_, data, NULL, len);
+    return (uint16_t)(ptr + len);
+}
+
+uint16_t w5500_socket_rx_read_start(uint8_t sock_num, uint16_t ptr, uint8_t *buffer, uint16_t len) {
+    uint32_t addrsel = ((uint32_t)ptr << 8) + (WIZCHIP_RXBUF_BLOCK(sock_num) << 3);
+    w5500_socket_frame_start(addrsel, _W5500_SPI_READ_, NULL, buffer, len);
+    return (uint16_t)(ptr + len);
+}
+
+void w5500_socket_xfer_wait(void) {
+    w5500_spi_burst_wait();
+    w5500_cs_deselect();
+    w5500_cris_exit();
+}
+
+uint8_t w5500_socket_get_pending_irq(void) {
+    return w5500_reg_get_sir();
+}
+
+uint8_t w5500_socket_take_irq(uint8_t sock_num) {
+    if (sock_num >= W5500_MAX_SOCKET) return 0;
+    uint8_t ir = w5500_reg_get_sn_ir(sock_num);
+    if (ir) w5500_reg_set_sn_ir(sock_num, ir);
+    return ir;
+}
+
+void w5500_socket_set_irq_mask(uint8_t sock_num, uint8_t mask) {
+    if (sock_num >= W5500_MAX_SOCKET) return;
+    setSn_IMR(sock_num, mask);
+    w5500_reg_set_sn_ir(sock_num, 0x1F);
+    uint8_t simr = getSIMR();
+    setSIMR(mask ? (uint8_t)(simr | (1 << sock_num)) : (uint8_t)(simr & ~(1 << sock_num)));
 }
\ No newline at end of file
@@ -12,6 +12,10 @@
 
  #ifndef _W5500_SOCKET_H_
  #define _W5500_SOCKET_H_
+
+ #ifdef __cplusplus
+ extern "C" {
+ #endif
  
  #include <stdint.h>
  #include <stdbool.h>
@@ -84,6 +88,12 @@
   */
  int8_t w5500_socket_open(uint8_t sock_num, w5500_sock_type_t type, uint16_t port);
  
+ /**
+  * @brief Open a UDP socket in multicast mode and join group (IGMP)
+  * @note  sendto() on this socket always goes to the group
+  */
+ int8_t w5500_socket_open_multicast(uint8_t sock_num, const uint8_t* group, uint16_t port);
+
  /**
   * @brief Close a socket
   */
@@ -96,6 +106,7 @@
  
  /**
   * @brief Connect a TCP socket to a remote host
+  * @return W5500_SOCK_BUSY if the socket is non-blocking and the connection is in progress
   */
  int8_t w5500_socket_connect(uint8_t sock_num, const uint8_t* dest_ip, uint16_t dest_port);
  
@@ -173,5 +184,87 @@
   */
  uint16_t w5500_socket_get_rx_buf_size(uint8_t sock_num);
  
+ /*============================================================================*/
+ /* ZERO-COPY BUFFER ACCESS                                                    */
+ /*============================================================================*/
+
+ /**
+  * @brief Get the current TX write pointer (Sn_TX_WR) to start building a frame
+  * @note  The caller must check w5500_socket_get_tx_buf_free_size() first
+  */
+ uint16_t w5500_socket_tx_begin(uint8_t sock_num);
+
+ /**
+  * @brief Write bytes straight into the socket TX buffer at ptr
+  * @return ptr advanced by len
+  */
+ uint16_t w5500_socket_tx_write(uint8_t sock_num, uint16_t ptr, const uint8_t* data, uint16_t len);
+
+ /**
+  * @brief Publish TX buffer bytes [start_ptr, end_ptr) and issue SEND
+  * @return Number of bytes sent or error code
+  */
+ int32_t w5500_socket_tx_commit(uint8_t sock_num, uint16_t start_ptr, uint16_t end_ptr);
+
+ /**
+  * @brief Get the current RX read pointer (Sn_RX_RD)
+  */
+ uint16_t w5500_socket_rx_begin(uint8_t sock_num);
+
+ /**
+  * @brief Copy bytes out of the socket RX buffer at ptr without consuming them
+  * @return ptr advanced by len
+  */
+ uint16_t w5500_socket_rx_read(uint8_t sock_num, uint16_t ptr, uint8_t* buffer, uint16_t len);
+
+ /**
+  * @brief Release RX buffer bytes up to end_ptr and issue RECV
+  */
+ int8_t w5500_socket_rx_commit(uint8_t sock_num, uint16_t end_ptr);
+
+ /**
+  * @brief Start writing len bytes into the socket TX buffer at ptr on DMA
+  * @note  The chip stays selected and locked (no other task touches it)
+  *        until w5500_socket_xfer_wait(); data must stay valid until then.
+  *        For a valid sock_num and len > 0 only.
+  * @return ptr advanced by len
+  */
+ uint16_t w5500_socket_tx_write_start(uint8_t sock_num, uint16_t ptr, const uint8_t* data, uint16_t len);
+
+ /**
+  * @brief Start copying len bytes out of the socket RX buffer at ptr on DMA
+  * @note  As w5500_socket_tx_write_start(); buffer is filled by
+  *        w5500_socket_xfer_wait()
+  * @return ptr advanced by len
+  */
+ uint16_t w5500_socket_rx_read_start(uint8_t sock_num, uint16_t ptr, uint8_t* buffer, uint16_t len);
+
+ /**
+  * @brief Finish the transfer started above and release the chip
+  */
+ void w5500_socket_xfer_wait(void);
+
+ /**
+  * @brief Get the socket interrupt summary register (SIR), one bit per socket
+  */
+ uint8_t w5500_socket_get_pending_irq(void);
+
+ /**
+  * @brief Read and clear the socket interrupt register (Sn_IR)
+  * @return Sn_IR flags that were pending
+  */
+ uint8_t w5500_socket_take_irq(uint8_t sock_num);
+
+ /**
+  * @brief Route socket interrupts to the INTn pin
+  * @param mask Sn_IR_xxx events that pull INTn low, 0 to detach the socket
+  * @note  Pending Sn_IR flags are cleared so INTn starts released
+  */
+ void w5500_socket_set_irq_mask(uint8_t sock_num, uint8_t mask);
+
+ #ifdef __cplusplus
+ }
+ #endif
+
  #endif // _W5500_SOCKET_H_
  
@@ -0,0 +1,273 @@
+/**
+ * @file w5500_socket.hpp
+ * @brief C++ socket facade over the ioLibrary (C++17, header-only)
+ *
+ * @details Sockets are move-only objects that own one W5500 socket and close
+ *          it when they go out of scope, so an early return cannot leak it.
+ *          There are no exceptions and no heap: results come back as
+ *          expected<T>, which holds either the value or a w5500_sock_error_t.
+ *
+ *            auto sock = w5500::UdpSocket::open(ETH_CONFIG_UDP_SOCKET);
+ *            if (!sock) return sock.error();
+ *            auto sent = sock->send_to(payload, {ip, port});
+ *
+ *          The protocol is a template parameter: UDP-only and TCP-only calls
+ *          are rejected at compile time. All members are inline and call the
+ *          ioLibrary directly; the socket number is validated once, in open().
+ *          Blocking behaviour is the ioLibrary's (SF_IO_NONBLOCK at open()).
+ */
+
+#ifndef W5500_SOCKET_HPP
+#define W5500_SOCKET_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "w5500_socket.h"
+#include "w5500_regs.h"
+
+namespace w5500 {
+
+/**
+ * @brief Non-owning view of a contiguous buffer (subset of C++20 std::span)
+ */
+template <typename T>
+class span {
+public:
+    constexpr span() noexcept : data_(nullptr), size_(0) {}
+    constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    template <std::size_t N>
+    constexpr span(T (&arr)[N]) noexcept : data_(arr), size_(N) {}
+
+    template <typename U, std::size_t N,
+              typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(std::array<U, N> &arr) noexcept : data_(arr.data()), size_(N) {}
+
+    template <typename U, std::size_t N,
+              typename = std::enable_if_t<std::is_convertible_v<const U (*)[], T (*)[]>>>
+    constexpr span(const std::array<U, N> &arr) noexcept : data_(arr.data()), size_(N) {}
+
+    /* span<T> converts to span<const T> */
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(const span<U> &other) noexcept : data_(other.data()), size_(other.size()) {}
+
+    constexpr T *data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T &operator[](std::size_t i) const noexcept { return data_[i]; }
+    constexpr T *begin() const noexcept { return data_; }
+    constexpr T *end() const noexcept { return data_ + size_; }
+
+    constexpr span first(std::size_t n) const noexcept { return {data_, n}; }
+    constexpr span subspan(std::size_t offset) const noexcept { return {data_ + offset, size_ - offset}; }
+
+private:
+    T *data_;
+    std::size_t size_;
+};
+
+/* Error side of an expected<T> */
+struct unexpected {
+    w5500_sock_error_t code;
+};
+
+/**
+ * @brief Value or error (subset of C++23 std::expected, without exceptions)
+ * @note  T must be default-constructible; value() on an error is a logic
+ *        error and returns the default value.
+ */
+template <typename T>
+class [[nodiscard]] expected {
+public:
+    constexpr expected(T value) noexcept : value_(std::move(value)), error_(W5500_SOCK_OK) {}
+    constexpr expected(unexpected e) noexcept : value_(), error_(e.code) {}
+
+    constexpr bool has_value() const noexcept { return error_ == W5500_SOCK_OK; }
+    constexpr explicit operator bool() const noexcept { return has_value(); }
+    constexpr w5500_sock_error_t error() const noexcept { return static_cast<w5500_sock_error_t>(error_); }
+
+    constexpr T &value() & noexcept { return value_; }
+    constexpr const T &value() const & noexcept { return value_; }
+    constexpr T &&value() && noexcept { return std::move(value_); }
+    constexpr T &operator*() & noexcept { return value_; }
+    constexpr T *operator->() noexcept { return &value_; }
+    constexpr const T *operator->() const noexcept { return &value_; }
+
+    constexpr T value_or(T fallback) const & noexcept { return has_value() ? value_ : fallback; }
+
+private:
+    T value_;
+    int8_t error_;
+};
+
+template <>
+class [[nodiscard]] expected<void> {
+public:
+    constexpr expected() noexcept : error_(W5500_SOCK_OK) {}
+    constexpr expected(unexpected e) noexcept : error_(e.code) {}
+
+    constexpr bool has_value() const noexcept { return error_ == W5500_SOCK_OK; }
+    constexpr explicit operator bool() const noexcept { return has_value(); }
+    constexpr w5500_sock_error_t error() const noexcept { return static_cast<w5500_sock_error_t>(error_); }
+
+private:
+    int8_t error_;
+};
+
+struct Endpoint {
+    std::array<uint8_t, 4> ip;
+    uint16_t port;
+};
+
+enum class Protocol : uint8_t {
+    tcp = Sn_MR_TCP,
+    udp = Sn_MR_UDP,
+};
+
+namespace detail {
+
+/* ioLibrary return codes: SOCK_BUSY (0) in non-blocking mode, SOCKERR_xxx below */
+inline w5500_sock_error_t to_error(int32_t ret) {
+    if (ret == SOCK_BUSY) return W5500_SOCK_BUSY;
+    if (ret == SOCKERR_TIMEOUT) return W5500_SOCK_TIMEOUT;
+    return W5500_SOCK_ERROR;
+}
+
+inline expected<uint16_t> to_count(int32_t ret) {
+    if (ret > 0) return static_cast<uint16_t>(ret);
+    return unexpected{to_error(ret)};
+}
+
+inline expected<void> to_status(int8_t ret) {
+    if (ret == SOCK_OK) return {};
+    return unexpected{to_error(ret)};
+}
+
+} // namespace detail
+
+/**
+ * @brief Owning handle to one W5500 socket
+ * @tparam P Protocol the socket is opened with
+ */
+template <Protocol P>
+class Socket {
+public:
+    static constexpr uint8_t none = 0xFF;
+
+    /* Empty handle, owns no socket */
+    constexpr Socket() noexcept : sn_(none) {}
+    ~Socket() { close(); }
+
+    Socket(Socket &&other) noexcept : sn_(other.sn_) { other.sn_ = none; }
+    Socket &operator=(Socket &&other) noexcept {
+        if (this != &other) {
+            close();
+            sn_ = other.sn_;
+            other.sn_ = none;
+        }
+        return *this;
+    }
+    Socket(const Socket &) = delete;
+    Socket &operator=(const Socket &) = delete;
+
+    /**
+     * @brief Open socket sn
+     * @param port  Local port, 0 for an ephemeral one
+     * @param flags ioLibrary SF_xxx flags
+     */
+    static expected<Socket> open(uint8_t sn, uint16_t port = 0, uint8_t flags = 0) {
+        if (sn >= W5500_MAX_SOCKET) return unexpected{W5500_SOCK_ERROR};
+        int8_t ret = ::socket(sn, static_cast<uint8_t>(P), port, flags);
+        if (ret != static_cast<int8_t>(sn)) return unexpected{detail::to_error(ret)};
+        return Socket(sn);
+    }
+
+    /* Take over a socket opened through the C API */
+    static Socket adopt(uint8_t sn) noexcept { return Socket((sn < W5500_MAX_SOCKET) ? sn : none); }
+
+    /* Give up ownership without closing; returns the socket number */
+    uint8_t release() noexcept {
+        uint8_t sn = sn_;
+        sn_ = none;
+        return sn;
+    }
+
+    void close() noexcept {
+        if (sn_ != none) {
+            ::close(sn_);
+            sn_ = none;
+        }
+    }
+
+    constexpr bool valid() const noexcept { return sn_ != none; }
+    constexpr explicit operator bool() const noexcept { return valid(); }
+    constexpr uint8_t number() const noexcept { return sn_; }
+
+    uint8_t status() const { return w5500_reg_get_sn_sr(sn_); }
+    uint16_t rx_size() const { return w5500_reg_get_sn_rx_rsr(sn_); }
+    uint16_t tx_free() const { return w5500_reg_get_sn_tx_fsr(sn_); }
+
+    /* ---- UDP ---- */
+
+    expected<uint16_t> send_to(span<const uint8_t> data, const Endpoint &to) {
+        static_assert(P == Protocol::udp, "send_to() needs a UDP socket");
+        return detail::to_count(::sendto(sn_, const_cast<uint8_t *>(data.data()),
+                                         static_cast<uint16_t>(data.size()),
+                                         const_cast<uint8_t *>(to.ip.data()), to.port));
+    }
+
+    expected<uint16_t> recv_from(span<uint8_t> buf, Endpoint &from) {
+        static_assert(P == Protocol::udp, "recv_from() needs a UDP socket");
+        return detail::to_count(::recvfrom(sn_, buf.data(), static_cast<uint16_t>(buf.size()),
+                                           from.ip.data(), &from.port));
+    }
+
+    /* ---- TCP ---- */
+
+    expected<void> connect(const Endpoint &to) {
+        static_assert(P == Protocol::tcp, "connect() needs a TCP socket");
+        return detail::to_status(::connect(sn_, const_cast<uint8_t *>(to.ip.data()), to.port));
+    }
+
+    expected<void> listen() {
+        static_assert(P == Protocol::tcp, "listen() needs a TCP socket");
+        return detail::to_status(::listen(sn_));
+    }
+
+    expected<void> disconnect() {
+        static_assert(P == Protocol::tcp, "disconnect() needs a TCP socket");
+        return detail::to_status(::disconnect(sn_));
+    }
+
+    bool established() const {
+        static_assert(P == Protocol::tcp, "established() needs a TCP socket");
+        return status() == SOCK_ESTABLISHED;
+    }
+
+    expected<uint16_t> send(span<const uint8_t> data) {
+        static_assert(P == Protocol::tcp, "send() needs a TCP socket");
+        return detail::to_count(::send(sn_, const_cast<uint8_t *>(data.data()),
+                                       static_cast<uint16_t>(data.size())));
+    }
+
+    expected<uint16_t> recv(span<uint8_t> buf) {
+        static_assert(P == Protocol::tcp, "recv() needs a TCP socket");
+        return detail::to_count(::recv(sn_, buf.data(), static_cast<uint16_t>(buf.size())));
+    }
+
+private:
+    explicit constexpr Socket(uint8_t sn) noexcept : sn_(sn) {}
+
+    uint8_t sn_;
+};
+
+using TcpSocket = Socket<Protocol::tcp>;
+using UdpSocket = Socket<Protocol::udp>;
+
+} // namespace w5500
+
+#endif // W5500_SOCKET_HPP
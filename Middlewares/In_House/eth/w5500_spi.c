@@ -24,12 +24,19 @@
 
 #include "w5500_spi.h"
 #include "main.h"
+#include "boot_prof.h"
+#include "dwt_cycles.h"
+#include "spi_pump.h"
+#include "spi_dma.h"
+#include "w5500_regs.h"
 
 /* ==========================================================================
  * CONFIGURATION AND DEFINES
  * ==========================================================================*/
 
-#define W5500_SPI_TIMEOUT      1000
+#define W5500_VERSION          0x04
+#define W5500_RESET_PULSE_US   500     // Datasheet minimum RSTn low time
+#define W5500_READY_TIMEOUT_MS 20      // PLL lock is 1 ms max; margin for slow supplies
 
 
 /* ==========================================================================
@@ -38,10 +45,14 @@
 
 extern SPI_HandleTypeDef hspi2;
 
+static bool w5500_reset_released = false;   /* RSTn already pulsed by main() */
+
 /* ==========================================================================
  * PRIVATE FUNCTION PROTOTYPES
  * ==========================================================================*/
 
+static void w5500_spi_reset_pulse(void);
+
 /* ==========================================================================
  * SPI INTERFACE FUNCTIONS
  * These are used by the wizchip driver for SPI communication
@@ -70,21 +81,15 @@ void w5500_cs_deselect(void)
 
 uint8_t w5500_spi_read(void)
 {
-    uint8_t tx = 0x00;
     uint8_t rx = 0x00;
-    if(HAL_SPI_TransmitReceive(&hspi2, &tx, &rx, 1, W5500_SPI_TIMEOUT) != HAL_OK) {
-        printf("SPI transfer error!\n");
-        //Error_Handler();
-    }
+    spi_pump_xfer(W5500_SPI_INSTANCE, NULL, &rx, 1);
     return rx;
 }
 
 void w5500_spi_readburst(uint8_t* pBuf, uint16_t len)
 {
-    // More efficient than looping: do whole burst at once
-    uint8_t tx[len];
-    memset(tx, 0, len);
-    HAL_SPI_TransmitReceive(&hspi2, tx, pBuf, len, W5500_SPI_TIMEOUT);
+    // More efficient than looping: do whole burst at once (0x00 clocked out)
+    spi_pump_xfer(W5500_SPI_INSTANCE, NULL, pBuf, len);
 }
 
 /**
@@ -94,12 +99,54 @@ void w5500_spi_readburst(uint8_t* pBuf, uint16_t len)
  */
 void w5500_spi_write(uint8_t byte)
 {
-    HAL_SPI_Transmit(&hspi2, &byte, 1, W5500_SPI_TIMEOUT);
+    spi_pump_xfer(W5500_SPI_INSTANCE, &byte, NULL, 1);
 }
 
 void w5500_spi_writeburst(uint8_t* pBuf, uint16_t len)
 {
-    HAL_SPI_Transmit(&hspi2, pBuf, len, W5500_SPI_TIMEOUT);
+    spi_pump_xfer(W5500_SPI_INSTANCE, pBuf, NULL, len);
+}
+
+void w5500_spi_readburst_start(uint8_t* pBuf, uint16_t len)
+{
+    spi_dma_start(W5500_SPI_INSTANCE, NULL, pBuf, len);
+}
+
+void w5500_spi_writeburst_start(const uint8_t* pBuf, uint16_t len)
+{
+    spi_dma_start(W5500_SPI_INSTANCE, pBuf, NULL, len);
+}
+
+void w5500_spi_burst_wait(void)
+{
+    spi_dma_wait(W5500_SPI_INSTANCE);
+}
+
+/* Nesting depth of the W5500 critical section and the lock state outside it.
+   Only touched with the scheduler locked, so no further protection needed. */
+static uint8_t w5500_cris_depth = 0;
+static int32_t w5500_cris_saved = 0;
+
+/**
+ * @brief Enter W5500 critical section
+ * @note  Several tasks access the chip, so each SPI frame issued by the
+ *        ioLibrary must not be interleaved with another task's frame.
+ *        Sections nest: osKernelLock() does not count, so the state before
+ *        the outermost enter is saved and only the matching exit restores it.
+ */
+void w5500_cris_enter(void)
+{
+    int32_t prev = osKernelLock();
+    if (w5500_cris_depth++ == 0) w5500_cris_saved = prev;
+}
+
+/**
+ * @brief Exit W5500 critical section
+ */
+void w5500_cris_exit(void)
+{
+    if (w5500_cris_depth == 0) return;
+    if (--w5500_cris_depth == 0) osKernelRestoreLock(w5500_cris_saved);
 }
 
 
@@ -123,16 +170,19 @@ void w5500_spi_writeburst(uint8_t* pBuf, uint16_t len)
  * 
  * This function:
  *  - Registers SPI and chip select callbacks
- *  - Performs a hardware reset
- *  - Verifies SPI connection (VERSIONR == 0x04)
+ *  - Performs a hardware reset, unless main() already released it
+ *  - Polls VERSIONR (== 0x04) until the chip answers
  *  - Initializes socket TX/RX buffers
  *  - Applies static IP configuration
- *  - Reads back the applied network info for verification
+ *
+ * Diagnostics (register dumps, raw SPI test, readback) are skipped with
+ * BOOT_FAST_ENABLED.
  */
-void w5500_spi_init(void)
+bool w5500_spi_init(void)
 {
-	printf("\n=== W5500 SPI Hardware Setup ===\n");
+    BOOT_LOG("\n=== W5500 SPI Hardware Setup ===\n");
 
+#if !BOOT_FAST_ENABLED
 	// Re-Confirm SPI Setting CR1 & CR2
 	printf("=== Check Current SPI2_CR1 ===\n");
 	printf("CR1: 0x%04lX\n", SPI2->CR1);
@@ -148,39 +198,30 @@ void w5500_spi_init(void)
     HAL_SPI_TransmitReceive(&hspi2, &tx, &rx, 1, 1000);
     HAL_GPIO_WritePin(W5500_CS_GPIO_Port, W5500_CS_Pin, GPIO_PIN_SET);
     printf("Raw SPI test done, RX = 0x%02X\n", rx);
-
-    ///////////////////////////////////////////////////////////////////////////////////////////////////
-        // Optionally version read
-    uint8_t ver, hdr[3] = {0x00, 0x39, 0x80}; // Addr high, Addr low, Read control byte
-
-    HAL_GPIO_WritePin(W5500_CS_GPIO_Port, W5500_CS_Pin, GPIO_PIN_RESET);
-    HAL_SPI_Transmit(&hspi2, hdr, 3, HAL_MAX_DELAY);
-    HAL_SPI_Receive(&hspi2, &ver, 1, HAL_MAX_DELAY);
-    HAL_GPIO_WritePin(W5500_CS_GPIO_Port, W5500_CS_Pin, GPIO_PIN_SET);
-
-    printf("W5500 VERSIONR: 0x%02X\n", ver);
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-    // 7️⃣ Continue with W5500-specific initialization
-    printf("\n=== W5500 Hardware Initialization ===\n");
-    printf("Resetting W5500...\n");
-    w5500_spi_reset();
-    osDelay(10);
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
-    printf("Registering chip select callbacks...\n");
+    // Callbacks first: the readiness poll below goes through the ioLibrary
+    BOOT_LOG("Registering W5500 callbacks...\n");
     reg_wizchip_cs_cbfunc(w5500_cs_select, w5500_cs_deselect);
-
-    printf("Registering SPI byte read/write callbacks...\n");
+    reg_wizchip_cris_cbfunc(w5500_cris_enter, w5500_cris_exit);
     reg_wizchip_spi_cbfunc(w5500_spi_read, w5500_spi_write);
-
-    printf("Registering SPI burst read/write callbacks...\n");
     reg_wizchip_spiburst_cbfunc(w5500_spi_readburst, w5500_spi_writeburst);
 
-    printf("Finished callbacks registeration...\n");
 ///////////////////////////////////////////////////////////////////////////////////////////////////
+    if (!w5500_reset_released) {
+        BOOT_LOG("Resetting W5500...\n");
+        w5500_spi_reset_pulse();
+    }
+    if (!w5500_spi_wait_ready(W5500_READY_TIMEOUT_MS)) {
+        printf("ERROR: W5500 not answering (VERSIONR 0x%02X)\n", getVERSIONR());
+        return false;
+    }
+    BOOT_LOG("W5500 VERSIONR: 0x%02X\n", getVERSIONR());
+    boot_prof_mark(BOOT_PHASE_W5500_READY);
 
-    printf("Initializing socket buffers...\n");
+///////////////////////////////////////////////////////////////////////////////////////////////////
+    BOOT_LOG("Initializing socket buffers...\n");
     // Use centralized buffer configuration from eth_config.h
     uint8_t rx_tx_buff_sizes[ETH_CONFIG_TOTAL_BUFFERS];
     for (int i = 0; i < ETH_CONFIG_TOTAL_BUFFERS; i++) {
@@ -189,14 +230,38 @@ void w5500_spi_init(void)
     if (wizchip_init(rx_tx_buff_sizes, rx_tx_buff_sizes) != 0)
     {
         printf("ERROR: wizchip_init() failed! Aborting.\n");
-        //Error_Handler();
+        return false;
     }
 
-    printf("Applying static network configuration...\n");
+    BOOT_LOG("Applying static network configuration...\n");
     eth_config_init_static();
     eth_config_set_netinfo(&g_network_info);
+    boot_prof_mark(BOOT_PHASE_NET_CONFIG);
+
+    BOOT_LOG("=== W5500 Initialization Complete ===\n");
+    return true;
+}
 
-    printf("=== W5500 Initialization Complete ===\n");
+/**
+ * @brief Poll VERSIONR until the chip answers
+ * @note  The W5500 needs up to 1 ms after RSTn rises for its PLL to lock;
+ *        reads before that return garbage, so poll instead of waiting blindly
+ */
+bool w5500_spi_wait_ready(uint32_t timeout_ms)
+{
+    uint32_t start = HAL_GetTick();
+    while (w5500_reg_get_versionr() != W5500_VERSION) {
+        if ((HAL_GetTick() - start) >= timeout_ms) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief PHY link status (PHYCFGR.LNK)
+ */
+bool w5500_spi_link_up(void)
+{
+    return (w5500_reg_get_phycfgr() & PHYCFGR_LNK_ON) != 0;
 }
 
 
@@ -223,19 +288,49 @@ void w5500_spi_init(void)
  * Functions to reset the chip and verify hardware status
  * ==========================================================================*/
 
+/**
+ * @brief Hold RSTn low for the minimum reset pulse, then release it
+ * @note  Busy-waits on the DWT counter so it also works before the scheduler
+ */
+static void w5500_spi_reset_pulse(void)
+{
+	HAL_GPIO_WritePin(W5500_RST_GPIO_Port, W5500_RST_Pin, GPIO_PIN_RESET);
+	w5500_spi_reset_release();
+}
+
+/**
+ * @brief Release RSTn once it has been low for W5500_RESET_PULSE_US
+ *
+ * @details MX_GPIO_Init() drives RSTn low as its initial level, so main()
+ *          calls this after the other peripherals are initialized: the
+ *          reset pulse overlaps their init, and the PLL lock and PHY
+ *          auto-negotiation overlap the scheduler start. The full pulse is
+ *          still timed from here since MX_GPIO_Init() leaves no timestamp.
+ */
+void w5500_spi_reset_release(void)
+{
+	dwt_cycles_init();
+	uint32_t start = dwt_cycles_now();
+	uint32_t pulse = W5500_RESET_PULSE_US * (SystemCoreClock / 1000000U);
+	while ((dwt_cycles_now() - start) < pulse) {
+	}
+	HAL_GPIO_WritePin(W5500_RST_GPIO_Port, W5500_RST_Pin, GPIO_PIN_SET);
+	w5500_reset_released = true;
+}
+
 /**
  * @brief Restart the W5500 hardware
  * 
- * @details Performs a hardware reset by toggling the reset pin
- *          Can be called to recover from error conditions
+ * @details Performs a hardware reset by toggling the reset pin and waits
+ *          until the chip answers again. Can be called to recover from
+ *          error conditions
  * 
+ * @return true if the chip answered within W5500_READY_TIMEOUT_MS
  */
-void w5500_spi_reset(void)
+bool w5500_spi_reset(void)
 {
-	HAL_GPIO_WritePin(W5500_RST_GPIO_Port, W5500_RST_Pin, GPIO_PIN_RESET);
-	osDelay(10); // At least 1ms = safe for PMODE latching
-	HAL_GPIO_WritePin(W5500_RST_GPIO_Port, W5500_RST_Pin, GPIO_PIN_SET);
-	osDelay(10); // Wait for internal init
+	w5500_spi_reset_pulse();
+	return w5500_spi_wait_ready(W5500_READY_TIMEOUT_MS);
 }
 
 
@@ -17,7 +17,12 @@
 #ifndef _W5500_SPI_H_
 #define _W5500_SPI_H_
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
 #include <cmsis_os2.h>
@@ -42,6 +47,8 @@
 #define W5500_CS_Pin         GPIO_PIN_12
 #define W5500_CS_GPIO_Port   GPIOB
 
+#define W5500_SPI_INSTANCE   SPI2
+
 /* Note: _WIZCHIP_ and _WIZCHIP_IO_MODE_ are now centralized in eth_config.h */
 
 
@@ -81,26 +88,60 @@ uint8_t w5500_spi_read(void);
 void w5500_spi_writeburst(uint8_t* pBuf, uint16_t len);
 void w5500_spi_write(uint8_t byte);
 
+/**
+ * @brief Start a burst on the SPI2 DMA channels and return
+ * @note  CS stays low; finish with w5500_spi_burst_wait() before the next
+ *        SPI access
+ */
+void w5500_spi_readburst_start(uint8_t* pBuf, uint16_t len);
+void w5500_spi_writeburst_start(const uint8_t* pBuf, uint16_t len);
+void w5500_spi_burst_wait(void);
+
+/**
+ * @brief Enter/exit the W5500 critical section (scheduler lock)
+ * @note  Registered with the ioLibrary so SPI frames from different tasks
+ *        never interleave
+ */
+void w5500_cris_enter(void);
+void w5500_cris_exit(void);
+
 
 /**
  * @brief Initialize the W5500 hardware and network settings
  * 
- * @details Sets up the W5500 Ethernet controller with the provided network
- *          configuration. This function handles:
- *          - SPI interface initialization
- *          - W5500 hardware reset sequence
- *          - Chip initialization and verification
- *          - Network parameters configuration
+ * @details Sets up the W5500 Ethernet controller with the static network
+ *          configuration from eth_config.h. This function handles:
+ *          - SPI callback registration
+ *          - W5500 hardware reset, unless w5500_spi_reset_release() ran
+ *          - Readiness polling (VERSIONR)
  *          - Socket buffer allocation
+ *          - Network parameters configuration
  * 
- * @param spi_handle Pointer to STM32 HAL SPI handle for W5500 communication
- * @param mac MAC address for the W5500 (6 bytes)
- * @param ip IP address for the local device (4 bytes)
- * @param subnet Subnet mask (4 bytes)
- * @param gateway Gateway IP address (4 bytes)
  * @return true if initialization successful, false otherwise
  */
- void w5500_spi_init(void);
+bool w5500_spi_init(void);
+
+/**
+ * @brief Release the W5500 from the reset MX_GPIO_Init() holds it in
+ * 
+ * @details Called from main() before the scheduler starts, so the chip's
+ *          PLL lock and PHY auto-negotiation run in parallel with the rest
+ *          of the boot. Enforces the minimum reset pulse width.
+ */
+void w5500_spi_reset_release(void);
+
+/**
+ * @brief Poll until the W5500 answers on SPI (VERSIONR)
+ * @param timeout_ms Give up after this many milliseconds
+ * @return true if the chip answered
+ */
+bool w5500_spi_wait_ready(uint32_t timeout_ms);
+
+/**
+ * @brief PHY link status
+ * @return true once auto-negotiation has completed with a link partner
+ */
+bool w5500_spi_link_up(void);
 
 /**
  * @brief Restart the W5500 hardware
@@ -108,10 +149,12 @@ void w5500_spi_write(uint8_t byte);
  * @details Performs a hardware reset by toggling the reset pin
  *          Can be called to recover from error conditions
  * 
- * @return true if reset was successful
+ * @return true if the chip answered after the reset
  */
-void w5500_spi_reset(void);
-
+bool w5500_spi_reset(void);
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* _W5500_SPI_H_ */
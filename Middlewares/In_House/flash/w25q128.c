@@ -5,10 +5,32 @@
  * This driver provides the core functionality for interfacing with the W25Q128JVSIQ
  * SPI flash memory. It supports read, write, erase, and status operations with thread safety.
  * 
+ * Between accesses the flash is put into deep power-down (about 1 uA instead of
+ * the 10-50 uA standby current) after FLASH_DPD_IDLE_MS; FLASH_LOCK() wakes it.
+ * 
+ * A read leaves its READ command running: CS stays low and the next read that
+ * starts where it ended just clocks on, without opcode, address or CS edges.
+ * Sequential readers in small chunks (log replay, file streaming, sector
+ * copies) so run at the bus rate with no per-call command overhead. Any other
+ * command, a read elsewhere, or deep power-down ends the session first. The
+ * flash is alone on SPI1, so holding CS low blocks nobody.
+ * 
+ * w25q128_read_start() and w25q128_write_page_start() return while the
+ * transfer runs (a read on the SPI1 DMA channels, a program in the chip) and
+ * keep the lock until w25q128_xfer_wait(), so the caller can drive the other
+ * bus in between.
+ * 
  * @note All configuration parameters are centralized in flash_config.h
+ */
 
 #include "w25q128.h"
+#include "w25q128_wear.h"
 #include "../../../Core/Inc/flash_config.h"
+#include "../../../Core/Inc/dwt_cycles.h"
+#include "../../../Core/Inc/trace.h"
+#include "spi_pump.h"
+#include "spi_dma.h"
+#include <string.h>
 
 /* Thread safety protection */
 static osMutexId_t flash_mutex;
@@ -16,8 +38,49 @@ static const osMutexAttr_t flash_mutex_attr = {
     .name = "flashMutex"
 };
 
-#define FLASH_LOCK()   osMutexAcquire(flash_mutex, FLASH_MUTEX_TIMEOUT)
-#define FLASH_UNLOCK() osMutexRelease(flash_mutex)
+/* Deep power-down state. flash_active is read lock-free by w25q128_pre_sleep() */
+static volatile bool flash_active = false;
+static bool flash_powered_down = false;
+static uint32_t flash_last_ms = 0;          /* End of the last access */
+static uint32_t flash_down_ms = 0;          /* Entry into deep power-down */
+static w25q128_power_stats_t flash_power;
+
+/* Open READ session: CS low, the chip will next return flash_read_next */
+static bool flash_read_open = false;
+static uint32_t flash_read_next = 0;
+static w25q128_read_stats_t flash_read_stats;
+
+/* Split-phase transfer holding the lock until w25q128_xfer_wait() */
+typedef enum {
+    FLASH_XFER_NONE = 0,
+    FLASH_XFER_READ,
+    FLASH_XFER_PROGRAM
+} flash_xfer_t;
+static flash_xfer_t flash_xfer = FLASH_XFER_NONE;
+
+/* Geometry, from SFDP or the JEDEC ID at init */
+static uint32_t flash_size = W25_FLASH_SIZE;
+static uint8_t flash_addr_bytes = 3;
+
+static void w25q128_wake(void);
+
+static inline void w25q128_read_end(void) {
+    if (flash_read_open) {
+        W25_CS_HIGH();
+        flash_read_open = false;
+    }
+}
+
+/* FLASH_LOCK_READ() leaves an open read session for w25q128_read_bytes() to continue */
+#define FLASH_LOCK_READ() do { \
+        TRACE_SPAN_BEGIN(TRACE_SPAN_FLASH_LOCK, 0); \
+        osMutexAcquire(flash_mutex, FLASH_MUTEX_TIMEOUT); \
+        TRACE_SPAN_END(TRACE_SPAN_FLASH_LOCK, 0); \
+        flash_active = true; \
+        w25q128_wake(); \
+    } while (0)
+#define FLASH_LOCK()   do { FLASH_LOCK_READ(); w25q128_read_end(); } while (0)
+#define FLASH_UNLOCK() do { flash_last_ms = HAL_GetTick(); flash_active = false; osMutexRelease(flash_mutex); } while (0)
 
 /* Use standardized timeouts from central configuration */
 
@@ -27,97 +90,309 @@ static const osMutexAttr_t flash_mutex_attr = {
 static void w25q128_write_enable(void) {
     uint8_t cmd = W25_CMD_WRITE_ENABLE;
     W25_CS_LOW();
-    HAL_SPI_Transmit(&W25_SPI_HANDLE, &cmd, 1, HAL_MAX_DELAY);
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, &cmd, NULL, 1);
     W25_CS_HIGH();
 }
 
+/**
+ * @brief Leave deep power-down, waiting out tRES1 (caller holds the lock)
+ */
+static void w25q128_wake(void) {
+    if (!flash_powered_down) return;
+
+    uint8_t cmd = W25_CMD_RELEASE_POWER_DOWN;
+    uint32_t start = dwt_cycles_now();
+    W25_CS_LOW();
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, &cmd, NULL, 1);
+    W25_CS_HIGH();
+    uint32_t cs_high = dwt_cycles_now();
+    while (dwt_cycles_to_us(dwt_cycles_now() - cs_high) < W25_TRES1_US) {
+    }
+
+    uint32_t us = dwt_cycles_to_us(dwt_cycles_now() - start);
+    flash_powered_down = false;
+    flash_power.wakeups++;
+    flash_power.resume_us += us;
+    if (us > flash_power.resume_max_us) flash_power.resume_max_us = us;
+    flash_power.down_ms += HAL_GetTick() - flash_down_ms;
+}
+
+/**
+ * @brief Enter deep power-down (caller holds the lock or runs with the scheduler stopped)
+ */
+static void w25q128_power_down(void) {
+    uint8_t cmd = W25_CMD_POWER_DOWN;
+    w25q128_read_end();
+    W25_CS_LOW();
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, &cmd, NULL, 1);
+    W25_CS_HIGH();
+    /* tDP is shorter than any path back to FLASH_LOCK(), no wait needed */
+    flash_powered_down = true;
+    flash_down_ms = HAL_GetTick();
+    flash_power.power_downs++;
+}
+
+/**
+ * @brief Opcode and address for the detected address width
+ * @return Command length (4 or 5)
+ */
+static uint8_t w25q128_cmd_addr(uint8_t *cmd, uint8_t op_3b, uint8_t op_4b, uint32_t addr) {
+    uint8_t n = 0;
+    if (flash_addr_bytes == 4) {
+        cmd[n++] = op_4b;
+        cmd[n++] = (uint8_t)(addr >> 24);
+    } else {
+        cmd[n++] = op_3b;
+    }
+    cmd[n++] = (uint8_t)(addr >> 16);
+    cmd[n++] = (uint8_t)(addr >> 8);
+    cmd[n++] = (uint8_t)(addr >> 0);
+    return n;
+}
+
 bool w25q128_wait_ready(uint32_t timeout_ms) {
     uint8_t cmd = W25_CMD_READ_STATUS1;
     uint8_t status;
     uint32_t tickstart = HAL_GetTick();
 
+    w25q128_read_end();
+    TRACE_SPAN_BEGIN(TRACE_SPAN_FLASH_BUSY, 0);
     do {
         W25_CS_LOW();
-        HAL_SPI_Transmit(&W25_SPI_HANDLE, &cmd, 1, HAL_MAX_DELAY);
-        HAL_SPI_Receive(&W25_SPI_HANDLE, &status, 1, HAL_MAX_DELAY);
+        spi_pump_xfer(W25_SPI_HANDLE.Instance, &cmd, NULL, 1);
+        spi_pump_xfer(W25_SPI_HANDLE.Instance, NULL, &status, 1);
         W25_CS_HIGH();
 
-        if (!(status & W25_STATUS1_BUSY)) return true;
+        if (!(status & W25_STATUS1_BUSY)) break;
     } while ((HAL_GetTick() - tickstart) < timeout_ms);
+    TRACE_SPAN_END(TRACE_SPAN_FLASH_BUSY, 0);
 
-    return false;
+    return !(status & W25_STATUS1_BUSY);
 }
 
 bool w25q128_read_id(uint8_t *id_buf) {
     FLASH_LOCK();
     uint8_t cmd = W25_CMD_READ_ID;
-    uint8_t dummy[3] = {0};
     W25_CS_LOW();
-    HAL_SPI_Transmit(&W25_SPI_HANDLE, &cmd, 1, HAL_MAX_DELAY);
-    HAL_SPI_Transmit(&W25_SPI_HANDLE, dummy, 3, HAL_MAX_DELAY);
-    HAL_SPI_Receive(&W25_SPI_HANDLE, id_buf, 3, HAL_MAX_DELAY);
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, &cmd, NULL, 1);
+    /* 9Fh has no address or dummy phase: the ID follows the opcode */
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, NULL, id_buf, 3);
     W25_CS_HIGH();
     FLASH_UNLOCK();
     return true;
 }
 
+/**
+ * @brief Position the READ session at addr: continue it or send a new command
+ */
+static void w25q128_read_seek(uint32_t addr) {
+    if (!flash_read_open || addr != flash_read_next) {
+        w25q128_read_end();
+        uint8_t cmd[5];
+        uint8_t cmd_len = w25q128_cmd_addr(cmd, W25_CMD_READ_DATA, W25_CMD_READ_DATA_4B, addr);
+        W25_CS_LOW();
+        spi_pump_xfer(W25_SPI_HANDLE.Instance, cmd, NULL, cmd_len);
+        flash_read_open = true;
+        flash_read_stats.commands++;
+    } else {
+        flash_read_stats.continued++;
+    }
+}
+
 bool w25q128_read_bytes(uint32_t addr, uint8_t *buf, uint32_t len) {
-    FLASH_LOCK();
-    uint8_t cmd[4] = {
-        W25_CMD_READ_DATA,
-        (uint8_t)(addr >> 16),
-        (uint8_t)(addr >> 8),
-        (uint8_t)(addr >> 0),
-    };
-    W25_CS_LOW();
-    HAL_SPI_Transmit(&W25_SPI_HANDLE, cmd, 4, HAL_MAX_DELAY);
-    HAL_SPI_Receive(&W25_SPI_HANDLE, buf, len, HAL_MAX_DELAY);
-    W25_CS_HIGH();
+    FLASH_LOCK_READ();
+    w25q128_read_seek(addr);
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, NULL, buf, len);
+    /* The array wraps to 0 past the end; a new command costs no more there */
+    flash_read_next = addr + len;
+    if (flash_read_next >= flash_size) w25q128_read_end();
     FLASH_UNLOCK();
     return true;
 }
 
-bool w25q128_write_page(uint32_t addr, const uint8_t *data, uint32_t len) {
+bool w25q128_read_start(uint32_t addr, uint8_t *buf, uint16_t len) {
+    FLASH_LOCK_READ();
+    w25q128_read_seek(addr);
+    spi_dma_start(W25_SPI_HANDLE.Instance, NULL, buf, len);
+    flash_read_next = addr + len;
+    flash_xfer = FLASH_XFER_READ;
+    return true;
+}
+
+bool w25q128_write_page_start(uint32_t addr, const uint8_t *data, uint32_t len) {
     if (len > W25_PAGE_SIZE) return false;
     FLASH_LOCK();
     w25q128_write_enable();
-    uint8_t cmd[4] = {
-        W25_CMD_PAGE_PROGRAM,
-        (uint8_t)(addr >> 16),
-        (uint8_t)(addr >> 8),
-        (uint8_t)(addr >> 0),
-    };
+    uint8_t cmd[5];
+    uint8_t cmd_len = w25q128_cmd_addr(cmd, W25_CMD_PAGE_PROGRAM, W25_CMD_PAGE_PROGRAM_4B, addr);
     W25_CS_LOW();
-    HAL_SPI_Transmit(&W25_SPI_HANDLE, cmd, 4, HAL_MAX_DELAY);
-    HAL_SPI_Transmit(&W25_SPI_HANDLE, (uint8_t *)data, len, HAL_MAX_DELAY);
-    W25_CS_HIGH();
-    bool result = w25q128_wait_ready(FLASH_TIMEOUT_WRITE);
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, cmd, NULL, cmd_len);
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, data, NULL, len);
+    W25_CS_HIGH();                  /* Programming starts on this edge */
+    flash_xfer = FLASH_XFER_PROGRAM;
+    return true;
+}
+
+bool w25q128_xfer_wait(void) {
+    bool result = true;
+    switch (flash_xfer) {
+    case FLASH_XFER_READ:
+        spi_dma_wait(W25_SPI_HANDLE.Instance);
+        if (flash_read_next >= flash_size) w25q128_read_end();
+        break;
+    case FLASH_XFER_PROGRAM:
+        result = w25q128_wait_ready(FLASH_TIMEOUT_WRITE);
+        break;
+    default:
+        return false;               /* Nothing started, the lock is not ours */
+    }
+    flash_xfer = FLASH_XFER_NONE;
     FLASH_UNLOCK();
     return result;
 }
 
+bool w25q128_write_page(uint32_t addr, const uint8_t *data, uint32_t len) {
+    return w25q128_write_page_start(addr, data, len) && w25q128_xfer_wait();
+}
+
 bool w25q128_erase_sector(uint32_t addr) {
     FLASH_LOCK();
     w25q128_write_enable();
-    uint8_t cmd[4] = {
-        W25_CMD_SECTOR_ERASE,
+    uint8_t cmd[5];
+    uint8_t cmd_len = w25q128_cmd_addr(cmd, W25_CMD_SECTOR_ERASE, W25_CMD_SECTOR_ERASE_4B, addr);
+    W25_CS_LOW();
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, cmd, NULL, cmd_len);
+    W25_CS_HIGH();
+    bool result = w25q128_wait_ready(FLASH_TIMEOUT_ERASE);
+    FLASH_UNLOCK();
+    w25q128_wear_note(addr);        /* A failed erase has cycled the cells too */
+    return result;
+}
+
+/**
+ * @brief Read the SFDP area (5Ah: 3-byte address, one dummy byte)
+ */
+static void w25q128_read_sfdp(uint32_t addr, uint8_t *buf, uint16_t len) {
+    uint8_t cmd[5] = {
+        W25_CMD_READ_SFDP,
         (uint8_t)(addr >> 16),
         (uint8_t)(addr >> 8),
         (uint8_t)(addr >> 0),
+        0x00,
     };
+    FLASH_LOCK();
     W25_CS_LOW();
-    HAL_SPI_Transmit(&W25_SPI_HANDLE, cmd, 4, HAL_MAX_DELAY);
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, cmd, NULL, sizeof(cmd));
+    spi_pump_xfer(W25_SPI_HANDLE.Instance, NULL, buf, len);
     W25_CS_HIGH();
-    bool result = w25q128_wait_ready(FLASH_TIMEOUT_ERASE);
     FLASH_UNLOCK();
-    return result;
+}
+
+static uint32_t w25q128_get32le(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Capacity from the SFDP Basic Flash Parameter Table
+ * @return Bytes, 0 if the part has no usable SFDP
+ */
+static uint32_t w25q128_sfdp_size(void) {
+    uint8_t hdr[16];
+    w25q128_read_sfdp(0, hdr, sizeof(hdr));
+    /* Header, then the first parameter header: the mandatory BFPT (ID 0x00) */
+    if (w25q128_get32le(hdr) != W25_SFDP_SIGNATURE || hdr[8] != 0x00 || hdr[11] < 2) return 0;
+
+    uint8_t bfpt[8];
+    w25q128_read_sfdp(w25q128_get32le(&hdr[12]) & 0xFFFFFF, bfpt, sizeof(bfpt));
+    uint32_t density = w25q128_get32le(&bfpt[4]);
+    uint32_t size;
+    if (density & W25_SFDP_BFPT_DENSITY_POW2) {
+        uint32_t n = density & ~W25_SFDP_BFPT_DENSITY_POW2;
+        if (n < 3 || n > 34) return 0;
+        size = 1UL << (n - 3);
+    } else {
+        size = (density >> 3) + 1;                  /* Bits - 1 below 4 Gbit */
+    }
+    /* A 3-byte-only part cannot reach above 16 MB */
+    if (!(w25q128_get32le(bfpt) & W25_SFDP_BFPT_ADDR_MODE_MASK) && size > W25_3B_ADDR_LIMIT) {
+        size = W25_3B_ADDR_LIMIT;
+    }
+    return size;
+}
+
+/**
+ * @brief Capacity from the JEDEC ID capacity byte (Winbond coding)
+ */
+static uint32_t w25q128_jedec_size(const uint8_t *id) {
+    if (id[2] >= 0x10 && id[2] <= 0x19) return 1UL << id[2];        /* 0x18 = 16 MB, 0x19 = 32 MB */
+    if (id[2] >= 0x20 && id[2] <= 0x21) return 1UL << (id[2] - 6);  /* 0x20 = 64 MB (W25Q512) */
+    return 0;
+}
+
+uint32_t w25q128_get_size(void) {
+    return flash_size;
+}
+
+uint8_t w25q128_get_addr_bytes(void) {
+    return flash_addr_bytes;
+}
+
+void w25q128_power_poll(void) {
+#if FLASH_DPD_IDLE_MS > 0
+    if (flash_mutex == NULL || osMutexAcquire(flash_mutex, 0) != osOK) return;
+    if (!flash_powered_down && (HAL_GetTick() - flash_last_ms) >= FLASH_DPD_IDLE_MS) {
+        w25q128_power_down();
+    }
+    osMutexRelease(flash_mutex);
+#endif
+}
+
+void w25q128_pre_sleep(uint32_t expected_idle_ms) {
+#if FLASH_DPD_IDLE_MS > 0
+    /* Only the idle task gets here: any task inside FLASH_LOCK() would be ready */
+    if (flash_mutex == NULL || flash_active || flash_powered_down) return;
+    if ((HAL_GetTick() - flash_last_ms) + expected_idle_ms >= FLASH_DPD_IDLE_MS) {
+        w25q128_power_down();
+    }
+#else
+    (void)expected_idle_ms;
+#endif
+}
+
+void w25q128_get_power_stats(w25q128_power_stats_t *stats) {
+    *stats = flash_power;
+    stats->powered_down = flash_powered_down;
+}
+
+void w25q128_get_read_stats(w25q128_read_stats_t *stats) {
+    *stats = flash_read_stats;
 }
 
 bool w25q128_init(void) {
     flash_mutex = osMutexNew(&flash_mutex_attr);
     if (flash_mutex == NULL) return false;
+    dwt_cycles_init();
+
+    /* Release a deep power-down left over from before a warm reset */
+    W25_CS_HIGH();
+    flash_read_open = false;
+    flash_powered_down = true;
+    flash_down_ms = HAL_GetTick();
 
     uint8_t id[3];
-    return w25q128_read_id(id) && (id[0] == 0xEF); // Winbond JEDEC ID
+    bool ok = w25q128_read_id(id) && (id[0] == 0xEF); // Winbond JEDEC ID
+    if (ok) {
+        uint32_t size = w25q128_sfdp_size();
+        if (size == 0) size = w25q128_jedec_size(id);
+        if (size > W25_FLASH_SIZE_MAX) size = W25_FLASH_SIZE_MAX;   /* Beyond what the layout scales to */
+        ok = (size >= W25_FLASH_SIZE);                              /* Smaller parts do not hold the layout */
+        if (ok) {
+            flash_size = size;
+            flash_addr_bytes = (size > W25_3B_ADDR_LIMIT) ? 4 : 3;
+        }
+    }
+    memset(&flash_power, 0, sizeof(flash_power));
+    memset(&flash_read_stats, 0, sizeof(flash_read_stats));
+    return ok;
 }
     
\ No newline at end of file
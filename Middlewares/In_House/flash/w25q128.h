@@ -2,7 +2,11 @@
  * @file w25q128.h
  * @brief Driver for W25Q128JVSIQ external SPI flash
  *
- * @details Supports read, write, and sector erase using STM32 HAL SPI with CMSIS-RTOS2 mutex protection
+ * @details Supports read, write, and sector erase using STM32 HAL SPI with CMSIS-RTOS2 mutex protection.
+ *          The capacity is read from SFDP (JEDEC ID as fallback) at init, so
+ *          the same driver runs 32 and 64 MB parts of the family; those are
+ *          addressed with the 4-byte opcodes, which work whatever the
+ *          address mode bit says.
  */
 
 #ifndef W25Q128_H
@@ -26,17 +30,34 @@
 #define W25_CMD_WRITE_ENABLE         0x06
 #define W25_CMD_WRITE_DISABLE        0x04
 #define W25_CMD_READ_ID              0x9F
+#define W25_CMD_READ_SFDP            0x5A
+#define W25_CMD_READ_DATA_4B         0x13
+#define W25_CMD_PAGE_PROGRAM_4B      0x12
+#define W25_CMD_SECTOR_ERASE_4B      0x21
+#define W25_CMD_POWER_DOWN           0xB9
+#define W25_CMD_RELEASE_POWER_DOWN   0xAB
 
 /* Status Register Bits */
 #define W25_STATUS1_BUSY             0x01
 #define W25_STATUS1_WEL              0x02
 
+/* Deep power-down timing (datasheet maximums) */
+#define W25_TDP_US                   3          /* CS high after 0xB9 until power-down */
+#define W25_TRES1_US                 3          /* CS high after 0xAB until accessible */
+
 /* Flash Geometry */
 #define W25_PAGE_SIZE                256        /* 256 bytes per page */
 #define W25_SECTOR_SIZE              4096       /* 4KB sector size */
 #define W25_BLOCK32K_SIZE            0x8000     /* 32KB block size */
 #define W25_BLOCK64K_SIZE            0x10000    /* 64KB block size */
-#define W25_FLASH_SIZE               0x1000000  /* 16MB total capacity */
+#define W25_FLASH_SIZE               0x1000000  /* 16MB: W25Q128, smallest part the layout fits */
+#define W25_FLASH_SIZE_MAX           0x4000000  /* 64MB: W25Q512 */
+#define W25_3B_ADDR_LIMIT            0x1000000  /* Above this, 4-byte addresses */
+
+/* SFDP: header signature and Basic Flash Parameter Table fields */
+#define W25_SFDP_SIGNATURE           0x50444653 /* "SFDP" little-endian */
+#define W25_SFDP_BFPT_ADDR_MODE_MASK 0x00060000 /* DWORD1[18:17]: 0 = 3-byte only */
+#define W25_SFDP_BFPT_DENSITY_POW2   0x80000000 /* DWORD2[31]: density is 2^N bits */
 
 /* Expected JEDEC ID values */
 #define W25_MANUFACTURER_ID          0xEF       /* Winbond */
@@ -51,6 +72,20 @@ extern SPI_HandleTypeDef hspi1;
 #define W25_CS_LOW()                 HAL_GPIO_WritePin(W25_CS_GPIO_PORT, W25_CS_GPIO_PIN, GPIO_PIN_RESET)
 #define W25_CS_HIGH()                HAL_GPIO_WritePin(W25_CS_GPIO_PORT, W25_CS_GPIO_PIN, GPIO_PIN_SET)
 
+typedef struct {
+    bool     powered_down;      /**< In deep power-down now */
+    uint32_t power_downs;
+    uint32_t wakeups;
+    uint32_t resume_us;         /**< Total time spent waking (0xAB + tRES1) */
+    uint32_t resume_max_us;
+    uint32_t down_ms;           /**< Total time in deep power-down, up to the last wakeup */
+} w25q128_power_stats_t;
+
+typedef struct {
+    uint32_t commands;          /**< Reads that sent a READ command */
+    uint32_t continued;         /**< Reads that picked up where the last one ended */
+} w25q128_read_stats_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -61,6 +96,16 @@ extern "C" {
  */
 bool w25q128_init(void);
 
+/**
+ * @brief Detected capacity in bytes (W25_FLASH_SIZE before w25q128_init())
+ */
+uint32_t w25q128_get_size(void);
+
+/**
+ * @brief Address bytes sent with read, program and erase (3 or 4)
+ */
+uint8_t w25q128_get_addr_bytes(void);
+
 /**
  * @brief Read the flash JEDEC ID
  * @param id_buf Buffer to store the 3-byte ID (Manufacturer, Memory Type, Capacity)
@@ -77,6 +122,11 @@ bool w25q128_read_id(uint8_t *id_buf);
  */
 bool w25q128_read_bytes(uint32_t addr, uint8_t *buf, uint32_t len);
 
+/**
+ * @brief Read session counters since init
+ */
+void w25q128_get_read_stats(w25q128_read_stats_t *stats);
+
 /**
  * @brief Write data to a single page (max 256 bytes)
  * @param addr Start address to write to (should be page-aligned for best performance)
@@ -86,6 +136,26 @@ bool w25q128_read_bytes(uint32_t addr, uint8_t *buf, uint32_t len);
  */
 bool w25q128_write_page(uint32_t addr, const uint8_t *data, uint32_t len);
 
+/**
+ * @brief Start a read on the SPI1 DMA channels and return
+ * @note  Continues an open read session like w25q128_read_bytes(). The
+ *        driver stays locked until w25q128_xfer_wait(); buf is filled then.
+ */
+bool w25q128_read_start(uint32_t addr, uint8_t *buf, uint16_t len);
+
+/**
+ * @brief Send one page and return while the chip programs it
+ * @note  The driver stays locked until w25q128_xfer_wait()
+ */
+bool w25q128_write_page_start(uint32_t addr, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Finish the transfer started by w25q128_read_start() or
+ *        w25q128_write_page_start() and release the driver
+ * @return false if the program timed out or nothing was started
+ */
+bool w25q128_xfer_wait(void);
+
 /**
  * @brief Erase a 4KB sector
  * @param addr Address within the sector to erase
@@ -100,6 +170,24 @@ bool w25q128_erase_sector(uint32_t addr);
  */
 bool w25q128_wait_ready(uint32_t timeout_ms);
 
+/**
+ * @brief Enter deep power-down once the flash has been idle FLASH_DPD_IDLE_MS
+ * @note  Call periodically from a task. The next read, write or erase wakes
+ *        the flash first; the wakeup time is part of that call.
+ */
+void w25q128_power_poll(void);
+
+/**
+ * @brief Enter deep power-down ahead of a tickless sleep
+ * @param expected_idle_ms Sleep the kernel is about to enter
+ * @note  For configPRE_SLEEP_PROCESSING: lock-free, safe with interrupts masked.
+ *        Powers down if the idle time so far plus the sleep reaches
+ *        FLASH_DPD_IDLE_MS.
+ */
+void w25q128_pre_sleep(uint32_t expected_idle_ms);
+
+void w25q128_get_power_stats(w25q128_power_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,837 @@
+/**
+ * @file w25q128_fs.c
+ * @brief Power-loss-safe copy-on-write file store in the USER_DATA region
+ *
+ * RAM holds the superblock position, the directory pair and the allocator
+ * window; everything else is read from flash as needed. Open handles are
+ * kept on a list so the allocator never hands out a block an open reader or
+ * writer still uses.
+ */
+
+#include "w25q128_fs.h"
+#include "w25q128_remap.h"
+#include "w25q128_wear.h"
+#include "../../../Core/Inc/flash_config.h"
+#include "crc32.h"
+#include <string.h>
+
+#define FS_CHUNK            64      /* Read/program unit, divides the page size */
+#define FS_RECORD_SIZE      16      /* Superblock record */
+#define FS_SUPER_BLOCKS     2
+#define FS_PTRS_PER_INDEX   (FLASH_SECTOR_SIZE / 2)
+
+#define FS_BLOCKS           ((uint16_t)(USER_DATA_SIZE / FLASH_SECTOR_SIZE))
+#define FS_ADDR(b)          (USER_DATA_BASE_ADDR + (uint32_t)(b) * FLASH_SECTOR_SIZE)
+#define FS_ENTRY_ADDR(b, i) (FS_ADDR(b) + W25_FS_HEADER_SIZE + (uint32_t)(i) * W25_FS_ENTRY_SIZE)
+#define FS_BLOCKS_FOR(size) ((uint16_t)(((size) + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE))
+#define FS_WEAR_RUN         32      /* Erase counters read at once */
+#define FS_WEAR_SLACK       32      /* Erases a free block may lead the window's coldest by */
+
+/* Entry layout */
+#define FS_E_INDEX          22
+#define FS_E_SIZE           24
+#define FS_E_CRC            28
+
+static osMutexId_t fs_mutex;
+static const osMutexAttr_t fs_mutex_attr = {
+    .name = "fsMutex"
+};
+
+#define FS_LOCK()   osMutexAcquire(fs_mutex, FLASH_MUTEX_TIMEOUT)
+#define FS_UNLOCK() osMutexRelease(fs_mutex)
+
+static bool fs_mounted = false;
+static uint16_t fs_super_block = 0;     /* Superblock sector being appended to */
+static uint16_t fs_super_off = 0;       /* Next free record in it */
+static uint32_t fs_super_rev = 0;
+
+static uint16_t fs_dir[2];              /* Directory pair */
+static uint16_t fs_dir_cycles[2];       /* Erases of each while in the pair */
+static uint8_t  fs_dir_cur = 0;         /* Which of the pair is current */
+static uint32_t fs_dir_rev = 0;
+static uint16_t fs_dir_count = 0;
+
+static uint16_t fs_la_start = 0;        /* Allocator window */
+static uint16_t fs_la_next = 0;         /* Next block to try, relative to the window */
+static uint32_t fs_la_misses = 0;       /* Blocks tried since the last hit */
+static uint8_t  fs_la_bits[W25_FS_LOOKAHEAD / 8];
+
+static w25q128_file_t *fs_open_list = NULL;
+static uint32_t fs_commits = 0;
+static uint32_t fs_relocations = 0;
+
+static uint8_t fs_buf[FS_CHUNK];        /* Reads, copies and CRC passes */
+static uint8_t fs_wbuf[FS_CHUNK];       /* Directory snapshot being written */
+static uint8_t fs_entry[W25_FS_ENTRY_SIZE];     /* Entry read from the directory */
+static uint8_t fs_new[W25_FS_ENTRY_SIZE];       /* Entry being committed */
+
+static inline void fs_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void fs_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t fs_get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t fs_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool fs_is_erased(const uint8_t *p, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+/* Program across page boundaries */
+static bool fs_program(uint32_t addr, const uint8_t *data, uint32_t len) {
+    while (len) {
+        uint32_t chunk = FLASH_PROGRAM_PAGE_SIZE - (addr % FLASH_PROGRAM_PAGE_SIZE);
+        if (chunk > len) chunk = len;
+        if (!w25q128_remap_write_page(addr, data, chunk)) return false;
+        addr += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+static bool fs_erase(uint16_t block) {
+    return w25q128_remap_erase_sector(FS_ADDR(block));
+}
+
+static bool fs_name_valid(const char *name) {
+    size_t len = (name != NULL) ? strlen(name) : 0;
+    return len > 0 && len <= W25_FS_NAME_MAX;
+}
+
+static int fs_name_cmp(const char *name, const uint8_t *entry) {
+    return strncmp(name, (const char *)entry, W25_FS_NAME_MAX);
+}
+
+// ============================================================================
+// SUPERBLOCK
+// ============================================================================
+
+static bool fs_super_append(uint16_t dir0, uint16_t dir1) {
+    if (fs_super_off + FS_RECORD_SIZE > FLASH_SECTOR_SIZE) {
+        /* Full: continue in the other sector, the newest record stays readable meanwhile */
+        uint16_t other = (uint16_t)(fs_super_block ^ 1);
+        if (!fs_erase(other)) return false;
+        fs_super_block = other;
+        fs_super_off = 0;
+    }
+    uint8_t rec[FS_RECORD_SIZE];
+    fs_put32(&rec[0], W25_FS_SUPER_MAGIC);
+    fs_put32(&rec[4], fs_super_rev + 1);
+    fs_put16(&rec[8], dir0);
+    fs_put16(&rec[10], dir1);
+    fs_put32(&rec[12], crc32(rec, 12));
+
+    uint32_t addr = FS_ADDR(fs_super_block) + fs_super_off;
+    fs_super_off = (uint16_t)(fs_super_off + FS_RECORD_SIZE);  /* Torn records use up their slot */
+    if (!fs_program(addr, rec, sizeof(rec))) return false;
+    fs_super_rev++;
+    return true;
+}
+
+/**
+ * @brief Find the newest superblock record and the append position
+ */
+static bool fs_super_load(bool *found) {
+    *found = false;
+    for (uint16_t s = 0; s < FS_SUPER_BLOCKS; s++) {
+        uint16_t last_used = 0;
+        bool newest_here = false;
+        for (uint32_t off = 0; off < FLASH_SECTOR_SIZE; off += FS_CHUNK) {
+            if (!w25q128_remap_read(FS_ADDR(s) + off, fs_buf, FS_CHUNK)) return false;
+            for (uint16_t r = 0; r < FS_CHUNK; r += FS_RECORD_SIZE) {
+                const uint8_t *rec = &fs_buf[r];
+                if (fs_is_erased(rec, FS_RECORD_SIZE)) continue;
+                last_used = (uint16_t)(off + r + FS_RECORD_SIZE);
+                if (fs_get32(&rec[0]) != W25_FS_SUPER_MAGIC || fs_get32(&rec[12]) != crc32(rec, 12)) continue;
+                uint32_t rev = fs_get32(&rec[4]);
+                if (!*found || (int32_t)(rev - fs_super_rev) > 0) {
+                    *found = true;
+                    newest_here = true;
+                    fs_super_rev = rev;
+                    fs_dir[0] = fs_get16(&rec[8]);
+                    fs_dir[1] = fs_get16(&rec[10]);
+                }
+            }
+        }
+        if (newest_here) {
+            fs_super_block = s;
+            fs_super_off = last_used;
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// DIRECTORY
+// ============================================================================
+
+/**
+ * @brief Check a directory block; fills rev, count and cycles when valid
+ */
+static bool fs_dir_check(uint16_t block, uint32_t *rev, uint16_t *count, uint16_t *cycles) {
+    uint8_t head[W25_FS_HEADER_SIZE];
+    if (block >= FS_BLOCKS || !w25q128_remap_read(FS_ADDR(block), head, sizeof(head))) return false;
+    uint16_t n = fs_get16(&head[8]);
+    if (fs_get32(&head[0]) != W25_FS_DIR_MAGIC || n > W25_FS_MAX_FILES) return false;
+
+    uint32_t crc = CRC32_INIT;
+    uint32_t len = (uint32_t)n * W25_FS_ENTRY_SIZE;
+    for (uint32_t off = 0; off < len; off += FS_CHUNK) {
+        uint32_t chunk = (len - off < FS_CHUNK) ? len - off : FS_CHUNK;
+        if (!w25q128_remap_read(FS_ENTRY_ADDR(block, 0) + off, fs_buf, chunk)) return false;
+        crc = crc32_update(crc, fs_buf, chunk);
+    }
+    crc = crc32_update(crc, head, 12) ^ 0xFFFFFFFFUL;
+    if (crc != fs_get32(&head[12])) return false;
+
+    *rev = fs_get32(&head[4]);
+    *count = n;
+    *cycles = fs_get16(&head[10]);
+    return true;
+}
+
+static bool fs_dir_load(void) {
+    uint32_t rev[2];
+    uint16_t count[2];
+    bool valid[2];
+    for (uint8_t i = 0; i < 2; i++) {
+        fs_dir_cycles[i] = 0;
+        valid[i] = fs_dir_check(fs_dir[i], &rev[i], &count[i], &fs_dir_cycles[i]);
+    }
+    if (!valid[0] && !valid[1]) return false;
+
+    fs_dir_cur = (valid[1] && (!valid[0] || (int32_t)(rev[1] - rev[0]) > 0)) ? 1 : 0;
+    fs_dir_rev = rev[fs_dir_cur];
+    fs_dir_count = count[fs_dir_cur];
+    /* A torn block keeps the erase count of its partner, close enough for wear */
+    if (!valid[fs_dir_cur ^ 1]) fs_dir_cycles[fs_dir_cur ^ 1] = fs_dir_cycles[fs_dir_cur];
+    return true;
+}
+
+static bool fs_entry_read(uint16_t i) {
+    return w25q128_remap_read(FS_ENTRY_ADDR(fs_dir[fs_dir_cur], i), fs_entry, W25_FS_ENTRY_SIZE);
+}
+
+/**
+ * @brief Binary search; on return *pos is the match or the insertion point
+ * @return true if found (fs_entry holds it)
+ */
+static bool fs_find(const char *name, uint16_t *pos, flash_status_t *status) {
+    uint16_t lo = 0, hi = fs_dir_count;
+    *status = FLASH_STATUS_OK;
+    while (lo < hi) {
+        uint16_t mid = (uint16_t)((lo + hi) / 2);
+        if (!fs_entry_read(mid)) {
+            *status = FLASH_STATUS_ERROR;
+            return false;
+        }
+        int cmp = fs_name_cmp(name, fs_entry);
+        if (cmp == 0) {
+            *pos = mid;
+            return true;
+        }
+        if (cmp < 0) hi = mid; else lo = (uint16_t)(mid + 1);
+    }
+    *pos = lo;
+    return false;
+}
+
+/* Snapshot writer: collects bytes into program chunks aligned to FS_CHUNK */
+static uint32_t fs_w_addr;      /* Block base */
+static uint16_t fs_w_start;     /* Offset of the first unflushed byte */
+static uint16_t fs_w_off;       /* Next offset */
+static uint32_t fs_w_crc;
+
+static bool fs_w_flush(void) {
+    if (fs_w_off == fs_w_start) return true;
+    bool ok = fs_program(fs_w_addr + fs_w_start, &fs_wbuf[fs_w_start % FS_CHUNK], (uint32_t)(fs_w_off - fs_w_start));
+    fs_w_start = fs_w_off;
+    return ok;
+}
+
+static bool fs_w_put(const uint8_t *data, uint16_t len) {
+    fs_w_crc = crc32_update(fs_w_crc, data, len);
+    while (len) {
+        uint16_t room = (uint16_t)(FS_CHUNK - (fs_w_off % FS_CHUNK));
+        uint16_t chunk = (len < room) ? len : room;
+        memcpy(&fs_wbuf[fs_w_off % FS_CHUNK], data, chunk);
+        fs_w_off = (uint16_t)(fs_w_off + chunk);
+        data += chunk;
+        len = (uint16_t)(len - chunk);
+        if ((fs_w_off % FS_CHUNK) == 0 && !fs_w_flush()) return false;
+    }
+    return true;
+}
+
+static flash_status_t fs_alloc(uint16_t *block);
+
+/**
+ * @brief Write a new directory snapshot: fs_new inserted or replacing its
+ *        name, or the entry named remove dropped
+ *
+ * Goes to the older block of the pair, or to a new block once that one has
+ * used up its cycles. The header goes last, so until it is written the
+ * current snapshot stays the newest valid one.
+ */
+static flash_status_t fs_commit(const char *remove) {
+    /* The open check counted the directory as it was then: another writer
+     * may have added a name since */
+    if (remove == NULL && fs_dir_count >= W25_FS_MAX_FILES) {
+        uint16_t pos;
+        flash_status_t st;
+        if (!fs_find((const char *)fs_new, &pos, &st)) return (st == FLASH_STATUS_OK) ? FLASH_STATUS_NO_MEMORY : st;
+    }
+
+    uint8_t old = (uint8_t)(fs_dir_cur ^ 1);
+    uint16_t target = fs_dir[old];
+    uint16_t cycles = (uint16_t)(fs_dir_cycles[old] + 1);
+    bool relocate = cycles > W25_FS_BLOCK_CYCLES;
+    if (relocate) {
+        flash_status_t st = fs_alloc(&target);
+        if (st != FLASH_STATUS_OK) return st;
+        cycles = 1;
+    }
+    if (!fs_erase(target)) return FLASH_STATUS_ERROR;
+
+    const char *name = (remove != NULL) ? remove : (const char *)fs_new;
+    fs_w_addr = FS_ADDR(target);
+    fs_w_start = fs_w_off = W25_FS_HEADER_SIZE;
+    fs_w_crc = CRC32_INIT;
+    uint16_t count = 0;
+    bool placed = (remove != NULL);
+    for (uint16_t i = 0; i < fs_dir_count; i++) {
+        if (!fs_entry_read(i)) return FLASH_STATUS_ERROR;
+        int cmp = strncmp(name, (const char *)fs_entry, W25_FS_NAME_MAX);
+        if (!placed && cmp <= 0) {
+            if (!fs_w_put(fs_new, W25_FS_ENTRY_SIZE)) return FLASH_STATUS_ERROR;
+            count++;
+            placed = true;
+        }
+        if (cmp == 0) continue;     /* Replaced or removed */
+        if (!fs_w_put(fs_entry, W25_FS_ENTRY_SIZE)) return FLASH_STATUS_ERROR;
+        count++;
+    }
+    if (!placed) {
+        if (!fs_w_put(fs_new, W25_FS_ENTRY_SIZE)) return FLASH_STATUS_ERROR;
+        count++;
+    }
+    if (!fs_w_flush()) return FLASH_STATUS_ERROR;
+
+    uint8_t head[W25_FS_HEADER_SIZE];
+    fs_put32(&head[0], W25_FS_DIR_MAGIC);
+    fs_put32(&head[4], fs_dir_rev + 1);
+    fs_put16(&head[8], count);
+    fs_put16(&head[10], cycles);
+    fs_put32(&head[12], crc32_update(fs_w_crc, head, 12) ^ 0xFFFFFFFFUL);
+    if (!fs_program(FS_ADDR(target), head, sizeof(head))) return FLASH_STATUS_ERROR;
+
+    if (relocate) {
+        uint16_t cur = fs_dir[fs_dir_cur];
+        if (!fs_super_append(target, cur)) return FLASH_STATUS_ERROR;
+        fs_dir[0] = target;
+        fs_dir[1] = cur;
+        fs_dir_cycles[1] = fs_dir_cycles[fs_dir_cur];
+        old = 0;
+        fs_relocations++;
+    } else {
+        fs_dir[old] = target;
+    }
+    fs_dir_cycles[old] = cycles;
+    fs_dir_cur = old;
+    fs_dir_rev++;
+    fs_dir_count = count;
+    fs_commits++;
+    return FLASH_STATUS_OK;
+}
+
+// ============================================================================
+// ALLOCATOR
+// ============================================================================
+
+static void fs_la_mark(uint16_t block) {
+    uint16_t rel = (uint16_t)((block + FS_BLOCKS - fs_la_start) % FS_BLOCKS);
+    if (rel < W25_FS_LOOKAHEAD) fs_la_bits[rel / 8] |= (uint8_t)(1U << (rel % 8));
+}
+
+/**
+ * @brief Mark an index block and the data blocks it lists (up to max or the first hole)
+ */
+static bool fs_la_mark_file(uint16_t index, uint16_t max) {
+    if (index >= FS_BLOCKS) return true;        /* Handle still being opened */
+    fs_la_mark(index);
+    for (uint16_t i = 0; i < max; i += FS_CHUNK / 2) {
+        if (!w25q128_remap_read(FS_ADDR(index) + (uint32_t)i * 2, fs_buf, FS_CHUNK)) return false;
+        for (uint16_t j = 0; j < FS_CHUNK / 2 && i + j < max; j++) {
+            uint16_t b = fs_get16(&fs_buf[j * 2]);
+            if (b >= FS_BLOCKS) return true;
+            fs_la_mark(b);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Pass over free blocks in the window worn well past its coldest
+ *
+ * Static wear leveling on top of the walk: cold blocks are taken first, and
+ * the skipped ones come round again with the next window. Counters are
+ * looked up by logical address, so a remapped block reads its old sector's.
+ */
+static void fs_la_skip_hot(void) {
+    static uint32_t counts[FS_WEAR_RUN];
+    uint16_t window = (FS_BLOCKS < W25_FS_LOOKAHEAD) ? FS_BLOCKS : W25_FS_LOOKAHEAD;
+    uint32_t coldest = 0xFFFFFFFFUL;
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        for (uint16_t rel = 0; rel < window;) {
+            uint16_t block = (uint16_t)((fs_la_start + rel) % FS_BLOCKS);
+            uint16_t run = FS_WEAR_RUN;
+            if (run > window - rel) run = (uint16_t)(window - rel);
+            if (run > FS_BLOCKS - block) run = (uint16_t)(FS_BLOCKS - block);
+            if (!w25q128_wear_read(FS_ADDR(block), counts, run)) return;
+            for (uint16_t k = 0; k < run; k++, rel++) {
+                if (fs_la_bits[rel / 8] & (1U << (rel % 8))) continue;
+                if (pass == 0 && counts[k] < coldest) coldest = counts[k];
+                if (pass == 1 && counts[k] > coldest + FS_WEAR_SLACK) fs_la_bits[rel / 8] |= (uint8_t)(1U << (rel % 8));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Fill the window bitmap with every block in use
+ */
+static bool fs_la_scan(void) {
+    memset(fs_la_bits, 0, sizeof(fs_la_bits));
+    for (uint16_t s = 0; s < FS_SUPER_BLOCKS; s++) fs_la_mark(s);
+    fs_la_mark(fs_dir[0]);
+    fs_la_mark(fs_dir[1]);
+    for (uint16_t i = 0; i < fs_dir_count; i++) {
+        if (!fs_entry_read(i)) return false;
+        if (!fs_la_mark_file(fs_get16(&fs_entry[FS_E_INDEX]), FS_BLOCKS_FOR(fs_get32(&fs_entry[FS_E_SIZE])))) return false;
+    }
+    /* Open files still use their blocks, even ones a commit has just replaced */
+    for (w25q128_file_t *f = fs_open_list; f != NULL; f = f->next) {
+        if (!fs_la_mark_file(f->index, FS_PTRS_PER_INDEX)) return false;
+    }
+    fs_la_skip_hot();
+    return true;
+}
+
+static flash_status_t fs_alloc(uint16_t *block) {
+    uint16_t window = (FS_BLOCKS < W25_FS_LOOKAHEAD) ? FS_BLOCKS : W25_FS_LOOKAHEAD;
+    while (fs_la_misses < FS_BLOCKS) {
+        if (fs_la_next >= window) {
+            fs_la_start = (uint16_t)((fs_la_start + window) % FS_BLOCKS);
+            fs_la_next = 0;
+            if (!fs_la_scan()) return FLASH_STATUS_ERROR;
+        }
+        uint16_t rel = fs_la_next++;
+        if (fs_la_bits[rel / 8] & (1U << (rel % 8))) {
+            fs_la_misses++;
+            continue;
+        }
+        fs_la_bits[rel / 8] |= (uint8_t)(1U << (rel % 8));
+        fs_la_misses = 0;
+        *block = (uint16_t)((fs_la_start + rel) % FS_BLOCKS);
+        return FLASH_STATUS_OK;
+    }
+    /* Rescan next time: blocks may have been freed */
+    fs_la_misses = 0;
+    fs_la_next = window;
+    return FLASH_STATUS_NO_MEMORY;
+}
+
+/**
+ * @brief Allocate and erase a block
+ * @note  Worn blocks are already swapped out below, so a failed erase means
+ *        the spares are gone or the chip is not answering
+ */
+static flash_status_t fs_alloc_erased(uint16_t *block) {
+    flash_status_t st = fs_alloc(block);
+    if (st == FLASH_STATUS_OK && !fs_erase(*block)) st = FLASH_STATUS_ERROR;
+    return st;
+}
+
+static void fs_la_reset(void) {
+    /* Start elsewhere on each boot so the low blocks do not take all the wear */
+    fs_la_start = (uint16_t)((fs_dir_rev * 2654435761UL) % FS_BLOCKS);
+    fs_la_next = 0;
+    fs_la_misses = 0;
+    fs_la_scan();
+}
+
+// ============================================================================
+// FILE HELPERS
+// ============================================================================
+
+static void fs_list_remove(w25q128_file_t *f) {
+    for (w25q128_file_t **p = &fs_open_list; *p != NULL; p = &(*p)->next) {
+        if (*p == f) {
+            *p = f->next;
+            break;
+        }
+    }
+    f->next = NULL;
+}
+
+static bool fs_set_ptr(uint16_t index, uint16_t n, uint16_t block) {
+    uint8_t p[2];
+    fs_put16(p, block);
+    return fs_program(FS_ADDR(index) + (uint32_t)n * 2, p, sizeof(p));
+}
+
+static bool fs_get_ptr(uint16_t index, uint16_t n, uint16_t *block) {
+    uint8_t p[2];
+    if (!w25q128_remap_read(FS_ADDR(index) + (uint32_t)n * 2, p, sizeof(p))) return false;
+    *block = fs_get16(p);
+    return *block < FS_BLOCKS;
+}
+
+/**
+ * @brief Start an append: copy the full blocks' pointers and the partial last block
+ * @note  old_index is from fs_entry; f->index is already allocated and erased
+ */
+static flash_status_t fs_append_copy(w25q128_file_t *f, uint16_t old_index) {
+    uint16_t full = (uint16_t)(f->size / FLASH_SECTOR_SIZE);
+    uint32_t tail = f->size % FLASH_SECTOR_SIZE;
+
+    for (uint16_t i = 0; i < full; i += FS_CHUNK / 2) {
+        uint16_t n = (uint16_t)(full - i);
+        if (n > FS_CHUNK / 2) n = FS_CHUNK / 2;
+        if (!w25q128_remap_read(FS_ADDR(old_index) + (uint32_t)i * 2, fs_buf, (uint32_t)n * 2) ||
+            !fs_program(FS_ADDR(f->index) + (uint32_t)i * 2, fs_buf, (uint32_t)n * 2)) {
+            return FLASH_STATUS_ERROR;
+        }
+    }
+    if (tail == 0) return FLASH_STATUS_OK;
+
+    uint16_t old_block, block;
+    if (!fs_get_ptr(old_index, full, &old_block)) return FLASH_STATUS_CRC_ERROR;
+    flash_status_t st = fs_alloc_erased(&block);
+    if (st != FLASH_STATUS_OK) return st;
+    if (!fs_set_ptr(f->index, full, block)) return FLASH_STATUS_ERROR;
+    for (uint32_t off = 0; off < tail; off += FS_CHUNK) {
+        uint32_t chunk = (tail - off < FS_CHUNK) ? tail - off : FS_CHUNK;
+        if (!w25q128_remap_read(FS_ADDR(old_block) + off, fs_buf, chunk) ||
+            !fs_program(FS_ADDR(block) + off, fs_buf, chunk)) {
+            return FLASH_STATUS_ERROR;
+        }
+    }
+    f->block = block;
+    f->block_no = full;
+    return FLASH_STATUS_OK;
+}
+
+static void fs_info_from_entry(w25q128_fs_info_t *info) {
+    memcpy(info->name, fs_entry, W25_FS_NAME_MAX);
+    info->name[W25_FS_NAME_MAX] = '\0';
+    info->size = fs_get32(&fs_entry[FS_E_SIZE]);
+    info->crc = fs_get32(&fs_entry[FS_E_CRC]);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+flash_status_t w25q128_fs_format(void) {
+    if (fs_mutex == NULL) {
+        fs_mutex = osMutexNew(&fs_mutex_attr);
+        if (fs_mutex == NULL) return FLASH_STATUS_NO_MEMORY;
+    }
+    FS_LOCK();
+    flash_status_t st = FLASH_STATUS_ERROR;
+    fs_mounted = false;
+    fs_open_list = NULL;
+
+    /* Both pair blocks go, or a stale snapshot with a higher rev would win */
+    bool ok = true;
+    for (uint16_t b = 0; b < FS_SUPER_BLOCKS + 2 && ok; b++) ok = fs_erase(b);
+    if (ok) {
+        uint8_t head[W25_FS_HEADER_SIZE];
+        fs_put32(&head[0], W25_FS_DIR_MAGIC);
+        fs_put32(&head[4], 1);
+        fs_put16(&head[8], 0);
+        fs_put16(&head[10], 1);
+        fs_put32(&head[12], crc32(head, 12));
+
+        fs_super_block = 0;
+        fs_super_off = 0;
+        fs_super_rev = 0;
+        if (fs_program(FS_ADDR(FS_SUPER_BLOCKS), head, sizeof(head)) &&
+            fs_super_append(FS_SUPER_BLOCKS, FS_SUPER_BLOCKS + 1)) {
+            fs_dir[0] = FS_SUPER_BLOCKS;
+            fs_dir[1] = FS_SUPER_BLOCKS + 1;
+            fs_dir_cycles[0] = fs_dir_cycles[1] = 1;
+            fs_dir_cur = 0;
+            fs_dir_rev = 1;
+            fs_dir_count = 0;
+            fs_la_reset();
+            fs_mounted = true;
+            st = FLASH_STATUS_OK;
+        }
+    }
+    FS_UNLOCK();
+    return st;
+}
+
+flash_status_t w25q128_fs_mount(bool format) {
+    if (fs_mutex == NULL) {
+        fs_mutex = osMutexNew(&fs_mutex_attr);
+        if (fs_mutex == NULL) return FLASH_STATUS_NO_MEMORY;
+    }
+    FS_LOCK();
+    fs_mounted = false;
+    fs_open_list = NULL;
+    fs_commits = 0;
+    fs_relocations = 0;
+
+    bool found;
+    flash_status_t st = FLASH_STATUS_OK;
+    if (!fs_super_load(&found)) {
+        st = FLASH_STATUS_ERROR;
+    } else if (!found) {
+        st = FLASH_STATUS_NOT_FOUND;
+    } else if (!fs_dir_load()) {
+        st = FLASH_STATUS_CRC_ERROR;
+    } else {
+        fs_la_reset();
+        fs_mounted = true;
+    }
+    FS_UNLOCK();
+
+    if (st == FLASH_STATUS_NOT_FOUND && format) st = w25q128_fs_format();
+    return st;
+}
+
+flash_status_t w25q128_fs_open(w25q128_file_t *f, const char *name, uint8_t mode) {
+    if (f == NULL || !fs_name_valid(name) ||
+        (mode != W25_FS_READ && mode != W25_FS_WRITE && mode != W25_FS_APPEND)) {
+        return FLASH_STATUS_INVALID_PARAM;
+    }
+    if (!fs_mounted) return FLASH_STATUS_ERROR;
+
+    FS_LOCK();
+    memset(f, 0, sizeof(*f));
+    memcpy(f->name, name, strlen(name));       /* NUL-padded by the memset */
+    f->index = W25_FS_NONE;
+    f->block = W25_FS_NONE;
+
+    uint16_t pos;
+    flash_status_t st;
+    bool found = fs_find(name, &pos, &st);
+    if (st != FLASH_STATUS_OK) {
+        FS_UNLOCK();
+        return st;
+    }
+
+    if (mode == W25_FS_READ) {
+        if (found) {
+            f->index = fs_get16(&fs_entry[FS_E_INDEX]);
+            f->size = fs_get32(&fs_entry[FS_E_SIZE]);
+            f->crc = fs_get32(&fs_entry[FS_E_CRC]);
+            f->mode = mode;
+            f->next = fs_open_list;
+            fs_open_list = f;
+        }
+        FS_UNLOCK();
+        return found ? FLASH_STATUS_OK : FLASH_STATUS_NOT_FOUND;
+    }
+
+    for (w25q128_file_t *o = fs_open_list; o != NULL; o = o->next) {
+        if (o->mode != W25_FS_READ && strncmp(o->name, f->name, W25_FS_NAME_MAX) == 0) {
+            FS_UNLOCK();
+            return FLASH_STATUS_BUSY;
+        }
+    }
+    if (!found && fs_dir_count >= W25_FS_MAX_FILES) {
+        FS_UNLOCK();
+        return FLASH_STATUS_NO_MEMORY;
+    }
+
+    uint16_t old_index = found ? fs_get16(&fs_entry[FS_E_INDEX]) : W25_FS_NONE;
+    f->crc = CRC32_INIT;
+    if (found && mode == W25_FS_APPEND) {
+        f->size = f->pos = fs_get32(&fs_entry[FS_E_SIZE]);
+        f->crc = fs_get32(&fs_entry[FS_E_CRC]) ^ 0xFFFFFFFFUL;
+    }
+
+    /* On the list before the first allocation, so a rescan sees its blocks */
+    f->mode = mode;
+    f->next = fs_open_list;
+    fs_open_list = f;
+    st = fs_alloc_erased(&f->index);
+    if (st == FLASH_STATUS_OK && f->size > 0) st = fs_append_copy(f, old_index);
+    if (st != FLASH_STATUS_OK) {
+        fs_list_remove(f);
+        f->mode = 0;
+    }
+    FS_UNLOCK();
+    return st;
+}
+
+int32_t w25q128_fs_read(w25q128_file_t *f, void *buf, uint32_t len) {
+    if (f == NULL || f->mode != W25_FS_READ || (buf == NULL && len > 0)) return FLASH_STATUS_INVALID_PARAM;
+    FS_LOCK();
+    uint8_t *out = buf;
+    uint32_t done = 0;
+    if (len > f->size - f->pos) len = f->size - f->pos;
+    while (done < len) {
+        uint16_t n = (uint16_t)(f->pos / FLASH_SECTOR_SIZE);
+        if (f->block == W25_FS_NONE || f->block_no != n) {
+            if (!fs_get_ptr(f->index, n, &f->block)) {
+                f->block = W25_FS_NONE;
+                FS_UNLOCK();
+                return FLASH_STATUS_CRC_ERROR;
+            }
+            f->block_no = n;
+        }
+        uint32_t off = f->pos % FLASH_SECTOR_SIZE;
+        uint32_t chunk = FLASH_SECTOR_SIZE - off;
+        if (chunk > len - done) chunk = len - done;
+        if (!w25q128_remap_read(FS_ADDR(f->block) + off, out + done, chunk)) {
+            FS_UNLOCK();
+            return FLASH_STATUS_ERROR;
+        }
+        f->pos += chunk;
+        done += chunk;
+    }
+    FS_UNLOCK();
+    return (int32_t)done;
+}
+
+int32_t w25q128_fs_write(w25q128_file_t *f, const void *data, uint32_t len) {
+    if (f == NULL || f->mode == W25_FS_READ || (data == NULL && len > 0)) return FLASH_STATUS_INVALID_PARAM;
+    if (len > W25_FS_MAX_FILE_SIZE - f->pos) return FLASH_STATUS_NO_MEMORY;
+    FS_LOCK();
+    const uint8_t *in = data;
+    uint32_t done = 0;
+    flash_status_t st = FLASH_STATUS_OK;
+    while (done < len) {
+        uint32_t off = f->pos % FLASH_SECTOR_SIZE;
+        if (off == 0) {
+            uint16_t block;
+            st = fs_alloc_erased(&block);
+            if (st != FLASH_STATUS_OK) break;
+            if (!fs_set_ptr(f->index, (uint16_t)(f->pos / FLASH_SECTOR_SIZE), block)) {
+                st = FLASH_STATUS_ERROR;
+                break;
+            }
+            f->block = block;
+            f->block_no = (uint16_t)(f->pos / FLASH_SECTOR_SIZE);
+        }
+        uint32_t chunk = FLASH_PROGRAM_PAGE_SIZE - (off % FLASH_PROGRAM_PAGE_SIZE);
+        if (chunk > len - done) chunk = len - done;
+        if (!w25q128_remap_write_page(FS_ADDR(f->block) + off, in + done, chunk)) {
+            st = FLASH_STATUS_ERROR;
+            break;
+        }
+        f->crc = crc32_update(f->crc, in + done, chunk);
+        f->pos += chunk;
+        f->size = f->pos;
+        done += chunk;
+    }
+    FS_UNLOCK();
+    return (done > 0 || st == FLASH_STATUS_OK) ? (int32_t)done : st;
+}
+
+flash_status_t w25q128_fs_seek(w25q128_file_t *f, uint32_t pos) {
+    if (f == NULL || f->mode != W25_FS_READ || pos > f->size) return FLASH_STATUS_INVALID_PARAM;
+    f->pos = pos;
+    return FLASH_STATUS_OK;
+}
+
+flash_status_t w25q128_fs_close(w25q128_file_t *f) {
+    if (f == NULL) return FLASH_STATUS_INVALID_PARAM;
+    FS_LOCK();
+    flash_status_t st = FLASH_STATUS_OK;
+    if (f->mode != W25_FS_READ) {
+        memset(fs_new, 0, sizeof(fs_new));
+        memcpy(fs_new, f->name, W25_FS_NAME_MAX);
+        fs_put16(&fs_new[FS_E_INDEX], f->index);
+        fs_put32(&fs_new[FS_E_SIZE], f->size);
+        fs_put32(&fs_new[FS_E_CRC], f->crc ^ 0xFFFFFFFFUL);
+        st = fs_commit(NULL);
+    }
+    fs_list_remove(f);
+    f->mode = 0;
+    FS_UNLOCK();
+    return st;
+}
+
+flash_status_t w25q128_fs_remove(const char *name) {
+    if (!fs_name_valid(name)) return FLASH_STATUS_INVALID_PARAM;
+    if (!fs_mounted) return FLASH_STATUS_ERROR;
+    FS_LOCK();
+    uint16_t pos;
+    flash_status_t st;
+    if (fs_find(name, &pos, &st)) {
+        st = fs_commit(name);
+    } else if (st == FLASH_STATUS_OK) {
+        st = FLASH_STATUS_NOT_FOUND;
+    }
+    FS_UNLOCK();
+    return st;
+}
+
+flash_status_t w25q128_fs_stat(const char *name, w25q128_fs_info_t *info) {
+    if (!fs_name_valid(name) || info == NULL) return FLASH_STATUS_INVALID_PARAM;
+    if (!fs_mounted) return FLASH_STATUS_ERROR;
+    FS_LOCK();
+    uint16_t pos;
+    flash_status_t st;
+    if (fs_find(name, &pos, &st)) {
+        fs_info_from_entry(info);
+    } else if (st == FLASH_STATUS_OK) {
+        st = FLASH_STATUS_NOT_FOUND;
+    }
+    FS_UNLOCK();
+    return st;
+}
+
+flash_status_t w25q128_fs_stat_index(uint16_t index, w25q128_fs_info_t *info) {
+    if (info == NULL) return FLASH_STATUS_INVALID_PARAM;
+    if (!fs_mounted) return FLASH_STATUS_ERROR;
+    FS_LOCK();
+    flash_status_t st = FLASH_STATUS_NOT_FOUND;
+    if (index < fs_dir_count) {
+        st = fs_entry_read(index) ? FLASH_STATUS_OK : FLASH_STATUS_ERROR;
+        if (st == FLASH_STATUS_OK) fs_info_from_entry(info);
+    }
+    FS_UNLOCK();
+    return st;
+}
+
+flash_status_t w25q128_fs_get_stats(w25q128_fs_stats_t *stats) {
+    if (stats == NULL) return FLASH_STATUS_INVALID_PARAM;
+    if (!fs_mounted) return FLASH_STATUS_ERROR;
+    FS_LOCK();
+    flash_status_t st = FLASH_STATUS_OK;
+    memset(stats, 0, sizeof(*stats));
+    stats->blocks_total = FS_BLOCKS;
+    stats->blocks_used = FS_SUPER_BLOCKS + 2;
+    for (uint16_t i = 0; i < fs_dir_count; i++) {
+        if (!fs_entry_read(i)) {
+            st = FLASH_STATUS_ERROR;
+            break;
+        }
+        stats->blocks_used = (uint16_t)(stats->blocks_used + 1 + FS_BLOCKS_FOR(fs_get32(&fs_entry[FS_E_SIZE])));
+    }
+    stats->files = fs_dir_count;
+    stats->dir_cycles = (fs_dir_cycles[0] > fs_dir_cycles[1]) ? fs_dir_cycles[0] : fs_dir_cycles[1];
+    stats->commits = fs_commits;
+    stats->relocations = fs_relocations;
+    FS_UNLOCK();
+    return st;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file w25q128_fs.h
+ * @brief Power-loss-safe copy-on-write file store in the USER_DATA region
+ *
+ * @details The region is split into 4KB blocks (block n at
+ *          USER_DATA_BASE_ADDR + n * FLASH_SECTOR_SIZE):
+ *
+ *          - Blocks 0 and 1, superblock: an append-only journal of 16-byte
+ *            records naming the current directory pair,
+ *              magic:u32 rev:u32 dir0:u16 dir1:u16 crc:u32
+ *          - Directory pair: two blocks, each a complete sorted snapshot of
+ *            up to W25_FS_MAX_FILES 32-byte entries behind a 16-byte header,
+ *              magic:u32 rev:u32 count:u16 cycles:u16 crc:u32
+ *              name[22] index:u16 size:u32 crc:u32
+ *            A commit writes the whole snapshot into the older block, header
+ *            last; the CRC covers entries and header. Mount takes the valid
+ *            block with the higher rev, so a commit either happened or did
+ *            not. Once a directory block has been erased W25_FS_BLOCK_CYCLES
+ *            times the pair moves to a freshly allocated block and a
+ *            superblock record is appended.
+ *          - File: an index block of u16 data block numbers (up to 8MB per
+ *            file), filled in as data is written, and the data blocks.
+ *
+ *          Writes never touch blocks the committed directory references:
+ *          a file opened for writing gets a new index block and new data
+ *          blocks (appending copies the index and the partial last block),
+ *          and only close() commits the entry. A power cut at any point
+ *          leaves every file as it was at its last close(). Blocks orphaned
+ *          by a cut or by a commit are simply found free again.
+ *
+ *          Free blocks are found with a W25_FS_LOOKAHEAD-block bitmap window
+ *          that walks round the region, starting from a point derived from
+ *          the directory revision: consecutive allocations, and consecutive
+ *          boots, spread writes over all free blocks (dynamic wear leveling).
+ *          Free blocks in the window that the erase counters (w25q128_wear.h)
+ *          show well ahead of its coldest are passed over until the next
+ *          round, so cold blocks are used first.
+ *
+ *          Opening a file is a binary search of the directory (O(log n)
+ *          flash reads); seeking is one index read. A handle is about 48
+ *          bytes and owns no buffers, so RAM use does not depend on file
+ *          size.
+ *
+ * @note  All flash access goes through w25q128_remap.h. Files cannot be
+ *        overwritten in place: open with W25_FS_WRITE (truncate) or
+ *        W25_FS_APPEND.
+ */
+
+#ifndef W25Q128_FS_H
+#define W25Q128_FS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../../Core/Inc/flash_config.h"
+
+#define W25_FS_SUPER_MAGIC          0x31534657  /* "WFS1" */
+#define W25_FS_DIR_MAGIC            0x44534657  /* "WFSD" */
+#define W25_FS_NAME_MAX             22          /* Bytes; NUL-padded, no terminator at full length */
+#define W25_FS_HEADER_SIZE          16
+#define W25_FS_ENTRY_SIZE           32
+#define W25_FS_MAX_FILES            ((FLASH_SECTOR_SIZE - W25_FS_HEADER_SIZE) / W25_FS_ENTRY_SIZE)    /* 127 */
+#define W25_FS_MAX_FILE_SIZE        ((FLASH_SECTOR_SIZE / 2) * FLASH_SECTOR_SIZE)                     /* 8MB */
+#define W25_FS_BLOCK_CYCLES         500         /* Directory block erases before the pair moves */
+#define W25_FS_LOOKAHEAD            256         /* Allocator window in blocks (one bit each) */
+#define W25_FS_NONE                 0xFFFF      /* No block */
+
+/* Open modes */
+#define W25_FS_READ                 0x01
+#define W25_FS_WRITE                0x02        /* Create or truncate */
+#define W25_FS_APPEND               0x04        /* Create or append */
+
+typedef struct w25q128_file {
+    struct w25q128_file *next;  /**< Open-handle list */
+    char     name[W25_FS_NAME_MAX];
+    uint8_t  mode;
+    uint8_t  reserved;
+    uint16_t index;             /**< Index block (new one while writing) */
+    uint16_t block;             /**< Data block at pos, W25_FS_NONE if not looked up */
+    uint16_t block_no;          /**< Which block of the file that is */
+    uint32_t size;
+    uint32_t pos;
+    uint32_t crc;               /**< Running CRC-32 of the contents (writers) */
+} w25q128_file_t;
+
+typedef struct {
+    char     name[W25_FS_NAME_MAX + 1];
+    uint32_t size;
+    uint32_t crc;               /**< CRC-32 of the contents */
+} w25q128_fs_info_t;
+
+typedef struct {
+    uint16_t blocks_total;
+    uint16_t blocks_used;       /**< Superblock, directory, index and data blocks */
+    uint16_t files;
+    uint16_t dir_cycles;        /**< Erases of the current directory block */
+    uint32_t commits;           /**< Since mount */
+    uint32_t relocations;       /**< Directory moves since mount */
+} w25q128_fs_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Mount the store, formatting it if no superblock is found and format is set
+ * @note  Call after w25q128_remap_init()
+ */
+flash_status_t w25q128_fs_mount(bool format);
+
+/**
+ * @brief Erase the metadata and start an empty store
+ */
+flash_status_t w25q128_fs_format(void);
+
+/**
+ * @brief Open a file
+ * @param mode W25_FS_READ, W25_FS_WRITE or W25_FS_APPEND
+ * @return FLASH_STATUS_NOT_FOUND for a missing file opened for reading,
+ *         FLASH_STATUS_BUSY if the file is already open for writing
+ */
+flash_status_t w25q128_fs_open(w25q128_file_t *f, const char *name, uint8_t mode);
+
+/**
+ * @return Bytes read (0 at end of file) or a negative flash_status_t
+ */
+int32_t w25q128_fs_read(w25q128_file_t *f, void *buf, uint32_t len);
+
+/**
+ * @return Bytes written or a negative flash_status_t
+ */
+int32_t w25q128_fs_write(w25q128_file_t *f, const void *data, uint32_t len);
+
+/**
+ * @brief Move the read position (readers only)
+ */
+flash_status_t w25q128_fs_seek(w25q128_file_t *f, uint32_t pos);
+
+/**
+ * @brief Close; for writers this commits the new contents
+ * @return FLASH_STATUS_NO_MEMORY if a new name no longer fits the directory
+ *         (other writers filled it since open); the file is not created
+ */
+flash_status_t w25q128_fs_close(w25q128_file_t *f);
+
+flash_status_t w25q128_fs_remove(const char *name);
+
+flash_status_t w25q128_fs_stat(const char *name, w25q128_fs_info_t *info);
+
+/**
+ * @brief Directory listing in name order
+ * @return FLASH_STATUS_NOT_FOUND past the last file
+ */
+flash_status_t w25q128_fs_stat_index(uint16_t index, w25q128_fs_info_t *info);
+
+/**
+ * @brief Usage counters (walks every file to count blocks)
+ */
+flash_status_t w25q128_fs_get_stats(w25q128_fs_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* W25Q128_FS_H */
@@ -0,0 +1,327 @@
+/**
+ * @file w25q128_log.c
+ * @brief Circular record log in the LOG region of the W25Q128
+ *
+ * Only the ring position (head/tail sector, write offset, sequence numbers)
+ * is kept in RAM; everything else is recovered from the flash at init. All
+ * access goes through w25q128_remap.h, so worn sectors are swapped out.
+ */
+
+#include "w25q128_log.h"
+#include "w25q128.h"
+#include "w25q128_remap.h"
+#include "../../../Core/Inc/flash_config.h"
+#include "crc32.h"
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#define LOG_CURSOR_ADDR     (LOG_BASE_ADDR)
+#define LOG_RING_ADDR       (LOG_BASE_ADDR + FLASH_SECTOR_SIZE)
+#define LOG_RING_SECTORS    ((uint16_t)(LOG_SIZE / FLASH_SECTOR_SIZE - 1))
+#define LOG_RECORD_MAX      (LOG_HEADER_SIZE + W25_LOG_MSG_MAX)
+#define LOG_CURSOR_ENTRY    8       /* seq:u32, ~seq:u32 */
+
+#define LOG_SECTOR_ADDR(s)  (LOG_RING_ADDR + (uint32_t)(s) * FLASH_SECTOR_SIZE)
+#define LOG_SEQ_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+static osMutexId_t log_mutex;
+static const osMutexAttr_t log_mutex_attr = {
+    .name = "logMutex"
+};
+
+#define LOG_LOCK()   osMutexAcquire(log_mutex, FLASH_MUTEX_TIMEOUT)
+#define LOG_UNLOCK() osMutexRelease(log_mutex)
+
+static uint16_t log_head = 0;           /* Ring sector being written */
+static uint16_t log_head_off = 0;       /* Write offset in it */
+static uint16_t log_tail = 0;           /* Oldest ring sector holding records */
+static uint32_t log_next_seq = 1;
+static uint32_t log_tail_seq = 1;       /* == log_next_seq while empty */
+
+static uint32_t log_hint_seq = 0;       /* Sequential reads: where seq log_hint_seq starts */
+static uint32_t log_hint_addr = 0;
+
+static uint32_t log_cursor = 0;
+static bool log_cursor_valid = false;
+static uint16_t log_cursor_off = 0;     /* Next free journal entry */
+
+static uint8_t log_buf[LOG_RECORD_MAX + 1];     /* + terminator for vsnprintf */
+
+static inline void log_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void log_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t log_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool log_is_erased(const uint8_t *p, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+/* Program across page boundaries */
+static bool log_program(uint32_t addr, const uint8_t *data, uint16_t len) {
+    while (len) {
+        uint16_t chunk = (uint16_t)(FLASH_PROGRAM_PAGE_SIZE - (addr % FLASH_PROGRAM_PAGE_SIZE));
+        if (chunk > len) chunk = len;
+        if (!w25q128_remap_write_page(addr, data, chunk)) return false;
+        addr += chunk;
+        data += chunk;
+        len = (uint16_t)(len - chunk);
+    }
+    return true;
+}
+
+/**
+ * @brief Read and verify the record at addr into log_buf
+ * @return true if a complete record with a good CRC is there
+ */
+static bool log_fetch(uint32_t addr, w25q128_log_record_t *rec) {
+    uint32_t room = FLASH_SECTOR_SIZE - ((addr - LOG_RING_ADDR) % FLASH_SECTOR_SIZE);
+    if (room < LOG_HEADER_SIZE) return false;
+    if (!w25q128_remap_read(addr, log_buf, LOG_HEADER_SIZE)) return false;
+
+    uint16_t len = (uint16_t)(log_buf[2] | (log_buf[3] << 8));
+    if (log_buf[0] != W25_LOG_MAGIC || len > W25_LOG_MSG_MAX || LOG_HEADER_SIZE + len > room) return false;
+    if (len && !w25q128_remap_read(addr + LOG_HEADER_SIZE, &log_buf[LOG_HEADER_SIZE], len)) return false;
+
+    uint32_t crc = crc32_update(CRC32_INIT, log_buf, 12);
+    crc = crc32_update(crc, &log_buf[LOG_HEADER_SIZE], len) ^ 0xFFFFFFFFUL;
+    if (crc != log_get32(&log_buf[12])) return false;
+
+    rec->level = log_buf[1];
+    rec->len = len;
+    rec->seq = log_get32(&log_buf[4]);
+    rec->time_ms = log_get32(&log_buf[8]);
+    return true;
+}
+
+/* The oldest sector was (or is about to be) erased: find the next one holding records */
+static void log_advance_tail(void) {
+    w25q128_log_record_t rec;
+    do {
+        log_tail = (uint16_t)((log_tail + 1) % LOG_RING_SECTORS);
+        if (log_tail == log_head) {
+            log_tail_seq = log_next_seq;
+            return;
+        }
+    } while (!log_fetch(LOG_SECTOR_ADDR(log_tail), &rec));
+    log_tail_seq = rec.seq;
+}
+
+static bool log_cursor_scan(void) {
+    log_cursor_valid = false;
+    log_cursor_off = FLASH_SECTOR_SIZE;
+    for (uint16_t off = 0; off < FLASH_SECTOR_SIZE; off = (uint16_t)(off + LOG_RECORD_MAX)) {
+        if (!w25q128_remap_read(LOG_CURSOR_ADDR + off, log_buf, LOG_RECORD_MAX)) return false;
+        for (uint16_t i = 0; i < LOG_RECORD_MAX; i += LOG_CURSOR_ENTRY) {
+            uint32_t seq = log_get32(&log_buf[i]);
+            uint32_t inv = log_get32(&log_buf[i + 4]);
+            if (log_is_erased(&log_buf[i], LOG_CURSOR_ENTRY)) {
+                log_cursor_off = (uint16_t)(off + i);
+                return true;
+            }
+            if (seq == ~inv) {
+                log_cursor = seq;
+                log_cursor_valid = true;
+            }
+        }
+    }
+    return true;
+}
+
+bool w25q128_log_init(void) {
+    if (log_mutex == NULL) {
+        log_mutex = osMutexNew(&log_mutex_attr);
+        if (log_mutex == NULL) return false;
+    }
+
+    /* Newest sector: the one whose first record has the highest seq */
+    w25q128_log_record_t rec;
+    bool found = false;
+    for (uint16_t s = 0; s < LOG_RING_SECTORS; s++) {
+        if (log_fetch(LOG_SECTOR_ADDR(s), &rec) && (!found || LOG_SEQ_BEFORE(log_next_seq, rec.seq))) {
+            log_head = s;
+            log_next_seq = rec.seq;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        log_head = 0;
+        log_head_off = 0;
+        log_next_seq = 1;
+        if (!w25q128_remap_erase_sector(LOG_SECTOR_ADDR(0))) return false;
+    } else {
+        /* Walk the head sector to its end; damaged data closes the sector */
+        uint32_t base = LOG_SECTOR_ADDR(log_head);
+        log_head_off = 0;
+        while (log_head_off + LOG_HEADER_SIZE <= FLASH_SECTOR_SIZE) {
+            if (log_fetch(base + log_head_off, &rec)) {
+                log_next_seq = rec.seq + 1;
+                log_head_off = (uint16_t)(log_head_off + LOG_HEADER_SIZE + rec.len);
+                continue;
+            }
+            if (!log_is_erased(log_buf, LOG_HEADER_SIZE)) log_head_off = FLASH_SECTOR_SIZE;
+            break;
+        }
+    }
+
+    log_tail = log_head;
+    log_tail_seq = log_next_seq;
+    if (found) {
+        /* Oldest: the first sector after the head that holds records */
+        uint16_t head_first = log_head;
+        log_advance_tail();
+        if (log_tail == log_head) {
+            log_fetch(LOG_SECTOR_ADDR(head_first), &rec);
+            log_tail_seq = rec.seq;
+        }
+    }
+    log_hint_seq = log_tail_seq;
+    log_hint_addr = LOG_SECTOR_ADDR(log_tail);
+
+    return log_cursor_scan();
+}
+
+/* Message already in log_buf after the header */
+static bool log_append_locked(uint8_t level, uint16_t len) {
+    uint16_t size = (uint16_t)(LOG_HEADER_SIZE + len);
+    if (log_head_off + size > FLASH_SECTOR_SIZE) {
+        log_head = (uint16_t)((log_head + 1) % LOG_RING_SECTORS);
+        if (log_head == log_tail) log_advance_tail();
+        log_head_off = 0;
+        if (!w25q128_remap_erase_sector(LOG_SECTOR_ADDR(log_head))) {
+            log_head_off = FLASH_SECTOR_SIZE;
+            return false;
+        }
+    }
+
+    log_buf[0] = W25_LOG_MAGIC;
+    log_buf[1] = level;
+    log_put16(&log_buf[2], len);
+    log_put32(&log_buf[4], log_next_seq);
+    log_put32(&log_buf[8], HAL_GetTick());
+    uint32_t crc = crc32_update(CRC32_INIT, log_buf, 12);
+    log_put32(&log_buf[12], crc32_update(crc, &log_buf[LOG_HEADER_SIZE], len) ^ 0xFFFFFFFFUL);
+
+    if (!log_program(LOG_SECTOR_ADDR(log_head) + log_head_off, log_buf, size)) {
+        log_head_off = FLASH_SECTOR_SIZE;       /* Continue in a fresh sector */
+        return false;
+    }
+    if (log_tail_seq == log_next_seq) log_tail = log_head;      /* First record */
+    log_head_off = (uint16_t)(log_head_off + size);
+    log_next_seq++;
+    return true;
+}
+
+bool w25q128_log_write(uint8_t level, const char *msg, uint16_t len) {
+    if (len > W25_LOG_MSG_MAX) len = W25_LOG_MSG_MAX;
+    LOG_LOCK();
+    memcpy(&log_buf[LOG_HEADER_SIZE], msg, len);
+    bool ok = log_append_locked(level, len);
+    LOG_UNLOCK();
+    return ok;
+}
+
+bool w25q128_log_printf(uint8_t level, const char *fmt, ...) {
+    va_list args;
+    LOG_LOCK();
+    va_start(args, fmt);
+    int n = vsnprintf((char *)&log_buf[LOG_HEADER_SIZE], W25_LOG_MSG_MAX + 1, fmt, args);
+    va_end(args);
+    if (n < 0) n = 0;
+    if (n > W25_LOG_MSG_MAX) n = W25_LOG_MSG_MAX;
+    bool ok = log_append_locked(level, (uint16_t)n);
+    LOG_UNLOCK();
+    return ok;
+}
+
+int16_t w25q128_log_read(uint32_t seq, w25q128_log_record_t *rec, uint8_t *buf, uint16_t max) {
+    LOG_LOCK();
+    if (!LOG_SEQ_BEFORE(seq, log_next_seq)) {
+        LOG_UNLOCK();
+        return -1;
+    }
+    if (LOG_SEQ_BEFORE(seq, log_tail_seq)) seq = log_tail_seq;
+
+    uint32_t addr = log_hint_addr;
+    if (seq != log_hint_seq) {
+        /* Seek: last sector from the tail whose first record is not after seq */
+        uint16_t s = log_tail;
+        addr = LOG_SECTOR_ADDR(s);
+        while (s != log_head) {
+            s = (uint16_t)((s + 1) % LOG_RING_SECTORS);
+            w25q128_log_record_t first;
+            if (!log_fetch(LOG_SECTOR_ADDR(s), &first)) continue;
+            if (LOG_SEQ_BEFORE(seq, first.seq)) break;
+            addr = LOG_SECTOR_ADDR(s);
+        }
+    }
+
+    int16_t result = -1;
+    while (true) {
+        uint16_t s = (uint16_t)((addr - LOG_RING_ADDR) / FLASH_SECTOR_SIZE);
+        bool in_head = (s == log_head);
+        if (in_head && addr >= LOG_SECTOR_ADDR(s) + log_head_off) break;
+        if (log_fetch(addr, rec)) {
+            addr += LOG_HEADER_SIZE + rec->len;
+            if (LOG_SEQ_BEFORE(rec->seq, seq)) continue;
+            uint16_t n = (rec->len < max) ? rec->len : max;
+            memcpy(buf, &log_buf[LOG_HEADER_SIZE], n);
+            log_hint_seq = rec->seq + 1;
+            log_hint_addr = addr;
+            result = (int16_t)n;
+            break;
+        }
+        if (in_head) break;
+        addr = LOG_SECTOR_ADDR((s + 1) % LOG_RING_SECTORS);     /* End of sector or damaged: next one */
+    }
+    LOG_UNLOCK();
+    return result;
+}
+
+uint32_t w25q128_log_next_seq(void) {
+    return log_next_seq;
+}
+
+uint32_t w25q128_log_oldest_seq(void) {
+    return log_tail_seq;
+}
+
+bool w25q128_log_cursor_load(uint32_t *seq) {
+    LOG_LOCK();
+    *seq = log_cursor_valid ? log_cursor : 0;
+    bool valid = log_cursor_valid;
+    LOG_UNLOCK();
+    return valid;
+}
+
+bool w25q128_log_cursor_store(uint32_t seq) {
+    uint8_t entry[LOG_CURSOR_ENTRY];
+    log_put32(&entry[0], seq);
+    log_put32(&entry[4], ~seq);
+
+    LOG_LOCK();
+    bool ok = true;
+    if (log_cursor_off + LOG_CURSOR_ENTRY > FLASH_SECTOR_SIZE) {
+        ok = w25q128_remap_erase_sector(LOG_CURSOR_ADDR);
+        log_cursor_off = 0;
+    }
+    if (ok) ok = w25q128_remap_write_page(LOG_CURSOR_ADDR + log_cursor_off, entry, LOG_CURSOR_ENTRY);
+    log_cursor_off = (uint16_t)(log_cursor_off + LOG_CURSOR_ENTRY);
+    if (ok) {
+        log_cursor = seq;
+        log_cursor_valid = true;
+    }
+    LOG_UNLOCK();
+    return ok;
+}
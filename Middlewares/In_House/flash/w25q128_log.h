@@ -0,0 +1,111 @@
+/**
+ * @file w25q128_log.h
+ * @brief Circular record log in the LOG region of the W25Q128
+ *
+ * @details The first sector of the region is a cursor journal for a log
+ *          reader (the log shipper); the remaining sectors form a ring of
+ *          variable-length records. Each record is a LOG_HEADER_SIZE header
+ *          followed by the message:
+ *
+ *              magic:u8 level:u8 len:u16 seq:u32 time_ms:u32 crc:u32
+ *
+ *          little-endian, with the CRC-32 over the first 12 header bytes
+ *          and the message. Records never straddle a sector. When the writer
+ *          moves into a new sector it erases it first, dropping the oldest
+ *          sector's records.
+ *
+ *          A power cut can only damage the record being written: recovery
+ *          stops at the first record that does not verify and continues in
+ *          the next sector. Sequence numbers increase by one per record and
+ *          survive resets, so a reader can resume from any seq.
+ */
+
+#ifndef W25Q128_LOG_H
+#define W25Q128_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define W25_LOG_MAGIC                0x4C       /* 'L' */
+#define W25_LOG_MSG_MAX              112        /* Longest message; header + message fit in 128 bytes */
+
+/* Severities as in RFC 5424, so the shipper can forward them unchanged */
+#define W25_LOG_EMERG                0
+#define W25_LOG_ALERT                1
+#define W25_LOG_CRIT                 2
+#define W25_LOG_ERR                  3
+#define W25_LOG_WARNING              4
+#define W25_LOG_NOTICE               5
+#define W25_LOG_INFO                 6
+#define W25_LOG_DEBUG                7
+
+typedef struct {
+    uint8_t  level;
+    uint16_t len;               /**< Message length */
+    uint32_t seq;
+    uint32_t time_ms;           /**< HAL_GetTick() when written */
+} w25q128_log_record_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Find the newest record and the oldest surviving one
+ * @note  Call once after w25q128_remap_init(), before any other function here
+ * @return true if the region could be scanned
+ */
+bool w25q128_log_init(void);
+
+/**
+ * @brief Append one record
+ * @param level W25_LOG_xxx
+ * @param msg   Message bytes (not terminated), truncated to W25_LOG_MSG_MAX
+ * @return true if programmed
+ */
+bool w25q128_log_write(uint8_t level, const char *msg, uint16_t len);
+
+/**
+ * @brief Append a formatted record
+ */
+bool w25q128_log_printf(uint8_t level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Read the first surviving record with sequence number >= seq
+ * @param seq Requested sequence number
+ * @param rec Receives the record header (rec->seq may be above seq if
+ *            older records were overwritten or damaged)
+ * @param buf Receives the message, truncated to max
+ * @return Message bytes copied, -1 if no such record exists yet
+ * @note  Reading forward one seq at a time costs one flash read per record
+ */
+int16_t w25q128_log_read(uint32_t seq, w25q128_log_record_t *rec, uint8_t *buf, uint16_t max);
+
+/**
+ * @brief Sequence number the next record will get
+ */
+uint32_t w25q128_log_next_seq(void);
+
+/**
+ * @brief Sequence number of the oldest surviving record (next_seq if empty)
+ */
+uint32_t w25q128_log_oldest_seq(void);
+
+/**
+ * @brief Load the reader cursor from the journal sector
+ * @param seq Receives the stored cursor, 0 if none was stored
+ * @return true if a cursor was found
+ */
+bool w25q128_log_cursor_load(uint32_t *seq);
+
+/**
+ * @brief Append a cursor to the journal sector (erased when full)
+ * @note  One 8-byte program per call; rate-limit the callers
+ */
+bool w25q128_log_cursor_store(uint32_t seq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* W25Q128_LOG_H */
@@ -0,0 +1,369 @@
+/**
+ * @file w25q128_part.c
+ * @brief Partition table: region boundaries stored in flash, cached in RAM
+ *
+ * Lookups are a RAM array access. Until w25q128_part_init() has loaded the
+ * table they fall back to the defaults, computed from the detected size.
+ */
+
+#include "w25q128_part.h"
+#include "w25q128.h"
+#include "w25q128_remap.h"
+#include "../../../Core/Inc/flash_config.h"
+#include "crc32.h"
+#include <string.h>
+#include <stdio.h>
+
+#define PART_CHUNK          64      /* Copy unit, divides the page size */
+#define PART_BODY_SIZE      (W25_PART_MIGRATION_OFFSET + W25_PART_MIGRATION_SIZE - W25_PART_HEADER_SIZE)
+#define PART_MAX_STEPS      ((FLASH_SECTOR_SIZE - W25_PART_PROGRESS_OFFSET) * 8)
+
+#define PART_COPY_ADDR(c)   (PART_TABLE_ADDR + (uint32_t)(c) * FLASH_SECTOR_SIZE)
+
+typedef struct {
+    uint32_t src;
+    uint32_t dst;
+    uint32_t len;       /* Bytes to move, 0 when idle */
+    uint32_t erase;     /* Bytes to erase at src afterwards */
+} part_migration_t;
+
+static osMutexId_t part_mutex;
+static const osMutexAttr_t part_mutex_attr = {
+    .name = "partMutex"
+};
+
+#define PART_LOCK()   osMutexAcquire(part_mutex, FLASH_MUTEX_TIMEOUT)
+#define PART_UNLOCK() osMutexRelease(part_mutex)
+
+static w25q128_part_info_t part_table[FLASH_PART_COUNT];
+static bool part_loaded = false;
+static uint32_t part_seq = 0;
+static uint8_t part_copy = 0;           /* Copy holding the current table */
+static part_migration_t part_mig;
+static bool part_pending = false;       /* Stored table differs from the one in use */
+
+static uint8_t part_buf[W25_PART_HEADER_SIZE + PART_BODY_SIZE];
+static uint8_t part_chunk[PART_CHUNK];
+
+static inline void part_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t part_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ============================================================================
+// DEFAULTS
+// ============================================================================
+
+static void part_defaults(w25q128_part_info_t *t) {
+    static const struct { uint32_t base, size; } fixed[] = {
+        [FLASH_PART_BOOT]   = { BOOT_DEFAULT_ADDR, BOOT_DEFAULT_SIZE },
+        [FLASH_PART_FW_A]   = { BOOT_DEFAULT_ADDR + BOOT_DEFAULT_SIZE, FW_SLOT_DEFAULT_SIZE },
+        [FLASH_PART_FW_B]   = { BOOT_DEFAULT_ADDR + BOOT_DEFAULT_SIZE + FW_SLOT_DEFAULT_SIZE, FW_SLOT_DEFAULT_SIZE },
+        [FLASH_PART_FW_C]   = { BOOT_DEFAULT_ADDR + BOOT_DEFAULT_SIZE + 2 * FW_SLOT_DEFAULT_SIZE, FW_SLOT_DEFAULT_SIZE },
+        [FLASH_PART_META]   = { META_DEFAULT_ADDR, META_DEFAULT_SIZE },
+        [FLASH_PART_CONFIG] = { CONFIG_DEFAULT_ADDR, CONFIG_DEFAULT_SIZE },
+        [FLASH_PART_EEPROM] = { EEPROM_DEFAULT_ADDR, EEPROM_DEFAULT_SIZE },
+    };
+    for (uint8_t i = 0; i <= FLASH_PART_EEPROM; i++) {
+        t[i].base = fixed[i].base;
+        t[i].size = fixed[i].size;
+        t[i].flags = W25_PART_FIXED;
+    }
+    uint32_t reserved = FLASH_TOTAL_SIZE - RESERVED_DEFAULT_SIZE;
+    t[FLASH_PART_CONFIG].flags = 0;
+    t[FLASH_PART_EEPROM].flags = 0;
+    t[FLASH_PART_LOG] = (w25q128_part_info_t){ LOG_DEFAULT_ADDR, LOG_DEFAULT_SIZE, W25_PART_GROWABLE };
+    t[FLASH_PART_USER_DATA] = (w25q128_part_info_t){ LOG_DEFAULT_ADDR + LOG_DEFAULT_SIZE,
+                                                     reserved - (LOG_DEFAULT_ADDR + LOG_DEFAULT_SIZE), W25_PART_GROWABLE };
+    t[FLASH_PART_RESERVED] = (w25q128_part_info_t){ reserved, RESERVED_DEFAULT_SIZE, 0 };
+}
+
+uint32_t w25q128_part_base(flash_part_id_t id) {
+    if (id >= FLASH_PART_COUNT) return 0;
+    if (!part_loaded) part_defaults(part_table);
+    return part_table[id].base;
+}
+
+uint32_t w25q128_part_size(flash_part_id_t id) {
+    if (id >= FLASH_PART_COUNT) return 0;
+    if (!part_loaded) part_defaults(part_table);
+    return part_table[id].size;
+}
+
+// ============================================================================
+// TABLE STORAGE
+// ============================================================================
+
+static bool part_valid_layout(const w25q128_part_info_t *t) {
+    for (uint8_t i = 0; i < FLASH_PART_COUNT; i++) {
+        if (!IS_SECTOR_ALIGNED(t[i].base) || !IS_SECTOR_ALIGNED(t[i].size) || t[i].size == 0 ||
+            t[i].base + t[i].size > FLASH_TOTAL_SIZE || t[i].base + t[i].size < t[i].base) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Read and check one copy into part_buf
+ */
+static bool part_read_copy(uint8_t copy, uint32_t *seq) {
+    if (!w25q128_read_bytes(PART_COPY_ADDR(copy), part_buf, sizeof(part_buf))) return false;
+    if (part_get32(&part_buf[0]) != W25_PART_MAGIC || part_buf[4] != W25_PART_VERSION ||
+        part_buf[5] != 0 || part_buf[6] != FLASH_PART_COUNT) {
+        return false;
+    }
+    uint32_t crc = crc32_update(CRC32_INIT, &part_buf[W25_PART_HEADER_SIZE], PART_BODY_SIZE);
+    crc = crc32_update(crc, part_buf, 12) ^ 0xFFFFFFFFUL;
+    if (crc != part_get32(&part_buf[12])) return false;
+    *seq = part_get32(&part_buf[8]);
+    return true;
+}
+
+static void part_decode(w25q128_part_info_t *t, part_migration_t *m) {
+    for (uint8_t i = 0; i < FLASH_PART_COUNT; i++) {
+        const uint8_t *e = &part_buf[W25_PART_HEADER_SIZE + i * W25_PART_ENTRY_SIZE];
+        uint8_t id = e[0] < FLASH_PART_COUNT ? e[0] : i;
+        t[id].flags = e[1];
+        t[id].base = part_get32(&e[4]);
+        t[id].size = part_get32(&e[8]);
+    }
+    const uint8_t *mp = &part_buf[W25_PART_MIGRATION_OFFSET];
+    m->src = part_get32(&mp[0]);
+    m->dst = part_get32(&mp[4]);
+    m->len = part_get32(&mp[8]);
+    m->erase = part_get32(&mp[12]);
+}
+
+/**
+ * @brief Store t and m as the next generation, in the older copy
+ * @param apply Also switch the cached table; otherwise it takes effect at
+ *              the next init
+ */
+static bool part_store(const w25q128_part_info_t *t, const part_migration_t *m, bool apply) {
+    uint8_t target = (uint8_t)(part_copy ^ 1);
+    memset(part_buf, 0xFF, sizeof(part_buf));
+    part_put32(&part_buf[0], W25_PART_MAGIC);
+    part_buf[4] = W25_PART_VERSION;
+    part_buf[5] = 0;
+    part_buf[6] = FLASH_PART_COUNT;
+    part_put32(&part_buf[8], part_seq + 1);
+    for (uint8_t i = 0; i < FLASH_PART_COUNT; i++) {
+        uint8_t *e = &part_buf[W25_PART_HEADER_SIZE + i * W25_PART_ENTRY_SIZE];
+        e[0] = i;
+        e[1] = t[i].flags;
+        part_put32(&e[4], t[i].base);
+        part_put32(&e[8], t[i].size);
+    }
+    uint8_t *mp = &part_buf[W25_PART_MIGRATION_OFFSET];
+    part_put32(&mp[0], m->src);
+    part_put32(&mp[4], m->dst);
+    part_put32(&mp[8], m->len);
+    part_put32(&mp[12], m->erase);
+    uint32_t crc = crc32_update(CRC32_INIT, &part_buf[W25_PART_HEADER_SIZE], PART_BODY_SIZE);
+    part_put32(&part_buf[12], crc32_update(crc, part_buf, 12) ^ 0xFFFFFFFFUL);
+
+    uint32_t addr = PART_COPY_ADDR(target);
+    if (!w25q128_erase_sector(addr) ||
+        !w25q128_write_page(addr + W25_PART_HEADER_SIZE, &part_buf[W25_PART_HEADER_SIZE], PART_BODY_SIZE) ||
+        !w25q128_write_page(addr, part_buf, W25_PART_HEADER_SIZE)) {
+        return false;
+    }
+    /* Read back: the bootloader trusts this table */
+    uint32_t seq;
+    if (!part_read_copy(target, &seq) || seq != part_seq + 1) return false;
+
+    if (apply) {
+        memcpy(part_table, t, sizeof(part_table));
+        part_mig = *m;
+    } else {
+        part_pending = true;
+    }
+    part_seq = seq;
+    part_copy = target;
+    return true;
+}
+
+// ============================================================================
+// MIGRATION
+// ============================================================================
+
+static uint32_t part_steps(void) {
+    return (part_mig.len + part_mig.erase) / FLASH_SECTOR_SIZE;
+}
+
+/* Steps already done: progress bits are cleared in order */
+static bool part_progress(uint32_t *done) {
+    uint32_t addr = PART_COPY_ADDR(part_copy) + W25_PART_PROGRESS_OFFSET;
+    uint32_t steps = part_steps();
+    *done = 0;
+    for (uint32_t off = 0; *done < steps; off += PART_CHUNK) {
+        if (!w25q128_read_bytes(addr + off, part_chunk, PART_CHUNK)) return false;
+        for (uint16_t i = 0; i < PART_CHUNK * 8 && *done < steps; i++) {
+            if (part_chunk[i / 8] & (1U << (i % 8))) return true;
+            (*done)++;
+        }
+    }
+    return true;
+}
+
+static bool part_mark_step(uint32_t step) {
+    uint8_t bits = (uint8_t)~(1U << (step % 8));
+    /* Earlier bits of the byte are already 0; programming 1s leaves them */
+    return w25q128_write_page(PART_COPY_ADDR(part_copy) + W25_PART_PROGRESS_OFFSET + step / 8, &bits, 1);
+}
+
+static bool part_copy_sector(uint32_t src, uint32_t dst) {
+    if (!w25q128_remap_erase_sector(dst)) return false;
+    for (uint32_t off = 0; off < FLASH_SECTOR_SIZE; off += PART_CHUNK) {
+        if (!w25q128_remap_read(src + off, part_chunk, PART_CHUNK)) return false;
+        bool erased = true;
+        for (uint16_t i = 0; i < PART_CHUNK && erased; i++) erased = (part_chunk[i] == 0xFF);
+        if (!erased && !w25q128_remap_write_page(dst + off, part_chunk, PART_CHUNK)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Run the stored migration to the end
+ */
+static bool part_migrate(void) {
+    uint32_t done;
+    if (!part_progress(&done)) return false;
+    uint32_t copies = part_mig.len / FLASH_SECTOR_SIZE;
+    uint32_t steps = part_steps();
+    if (done < steps) {
+        printf("Flash partitions: moving %lu KB from 0x%06lX to 0x%06lX, step %lu/%lu\n",
+               (unsigned long)(part_mig.len / 1024), (unsigned long)part_mig.src, (unsigned long)part_mig.dst,
+               (unsigned long)done, (unsigned long)steps);
+    }
+    for (uint32_t step = done; step < steps; step++) {
+        bool ok;
+        if (step < copies) {
+            uint32_t off = part_mig.len - (step + 1) * FLASH_SECTOR_SIZE;     /* Top down */
+            ok = part_copy_sector(part_mig.src + off, part_mig.dst + off);
+        } else {
+            ok = w25q128_remap_erase_sector(part_mig.src + (step - copies) * FLASH_SECTOR_SIZE);
+        }
+        if (!ok || !part_mark_step(step)) {
+            printf("Flash partitions: migration failed at step %lu\n", (unsigned long)step);
+            return false;
+        }
+    }
+    part_migration_t idle = { 0, 0, 0, 0 };
+    return part_store(part_table, &idle, true);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool w25q128_part_init(void) {
+    if (part_mutex == NULL) {
+        part_mutex = osMutexNew(&part_mutex_attr);
+        if (part_mutex == NULL) return false;
+    }
+    PART_LOCK();
+    static w25q128_part_info_t table[FLASH_PART_COUNT];
+    uint32_t seq[2];
+    bool valid[2], blank = true;
+    for (uint8_t c = 0; c < 2; c++) {
+        valid[c] = part_read_copy(c, &seq[c]);
+        if (valid[c]) {
+            part_decode(table, &part_mig);
+            valid[c] = part_valid_layout(table);
+        }
+        /* Header never written; a read error must not look like this */
+        if (part_get32(&part_buf[0]) != 0xFFFFFFFFUL) blank = false;
+    }
+
+    bool ok = true;
+    if (!valid[0] && !valid[1]) {
+        part_defaults(part_table);
+        part_mig = (part_migration_t){ 0, 0, 0, 0 };
+        part_seq = 0;
+        part_copy = 1;
+        if (blank) {
+            /* First boot: store the defaults */
+            ok = part_store(part_table, &part_mig, true);
+            printf("Flash partitions: %s defaults\n", ok ? "stored" : "could not store");
+        } else {
+            /* Leave the evidence alone; run on the defaults */
+            ok = false;
+            printf("Flash partitions: table corrupt, running on defaults\n");
+        }
+    } else {
+        part_copy = (valid[1] && (!valid[0] || (int32_t)(seq[1] - seq[0]) > 0)) ? 1 : 0;
+        part_seq = seq[part_copy];
+        ok = part_read_copy(part_copy, &seq[part_copy]);
+        part_decode(part_table, &part_mig);
+    }
+    part_loaded = true;     /* Defaults stay in use if the table could not be stored */
+    part_pending = false;
+
+    if (ok && part_mig.len + part_mig.erase > 0) {
+        ok = part_migrate();
+        if (ok) printf("Flash partitions: migration done, table generation %lu\n", (unsigned long)part_seq);
+    }
+    PART_UNLOCK();
+    return ok;
+}
+
+flash_status_t w25q128_part_get(flash_part_id_t id, w25q128_part_info_t *info) {
+    if (id >= FLASH_PART_COUNT || info == NULL) return FLASH_STATUS_INVALID_PARAM;
+    info->base = w25q128_part_base(id);
+    info->size = w25q128_part_size(id);
+    info->flags = part_table[id].flags;
+    return FLASH_STATUS_OK;
+}
+
+flash_status_t w25q128_part_grow(flash_part_id_t id, uint32_t size) {
+    if (id >= FLASH_PART_COUNT || !IS_SECTOR_ALIGNED(size)) return FLASH_STATUS_INVALID_PARAM;
+    if (!part_loaded || part_seq == 0) return FLASH_STATUS_ERROR;     /* No table in flash to build on */
+    PART_LOCK();
+    flash_status_t st = FLASH_STATUS_OK;
+    static w25q128_part_info_t table[FLASH_PART_COUNT];
+    memcpy(table, part_table, sizeof(table));
+    w25q128_part_info_t *p = &table[id];
+    w25q128_part_info_t *res = &table[FLASH_PART_RESERVED];
+    uint32_t delta = size - p->size;
+
+    if (part_pending || part_mig.len + part_mig.erase > 0) {
+        st = FLASH_STATUS_BUSY;
+    } else if (!(p->flags & W25_PART_GROWABLE) || size <= p->size) {
+        st = FLASH_STATUS_INVALID_PARAM;
+    } else if (res->size < RESERVED_MIN_SIZE + delta || p->base + p->size > res->base) {
+        st = FLASH_STATUS_NO_MEMORY;
+    } else {
+        /* Everything between the partition and RESERVED moves up by delta */
+        part_migration_t m;
+        m.src = p->base + p->size;
+        m.len = res->base - m.src;
+        m.dst = m.src + delta;
+        m.erase = delta;
+        if ((m.len + m.erase) / FLASH_SECTOR_SIZE > PART_MAX_STEPS) {
+            st = FLASH_STATUS_NO_MEMORY;
+        } else {
+            for (uint8_t i = 0; i < FLASH_PART_COUNT; i++) {
+                if (i != FLASH_PART_RESERVED && table[i].base >= m.src && table[i].base < res->base) table[i].base += delta;
+            }
+            p->size = size;
+            res->base += delta;
+            res->size -= delta;
+            if (!part_store(table, &m, false)) st = FLASH_STATUS_ERROR;
+        }
+    }
+    PART_UNLOCK();
+    return st;
+}
+
+uint32_t w25q128_part_seq(void) {
+    return part_seq;
+}
+
+bool w25q128_part_migrating(void) {
+    return part_pending || part_mig.len + part_mig.erase > 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file w25q128_part.h
+ * @brief Partition table: region boundaries stored in flash, cached in RAM
+ *
+ * @details Two copies at PART_TABLE_ADDR, one per sector. A copy is:
+ *
+ *              0    magic:u32 version:u16 count:u8 0xFF seq:u32 crc:u32
+ *              16   count x { id:u8 flags:u8 0xFFFF base:u32 size:u32 }
+ *              136  migration { src:u32 dst:u32 len:u32 erase:u32 }
+ *              256  progress bitmap, one bit per step, cleared when done
+ *
+ *          The CRC covers bytes 16..151 and then the first 12 header bytes.
+ *          An update goes to the older copy, header last; init takes the
+ *          valid copy with the higher seq. Without a valid copy the defaults
+ *          from flash_config.h are written.
+ *
+ *          Growing a partition takes space from the bottom of RESERVED: the
+ *          partitions between it and RESERVED move up, data included. The
+ *          new table goes in first, with the move recorded as a migration:
+ *          copy len bytes from src to dst one sector at a time from the top
+ *          down (each step only overwrites source sectors already copied, so
+ *          it can be repeated), then erase the erase bytes the partition
+ *          gained. Each finished step clears its progress bit, so a power cut
+ *          resumes where it stopped. When all steps are done the migration is
+ *          dropped in a final table update. The migration runs in
+ *          w25q128_part_init(), before the log and file store are started.
+ *
+ * @note  Data moves through w25q128_remap.h, so remapped sectors follow.
+ */
+
+#ifndef W25Q128_PART_H
+#define W25Q128_PART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../../Core/Inc/flash_config.h"
+
+#define W25_PART_MAGIC              0x4C425450  /* "PTBL" */
+#define W25_PART_VERSION            1
+#define W25_PART_HEADER_SIZE        16
+#define W25_PART_ENTRY_SIZE         12
+#define W25_PART_MIGRATION_OFFSET   (W25_PART_HEADER_SIZE + FLASH_PART_COUNT * W25_PART_ENTRY_SIZE)
+#define W25_PART_MIGRATION_SIZE     16
+#define W25_PART_PROGRESS_OFFSET    256
+
+/* Partition flags */
+#define W25_PART_FIXED              0x01        /* Built into the bootloader, never moves */
+#define W25_PART_GROWABLE           0x02        /* May grow into RESERVED */
+
+typedef struct {
+    uint32_t base;
+    uint32_t size;
+    uint8_t  flags;
+} w25q128_part_info_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Load the table (writing the defaults on first boot) and finish a
+ *        pending migration
+ * @note  Call after w25q128_remap_init(), before the log and file store.
+ *        Region lookups before this return the defaults.
+ */
+bool w25q128_part_init(void);
+
+flash_status_t w25q128_part_get(flash_part_id_t id, w25q128_part_info_t *info);
+
+/**
+ * @brief Grow a partition into RESERVED
+ * @param size New size, a multiple of FLASH_SECTOR_SIZE
+ * @return FLASH_STATUS_OK once the new table is stored. Lookups keep
+ *         returning the running layout; the data moves and the new layout
+ *         takes effect at the next w25q128_part_init(), i.e. after a reboot.
+ *         FLASH_STATUS_BUSY if a grow is already waiting for that.
+ */
+flash_status_t w25q128_part_grow(flash_part_id_t id, uint32_t size);
+
+/**
+ * @brief Table generation (0 while on the defaults)
+ */
+uint32_t w25q128_part_seq(void);
+
+/**
+ * @brief true while a grow is stored but its migration not finished
+ */
+bool w25q128_part_migrating(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* W25Q128_PART_H */
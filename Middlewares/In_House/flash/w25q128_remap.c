@@ -0,0 +1,255 @@
+/**
+ * @file w25q128_remap.c
+ * @brief Verified program/erase with bad-sector remapping for the data regions
+ *
+ * The table lives in RAM as one logical sector number per spare; lookups scan
+ * it backwards so the newest mapping of a sector wins.
+ */
+
+#include "w25q128_remap.h"
+#include "w25q128.h"
+#include "../../../Core/Inc/flash_config.h"
+#include <string.h>
+#include <stdio.h>
+
+#define REMAP_CHUNK         64      /* Verify and copy unit, divides the page size */
+#define REMAP_FREE          0xFFFF
+
+#define REMAP_SPARE_ADDR(i) (REMAP_SPARE_BASE_ADDR + (uint32_t)(i) * FLASH_SECTOR_SIZE)
+
+static osMutexId_t remap_mutex;
+static const osMutexAttr_t remap_mutex_attr = {
+    .name = "remapMutex"
+};
+
+#define REMAP_LOCK()   osMutexAcquire(remap_mutex, FLASH_MUTEX_TIMEOUT)
+#define REMAP_UNLOCK() osMutexRelease(remap_mutex)
+
+static uint16_t remap_sector[REMAP_SPARE_COUNT];    /* Logical sector per spare */
+static uint16_t remap_used = 0;                     /* Spares consumed, in order */
+static w25q128_remap_stats_t remap_stats;
+
+static uint8_t remap_buf[REMAP_CHUNK];          /* Readback */
+static uint8_t remap_copy[REMAP_CHUNK];         /* Sector copy, verified through remap_buf */
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static bool remap_in_region(uint32_t addr) {
+    return addr >= REMAP_REGION_START && addr < REMAP_REGION_END;
+}
+
+static uint32_t remap_lookup(uint32_t addr) {
+    if (!remap_in_region(addr)) return addr;
+    uint16_t sector = (uint16_t)ADDR_TO_SECTOR(addr);
+    for (uint16_t i = remap_used; i-- > 0;) {
+        if (remap_sector[i] == sector) return REMAP_SPARE_ADDR(i) + (addr % FLASH_SECTOR_SIZE);
+    }
+    return addr;
+}
+
+/* Every 0 bit in data must read back as 0 */
+static bool remap_verify(uint32_t phys, const uint8_t *data, uint32_t len) {
+    while (len) {
+        uint32_t chunk = (len < REMAP_CHUNK) ? len : REMAP_CHUNK;
+        if (!w25q128_read_bytes(phys, remap_buf, chunk)) return false;
+        for (uint32_t i = 0; i < chunk; i++) {
+            if (remap_buf[i] & (uint8_t)~data[i]) return false;
+        }
+        phys += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+static bool remap_blank(uint32_t phys) {
+    for (uint32_t off = 0; off < FLASH_SECTOR_SIZE; off += REMAP_CHUNK) {
+        if (!w25q128_read_bytes(phys + off, remap_buf, REMAP_CHUNK)) return false;
+        for (uint16_t i = 0; i < REMAP_CHUNK; i++) {
+            if (remap_buf[i] != 0xFF) return false;
+        }
+    }
+    return true;
+}
+
+static bool remap_program(uint32_t phys, const uint8_t *data, uint32_t len) {
+    return w25q128_write_page(phys, data, len) && remap_verify(phys, data, len);
+}
+
+static bool remap_entry_valid(const uint8_t *e) {
+    uint32_t head = (uint32_t)e[0] | ((uint32_t)e[1] << 8) | ((uint32_t)e[2] << 16) | ((uint32_t)e[3] << 24);
+    uint32_t check = (uint32_t)e[4] | ((uint32_t)e[5] << 8) | ((uint32_t)e[6] << 16) | ((uint32_t)e[7] << 24);
+    return e[0] == W25_REMAP_MAGIC && check == ~head;
+}
+
+/* Write slot i to both table copies; one good copy is enough */
+static bool remap_store(uint16_t slot, uint16_t sector) {
+    uint8_t e[W25_REMAP_ENTRY_SIZE] = { W25_REMAP_MAGIC, 0xFF, (uint8_t)sector, (uint8_t)(sector >> 8) };
+    uint32_t head = (uint32_t)e[0] | ((uint32_t)e[1] << 8) | ((uint32_t)e[2] << 16) | ((uint32_t)e[3] << 24);
+    for (uint8_t b = 0; b < 4; b++) e[4 + b] = (uint8_t)(~head >> (8 * b));
+
+    uint32_t off = (uint32_t)slot * W25_REMAP_ENTRY_SIZE;
+    bool a = remap_program(REMAP_TABLE_ADDR + off, e, sizeof(e));
+    bool b = remap_program(REMAP_TABLE_ADDR + FLASH_SECTOR_SIZE + off, e, sizeof(e));
+    return a || b;
+}
+
+/**
+ * @brief Copy sector old_phys into a fresh spare, merging in a pending page program
+ * @param data NULL when replacing after a failed erase (the spare stays blank)
+ */
+static bool remap_fill(uint32_t spare, uint32_t old_phys, uint32_t data_off, const uint8_t *data, uint32_t len) {
+    if (!w25q128_erase_sector(spare) || !remap_blank(spare)) return false;
+    if (data == NULL) return true;
+
+    for (uint32_t off = 0; off < FLASH_SECTOR_SIZE; off += REMAP_CHUNK) {
+        if (!w25q128_read_bytes(old_phys + off, remap_copy, REMAP_CHUNK)) return false;
+        /* The failed program may have cleared some bits already: AND again */
+        bool erased = true;
+        for (uint32_t i = 0; i < REMAP_CHUNK; i++) {
+            uint32_t pos = off + i;
+            if (pos >= data_off && pos < data_off + len) remap_copy[i] &= data[pos - data_off];
+            if (remap_copy[i] != 0xFF) erased = false;
+        }
+        if (erased) continue;
+        if (!remap_program(spare + off, remap_copy, REMAP_CHUNK)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Move the logical sector holding addr to the next good spare
+ */
+static bool remap_replace(uint32_t addr, const uint8_t *data, uint32_t len) {
+    uint16_t sector = (uint16_t)ADDR_TO_SECTOR(addr);
+    uint32_t old_phys = SECTOR_ALIGN(remap_lookup(addr));
+
+    while (remap_used < REMAP_SPARE_COUNT) {
+        /* A chip that stopped answering (brown-out, loose wire) fails every
+         * spare too: keep them for sectors that are really worn */
+        uint8_t id[3];
+        if (!w25q128_read_id(id) || id[0] != 0xEF) {
+            printf("Flash remap: chip not responding, sector 0x%06lX kept\n", (unsigned long)SECTOR_ALIGN(addr));
+            return false;
+        }
+        uint16_t slot = remap_used++;
+        if (remap_fill(REMAP_SPARE_ADDR(slot), old_phys, addr % FLASH_SECTOR_SIZE, data, len) &&
+            remap_store(slot, sector)) {
+            remap_sector[slot] = sector;
+            printf("Flash remap: sector 0x%06lX -> spare %u (%u left)\n", (unsigned long)SECTOR_ALIGN(addr),
+                   slot, (unsigned)(REMAP_SPARE_COUNT - remap_used));
+            return true;
+        }
+        remap_store(slot, W25_REMAP_RETIRED);
+        remap_sector[slot] = W25_REMAP_RETIRED;
+    }
+    printf("Flash remap: no spare left for sector 0x%06lX\n", (unsigned long)SECTOR_ALIGN(addr));
+    return false;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool w25q128_remap_init(void) {
+    if (remap_mutex == NULL) {
+        remap_mutex = osMutexNew(&remap_mutex_attr);
+        if (remap_mutex == NULL) return false;
+    }
+    memset(&remap_stats, 0, sizeof(remap_stats));
+    remap_used = 0;
+
+    for (uint16_t i = 0; i < REMAP_SPARE_COUNT; i++) {
+        uint8_t a[W25_REMAP_ENTRY_SIZE], b[W25_REMAP_ENTRY_SIZE];
+        uint32_t off = (uint32_t)i * W25_REMAP_ENTRY_SIZE;
+        if (!w25q128_read_bytes(REMAP_TABLE_ADDR + off, a, sizeof(a)) ||
+            !w25q128_read_bytes(REMAP_TABLE_ADDR + FLASH_SECTOR_SIZE + off, b, sizeof(b))) {
+            return false;
+        }
+        const uint8_t *e = remap_entry_valid(a) ? a : (remap_entry_valid(b) ? b : NULL);
+        remap_sector[i] = e ? (uint16_t)(e[2] | (e[3] << 8)) : REMAP_FREE;
+
+        /* A torn entry still used up its spare */
+        static const uint8_t erased[W25_REMAP_ENTRY_SIZE] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+        if (e != NULL || memcmp(a, erased, sizeof(a)) != 0 || memcmp(b, erased, sizeof(b)) != 0) {
+            remap_used = (uint16_t)(i + 1);
+            if (e == NULL) remap_sector[i] = W25_REMAP_RETIRED;
+        }
+    }
+    return true;
+}
+
+bool w25q128_remap_read(uint32_t addr, uint8_t *buf, uint32_t len) {
+    REMAP_LOCK();
+    bool ok = true;
+    while (ok && len) {
+        uint32_t chunk = FLASH_SECTOR_SIZE - (addr % FLASH_SECTOR_SIZE);
+        if (chunk > len || remap_used == 0) chunk = len;
+        ok = w25q128_read_bytes(remap_lookup(addr), buf, chunk);
+        addr += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+    REMAP_UNLOCK();
+    return ok;
+}
+
+bool w25q128_remap_write_page(uint32_t addr, const uint8_t *data, uint32_t len) {
+    if (len > FLASH_PROGRAM_PAGE_SIZE || (addr % FLASH_PROGRAM_PAGE_SIZE) + len > FLASH_PROGRAM_PAGE_SIZE) return false;
+    REMAP_LOCK();
+    bool ok = remap_program(remap_lookup(addr), data, len);
+    if (!ok) {
+        remap_stats.program_failures++;
+        ok = remap_in_region(addr) && remap_replace(addr, data, len);
+    }
+    REMAP_UNLOCK();
+    return ok;
+}
+
+bool w25q128_remap_check_page(uint32_t addr, const uint8_t *data, uint32_t len) {
+    if (len > FLASH_PROGRAM_PAGE_SIZE || (addr % FLASH_PROGRAM_PAGE_SIZE) + len > FLASH_PROGRAM_PAGE_SIZE) return false;
+    REMAP_LOCK();
+    bool ok = remap_verify(remap_lookup(addr), data, len);
+    if (!ok) {
+        remap_stats.program_failures++;
+        ok = remap_in_region(addr) && remap_replace(addr, data, len);
+    }
+    REMAP_UNLOCK();
+    return ok;
+}
+
+bool w25q128_remap_erase_sector(uint32_t addr) {
+    REMAP_LOCK();
+    uint32_t phys = SECTOR_ALIGN(remap_lookup(addr));
+    bool ok = w25q128_erase_sector(phys) && remap_blank(phys);
+    if (!ok) {
+        remap_stats.erase_failures++;
+        ok = remap_in_region(addr) && remap_replace(addr, NULL, 0);
+    }
+    REMAP_UNLOCK();
+    return ok;
+}
+
+uint32_t w25q128_remap_physical(uint32_t addr) {
+    REMAP_LOCK();
+    uint32_t phys = remap_lookup(addr);
+    REMAP_UNLOCK();
+    return phys;
+}
+
+void w25q128_remap_get_stats(w25q128_remap_stats_t *stats) {
+    REMAP_LOCK();
+    *stats = remap_stats;
+    stats->spares_used = remap_used;
+    stats->spares_free = (uint16_t)(REMAP_SPARE_COUNT - remap_used);
+    stats->remapped = 0;
+    for (uint16_t i = 0; i < remap_used; i++) {
+        if (remap_sector[i] == W25_REMAP_RETIRED) continue;
+        bool newest = true;     /* Count each logical sector once */
+        for (uint16_t j = (uint16_t)(i + 1); j < remap_used && newest; j++) newest = (remap_sector[j] != remap_sector[i]);
+        if (newest) stats->remapped++;
+    }
+    REMAP_UNLOCK();
+}
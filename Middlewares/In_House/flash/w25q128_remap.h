@@ -0,0 +1,92 @@
+/**
+ * @file w25q128_remap.h
+ * @brief Verified program/erase with bad-sector remapping for the data regions
+ *
+ * @details Drop-in for w25q128_read_bytes/write_page/erase_sector. Every
+ *          program is read back (each 0 bit written must read 0, so clearing
+ *          bits in already-programmed bytes verifies too) and every erase is
+ *          blank-checked. When either fails in REMAP_REGION_START ..
+ *          REMAP_REGION_END, the logical sector moves to the next spare at the
+ *          top of RESERVED: a program failure copies the sector over first,
+ *          with the new data merged in; an erase failure just takes an erased
+ *          spare. Callers keep using logical addresses.
+ *
+ *          The table holds one 8-byte entry per spare, slot i describing
+ *          spare i, so it is append-only and never erased:
+ *
+ *              magic:u8 0xFF sector:u16 check:u32 (= ~first four bytes)
+ *
+ *          Two copies are written; a slot counts if either copy verifies. A
+ *          spare is copied before its entry is written, so a power cut during
+ *          remapping leaves the old mapping in place. Spares that fail
+ *          themselves are retired (sector W25_REMAP_RETIRED) and the next one
+ *          is tried. The firmware slots and the bootloader are outside the
+ *          remapped range: the bootloader reads them without this layer.
+ *
+ * @note  Reads are not checked: the part has no ECC to report with.
+ */
+
+#ifndef W25Q128_REMAP_H
+#define W25Q128_REMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define W25_REMAP_MAGIC             0x52        /* 'R' */
+#define W25_REMAP_ENTRY_SIZE        8
+#define W25_REMAP_RETIRED           0xFFFE      /* Spare that failed itself */
+
+typedef struct {
+    uint16_t spares_used;       /**< Including retired spares */
+    uint16_t spares_free;
+    uint16_t remapped;          /**< Logical sectors living in a spare */
+    uint32_t program_failures;  /**< Since boot */
+    uint32_t erase_failures;    /**< Since boot */
+} w25q128_remap_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Load the remap table
+ * @note  Call after w25q128_init(), before the log and other region users
+ * @return true if the table could be read
+ */
+bool w25q128_remap_init(void);
+
+/**
+ * @brief Read through the remap table (may span sectors)
+ */
+bool w25q128_remap_read(uint32_t addr, uint8_t *buf, uint32_t len);
+
+/**
+ * @brief Program within one page, verify, remap the sector on failure
+ * @return true if the data is in flash (possibly in a spare)
+ */
+bool w25q128_remap_write_page(uint32_t addr, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Verify a page programmed at w25q128_remap_physical(addr) without this
+ *        layer (DMA), remap the sector on failure
+ * @return true if the data is in flash (possibly in a spare)
+ */
+bool w25q128_remap_check_page(uint32_t addr, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Erase a sector, blank-check, remap it on failure
+ */
+bool w25q128_remap_erase_sector(uint32_t addr);
+
+/**
+ * @brief Physical address a logical address currently maps to
+ */
+uint32_t w25q128_remap_physical(uint32_t addr);
+
+void w25q128_remap_get_stats(w25q128_remap_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* W25Q128_REMAP_H */
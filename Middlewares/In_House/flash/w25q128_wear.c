@@ -0,0 +1,316 @@
+/**
+ * @file w25q128_wear.c
+ * @brief Per-sector erase counters and wear reporting
+ *
+ * Two locks: wear_mutex guards the RAM batch and is only held for a few
+ * instructions, so the driver can count from any task; wear_bank_mutex is
+ * held across flash access to the banks. A flush erases sectors itself and
+ * so counts into the batch while merging it: entries up to wear_frozen are
+ * being merged and are not touched, new counts go after them.
+ */
+
+#include "w25q128_wear.h"
+#include "w25q128.h"
+#include "../../../Core/Inc/flash_config.h"
+#include "crc32.h"
+#include <string.h>
+
+#define WEAR_CHUNK          64      /* Counters are read and written in chunks of 16 */
+#define WEAR_SECTORS        (FLASH_TOTAL_SIZE / FLASH_SECTOR_SIZE)
+#define WEAR_BANK_ADDR(b)   (WEAR_BASE_ADDR + (uint32_t)(b) * WEAR_BANK_SIZE)
+#define WEAR_HEADER_ADDR(b) (WEAR_BANK_ADDR(b) + WEAR_SECTORS * 4)
+#define WEAR_HEADER_SIZE    16
+#define WEAR_NONE           0xFF
+#define WEAR_BATCH_SPARE    16      /* Room left for the flush's own erases */
+#define WEAR_ON_TIME_SAVE_S 86400UL /* Flush for the power-on time alone once a day */
+
+typedef struct {
+    uint16_t sector;
+    uint16_t count;
+} wear_entry_t;
+
+static osMutexId_t wear_mutex;
+static const osMutexAttr_t wear_mutex_attr = {
+    .name = "wearMutex"
+};
+static osMutexId_t wear_bank_mutex;
+static const osMutexAttr_t wear_bank_mutex_attr = {
+    .name = "wearBankMutex"
+};
+
+#define WEAR_LOCK()   osMutexAcquire(wear_mutex, FLASH_MUTEX_TIMEOUT)
+#define WEAR_UNLOCK() osMutexRelease(wear_mutex)
+
+static wear_entry_t wear_batch[W25_WEAR_BATCH];
+static uint8_t wear_len = 0;
+static uint8_t wear_frozen = 0;         /* Entries the running flush is merging */
+static volatile bool wear_flushing = false;
+
+static uint8_t wear_bank = WEAR_NONE;   /* Current bank */
+static uint32_t wear_seq = 0;
+static uint32_t wear_on_s = 0;          /* Power-on time, stored plus this boot */
+static uint32_t wear_on_saved_s = 0;    /* Part of it in the current bank */
+static uint32_t wear_on_tick = 0;       /* Tick wear_on_s is counted up to */
+static uint32_t wear_flush_tick = 0;
+static uint32_t wear_flushes = 0;
+static uint32_t wear_dropped = 0;
+
+static uint8_t wear_chunk[WEAR_CHUNK];
+
+static inline void wear_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t wear_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t wear_chunk_count(uint8_t i) {
+    return ~wear_get32(&wear_chunk[i * 4]);
+}
+
+static inline void wear_chunk_set(uint8_t i, uint32_t count) {
+    wear_put32(&wear_chunk[i * 4], ~count);
+}
+
+/* Caller holds wear_mutex */
+static void wear_clock(void) {
+    uint32_t elapsed_s = (HAL_GetTick() - wear_on_tick) / 1000;
+    wear_on_s += elapsed_s;
+    wear_on_tick += elapsed_s * 1000;
+}
+
+// ============================================================================
+// BANKS
+// ============================================================================
+
+/**
+ * @brief Counters of sectors first..first+15 from the current bank
+ */
+static bool wear_chunk_load(uint32_t first) {
+    if (wear_bank == WEAR_NONE) {
+        memset(wear_chunk, 0xFF, sizeof(wear_chunk));
+        return true;
+    }
+    return w25q128_read_bytes(WEAR_BANK_ADDR(wear_bank) + first * 4, wear_chunk, WEAR_CHUNK);
+}
+
+/**
+ * @brief Add the first n batch entries (at most) to the chunk
+ */
+static void wear_chunk_apply(uint32_t first, uint8_t n) {
+    WEAR_LOCK();
+    if (n > wear_len) n = wear_len;
+    for (uint8_t i = 0; i < n; i++) {
+        uint32_t rel = wear_batch[i].sector - first;
+        if (wear_batch[i].sector < first || rel >= WEAR_CHUNK / 4) continue;
+        uint32_t count = wear_chunk_count((uint8_t)rel);
+        wear_chunk_set((uint8_t)rel, (count > 0xFFFFFFFFUL - wear_batch[i].count) ? 0xFFFFFFFFUL : count + wear_batch[i].count);
+    }
+    WEAR_UNLOCK();
+}
+
+static bool wear_bank_check(uint8_t bank, uint32_t *seq, uint32_t *on_s) {
+    uint8_t header[WEAR_HEADER_SIZE];
+    if (!w25q128_read_bytes(WEAR_HEADER_ADDR(bank), header, sizeof(header)) ||
+        wear_get32(&header[0]) != W25_WEAR_MAGIC) {
+        return false;
+    }
+    uint32_t crc = CRC32_INIT;
+    for (uint32_t off = 0; off < WEAR_SECTORS * 4; off += WEAR_CHUNK) {
+        if (!w25q128_read_bytes(WEAR_BANK_ADDR(bank) + off, wear_chunk, WEAR_CHUNK)) return false;
+        crc = crc32_update(crc, wear_chunk, WEAR_CHUNK);
+    }
+    if ((crc32_update(crc, header, 12) ^ 0xFFFFFFFFUL) != wear_get32(&header[12])) return false;
+    *seq = wear_get32(&header[4]);
+    *on_s = wear_get32(&header[8]);
+    return true;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+bool w25q128_wear_init(void) {
+    if (wear_mutex == NULL) {
+        wear_mutex = osMutexNew(&wear_mutex_attr);
+        wear_bank_mutex = osMutexNew(&wear_bank_mutex_attr);
+        if (wear_mutex == NULL || wear_bank_mutex == NULL) return false;
+    }
+    osMutexAcquire(wear_bank_mutex, FLASH_MUTEX_TIMEOUT);
+    uint32_t seq[2], on_s[2];
+    bool valid[2];
+    for (uint8_t b = 0; b < 2; b++) valid[b] = wear_bank_check(b, &seq[b], &on_s[b]);
+
+    wear_bank = WEAR_NONE;
+    if (valid[0] || valid[1]) {
+        wear_bank = (valid[1] && (!valid[0] || (int32_t)(seq[1] - seq[0]) > 0)) ? 1 : 0;
+    }
+    WEAR_LOCK();
+    wear_seq = (wear_bank == WEAR_NONE) ? 0 : seq[wear_bank];
+    wear_on_s = wear_on_saved_s = (wear_bank == WEAR_NONE) ? 0 : on_s[wear_bank];
+    wear_on_tick = wear_flush_tick = HAL_GetTick();
+    wear_len = 0;
+    wear_frozen = 0;
+    WEAR_UNLOCK();
+    osMutexRelease(wear_bank_mutex);
+    return wear_bank != WEAR_NONE;
+}
+
+void w25q128_wear_note(uint32_t addr) {
+    if (wear_mutex == NULL) return;
+    uint16_t sector = (uint16_t)ADDR_TO_SECTOR(addr);
+    WEAR_LOCK();
+    uint8_t i = wear_frozen;
+    while (i < wear_len && wear_batch[i].sector != sector) i++;
+    if (i < wear_len) {
+        if (wear_batch[i].count < 0xFFFF) wear_batch[i].count++;
+    } else if (wear_len < W25_WEAR_BATCH) {
+        wear_batch[wear_len].sector = sector;
+        wear_batch[wear_len].count = 1;
+        wear_len++;
+    } else {
+        wear_dropped++;
+    }
+    bool full = (wear_len >= W25_WEAR_BATCH - WEAR_BATCH_SPARE);
+    WEAR_UNLOCK();
+    /* Not from inside a flush: its own erases just queue */
+    if (full && !wear_flushing) w25q128_wear_flush();
+}
+
+void w25q128_wear_poll(void) {
+    if (wear_mutex == NULL) return;
+    WEAR_LOCK();
+    wear_clock();
+    bool due = (HAL_GetTick() - wear_flush_tick) >= FLASH_WEAR_FLUSH_MS &&
+               (wear_len > 0 || (wear_on_s - wear_on_saved_s) >= WEAR_ON_TIME_SAVE_S);
+    WEAR_UNLOCK();
+    if (due) w25q128_wear_flush();
+}
+
+bool w25q128_wear_flush(void) {
+    if (wear_bank_mutex == NULL) return false;
+    osMutexAcquire(wear_bank_mutex, FLASH_MUTEX_TIMEOUT);
+    wear_flushing = true;
+    WEAR_LOCK();
+    uint8_t n = wear_len;
+    wear_frozen = n;
+    wear_clock();
+    uint32_t on_s = wear_on_s;
+    WEAR_UNLOCK();
+
+    /* Into the other bank, header last */
+    uint8_t target = (wear_bank == 0) ? 1 : 0;
+    bool ok = true;
+    for (uint32_t off = 0; ok && off < WEAR_BANK_SIZE; off += FLASH_SECTOR_SIZE) {
+        ok = w25q128_erase_sector(WEAR_BANK_ADDR(target) + off);
+    }
+    uint32_t crc = CRC32_INIT;
+    for (uint32_t first = 0; ok && first < WEAR_SECTORS; first += WEAR_CHUNK / 4) {
+        ok = wear_chunk_load(first);
+        if (!ok) break;
+        wear_chunk_apply(first, n);
+        crc = crc32_update(crc, wear_chunk, WEAR_CHUNK);
+        bool erased = true;
+        for (uint8_t i = 0; i < WEAR_CHUNK && erased; i++) erased = (wear_chunk[i] == 0xFF);
+        if (!erased) ok = w25q128_write_page(WEAR_BANK_ADDR(target) + first * 4, wear_chunk, WEAR_CHUNK);
+    }
+    if (ok) {
+        uint8_t header[WEAR_HEADER_SIZE], check[WEAR_HEADER_SIZE];
+        wear_put32(&header[0], W25_WEAR_MAGIC);
+        wear_put32(&header[4], wear_seq + 1);
+        wear_put32(&header[8], on_s);
+        wear_put32(&header[12], crc32_update(crc, header, 12) ^ 0xFFFFFFFFUL);
+        ok = w25q128_write_page(WEAR_HEADER_ADDR(target), header, sizeof(header)) &&
+             w25q128_read_bytes(WEAR_HEADER_ADDR(target), check, sizeof(check)) &&
+             memcmp(header, check, sizeof(header)) == 0;
+    }
+
+    WEAR_LOCK();
+    if (ok) {
+        /* Keep what was counted during the flush */
+        memmove(wear_batch, &wear_batch[n], (size_t)(wear_len - n) * sizeof(wear_entry_t));
+        wear_len = (uint8_t)(wear_len - n);
+        wear_bank = target;
+        wear_seq++;
+        wear_on_saved_s = on_s;
+        wear_flushes++;
+    }
+    wear_frozen = 0;
+    wear_flush_tick = HAL_GetTick();
+    WEAR_UNLOCK();
+    wear_flushing = false;
+    osMutexRelease(wear_bank_mutex);
+    return ok;
+}
+
+bool w25q128_wear_read(uint32_t addr, uint32_t *counts, uint16_t n) {
+    uint32_t first = ADDR_TO_SECTOR(addr);
+    if (wear_bank_mutex == NULL || counts == NULL || first + n > WEAR_SECTORS) return false;
+    osMutexAcquire(wear_bank_mutex, FLASH_MUTEX_TIMEOUT);
+    bool ok = true;
+    if (wear_bank == WEAR_NONE) {
+        memset(counts, 0, (size_t)n * 4);
+    } else {
+        /* Decoded in place: counts[i] only overwrites the four bytes it was read from */
+        uint8_t *raw = (uint8_t *)counts;
+        ok = w25q128_read_bytes(WEAR_BANK_ADDR(wear_bank) + first * 4, raw, (uint32_t)n * 4);
+        for (uint16_t i = 0; ok && i < n; i++) counts[i] = ~wear_get32(&raw[i * 4]);
+    }
+    WEAR_LOCK();
+    for (uint8_t i = 0; ok && i < wear_len; i++) {
+        uint32_t rel = wear_batch[i].sector - first;
+        if (wear_batch[i].sector < first || rel >= n) continue;
+        counts[rel] = (counts[rel] > 0xFFFFFFFFUL - wear_batch[i].count) ? 0xFFFFFFFFUL : counts[rel] + wear_batch[i].count;
+    }
+    WEAR_UNLOCK();
+    osMutexRelease(wear_bank_mutex);
+    return ok;
+}
+
+flash_status_t w25q128_wear_get_stats(w25q128_wear_stats_t *stats) {
+    static const uint32_t limits[W25_WEAR_BUCKETS] = W25_WEAR_BUCKET_LIMITS;
+    if (stats == NULL) return FLASH_STATUS_INVALID_PARAM;
+    if (wear_bank_mutex == NULL) return FLASH_STATUS_ERROR;
+    memset(stats, 0, sizeof(*stats));
+
+    osMutexAcquire(wear_bank_mutex, FLASH_MUTEX_TIMEOUT);
+    flash_status_t st = FLASH_STATUS_OK;
+    for (uint32_t first = 0; first < WEAR_SECTORS; first += WEAR_CHUNK / 4) {
+        if (!wear_chunk_load(first)) {
+            st = FLASH_STATUS_ERROR;
+            break;
+        }
+        wear_chunk_apply(first, W25_WEAR_BATCH);
+        for (uint8_t i = 0; i < WEAR_CHUNK / 4; i++) {
+            uint32_t count = wear_chunk_count(i);
+            stats->total_erases += count;
+            if (count > stats->max_count) {
+                stats->max_count = count;
+                stats->hottest_addr = (first + i) * FLASH_SECTOR_SIZE;
+            }
+            uint8_t b = 0;
+            while (count > limits[b]) b++;
+            stats->histogram[b]++;
+        }
+    }
+    WEAR_LOCK();
+    wear_clock();
+    stats->power_on_s = wear_on_s;
+    stats->flushes = wear_flushes;
+    stats->dropped = wear_dropped;
+    WEAR_UNLOCK();
+    osMutexRelease(wear_bank_mutex);
+
+    stats->mean_count = stats->total_erases / WEAR_SECTORS;
+    stats->life_hours = W25_WEAR_NO_ESTIMATE;
+    if (stats->max_count >= FLASH_WEAR_ENDURANCE) {
+        stats->life_hours = 0;
+    } else if (stats->max_count > 0 && stats->power_on_s > 0) {
+        /* The hottest sector keeps its average rate so far */
+        uint64_t hours = (uint64_t)(FLASH_WEAR_ENDURANCE - stats->max_count) * stats->power_on_s /
+                         stats->max_count / 3600;
+        stats->life_hours = (hours < W25_WEAR_NO_ESTIMATE) ? (uint32_t)hours : W25_WEAR_NO_ESTIMATE - 1;
+    }
+    return st;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file w25q128_wear.h
+ * @brief Per-sector erase counters and wear reporting
+ *
+ * @details The driver reports every sector erase here. Counts collect in a
+ *          RAM batch of W25_WEAR_BATCH (sector, count) pairs and are folded
+ *          into flash when the batch fills, every FLASH_WEAR_FLUSH_MS while
+ *          counts are pending, and once a day to save the power-on time.
+ *
+ *          WEAR_AREA_SIZE holds two banks. A bank is one u32 per physical
+ *          sector, stored inverted so unworn sectors stay erased, followed by
+ *          a header sector:
+ *
+ *              0        ~count:u32 for sector 0, 1, ...
+ *              4 * N    magic:u32 seq:u32 power_on_s:u32 crc:u32
+ *
+ *          The CRC covers the counters and then the first 12 header bytes. A
+ *          flush merges the batch into a copy of the current bank written to
+ *          the other one, header last, so a power cut loses at most the batch.
+ *          Counters saturate at 0xFFFFFFFF, far past FLASH_WEAR_ENDURANCE.
+ *
+ *          Counts are physical: a remapped sector's erases land on its spare.
+ *
+ * @note  Lifetime is projected from the hottest sector: its count over the
+ *        accumulated power-on time gives the rate, FLASH_WEAR_ENDURANCE the
+ *        limit.
+ */
+
+#ifndef W25Q128_WEAR_H
+#define W25Q128_WEAR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../../../Core/Inc/flash_config.h"
+
+#define W25_WEAR_MAGIC              0x32414557  /* "WEA2": u32 counters */
+#define W25_WEAR_BATCH              64          /* Distinct sectors counted in RAM */
+#define W25_WEAR_BUCKETS            8
+#define W25_WEAR_NO_ESTIMATE        0xFFFFFFFFUL
+
+/* Inclusive upper erase count of each histogram bucket */
+#define W25_WEAR_BUCKET_LIMITS      { 0, 9, 99, 999, 9999, 49999, 99999, 0xFFFFFFFFUL }
+
+typedef struct {
+    uint32_t total_erases;      /**< Sum over all sectors */
+    uint32_t power_on_s;        /**< Accumulated over all boots */
+    uint32_t hottest_addr;
+    uint32_t max_count;
+    uint32_t mean_count;
+    uint16_t histogram[W25_WEAR_BUCKETS];   /**< Sectors per W25_WEAR_BUCKET_LIMITS bucket */
+    uint32_t life_hours;        /**< Projected remaining, W25_WEAR_NO_ESTIMATE without erases */
+    uint32_t flushes;           /**< Since boot */
+    uint32_t dropped;           /**< Erases not counted: batch full during a flush */
+} w25q128_wear_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Load the newest valid bank
+ * @note  Call right after w25q128_init(); erases before this are not counted
+ * @return false if no bank was found (counting starts from zero)
+ */
+bool w25q128_wear_init(void);
+
+/**
+ * @brief Count one erase of the sector holding addr (called by the driver)
+ */
+void w25q128_wear_note(uint32_t addr);
+
+/**
+ * @brief Flush on the FLASH_WEAR_FLUSH_MS and daily schedule; call periodically
+ */
+void w25q128_wear_poll(void);
+
+/**
+ * @brief Fold the batch into flash now
+ */
+bool w25q128_wear_flush(void);
+
+/**
+ * @brief Erase counts of n consecutive sectors starting at the one holding addr
+ * @note  For allocators that prefer cold sectors: one read per call
+ */
+bool w25q128_wear_read(uint32_t addr, uint32_t *counts, uint16_t n);
+
+/**
+ * @brief Histogram and projection (reads every counter)
+ */
+flash_status_t w25q128_wear_get_stats(w25q128_wear_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* W25Q128_WEAR_H */
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""
+STM32 Benchmark Collector
+-------------------------
+Receives the microbenchmark results sent by a board built with BENCH_ENABLED=1
+(Core/Src/bench.c), echoes its UDP round-trip probes, prints the results and
+optionally compares them against a stored baseline.
+
+Usage:
+python bench_collect.py                          # print one run
+python bench_collect.py --save baseline.json     # store the run as baseline
+python bench_collect.py --baseline baseline.json --threshold 5
+
+With --baseline the exit code is 1 if any kernel's mean got slower than the
+threshold (percent), so the script can gate a performance change. To measure
+the RAM-resident hot paths (ramfunc.h), save a run from a -DRAMFUNC_ENABLED=0
+build and compare the default build against it.
+
+Dependencies:
+- Python 3.x
+"""
+
+import socket
+import struct
+import json
+import sys
+import argparse
+
+BENCH_PORT = 8002
+BENCH_MAGIC = 0x42
+ECHO_MAGIC = 0x45
+BENCH_VERSION = 1
+HEADER = struct.Struct(">BBBBII")
+RECORD = struct.Struct(">16sIHHIII")
+FLAG_LAST = 0x01
+FLAG_RAMFUNC = 0x02  # hot paths built to run from RAM (RAMFUNC_ENABLED)
+TIMEOUT = 60  # seconds to wait for a complete run
+
+
+def parse_packet(data):
+    """Decode one result datagram into (run_id, core_hz, flags, records)"""
+    magic, version, count, flags, run_id, core_hz = HEADER.unpack_from(data)
+    if magic != BENCH_MAGIC or version != BENCH_VERSION:
+        return None
+    records = []
+    for i in range(count):
+        name, param, iterations, failures, cmin, cmean, cmax = RECORD.unpack_from(
+            data, HEADER.size + i * RECORD.size)
+        name = name.rstrip(b"\0").decode()
+        records.append({
+            "kernel": f"{name}/{param}",
+            "iterations": iterations,
+            "failures": failures,
+            "min": cmin,
+            "mean": cmean,
+            "max": cmax,
+        })
+    return run_id, core_hz, flags, records
+
+
+def collect(port, timeout):
+    """Wait for one complete run, echoing round-trip probes meanwhile"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", port))
+    sock.settimeout(timeout)
+
+    runs = {}
+    try:
+        while True:
+            data, addr = sock.recvfrom(2048)
+            if not data:
+                continue
+            if data[0] == ECHO_MAGIC:
+                sock.sendto(data, addr)
+                continue
+            if len(data) < HEADER.size:
+                continue
+            parsed = parse_packet(data)
+            if parsed is None:
+                continue
+            run_id, core_hz, flags, records = parsed
+            run = runs.setdefault(run_id, {"board": addr[0], "core_hz": core_hz,
+                                           "ramfunc": bool(flags & FLAG_RAMFUNC), "results": []})
+            run["results"].extend(records)
+            if flags & FLAG_LAST:
+                return run
+    except socket.timeout:
+        return None
+    finally:
+        sock.close()
+
+
+def placement(run):
+    """Where the RAMFUNC hot paths ran (baselines saved before the flag say flash)"""
+    return "RAM" if run.get("ramfunc") else "flash"
+
+
+def print_run(run, baseline=None):
+    """Print the results table, with the change against the baseline if given"""
+    mhz = run["core_hz"] / 1e6
+    base = {r["kernel"]: r for r in baseline["results"]} if baseline else {}
+
+    print(f"\nBoard {run['board']} @ {mhz:.0f} MHz, hot paths in {placement(run)}")
+    if baseline:
+        print(f"Baseline: hot paths in {placement(baseline)}")
+    print(f"{'kernel':<22}{'min':>10}{'mean':>10}{'max':>10}{'mean us':>10}{'fail':>6}"
+          f"{'d cycles':>10}{'vs base':>10}")
+    print("-" * 88)
+    for r in run["results"]:
+        cycles = delta = ""
+        if r["kernel"] in base and base[r["kernel"]]["mean"]:
+            diff = r["mean"] - base[r["kernel"]]["mean"]
+            cycles = f"{diff:+d}"
+            delta = f"{diff * 100.0 / base[r['kernel']]['mean']:+.1f}%"
+        print(f"{r['kernel']:<22}{r['min']:>10}{r['mean']:>10}{r['max']:>10}"
+              f"{r['mean'] / mhz:>10.1f}{r['failures']:>6}{cycles:>10}{delta:>10}")
+
+
+def regressions(run, baseline, threshold):
+    """Kernels whose mean got slower than threshold percent"""
+    base = {r["kernel"]: r for r in baseline["results"]}
+    slower = []
+    for r in run["results"]:
+        ref = base.get(r["kernel"])
+        if ref and ref["mean"] and (r["mean"] - ref["mean"]) * 100.0 / ref["mean"] > threshold:
+            slower.append(r["kernel"])
+    return slower
+
+
+def main():
+    parser = argparse.ArgumentParser(description="STM32 benchmark collector")
+    parser.add_argument("--port", type=int, default=BENCH_PORT, help=f"UDP port (default: {BENCH_PORT})")
+    parser.add_argument("--timeout", type=float, default=TIMEOUT, help="Seconds to wait for a run")
+    parser.add_argument("--save", metavar="FILE", help="Store this run as a baseline")
+    parser.add_argument("--baseline", metavar="FILE", help="Compare against a stored baseline")
+    parser.add_argument("--threshold", type=float, default=5.0, help="Allowed slowdown in percent")
+    args = parser.parse_args()
+
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    print(f"Waiting for benchmark results on UDP port {args.port}...")
+    run = collect(args.port, args.timeout)
+    if run is None:
+        print("No complete run received")
+        sys.exit(2)
+
+    print_run(run, baseline)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(run, f, indent=2)
+        print(f"\nBaseline saved to {args.save}")
+
+    if baseline:
+        slower = regressions(run, baseline, args.threshold)
+        if slower:
+            print(f"\nSlower than baseline by more than {args.threshold}%: {', '.join(slower)}")
+            sys.exit(1)
+        print(f"\nNo kernel slower than baseline by more than {args.threshold}%")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""
+Gorilla Stream Decoder
+----------------------
+Decodes the time-series bit streams of Core/Src/gorilla.c (format in
+Core/Inc/gorilla.h): delta-of-delta timestamps, delta/zig-zag varint integer
+channels and XOR channels. Every stream starts from zero state, so each
+datagram decodes on its own.
+
+Used as a module by the collectors (sync_collect.py); from the command line it
+prints the records of a raw stream.
+
+Usage:
+python gorilla.py block.bin -c 2 -n 64
+python gorilla.py block.bin -c 2 -n 64 --xor 0x2   # channel 1 XOR-coded
+
+Dependencies:
+- Python 3.x
+"""
+
+import sys
+import argparse
+
+MASK32 = 0xFFFFFFFF
+
+
+class BitReader:
+    """MSB-first bit reader over bytes"""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def remaining(self):
+        return len(self.data) * 8 - self.pos
+
+    def read(self, n):
+        if n > self.remaining():
+            raise ValueError("stream truncated")
+        value = 0
+        for _ in range(n):
+            byte = self.data[self.pos >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return value
+
+
+def signed(value, bits):
+    """Two's complement value of the low bits"""
+    return value - (1 << bits) if value & (1 << (bits - 1)) else value
+
+
+class Decoder:
+    """State of one stream, reset per datagram like gorilla_begin()"""
+
+    def __init__(self, channels, xor_mask=0):
+        self.channels = channels
+        self.xor_mask = xor_mask
+        self.prev_ts = 0
+        self.prev_delta = 0
+        self.prev = [0] * channels
+        self.window = [None] * channels    # (lead, len)
+
+    def timestamp(self, r):
+        if r.read(1) == 0:
+            dod = 0
+        elif r.read(1) == 0:
+            dod = signed(r.read(7), 7)
+        elif r.read(1) == 0:
+            dod = signed(r.read(9), 9)
+        elif r.read(1) == 0:
+            dod = signed(r.read(12), 12)
+        else:
+            dod = r.read(32)
+        self.prev_delta = (self.prev_delta + dod) & MASK32
+        self.prev_ts = (self.prev_ts + self.prev_delta) & MASK32
+        return self.prev_ts
+
+    def delta_value(self, r, ch):
+        if r.read(1):
+            z, shift = 0, 0
+            while True:
+                group = r.read(4)
+                z |= (group & 7) << shift
+                shift += 3
+                if not group & 8:
+                    break
+            z += 1
+            d = (z >> 1) ^ -(z & 1)
+            self.prev[ch] = (self.prev[ch] + d) & MASK32
+        return self.prev[ch]
+
+    def xor_value(self, r, ch):
+        if r.read(1):
+            if r.read(1) == 0:
+                lead, length = self.window[ch]
+            else:
+                lead = r.read(5)
+                length = r.read(5) + 1
+                self.window[ch] = (lead, length)
+            self.prev[ch] ^= r.read(length) << (32 - lead - length)
+        return self.prev[ch]
+
+    def record(self, r):
+        ts = self.timestamp(r)
+        values = [self.xor_value(r, ch) if self.xor_mask & (1 << ch) else self.delta_value(r, ch)
+                  for ch in range(self.channels)]
+        return ts, values
+
+
+def decode(data, channels, count, xor_mask=0):
+    """Records [(timestamp, [values])] of one stream of count records
+
+    The count comes from the datagram header: the zero padding of the last
+    byte would otherwise read as more records.
+    """
+    r = BitReader(data)
+    d = Decoder(channels, xor_mask)
+    return [d.record(r) for _ in range(count)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode a gorilla.c stream")
+    parser.add_argument("file", help="Raw stream bytes")
+    parser.add_argument("-c", "--channels", type=int, required=True, help="Values per record")
+    parser.add_argument("-n", "--count", type=int, required=True, help="Records in the stream")
+    parser.add_argument("--xor", type=lambda s: int(s, 0), default=0, help="Mask of XOR-coded channels")
+    args = parser.parse_args()
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+    try:
+        records = decode(data, args.channels, args.count, args.xor)
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        sys.exit(1)
+    for ts, values in records:
+        print(ts, " ".join(str(v) for v in values))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,487 @@
+/**
+ * @file fs_bench.c
+ * @brief Benchmark and power-cut torture test for the flash file store
+ *
+ * @details Runs w25q128_fs.c on the flash simulator through the unmodified
+ *          driver and remap layer, without the RTOS tasks or the network:
+ *
+ *            fs_bench bench                  mount/open cost, throughput
+ *            fs_bench torture [rounds] [seed]  random operations with power cuts
+ *            fs_bench grow [seed]            grow LOG under a full store, with
+ *                                            power cuts during the migration
+ *
+ *          Flash time is estimated from the simulator counters: SPI bytes at
+ *          FS_BENCH_SPI_HZ plus datasheet typical program and erase times,
+ *          so W25Q128_SIM_FAST can stay set. The image defaults to
+ *          fs_bench.bin (env W25Q128_SIM_IMAGE) and is formatted at start.
+ *
+ *          The torture test keeps a model of every committed file (content is
+ *          a function of a generation number and the offset), arms a cut at a
+ *          random program/erase, runs operations until the power fails, then
+ *          remounts and checks every file against the model. Only the
+ *          operation in flight at the cut may land either way.
+ *
+ *          The grow test fills the store, grows LOG so that USER_DATA has to
+ *          move up, then reboots with a cut armed until the partition
+ *          migration completes, and checks the files at their new place.
+ */
+
+#include "flash_config.h"
+#include "cmsis_os.h"
+#include "w25q128_sim.h"
+#include "w25q128.h"
+#include "w25q128_remap.h"
+#include "w25q128_fs.h"
+#include "w25q128_part.h"
+#include "w25q128_wear.h"
+#include "crc32.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FS_BENCH_SPI_HZ         18000000.0      /* SPI1 clock limit of the F103 */
+#define FS_BENCH_IMAGE          "fs_bench.bin"
+#define FS_BENCH_OPENS          200
+#define FS_BENCH_STREAM_SIZE    (1024UL * 1024)
+#define FS_BENCH_IO_SIZE        4096
+#define FS_BENCH_SMALL_IO       64
+
+#define TORTURE_NAMES           12
+#define TORTURE_MAX_SIZE        (20 * 1024)
+#define TORTURE_OPS_PER_ROUND   40
+
+void Error_Handler(void) {
+    fprintf(stderr, "Error_Handler called\n");
+    abort();
+}
+
+static uint8_t io_buf[FS_BENCH_IO_SIZE];
+static uint8_t check_buf[FS_BENCH_IO_SIZE];
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static double flash_us(const w25q128_sim_counters_t *c) {
+    return (double)c->spi_bytes * 8.0 * 1e6 / FS_BENCH_SPI_HZ +
+           (double)c->programs * W25Q128_SIM_T_PP_US + (double)c->erases * W25Q128_SIM_T_SE_US;
+}
+
+static void report(const char *what, uint32_t n, double wall_us) {
+    w25q128_sim_counters_t c;
+    w25q128_sim_get_counters(&c);
+    printf("  %-28s %9.1f read cmds %7.1f programs %6.2f erases %8.0f us flash %7.1f us host\n", what,
+           (double)c.read_cmds / n, (double)c.programs / n, (double)c.erases / n, flash_us(&c) / n, wall_us / n);
+}
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint8_t content(uint32_t gen, uint32_t offset) {
+    uint32_t x = gen * 0x9E3779B1UL + offset * 0x85EBCA6BUL;
+    x ^= x >> 15;
+    return (uint8_t)(x ^ (x >> 8));
+}
+
+/* Boot: the driver state goes with the MCU, the flash image stays */
+static bool fs_init(void) {
+    if (!w25q128_init()) {
+        printf("W25Q128 init failed\n");
+        return false;
+    }
+    w25q128_wear_init();
+    if (!w25q128_remap_init()) {
+        printf("remap init failed\n");
+        return false;
+    }
+    if (!w25q128_part_init()) {
+        printf("partition table init failed\n");
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// BENCHMARK
+// ============================================================================
+
+static bool write_file(const char *name, uint32_t gen, uint32_t size) {
+    w25q128_file_t f;
+    if (w25q128_fs_open(&f, name, W25_FS_WRITE) != FLASH_STATUS_OK) return false;
+    for (uint32_t off = 0; off < size; off += FS_BENCH_IO_SIZE) {
+        uint32_t n = (size - off < FS_BENCH_IO_SIZE) ? size - off : FS_BENCH_IO_SIZE;
+        for (uint32_t i = 0; i < n; i++) io_buf[i] = content(gen, off + i);
+        if (w25q128_fs_write(&f, io_buf, n) != (int32_t)n) return false;
+    }
+    return w25q128_fs_close(&f) == FLASH_STATUS_OK;
+}
+
+static int bench(void) {
+    w25q128_sim_reset_counters();
+    double t0 = now_us();
+    if (w25q128_fs_format() != FLASH_STATUS_OK) {
+        printf("format failed\n");
+        return 1;
+    }
+    printf("Per operation:\n");
+    report("format", 1, now_us() - t0);
+
+    char name[W25_FS_NAME_MAX + 1];
+    uint16_t created = 0;
+    static const uint16_t checkpoints[] = { 1, 16, W25_FS_MAX_FILES };
+    for (uint8_t c = 0; c < sizeof(checkpoints) / sizeof(checkpoints[0]); c++) {
+        w25q128_sim_reset_counters();
+        uint16_t first = created;
+        t0 = now_us();
+        /* Created out of order, so every commit inserts mid-directory */
+        for (; created < checkpoints[c]; created++) {
+            snprintf(name, sizeof(name), "file%03u", (unsigned)((created * 37U) % W25_FS_MAX_FILES));
+            if (!write_file(name, created, 100)) {
+                printf("create %s failed\n", name);
+                return 1;
+            }
+        }
+        if (c == 2) report("create 100 B, 16..127 files", (uint32_t)(created - first), now_us() - t0);
+        /* Names in use: (k * 37) % 127 for k < created */
+        char label[40];
+        w25q128_file_t f;
+        w25q128_sim_reset_counters();
+        t0 = now_us();
+        for (uint32_t i = 0; i < FS_BENCH_OPENS; i++) {
+            snprintf(name, sizeof(name), "file%03u", (unsigned)(((rng() % created) * 37U) % W25_FS_MAX_FILES));
+            if (w25q128_fs_open(&f, name, W25_FS_READ) != FLASH_STATUS_OK) printf("open %s failed\n", name);
+            w25q128_fs_close(&f);
+        }
+        snprintf(label, sizeof(label), "open, %u files", created);
+        report(label, FS_BENCH_OPENS, now_us() - t0);
+    }
+
+    w25q128_sim_reset_counters();
+    t0 = now_us();
+    if (w25q128_fs_mount(false) != FLASH_STATUS_OK) {
+        printf("mount failed\n");
+        return 1;
+    }
+    report("mount, 127 files", 1, now_us() - t0);
+
+    if (w25q128_fs_remove("file000") != FLASH_STATUS_OK) {
+        printf("remove failed\n");
+        return 1;
+    }
+    w25q128_sim_reset_counters();
+    t0 = now_us();
+    if (!write_file("stream.bin", 7, FS_BENCH_STREAM_SIZE)) {
+        printf("stream write failed\n");
+        return 1;
+    }
+    double wall = now_us() - t0;
+    w25q128_sim_counters_t c;
+    w25q128_sim_get_counters(&c);
+    printf("Streaming %lu KB in %u-byte calls:\n", FS_BENCH_STREAM_SIZE / 1024, FS_BENCH_IO_SIZE);
+    printf("  write  %6.1f KB/s flash (%lu programs, %lu erases), %7.1f MB/s host\n",
+           FS_BENCH_STREAM_SIZE / 1024.0 / (flash_us(&c) / 1e6), (unsigned long)c.programs, (unsigned long)c.erases,
+           FS_BENCH_STREAM_SIZE / wall);
+
+    w25q128_file_t f;
+    w25q128_sim_reset_counters();
+    t0 = now_us();
+    if (w25q128_fs_open(&f, "stream.bin", W25_FS_READ) != FLASH_STATUS_OK) return 1;
+    for (uint32_t off = 0; off < FS_BENCH_STREAM_SIZE; off += FS_BENCH_IO_SIZE) {
+        if (w25q128_fs_read(&f, io_buf, FS_BENCH_IO_SIZE) != FS_BENCH_IO_SIZE) {
+            printf("stream read failed\n");
+            return 1;
+        }
+        for (uint32_t i = 0; i < FS_BENCH_IO_SIZE; i++) {
+            if (io_buf[i] != content(7, off + i)) {
+                printf("stream mismatch at %lu\n", (unsigned long)(off + i));
+                return 1;
+            }
+        }
+    }
+    wall = now_us() - t0;
+    w25q128_sim_get_counters(&c);
+    printf("  read   %6.1f KB/s flash (%lu read cmds), %7.1f MB/s host\n",
+           FS_BENCH_STREAM_SIZE / 1024.0 / (flash_us(&c) / 1e6), (unsigned long)c.read_cmds, FS_BENCH_STREAM_SIZE / wall);
+
+    /* Small calls: each continues the flash READ session of the one before */
+    w25q128_sim_reset_counters();
+    t0 = now_us();
+    w25q128_fs_seek(&f, 0);
+    for (uint32_t off = 0; off < FS_BENCH_STREAM_SIZE; off += FS_BENCH_SMALL_IO) {
+        if (w25q128_fs_read(&f, io_buf, FS_BENCH_SMALL_IO) != FS_BENCH_SMALL_IO || io_buf[0] != content(7, off)) {
+            printf("small read failed at %lu\n", (unsigned long)off);
+            return 1;
+        }
+    }
+    wall = now_us() - t0;
+    w25q128_sim_get_counters(&c);
+    printf("  read   %6.1f KB/s flash (%lu read cmds) in %u-byte calls, %7.1f MB/s host\n",
+           FS_BENCH_STREAM_SIZE / 1024.0 / (flash_us(&c) / 1e6), (unsigned long)c.read_cmds, FS_BENCH_SMALL_IO,
+           FS_BENCH_STREAM_SIZE / wall);
+
+    w25q128_sim_reset_counters();
+    t0 = now_us();
+    for (uint32_t i = 0; i < FS_BENCH_OPENS; i++) {
+        w25q128_fs_seek(&f, (rng() % (FS_BENCH_STREAM_SIZE / 64)) * 64);
+        w25q128_fs_read(&f, io_buf, 64);
+    }
+    w25q128_fs_close(&f);
+    printf("Random access in a 1 MB file:\n");
+    report("seek + read 64 B", FS_BENCH_OPENS, now_us() - t0);
+
+    w25q128_fs_stats_t st;
+    w25q128_fs_get_stats(&st);
+    printf("Store: %u files, %u/%u blocks, %lu commits since mount\n", st.files, st.blocks_used, st.blocks_total,
+           (unsigned long)st.commits);
+    return 0;
+}
+
+// ============================================================================
+// TORTURE
+// ============================================================================
+
+typedef struct {
+    bool exists;
+    uint32_t gen;
+    uint32_t size;
+} model_file_t;
+
+static model_file_t model[TORTURE_NAMES];
+static model_file_t flight;         /* State of the in-flight file if its operation landed */
+static int flight_idx = -1;
+
+static void torture_name(int i, char *name) {
+    snprintf(name, W25_FS_NAME_MAX + 1, "t%02d.dat", i);
+}
+
+static bool check_file(int i, const model_file_t *m, bool quiet) {
+    char name[W25_FS_NAME_MAX + 1];
+    torture_name(i, name);
+    w25q128_fs_info_t info;
+    flash_status_t st = w25q128_fs_stat(name, &info);
+    if (!m->exists) {
+        if (st != FLASH_STATUS_NOT_FOUND && !quiet) printf("%s: exists, expected none\n", name);
+        return st == FLASH_STATUS_NOT_FOUND;
+    }
+    if (st != FLASH_STATUS_OK || info.size != m->size) {
+        if (!quiet) printf("%s: stat %d size %lu, expected %lu\n", name, st, (unsigned long)info.size, (unsigned long)m->size);
+        return false;
+    }
+    w25q128_file_t f;
+    if (w25q128_fs_open(&f, name, W25_FS_READ) != FLASH_STATUS_OK) return false;
+    uint32_t crc = 0xFFFFFFFFUL;
+    bool ok = true;
+    for (uint32_t off = 0; ok && off < m->size; off += FS_BENCH_IO_SIZE) {
+        uint32_t n = (m->size - off < FS_BENCH_IO_SIZE) ? m->size - off : FS_BENCH_IO_SIZE;
+        ok = (w25q128_fs_read(&f, check_buf, n) == (int32_t)n);
+        for (uint32_t k = 0; ok && k < n; k++) ok = (check_buf[k] == content(m->gen, off + k));
+        if (ok) crc = crc32_update(crc, check_buf, n);
+    }
+    w25q128_fs_close(&f);
+    if (ok && (crc ^ 0xFFFFFFFFUL) != info.crc) ok = false;
+    if (!ok && !quiet) printf("%s: content differs from generation %lu\n", name, (unsigned long)m->gen);
+    return ok;
+}
+
+/**
+ * @brief One random operation; updates the model once it has returned
+ */
+static void torture_op(uint32_t gen) {
+    char name[W25_FS_NAME_MAX + 1];
+    int i = (int)(rng() % TORTURE_NAMES);
+    torture_name(i, name);
+    model_file_t next = model[i];
+    uint32_t r = rng() % 10;
+    flight_idx = i;
+
+    if (r < 2) {
+        next.exists = false;
+        flight = next;
+        flash_status_t st = w25q128_fs_remove(name);
+        if (w25q128_sim_power_lost()) return;
+        if (st != FLASH_STATUS_OK && !(st == FLASH_STATUS_NOT_FOUND && !model[i].exists)) {
+            printf("remove %s: %d\n", name, st);
+            exit(1);
+        }
+    } else {
+        bool append = (r < 5) && model[i].exists;
+        uint32_t len = rng() % TORTURE_MAX_SIZE;
+        if (!append) {
+            next.gen = gen;
+            next.size = 0;
+        }
+        next.exists = true;
+        /* Only the close commits: until then the file is still model[i] */
+        flight = model[i];
+        w25q128_file_t f;
+        flash_status_t st = w25q128_fs_open(&f, name, append ? W25_FS_APPEND : W25_FS_WRITE);
+        for (uint32_t off = 0; st == FLASH_STATUS_OK && off < len;) {
+            uint32_t n = 1 + rng() % 700;
+            if (n > len - off) n = len - off;
+            for (uint32_t k = 0; k < n; k++) io_buf[k] = content(next.gen, next.size + off + k);
+            if (w25q128_fs_write(&f, io_buf, n) != (int32_t)n) st = FLASH_STATUS_ERROR;
+            off += n;
+        }
+        if (w25q128_sim_power_lost()) return;
+        next.size += len;
+        flight = next;
+        if (st == FLASH_STATUS_OK) st = w25q128_fs_close(&f);
+        if (w25q128_sim_power_lost()) return;
+        if (st != FLASH_STATUS_OK) {
+            printf("%s %s: %d\n", append ? "append" : "write", name, st);
+            exit(1);
+        }
+    }
+    model[i] = next;
+    flight_idx = -1;
+}
+
+static int torture(uint32_t rounds, uint32_t seed) {
+    rng_state = seed ? seed : 1;
+    if (w25q128_fs_format() != FLASH_STATUS_OK) {
+        printf("format failed\n");
+        return 1;
+    }
+    memset(model, 0, sizeof(model));
+    uint32_t gen = 1, cuts = 0, landed = 0;
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        bool cut = (rng() % 4) != 0;
+        if (cut) w25q128_sim_power_cut(1 + rng() % 400, rng());
+        flight_idx = -1;
+        for (uint32_t op = 0; op < TORTURE_OPS_PER_ROUND && !w25q128_sim_power_lost(); op++) torture_op(gen++);
+
+        /* Reboot */
+        if (w25q128_sim_power_lost()) cuts++;
+        w25q128_sim_power_restore();
+        if (!fs_init()) return 1;
+        flash_status_t st = w25q128_fs_mount(false);
+        if (st != FLASH_STATUS_OK) {
+            printf("round %lu: mount failed (%d)\n", (unsigned long)round, st);
+            return 1;
+        }
+        if (flight_idx >= 0) {
+            /* Cut mid-operation: either outcome is fine, nothing else is */
+            model_file_t *m = &model[flight_idx];
+            bool differs = flight.exists != m->exists || (flight.exists && (flight.gen != m->gen || flight.size != m->size));
+            if (differs && check_file(flight_idx, &flight, true)) {
+                *m = flight;
+                landed++;
+            }
+        }
+        for (int i = 0; i < TORTURE_NAMES; i++) {
+            if (!check_file(i, &model[i], false)) {
+                printf("round %lu: %s file %d corrupted\n", (unsigned long)round, cut ? "after cut," : "", i);
+                return 1;
+            }
+        }
+    }
+
+    w25q128_fs_stats_t st;
+    w25q128_fs_get_stats(&st);
+    w25q128_remap_stats_t rs;
+    w25q128_remap_get_stats(&rs);
+    printf("Torture: %lu rounds, %lu power cuts (%lu mid-operation commits landed), all files intact\n",
+           (unsigned long)rounds, (unsigned long)cuts, (unsigned long)landed);
+    printf("Store: %u files, %u/%u blocks, directory block at %u cycles; %u sectors remapped\n",
+           st.files, st.blocks_used, st.blocks_total, st.dir_cycles, rs.remapped);
+    w25q128_wear_flush();
+    w25q128_wear_stats_t ws;
+    w25q128_wear_get_stats(&ws);
+    printf("Wear: %lu erases, hottest sector 0x%06lX at %lu, mean %lu, %u sectors at 1-9, %u at 10-99, %u at 100-999\n",
+           (unsigned long)ws.total_erases, (unsigned long)ws.hottest_addr,
+           (unsigned long)ws.max_count, (unsigned long)ws.mean_count,
+           ws.histogram[1], ws.histogram[2], ws.histogram[3]);
+    return 0;
+}
+
+// ============================================================================
+// PARTITION GROWTH
+// ============================================================================
+
+#define GROW_SECTORS            64
+
+static int grow(uint32_t seed) {
+    rng_state = seed ? seed : 1;
+    if (w25q128_fs_format() != FLASH_STATUS_OK) {
+        printf("format failed\n");
+        return 1;
+    }
+    for (int i = 0; i < TORTURE_NAMES; i++) {
+        char name[W25_FS_NAME_MAX + 1];
+        torture_name(i, name);
+        model[i] = (model_file_t){ true, (uint32_t)i + 1, rng() % TORTURE_MAX_SIZE };
+        if (!write_file(name, model[i].gen, model[i].size)) {
+            printf("write %s failed\n", name);
+            return 1;
+        }
+    }
+    uint32_t log_size = LOG_SIZE, user_base = USER_DATA_BASE_ADDR, seq = w25q128_part_seq();
+    flash_status_t st = w25q128_part_grow(FLASH_PART_LOG, log_size + GROW_SECTORS * FLASH_SECTOR_SIZE);
+    if (st != FLASH_STATUS_OK) {
+        printf("grow failed (%d)\n", st);
+        return 1;
+    }
+    if (LOG_SIZE != log_size || w25q128_part_grow(FLASH_PART_LOG, log_size + 2 * GROW_SECTORS * FLASH_SECTOR_SIZE) !=
+        FLASH_STATUS_BUSY) {
+        printf("layout changed before reboot\n");
+        return 1;
+    }
+
+    /* Reboot until the migration gets through */
+    uint32_t boots = 0;
+    double t0 = now_us();
+    do {
+        w25q128_sim_power_cut(1 + rng() % 1000, rng());
+        fs_init();
+        boots++;
+        w25q128_sim_power_restore();
+    } while (w25q128_part_migrating() || w25q128_part_seq() < seq + 2);
+    if (!fs_init() || w25q128_fs_mount(false) != FLASH_STATUS_OK) {
+        printf("mount after migration failed\n");
+        return 1;
+    }
+    for (int i = 0; i < TORTURE_NAMES; i++) {
+        if (!check_file(i, &model[i], false)) return 1;
+    }
+    printf("Grow: LOG %lu -> %lu KB, USER_DATA 0x%06lX -> 0x%06lX, %lu boots (%lu cut), %.0f ms host, all files intact\n",
+           (unsigned long)(log_size / 1024), (unsigned long)(LOG_SIZE / 1024), (unsigned long)user_base,
+           (unsigned long)USER_DATA_BASE_ADDR, (unsigned long)boots, (unsigned long)(boots - 1), (now_us() - t0) / 1000);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    const char *mode = (argc > 1) ? argv[1] : "bench";
+    const char *image = getenv("W25Q128_SIM_IMAGE");
+    if (!w25q128_sim_init(image ? image : FS_BENCH_IMAGE)) return 1;
+
+    osKernelInitialize();
+    if (!fs_init()) return 1;
+    printf("File store: %lu KB at 0x%06lX, %u files max\n", (unsigned long)(USER_DATA_SIZE / 1024),
+           (unsigned long)USER_DATA_BASE_ADDR, (unsigned)W25_FS_MAX_FILES);
+
+    if (strcmp(mode, "bench") == 0) return bench();
+    if (strcmp(mode, "torture") == 0) {
+        uint32_t rounds = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 200;
+        uint32_t seed = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : (uint32_t)time(NULL);
+        printf("Seed %lu\n", (unsigned long)seed);
+        return torture(rounds, seed);
+    }
+    if (strcmp(mode, "grow") == 0) {
+        uint32_t seed = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : (uint32_t)time(NULL);
+        printf("Seed %lu\n", (unsigned long)seed);
+        return grow(seed);
+    }
+    printf("usage: fs_bench [bench | torture [rounds] [seed] | grow [seed]]\n");
+    return 2;
+}
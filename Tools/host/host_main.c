@@ -0,0 +1,74 @@
+/**
+ * @file host_main.c
+ * @brief Entry point of the host-native firmware build
+ *
+ * @details Stands in for Core/Src/main.c: the CubeMX peripheral init is
+ *          replaced by the simulators, then the same MX_FREERTOS_Init() and
+ *          kernel start run the application tasks on pthreads.
+ *
+ *          Set HOST_RUN_MS to exit cleanly after that many milliseconds, so
+ *          profilers that write their data at exit (callgrind, heaptrack)
+ *          get a complete run. The peak stack use of each task is printed
+ *          then (run with LD_BIND_NOW=1, or lazy symbol binding adds a few
+ *          KB of glibc frames to it).
+ */
+
+#include "main.h"
+#include "flash_config.h"
+#include "cmsis_os.h"
+#include "boot_prof.h"
+#include "w5500_sim.h"
+#include "w25q128_sim.h"
+#include "w25q128.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+extern char **host_argv;
+
+void MX_FREERTOS_Init(void);
+
+static void *host_run_timer(void *arg) {
+    usleep((useconds_t)(uintptr_t)arg * 1000U);
+    printf("Host run time elapsed, exiting\n");
+    host_stack_report();
+    exit(0);
+    return NULL;
+}
+
+void Error_Handler(void) {
+    fprintf(stderr, "Error_Handler called\n");
+    abort();
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    host_argv = argv;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    HAL_GetTick();                          /* Tick 0 is now */
+    boot_prof_start();
+
+    if (!w5500_sim_init() || !w25q128_sim_init(NULL)) {
+        return 1;
+    }
+
+    const char *run_ms = getenv("HOST_RUN_MS");
+    if (run_ms != NULL) {
+        pthread_t timer;
+        pthread_create(&timer, NULL, host_run_timer, (void *)(uintptr_t)strtoul(run_ms, NULL, 0));
+    }
+
+    osKernelInitialize();
+#if FLASH_DRIVER_ENABLED
+    if (!w25q128_init()) {
+        printf("W25Q128 init failed\n");
+    } else {
+        printf("W25Q128: %lu MB, %u-byte addresses\n",
+               (unsigned long)(w25q128_get_size() >> 20), w25q128_get_addr_bytes());
+    }
+#endif
+    MX_FREERTOS_Init();
+    osKernelStart();
+    return 0;
+}
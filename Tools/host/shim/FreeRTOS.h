@@ -0,0 +1,30 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host shim for the few FreeRTOS kernel calls made outside CMSIS-RTOS2
+ *
+ * @details The heap functions map onto the C library so heaptrack and valgrind
+ *          see every allocation. xPortGetFreeHeapSize() reports the target heap
+ *          size minus the bytes currently allocated through pvPortMalloc().
+ */
+
+#ifndef FREERTOS_SHIM_H
+#define FREERTOS_SHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define configTOTAL_HEAP_SIZE   ((size_t)4864)
+
+void *pvPortMalloc(size_t xSize);
+void vPortFree(void *pv);
+size_t xPortGetFreeHeapSize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FREERTOS_SHIM_H
@@ -0,0 +1,14 @@
+/**
+ * @file cmsis_os.h
+ * @brief Host shim: CMSIS-RTOS2 API without the FreeRTOS port headers
+ */
+
+#ifndef CMSIS_OS_SHIM_H
+#define CMSIS_OS_SHIM_H
+
+#include "cmsis_os2.h"
+
+/* Host only: peak stack use of every thread so far (cmsis_os2_posix.c) */
+void host_stack_report(void);
+
+#endif // CMSIS_OS_SHIM_H
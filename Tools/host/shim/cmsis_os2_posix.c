@@ -0,0 +1,499 @@
+/**
+ * @file cmsis_os2_posix.c
+ * @brief CMSIS-RTOS2 subset on POSIX threads for the host-native build
+ *
+ * @details Covers what the application uses: kernel start/lock, threads,
+ *          delays, mutexes, semaphores and message queues. Threads created
+ *          before osKernelStart() wait until it is called, as on FreeRTOS.
+ *
+ *          Differences from the target, by design:
+ *          - Threads run truly in parallel and priorities are ignored.
+ *          - osKernelLock() only excludes other osKernelLock() holders; it does
+ *            not stop unrelated threads.
+ *          - Stacks are HOST_STACK_SIZE, not attr->stack_size: the target
+ *            sizes are far too small for glibc printf. They are painted, so
+ *            osThreadGetStackSpace() measures the peak use and reports what
+ *            that would leave of attr->stack_size (0 if it would not fit).
+ *            x86-64 frames are larger than Cortex-M3 ones, so the host peak
+ *            is an upper bound; host_stack_report() prints it per thread.
+ */
+
+#define _GNU_SOURCE
+#include "cmsis_os2.h"
+#include "FreeRTOS.h"
+#include "stm32f1xx_hal.h"
+#include "trace.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdio.h>
+
+typedef struct {
+    pthread_t thread;
+    osThreadFunc_t func;
+    void *argument;
+    const char *name;
+    uint8_t *stack;             /* HOST_STACK_SIZE, painted */
+    uint32_t stack_size;        /* attr->stack_size, as on the target */
+    uint8_t *stack_top;         /* Stack pointer at entry, below glibc's TLS */
+} host_thread_t;
+
+#define HOST_MAX_THREADS 16
+#define HOST_STACK_SIZE  (256U * 1024U)
+#define HOST_STACK_PAINT 0xA5
+
+static host_thread_t host_threads[HOST_MAX_THREADS];
+static uint32_t host_thread_count = 0;
+static osKernelState_t host_kernel_state = osKernelInactive;
+
+static pthread_mutex_t host_start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t host_kernel_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int32_t host_lock_depth = 0;
+static __thread host_thread_t *host_self = NULL;
+
+static size_t host_heap_used = 0;
+static pthread_mutex_t host_heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Absolute CLOCK_REALTIME deadline timeout ms from now, for pthread timed waits */
+static struct timespec host_deadline(uint32_t timeout) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout / 1000U;
+    ts.tv_nsec += (long)(timeout % 1000U) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+// ============================================================================
+// KERNEL
+// ============================================================================
+
+osStatus_t osKernelInitialize(void) {
+    host_kernel_state = osKernelReady;
+    return osOK;
+}
+
+osKernelState_t osKernelGetState(void) {
+    return host_kernel_state;
+}
+
+osStatus_t osKernelStart(void) {
+    pthread_mutex_lock(&host_start_lock);
+    host_kernel_state = osKernelRunning;
+    pthread_cond_broadcast(&host_start_cond);
+    pthread_mutex_unlock(&host_start_lock);
+
+    /* Like vTaskStartScheduler(): does not return while tasks run */
+    for (uint32_t i = 0; i < host_thread_count; i++) {
+        pthread_join(host_threads[i].thread, NULL);
+    }
+    return osOK;
+}
+
+int32_t osKernelLock(void) {
+    if (host_lock_depth++ > 0) return 1;
+    pthread_mutex_lock(&host_kernel_lock);
+    return 0;
+}
+
+int32_t osKernelUnlock(void) {
+    if (host_lock_depth == 0) return 0;
+    if (--host_lock_depth == 0) pthread_mutex_unlock(&host_kernel_lock);
+    return 1;
+}
+
+int32_t osKernelRestoreLock(int32_t lock) {
+    if (lock) {
+        if (host_lock_depth == 0) osKernelLock();
+    } else {
+        while (host_lock_depth > 0) osKernelUnlock();
+    }
+    return lock;
+}
+
+uint32_t osKernelGetTickCount(void) {
+    return HAL_GetTick();
+}
+
+uint32_t osKernelGetTickFreq(void) {
+    return 1000U;
+}
+
+// ============================================================================
+// THREADS
+// ============================================================================
+
+static void *host_thread_entry(void *arg) {
+    host_thread_t *t = (host_thread_t *)arg;
+    host_self = t;
+    uint8_t here;
+    t->stack_top = &here;
+
+    pthread_mutex_lock(&host_start_lock);
+    while (host_kernel_state != osKernelRunning) {
+        pthread_cond_wait(&host_start_cond, &host_start_lock);
+    }
+    pthread_mutex_unlock(&host_start_lock);
+
+    t->func(t->argument);
+    return NULL;
+}
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void *argument, const osThreadAttr_t *attr) {
+    if (func == NULL || host_thread_count >= HOST_MAX_THREADS) return NULL;
+
+    host_thread_t *t = &host_threads[host_thread_count];
+    t->func = func;
+    t->argument = argument;
+    t->name = (attr != NULL) ? attr->name : NULL;
+    t->stack_size = (attr != NULL) ? attr->stack_size : 0;
+
+    /* Painted like FreeRTOS does, to find the peak use afterwards */
+    pthread_attr_t pattr;
+    t->stack = malloc(HOST_STACK_SIZE);
+    if (t->stack == NULL) return NULL;
+    memset(t->stack, HOST_STACK_PAINT, HOST_STACK_SIZE);
+    pthread_attr_init(&pattr);
+    pthread_attr_setstack(&pattr, t->stack, HOST_STACK_SIZE);
+    int err = pthread_create(&t->thread, &pattr, host_thread_entry, t);
+    pthread_attr_destroy(&pattr);
+    if (err != 0) {
+        free(t->stack);
+        return NULL;
+    }
+#ifdef __GLIBC__
+    if (t->name != NULL) {
+        char short_name[16];
+        strncpy(short_name, t->name, sizeof(short_name) - 1);
+        short_name[sizeof(short_name) - 1] = '\0';
+        pthread_setname_np(t->thread, short_name);
+    }
+#endif
+    host_thread_count++;
+#if TRACE_ENABLED
+    trace_task_create((uint8_t)host_thread_count, t->name);    /* Numbered from 1, as by FreeRTOS */
+#endif
+    return (osThreadId_t)t;
+}
+
+/* Deepest byte ever written, from the task entry: the stack grows down */
+static uint32_t host_stack_peak(const host_thread_t *t) {
+    if (t->stack_top == NULL) return 0;
+    uint32_t untouched = 0;
+    while (untouched < HOST_STACK_SIZE && t->stack[untouched] == HOST_STACK_PAINT) untouched++;
+    return (uint32_t)(t->stack_top - &t->stack[untouched]);
+}
+
+uint32_t osThreadGetStackSpace(osThreadId_t thread_id) {
+    if (thread_id == NULL) return 0;
+    const host_thread_t *t = (const host_thread_t *)thread_id;
+    uint32_t peak = host_stack_peak(t);
+    return (peak < t->stack_size) ? t->stack_size - peak : 0;
+}
+
+void host_stack_report(void) {
+    for (uint32_t i = 0; i < host_thread_count; i++) {
+        fprintf(stderr, "Stack: %-16s peak %5lu bytes (target %lu)\n", host_threads[i].name ? host_threads[i].name : "?",
+               (unsigned long)host_stack_peak(&host_threads[i]), (unsigned long)host_threads[i].stack_size);
+    }
+}
+
+const char *osThreadGetName(osThreadId_t thread_id) {
+    return (thread_id != NULL) ? ((host_thread_t *)thread_id)->name : NULL;
+}
+
+osThreadId_t osThreadGetId(void) {
+    return (osThreadId_t)host_self;
+}
+
+osStatus_t osThreadYield(void) {
+    sched_yield();
+    return osOK;
+}
+
+__NO_RETURN void osThreadExit(void) {
+    pthread_exit(NULL);
+}
+
+osStatus_t osDelay(uint32_t ticks) {
+    struct timespec ts = {
+        .tv_sec = ticks / 1000U,
+        .tv_nsec = (long)(ticks % 1000U) * 1000000L
+    };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+    return osOK;
+}
+
+osStatus_t osDelayUntil(uint32_t ticks) {
+    int32_t remaining = (int32_t)(ticks - HAL_GetTick());
+    if (remaining > 0) osDelay((uint32_t)remaining);
+    return osOK;
+}
+
+// ============================================================================
+// MUTEXES
+// ============================================================================
+
+osMutexId_t osMutexNew(const osMutexAttr_t *attr) {
+    (void)attr;
+    pthread_mutex_t *m = malloc(sizeof(*m));
+    if (m == NULL) return NULL;
+
+    /* Always recursive: harmless for non-recursive users */
+    pthread_mutexattr_t ma;
+    pthread_mutexattr_init(&ma);
+    pthread_mutexattr_settype(&ma, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(m, &ma);
+    pthread_mutexattr_destroy(&ma);
+    return (osMutexId_t)m;
+}
+
+osStatus_t osMutexAcquire(osMutexId_t mutex_id, uint32_t timeout) {
+    pthread_mutex_t *m = (pthread_mutex_t *)mutex_id;
+    if (m == NULL) return osErrorParameter;
+
+    if (timeout == osWaitForever) {
+        return pthread_mutex_lock(m) == 0 ? osOK : osError;
+    }
+    if (timeout == 0) {
+        return pthread_mutex_trylock(m) == 0 ? osOK : osErrorResource;
+    }
+    struct timespec ts = host_deadline(timeout);
+    return pthread_mutex_timedlock(m, &ts) == 0 ? osOK : osErrorTimeout;
+}
+
+osStatus_t osMutexRelease(osMutexId_t mutex_id) {
+    pthread_mutex_t *m = (pthread_mutex_t *)mutex_id;
+    if (m == NULL) return osErrorParameter;
+    return pthread_mutex_unlock(m) == 0 ? osOK : osErrorResource;
+}
+
+osStatus_t osMutexDelete(osMutexId_t mutex_id) {
+    pthread_mutex_t *m = (pthread_mutex_t *)mutex_id;
+    if (m == NULL) return osErrorParameter;
+    pthread_mutex_destroy(m);
+    free(m);
+    return osOK;
+}
+
+// ============================================================================
+// SEMAPHORES
+// ============================================================================
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t count;
+    uint32_t max;
+} host_semaphore_t;
+
+osSemaphoreId_t osSemaphoreNew(uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t *attr) {
+    (void)attr;
+    if (max_count == 0 || initial_count > max_count) return NULL;
+
+    host_semaphore_t *s = malloc(sizeof(*s));
+    if (s == NULL) return NULL;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->count = initial_count;
+    s->max = max_count;
+    return (osSemaphoreId_t)s;
+}
+
+osStatus_t osSemaphoreAcquire(osSemaphoreId_t semaphore_id, uint32_t timeout) {
+    host_semaphore_t *s = (host_semaphore_t *)semaphore_id;
+    if (s == NULL) return osErrorParameter;
+
+    osStatus_t status = osOK;
+    struct timespec ts = host_deadline(timeout);
+    pthread_mutex_lock(&s->lock);
+    while (s->count == 0) {
+        if (timeout == 0) {
+            status = osErrorResource;
+            break;
+        }
+        int rc = (timeout == osWaitForever) ? pthread_cond_wait(&s->cond, &s->lock)
+                                             : pthread_cond_timedwait(&s->cond, &s->lock, &ts);
+        if (rc == ETIMEDOUT) {
+            status = osErrorTimeout;
+            break;
+        }
+    }
+    if (status == osOK) s->count--;
+    pthread_mutex_unlock(&s->lock);
+    return status;
+}
+
+osStatus_t osSemaphoreRelease(osSemaphoreId_t semaphore_id) {
+    host_semaphore_t *s = (host_semaphore_t *)semaphore_id;
+    if (s == NULL) return osErrorParameter;
+
+    osStatus_t status = osOK;
+    pthread_mutex_lock(&s->lock);
+    if (s->count < s->max) {
+        s->count++;
+        pthread_cond_signal(&s->cond);
+    } else {
+        status = osErrorResource;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return status;
+}
+
+uint32_t osSemaphoreGetCount(osSemaphoreId_t semaphore_id) {
+    host_semaphore_t *s = (host_semaphore_t *)semaphore_id;
+    if (s == NULL) return 0;
+    pthread_mutex_lock(&s->lock);
+    uint32_t count = s->count;
+    pthread_mutex_unlock(&s->lock);
+    return count;
+}
+
+osStatus_t osSemaphoreDelete(osSemaphoreId_t semaphore_id) {
+    host_semaphore_t *s = (host_semaphore_t *)semaphore_id;
+    if (s == NULL) return osErrorParameter;
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s);
+    return osOK;
+}
+
+// ============================================================================
+// MESSAGE QUEUES
+// ============================================================================
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint32_t msg_count;
+    uint32_t msg_size;
+    uint32_t head;
+    uint32_t used;
+    uint8_t *data;
+} host_queue_t;
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t *attr) {
+    (void)attr;
+    if (msg_count == 0 || msg_size == 0) return NULL;
+
+    host_queue_t *q = calloc(1, sizeof(*q));
+    if (q == NULL) return NULL;
+    q->data = malloc((size_t)msg_count * msg_size);
+    if (q->data == NULL) {
+        free(q);
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    q->msg_count = msg_count;
+    q->msg_size = msg_size;
+    return (osMessageQueueId_t)q;
+}
+
+/* Wait on cond until pred is false; returns osOK or the timeout status */
+#define HOST_QUEUE_WAIT(q, cond, pred, timeout, ts, status)                         \
+    while (pred) {                                                                  \
+        if ((timeout) == 0) { (status) = osErrorResource; break; }                  \
+        int rc_ = ((timeout) == osWaitForever) ? pthread_cond_wait(&(cond), &(q)->lock) \
+                                               : pthread_cond_timedwait(&(cond), &(q)->lock, &(ts)); \
+        if (rc_ == ETIMEDOUT) { (status) = osErrorTimeout; break; }                  \
+    }
+
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void *msg_ptr, uint8_t msg_prio, uint32_t timeout) {
+    (void)msg_prio;
+    host_queue_t *q = (host_queue_t *)mq_id;
+    if (q == NULL || msg_ptr == NULL) return osErrorParameter;
+
+    osStatus_t status = osOK;
+    struct timespec ts = host_deadline(timeout);
+    pthread_mutex_lock(&q->lock);
+    HOST_QUEUE_WAIT(q, q->not_full, q->used == q->msg_count, timeout, ts, status);
+    if (status == osOK) {
+        uint32_t tail = (q->head + q->used) % q->msg_count;
+        memcpy(&q->data[(size_t)tail * q->msg_size], msg_ptr, q->msg_size);
+        q->used++;
+        pthread_cond_signal(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return status;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void *msg_ptr, uint8_t *msg_prio, uint32_t timeout) {
+    host_queue_t *q = (host_queue_t *)mq_id;
+    if (q == NULL || msg_ptr == NULL) return osErrorParameter;
+
+    osStatus_t status = osOK;
+    struct timespec ts = host_deadline(timeout);
+    pthread_mutex_lock(&q->lock);
+    HOST_QUEUE_WAIT(q, q->not_empty, q->used == 0, timeout, ts, status);
+    if (status == osOK) {
+        memcpy(msg_ptr, &q->data[(size_t)q->head * q->msg_size], q->msg_size);
+        q->head = (q->head + 1) % q->msg_count;
+        q->used--;
+        if (msg_prio != NULL) *msg_prio = 0;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return status;
+}
+
+uint32_t osMessageQueueGetCount(osMessageQueueId_t mq_id) {
+    host_queue_t *q = (host_queue_t *)mq_id;
+    if (q == NULL) return 0;
+    pthread_mutex_lock(&q->lock);
+    uint32_t used = q->used;
+    pthread_mutex_unlock(&q->lock);
+    return used;
+}
+
+osStatus_t osMessageQueueDelete(osMessageQueueId_t mq_id) {
+    host_queue_t *q = (host_queue_t *)mq_id;
+    if (q == NULL) return osErrorParameter;
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->data);
+    free(q);
+    return osOK;
+}
+
+// ============================================================================
+// HEAP
+// ============================================================================
+
+/* Each block carries its size so vPortFree() can keep the books */
+void *pvPortMalloc(size_t xSize) {
+    size_t *block = malloc(sizeof(size_t) + xSize);
+    if (block == NULL) return NULL;
+    block[0] = xSize;
+    pthread_mutex_lock(&host_heap_lock);
+    host_heap_used += xSize;
+    pthread_mutex_unlock(&host_heap_lock);
+    return &block[1];
+}
+
+void vPortFree(void *pv) {
+    if (pv == NULL) return;
+    size_t *block = (size_t *)pv - 1;
+    pthread_mutex_lock(&host_heap_lock);
+    host_heap_used -= block[0];
+    pthread_mutex_unlock(&host_heap_lock);
+    free(block);
+}
+
+size_t xPortGetFreeHeapSize(void) {
+    pthread_mutex_lock(&host_heap_lock);
+    size_t used = host_heap_used;
+    pthread_mutex_unlock(&host_heap_lock);
+    return (used < configTOTAL_HEAP_SIZE) ? configTOTAL_HEAP_SIZE - used : 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file hal_posix.c
+ * @brief STM32 HAL subset on POSIX for the host-native build
+ *
+ * @details SPI transfers are clocked byte by byte into the simulator selected
+ *          by the instance, exactly as the wires are shared on the board:
+ *
+ *          Instance   Chip select   Device
+ *          SPI1       PA4           W25Q128 (w25q128_sim.c)
+ *          SPI2       PB12          W5500   (w5500_sim.c), reset on PC13
+ *
+ *          HAL_GetTick() is the monotonic clock in milliseconds since start.
+ *          NVIC_SystemReset() re-executes the binary, which keeps the flash
+ *          image, so reboot paths can be exercised too.
+ */
+
+#include "stm32f1xx_hal.h"
+#include "w5500_sim.h"
+#include "w25q128_sim.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+GPIO_TypeDef host_gpio[4];
+SPI_TypeDef host_spi[2];
+TIM_TypeDef host_tim2;
+CoreDebug_Type host_core_debug;
+ITM_Type host_itm;
+uint32_t SystemCoreClock = 72000000U;
+volatile uint32_t uwTick = 0;
+char **host_argv = NULL;
+
+/* Handles normally defined by the CubeMX peripheral sources */
+SPI_HandleTypeDef hspi1 = { .Instance = SPI1 };
+SPI_HandleTypeDef hspi2 = { .Instance = SPI2 };
+TIM_HandleTypeDef htim2 = { .Instance = TIM2 };
+DMA_HandleTypeDef hdma_tim2_ch2_ch4;
+
+static DWT_Type host_dwt_regs;
+
+static uint64_t host_now_ns(void) {
+    static struct timespec start;
+    static bool started = false;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (!started) {
+        start = ts;
+        started = true;
+    }
+    return (uint64_t)(ts.tv_sec - start.tv_sec) * 1000000000ULL + (uint64_t)ts.tv_nsec - (uint64_t)start.tv_nsec;
+}
+
+// ============================================================================
+// CORE
+// ============================================================================
+
+uint32_t HAL_GetTick(void) {
+    uwTick = (uint32_t)(host_now_ns() / 1000000ULL);
+    return uwTick;
+}
+
+void HAL_Delay(uint32_t Delay) {
+    usleep((useconds_t)Delay * 1000U);
+}
+
+void NVIC_SystemReset(void) {
+    fflush(stdout);
+    if (host_argv != NULL) execv("/proc/self/exe", host_argv);
+    perror("NVIC_SystemReset");
+    _exit(1);
+}
+
+static pthread_mutex_t host_irq_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread uint32_t host_primask = 0;
+
+void host_irq_disable(void) {
+    if (host_primask) return;
+    pthread_mutex_lock(&host_irq_lock);
+    host_primask = 1;
+}
+
+uint32_t host_get_primask(void) {
+    return host_primask;
+}
+
+void host_set_primask(uint32_t primask) {
+    if (primask) {
+        host_irq_disable();
+    } else if (host_primask) {
+        host_primask = 0;
+        pthread_mutex_unlock(&host_irq_lock);
+    }
+}
+
+DWT_Type *host_dwt(void) {
+    if (host_dwt_regs.CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+        host_dwt_regs.CYCCNT = (uint32_t)(host_now_ns() * (SystemCoreClock / 1000000U) / 1000U);
+    }
+    return &host_dwt_regs;
+}
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    if (PinState == GPIO_PIN_SET) {
+        GPIOx->ODR |= GPIO_Pin;
+    } else {
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    }
+    GPIOx->IDR = GPIOx->ODR;
+
+    bool low = (PinState == GPIO_PIN_RESET);
+    if (GPIOx == GPIOB && (GPIO_Pin & GPIO_PIN_12)) w5500_sim_select(low);
+    if (GPIOx == GPIOA && (GPIO_Pin & GPIO_PIN_4)) w25q128_sim_select(low);
+    if (GPIOx == GPIOC && (GPIO_Pin & GPIO_PIN_13) && low) w5500_sim_reset();
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    /* W5500 INTn on PA8, active low */
+    if (GPIOx == GPIOA && GPIO_Pin == GPIO_PIN_8) return w5500_sim_irq_pending() ? GPIO_PIN_RESET : GPIO_PIN_SET;
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    HAL_GPIO_WritePin(GPIOx, GPIO_Pin, (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+// ============================================================================
+// SPI
+// ============================================================================
+
+static uint8_t host_spi_exchange(SPI_TypeDef *instance, uint8_t mosi) {
+    if (instance == SPI1) return w25q128_sim_exchange(mosi);
+    if (instance == SPI2) return w5500_sim_exchange(mosi);
+    return 0xFF;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    (void)Timeout;
+    if (pData == NULL || Size == 0) return HAL_ERROR;
+    for (uint16_t i = 0; i < Size; i++) host_spi_exchange(hspi->Instance, pData[i]);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    (void)Timeout;
+    if (pData == NULL || Size == 0) return HAL_ERROR;
+    for (uint16_t i = 0; i < Size; i++) pData[i] = host_spi_exchange(hspi->Instance, 0xFF);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData,
+                                          uint16_t Size, uint32_t Timeout) {
+    (void)Timeout;
+    if (pTxData == NULL || pRxData == NULL || Size == 0) return HAL_ERROR;
+    for (uint16_t i = 0; i < Size; i++) pRxData[i] = host_spi_exchange(hspi->Instance, pTxData[i]);
+    return HAL_OK;
+}
+
+/* Register pump used by the drivers (Core/Src/spi_pump.c on target) */
+void spi_pump_xfer(SPI_TypeDef *spi, const uint8_t *tx, uint8_t *rx, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t miso = host_spi_exchange(spi, (tx != NULL) ? tx[i] : 0x00);
+        if (rx != NULL) rx[i] = miso;
+    }
+}
+
+/* DMA transfers (Core/Src/spi_dma.c on target) complete before returning */
+void spi_dma_start(SPI_TypeDef *spi, const uint8_t *tx, uint8_t *rx, uint16_t len) {
+    spi_pump_xfer(spi, tx, rx, len);
+}
+
+void spi_dma_wait(SPI_TypeDef *spi) {
+    (void)spi;
+}
+
+// ============================================================================
+// TIMER / DMA
+// ============================================================================
+
+/* No detector inputs on the host: the capture ring stays empty */
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress,
+                                uint32_t DataLength) {
+    (void)SrcAddress;
+    (void)DstAddress;
+    hdma->CNDTR = DataLength;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    (void)htim;
+    (void)Channel;
+    return HAL_OK;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file stm32f1xx_hal.h
+ * @brief Host shim for the subset of the STM32F1 HAL used by the application
+ *
+ * @details Replaces the device header and HAL for the host-native build
+ *          (Tools/host). Peripheral instances are plain structs in host memory;
+ *          hal_posix.c routes SPI1/SPI2 traffic and chip selects to the W25Q128
+ *          and W5500 simulators.
+ */
+
+#ifndef STM32F1XX_HAL_SHIM_H
+#define STM32F1XX_HAL_SHIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __IO volatile
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+/* GPIO ----------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t ODR;
+    __IO uint32_t IDR;
+} GPIO_TypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0U,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0  ((uint16_t)0x0001)
+#define GPIO_PIN_1  ((uint16_t)0x0002)
+#define GPIO_PIN_2  ((uint16_t)0x0004)
+#define GPIO_PIN_3  ((uint16_t)0x0008)
+#define GPIO_PIN_4  ((uint16_t)0x0010)
+#define GPIO_PIN_5  ((uint16_t)0x0020)
+#define GPIO_PIN_6  ((uint16_t)0x0040)
+#define GPIO_PIN_7  ((uint16_t)0x0080)
+#define GPIO_PIN_8  ((uint16_t)0x0100)
+#define GPIO_PIN_9  ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+
+extern GPIO_TypeDef host_gpio[4];
+#define GPIOA (&host_gpio[0])
+#define GPIOB (&host_gpio[1])
+#define GPIOC (&host_gpio[2])
+#define GPIOD (&host_gpio[3])
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+/* SPI -----------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SR;
+    __IO uint32_t DR;
+} SPI_TypeDef;
+
+typedef struct {
+    SPI_TypeDef *Instance;
+} SPI_HandleTypeDef;
+
+extern SPI_TypeDef host_spi[2];
+#define SPI1 (&host_spi[0])
+#define SPI2 (&host_spi[1])
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData,
+                                          uint16_t Size, uint32_t Timeout);
+
+/* DMA -----------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t CNDTR;        /**< Remaining transfers, as on the real channel */
+} DMA_HandleTypeDef;
+
+#define __HAL_DMA_GET_COUNTER(__HANDLE__) ((__HANDLE__)->CNDTR)
+
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress,
+                                uint32_t DataLength);
+
+/* TIM -----------------------------------------------------------------------*/
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t CNT;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+    __IO uint32_t DCR;
+    __IO uint32_t DMAR;
+} TIM_TypeDef;
+
+typedef struct {
+    TIM_TypeDef *Instance;
+} TIM_HandleTypeDef;
+
+extern TIM_TypeDef host_tim2;
+#define TIM2 (&host_tim2)
+
+#define TIM_CHANNEL_1                   0x00000000U
+#define TIM_CHANNEL_2                   0x00000004U
+#define TIM_CHANNEL_3                   0x00000008U
+#define TIM_CHANNEL_4                   0x0000000CU
+#define TIM_DMA_CC2                     (1U << 10)
+#define TIM_DMA_CC4                     (1U << 12)
+#define TIM_DMABASE_CCR1                0x0000000DU
+#define TIM_DMABURSTLENGTH_4TRANSFERS   0x00000300U
+
+#define __HAL_TIM_ENABLE_DMA(__HANDLE__, __DMA__) ((__HANDLE__)->Instance->DIER |= (__DMA__))
+
+HAL_StatusTypeDef HAL_TIM_IC_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+
+/* Core ----------------------------------------------------------------------*/
+/* uwTick follows HAL_GetTick(), which the tasks call every few milliseconds */
+extern volatile uint32_t uwTick;
+extern uint32_t SystemCoreClock;
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+void NVIC_SystemReset(void);
+
+/* PRIMASK: one process-wide lock stands in for masking interrupts, so code
+ * shared with ISRs on the target is serialised between the host threads */
+void host_irq_disable(void);
+uint32_t host_get_primask(void);
+void host_set_primask(uint32_t primask);
+#define __disable_irq()  host_irq_disable()
+#define __enable_irq()   host_set_primask(0U)
+#define __get_PRIMASK()  host_get_primask()
+#define __set_PRIMASK(x) host_set_primask(x)
+#define __get_IPSR()     0U     /* Thread mode: no handlers run on the host */
+
+/* DWT cycle counter: host_dwt() refreshes CYCCNT from the monotonic clock,
+ * scaled to SystemCoreClock, so cycle budgets read like on the target. */
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+DWT_Type *host_dwt(void);
+extern CoreDebug_Type host_core_debug;
+#define DWT        (host_dwt())
+#define CoreDebug  (&host_core_debug)
+
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+
+/* ITM: never enabled (no SWO), so stimulus port output is skipped */
+typedef struct {
+    union {
+        __IO uint8_t  u8;
+        __IO uint16_t u16;
+        __IO uint32_t u32;
+    } PORT[32];
+    __IO uint32_t TER;
+    __IO uint32_t TCR;
+} ITM_Type;
+
+extern ITM_Type host_itm;
+#define ITM        (&host_itm)
+
+#define ITM_TCR_ITMENA_Msk          (1UL << 0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STM32F1XX_HAL_SHIM_H
@@ -0,0 +1,17 @@
+/**
+ * @file task.h
+ * @brief Host shim: FreeRTOS task API is not used directly by the application
+ *
+ * @details Only the handle type, for the stack overflow hook in freertos.c
+ *          (never called on the host).
+ */
+
+#ifndef TASK_SHIM_H
+#define TASK_SHIM_H
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+#define xTaskHandle TaskHandle_t
+
+#endif // TASK_SHIM_H
@@ -0,0 +1,411 @@
+/**
+ * @file w25q128_sim.c
+ * @brief W25Q128JV SPI flash simulator
+ */
+
+#include "w25q128_sim.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define SIM_PAGE_SIZE   256U
+
+typedef enum {
+    SIM_PHASE_OPCODE = 0,
+    SIM_PHASE_ADDRESS,
+    SIM_PHASE_DATA
+} sim_phase_t;
+
+static uint8_t *sim_mem = NULL;
+static uint32_t sim_size = W25Q128_SIM_SIZE;
+static uint8_t sim_capacity_id = 0x18;      /* JEDEC ID capacity byte */
+
+#define SIM_STUCK_MAX   16
+static uint32_t sim_stuck[SIM_STUCK_MAX];   /* Worn cells: bytes stuck at 0x00 */
+static uint8_t sim_stuck_count = 0;
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool sim_selected = false;
+static bool sim_fast = false;
+
+static sim_phase_t sim_phase;
+static uint8_t sim_opcode;
+static uint8_t sim_addr_bytes;
+static uint32_t sim_addr;
+static uint32_t sim_data_count;
+static uint8_t sim_page_buf[SIM_PAGE_SIZE];
+static bool sim_page_used[SIM_PAGE_SIZE];
+
+static bool sim_wel = false;
+static bool sim_power_down = false;
+static uint8_t sim_status2 = 0x02;          /* QE set, as shipped for the IQ part */
+static uint64_t sim_busy_until_ns = 0;
+
+static w25q128_sim_counters_t sim_counters;
+static uint32_t sim_cut_countdown = 0;      /* Program/erase that gets torn, 0 = none */
+static unsigned int sim_cut_seed = 0;
+static bool sim_dead = false;
+
+static uint64_t sim_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static bool sim_busy(void) {
+    return sim_now_ns() < sim_busy_until_ns;
+}
+
+static void sim_set_busy(uint32_t us) {
+    sim_busy_until_ns = sim_fast ? 0 : sim_now_ns() + (uint64_t)us * 1000ULL;
+}
+
+static uint8_t sim_status1(void) {
+    return (uint8_t)((sim_busy() ? 0x01 : 0x00) | (sim_wel ? 0x02 : 0x00));
+}
+
+bool w25q128_sim_init(const char *image_path) {
+    if (image_path == NULL) image_path = getenv("W25Q128_SIM_IMAGE");
+    if (image_path == NULL) image_path = W25Q128_SIM_IMAGE;
+    sim_fast = getenv("W25Q128_SIM_FAST") != NULL;
+    const char *stuck = getenv("W25Q128_SIM_STUCK");
+    while (stuck != NULL && *stuck && sim_stuck_count < SIM_STUCK_MAX) {
+        char *end;
+        sim_stuck[sim_stuck_count++] = (uint32_t)strtoul(stuck, &end, 0);
+        stuck = (*end == ',') ? end + 1 : NULL;
+    }
+    const char *mbytes = getenv("W25Q128_SIM_MBYTES");
+    if (mbytes != NULL) {
+        switch (strtoul(mbytes, NULL, 0)) {
+        case 16: sim_size = 0x1000000U; sim_capacity_id = 0x18; break;
+        case 32: sim_size = 0x2000000U; sim_capacity_id = 0x19; break;
+        case 64: sim_size = 0x4000000U; sim_capacity_id = 0x20; break;
+        default:
+            fprintf(stderr, "W25Q128_SIM_MBYTES: 16, 32 or 64\n");
+            return false;
+        }
+    }
+
+    int fd = open(image_path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(image_path);
+        return false;
+    }
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < (off_t)sim_size) {
+        /* New or short image: extend with erased bytes */
+        static uint8_t erased[4096];
+        memset(erased, 0xFF, sizeof(erased));
+        for (off_t off = size; off < (off_t)sim_size; off += (off_t)sizeof(erased)) {
+            size_t n = sizeof(erased);
+            if ((off_t)n > (off_t)sim_size - off) n = (size_t)((off_t)sim_size - off);
+            if (pwrite(fd, erased, n, off) != (ssize_t)n) {
+                perror(image_path);
+                close(fd);
+                return false;
+            }
+        }
+    }
+
+    sim_mem = mmap(NULL, sim_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (sim_mem == MAP_FAILED) {
+        sim_mem = NULL;
+        perror("mmap");
+        return false;
+    }
+    for (uint8_t i = 0; i < sim_stuck_count; i++) sim_stuck[i] &= sim_size - 1U;
+    printf("W25Q128 sim: %s, %u MB%s", image_path, sim_size >> 20, sim_fast ? " (no timing)" : "");
+    if (sim_stuck_count) printf(", %u stuck bytes", sim_stuck_count);
+    printf("\n");
+    return true;
+}
+
+uint8_t *w25q128_sim_memory(void) {
+    return sim_mem;
+}
+
+void w25q128_sim_get_counters(w25q128_sim_counters_t *counters) {
+    pthread_mutex_lock(&sim_lock);
+    *counters = sim_counters;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+void w25q128_sim_reset_counters(void) {
+    pthread_mutex_lock(&sim_lock);
+    memset(&sim_counters, 0, sizeof(sim_counters));
+    pthread_mutex_unlock(&sim_lock);
+}
+
+void w25q128_sim_power_cut(uint32_t ops, uint32_t seed) {
+    pthread_mutex_lock(&sim_lock);
+    sim_cut_countdown = ops;
+    sim_cut_seed = seed;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+bool w25q128_sim_power_lost(void) {
+    return sim_dead;
+}
+
+void w25q128_sim_power_restore(void) {
+    pthread_mutex_lock(&sim_lock);
+    sim_dead = false;
+    sim_cut_countdown = 0;
+    sim_wel = false;
+    sim_power_down = false;
+    sim_busy_until_ns = 0;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+// ============================================================================
+// COMMAND COMPLETION (at /CS high)
+// ============================================================================
+
+/* Counts a program/erase; true if the power fails during this one */
+static bool sim_cut_now(void) {
+    if (sim_cut_countdown == 0 || --sim_cut_countdown > 0) return false;
+    sim_dead = true;
+    return true;
+}
+
+static void sim_erase(uint32_t addr, uint32_t size, uint32_t busy_us) {
+    addr &= ~(size - 1U);
+    sim_counters.erases++;
+    if (sim_cut_now()) {
+        /* Part of the block erased, one byte half-way */
+        uint32_t done = (uint32_t)rand_r(&sim_cut_seed) % size;
+        memset(&sim_mem[addr], 0xFF, done);
+        sim_mem[addr + done] |= (uint8_t)rand_r(&sim_cut_seed);
+        return;
+    }
+    memset(&sim_mem[addr], 0xFF, size);
+    sim_set_busy(busy_us);
+}
+
+static void sim_complete_op(void);
+
+static void sim_complete(void) {
+    sim_complete_op();
+    for (uint8_t i = 0; i < sim_stuck_count; i++) sim_mem[sim_stuck[i]] = 0x00;
+}
+
+static void sim_complete_op(void) {
+    sim_addr &= sim_size - 1U;              /* Address bits above the capacity are ignored */
+    switch (sim_opcode) {
+    case 0x02:  /* Page program: bits only go 1 -> 0, address wraps in the page */
+    case 0x12:
+        if (sim_data_count > 0) {
+            uint32_t page = sim_addr & ~(SIM_PAGE_SIZE - 1U);
+            uint32_t end = SIM_PAGE_SIZE;
+            sim_counters.programs++;
+            if (sim_cut_now()) {
+                /* Bytes before end programmed, the one at end only partly */
+                end = (uint32_t)rand_r(&sim_cut_seed) % SIM_PAGE_SIZE;
+                if (sim_page_used[end]) sim_mem[page + end] &= (uint8_t)(sim_page_buf[end] | rand_r(&sim_cut_seed));
+            }
+            for (uint32_t i = 0; i < end; i++) {
+                if (sim_page_used[i]) sim_mem[page + i] &= sim_page_buf[i];
+            }
+            if (sim_dead) break;
+            sim_set_busy(W25Q128_SIM_T_PP_US);
+            sim_wel = false;
+        }
+        break;
+    case 0x20:
+    case 0x21:
+        if (sim_phase == SIM_PHASE_DATA) {
+            sim_erase(sim_addr, 0x1000, W25Q128_SIM_T_SE_US);
+            sim_wel = false;
+        }
+        break;
+    case 0x52:
+        if (sim_phase == SIM_PHASE_DATA) {
+            sim_erase(sim_addr, 0x8000, W25Q128_SIM_T_BE32_US);
+            sim_wel = false;
+        }
+        break;
+    case 0xD8:
+        if (sim_phase == SIM_PHASE_DATA) {
+            sim_erase(sim_addr, 0x10000, W25Q128_SIM_T_BE64_US);
+            sim_wel = false;
+        }
+        break;
+    case 0xC7:
+    case 0x60:
+        sim_erase(0, sim_size, W25Q128_SIM_T_CE_US);
+        sim_wel = false;
+        break;
+    default:
+        break;
+    }
+}
+
+// ============================================================================
+// SPI INTERFACE
+// ============================================================================
+
+/* The lock is taken per call, not for the whole time /CS is low: the
+ * driver may leave a READ running between accesses */
+void w25q128_sim_select(bool selected) {
+    pthread_mutex_lock(&sim_lock);
+    if (selected != sim_selected) {
+        if (selected) {
+            sim_selected = true;
+            sim_phase = SIM_PHASE_OPCODE;
+            sim_data_count = 0;
+            sim_addr = 0;
+        } else {
+            if (sim_mem != NULL) sim_complete();
+            sim_opcode = 0;
+            sim_selected = false;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static void sim_start(uint8_t opcode) {
+    sim_opcode = opcode;
+    sim_addr_bytes = 0;
+
+    if (sim_dead) {
+        sim_opcode = 0;
+        sim_phase = SIM_PHASE_DATA;         /* MISO stays low until restored */
+        return;
+    }
+
+    if (sim_power_down && opcode != 0xAB) {
+        sim_opcode = 0;                     /* Only release wakes the chip */
+        return;
+    }
+    if (sim_busy() && opcode != 0x05 && opcode != 0x35 && opcode != 0x15) {
+        fprintf(stderr, "W25Q128 sim: opcode 0x%02X ignored while busy\n", opcode);
+        sim_opcode = 0;
+        return;
+    }
+
+    switch (opcode) {
+    case 0x06: sim_wel = true; break;
+    case 0x04: sim_wel = false; break;
+    case 0xB9: sim_power_down = true; break;
+    case 0xAB: sim_power_down = false; sim_addr_bytes = 3; break;   /* 3 dummies, then ID */
+    case 0x90: sim_addr_bytes = 3; break;
+    case 0x03:
+    case 0x0B:
+        sim_counters.read_cmds++;
+        sim_addr_bytes = 3;
+        break;
+    case 0x5A:
+        sim_addr_bytes = 3;
+        break;
+    case 0x13:
+    case 0x0C:
+        sim_counters.read_cmds++;
+        sim_addr_bytes = 4;
+        break;
+    case 0x02:
+    case 0x20:
+    case 0x52:
+    case 0xD8:
+    case 0x12:
+    case 0x21:
+        if (!sim_wel) {
+            sim_opcode = 0;                 /* Program/erase without WREN is ignored */
+            return;
+        }
+        sim_addr_bytes = (opcode == 0x12 || opcode == 0x21) ? 4 : 3;
+        memset(sim_page_used, 0, sizeof(sim_page_used));
+        break;
+    case 0xC7:
+    case 0x60:
+        if (!sim_wel) sim_opcode = 0;
+        break;
+    default:
+        break;
+    }
+    sim_phase = sim_addr_bytes ? SIM_PHASE_ADDRESS : SIM_PHASE_DATA;
+}
+
+/**
+ * @brief SFDP area: header, one parameter header, the first BFPT DWORDs
+ */
+static uint8_t sim_sfdp(uint32_t addr) {
+    static const uint8_t header[16] = {
+        'S', 'F', 'D', 'P', 0x05, 0x01, 0x00, 0xFF,     /* Rev 1.5, one parameter header */
+        0x00, 0x05, 0x01, 0x02, 0x80, 0x00, 0x00, 0xFF, /* BFPT: 2 DWORDs at 0x80 */
+    };
+    if (addr < sizeof(header)) return header[addr];
+    if (addr >= 0x80 && addr < 0x88) {
+        /* DWORD1[18:17]: 3-byte only on 16 MB, 3- or 4-byte above; DWORD2: bits - 1 */
+        uint32_t dw[2] = { sim_size > 0x1000000U ? 0xFFFB20E5U : 0xFFF920E5U, sim_size * 8U - 1U };
+        return (uint8_t)(dw[(addr - 0x80) / 4] >> (8 * (addr & 3)));
+    }
+    return 0xFF;
+}
+
+static uint8_t sim_data(uint8_t mosi) {
+    uint32_t n = sim_data_count++;
+
+    switch (sim_opcode) {
+    case 0x9F: {
+        const uint8_t jedec[3] = {0xEF, 0x40, sim_capacity_id};
+        return n < 3 ? jedec[n] : 0xFF;
+    }
+    case 0x90: return (n & 1) ? 0x17 : 0xEF;
+    case 0xAB: return 0x17;
+    case 0x05: return sim_status1();
+    case 0x35: return sim_status2;
+    case 0x15: return 0x00;
+    case 0x03:
+    case 0x13:
+        return sim_mem[(sim_addr + n) & (sim_size - 1U)];
+    case 0x0B:
+    case 0x0C:
+        if (n == 0) return 0xFF;            /* Dummy byte */
+        return sim_mem[(sim_addr + n - 1) & (sim_size - 1U)];
+    case 0x5A:
+        if (n == 0) return 0xFF;            /* Dummy byte */
+        return sim_sfdp(sim_addr + n - 1);
+    case 0x02:
+    case 0x12: {
+        uint32_t offset = (sim_addr + n) & (SIM_PAGE_SIZE - 1U);
+        /* Beyond 256 bytes the latest data wins, as on the chip */
+        sim_page_buf[offset] = mosi;
+        sim_page_used[offset] = true;
+        return 0xFF;
+    }
+    default:
+        return 0xFF;
+    }
+}
+
+static uint8_t sim_exchange(uint8_t mosi) {
+    if (!sim_selected || sim_mem == NULL) return 0xFF;
+    sim_counters.spi_bytes++;
+    if (sim_dead && sim_phase == SIM_PHASE_DATA) return 0x00;
+
+    switch (sim_phase) {
+    case SIM_PHASE_OPCODE:
+        sim_start(mosi);
+        return 0xFF;
+    case SIM_PHASE_ADDRESS:
+        sim_addr = (sim_addr << 8) | mosi;
+        if (--sim_addr_bytes == 0) sim_phase = SIM_PHASE_DATA;
+        return 0xFF;
+    case SIM_PHASE_DATA:
+    default:
+        return sim_opcode ? sim_data(mosi) : 0xFF;
+    }
+}
+
+uint8_t w25q128_sim_exchange(uint8_t mosi) {
+    pthread_mutex_lock(&sim_lock);
+    uint8_t miso = sim_exchange(mosi);
+    pthread_mutex_unlock(&sim_lock);
+    return miso;
+}
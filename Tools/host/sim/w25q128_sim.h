@@ -0,0 +1,81 @@
+/**
+ * @file w25q128_sim.h
+ * @brief W25Q128JV SPI flash simulator for the host-native build
+ *
+ * @details Byte-level model of the command set used by w25q128.c, backed by
+ *          a memory-mapped 16 MB image file so contents survive restarts and
+ *          can be inspected or seeded from the host. Program and erase keep
+ *          BUSY set for the datasheet typical times unless W25Q128_SIM_FAST is
+ *          set in the environment. W25Q128_SIM_MBYTES=32 or 64 models the
+ *          W25Q256/W25Q512 instead (JEDEC ID, SFDP density, 4-byte opcodes).
+ */
+
+#ifndef W25Q128_SIM_H
+#define W25Q128_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define W25Q128_SIM_SIZE        0x1000000U      /**< Default size, override with env W25Q128_SIM_MBYTES */
+#define W25Q128_SIM_IMAGE       "w25q128.bin"   /**< Default image, override with env W25Q128_SIM_IMAGE */
+
+/* Datasheet typical timings in microseconds */
+#define W25Q128_SIM_T_PP_US     400U
+#define W25Q128_SIM_T_SE_US     45000U
+#define W25Q128_SIM_T_BE32_US   120000U
+#define W25Q128_SIM_T_BE64_US   150000U
+#define W25Q128_SIM_T_CE_US     40000000U
+
+typedef struct {
+    uint64_t spi_bytes;         /**< Bytes clocked while selected */
+    uint32_t read_cmds;         /**< 0x03/0x0B/0x13/0x0C */
+    uint32_t programs;
+    uint32_t erases;
+} w25q128_sim_counters_t;
+
+/**
+ * @brief Map the image file, creating it erased (0xFF) if missing
+ * @param image_path NULL for env W25Q128_SIM_IMAGE or W25Q128_SIM_IMAGE
+ * @return false if the file cannot be created or mapped
+ */
+bool w25q128_sim_init(const char *image_path);
+
+/**
+ * @brief Chip select (true = /CS low); deselect completes the command
+ */
+void w25q128_sim_select(bool selected);
+
+/**
+ * @brief Clock one byte in, return the byte clocked out
+ */
+uint8_t w25q128_sim_exchange(uint8_t mosi);
+
+/**
+ * @brief Direct view of the image, for host-side checks
+ */
+uint8_t *w25q128_sim_memory(void);
+
+/**
+ * @brief Command counters since init or the last reset
+ */
+void w25q128_sim_get_counters(w25q128_sim_counters_t *counters);
+void w25q128_sim_reset_counters(void);
+
+/**
+ * @brief Arm a power cut: the ops-th program or erase from now is torn
+ * @param ops  0 disarms
+ * @param seed Picks how much of the torn operation lands
+ */
+void w25q128_sim_power_cut(uint32_t ops, uint32_t seed);
+
+/**
+ * @brief true once an armed cut has happened
+ */
+bool w25q128_sim_power_lost(void);
+
+/**
+ * @brief Power the chip up again (disarms any pending cut)
+ */
+void w25q128_sim_power_restore(void);
+
+#endif // W25Q128_SIM_H
@@ -0,0 +1,616 @@
+/**
+ * @file w5500_sim.c
+ * @brief W5500 Ethernet controller simulator
+ */
+
+#include "w5500_sim.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define SIM_SOCKETS         8
+#define SIM_BUF_MAX         16384U
+#define SIM_COMMON_SIZE     0x40
+#define SIM_SOCKET_SIZE     0x30
+#define SIM_POLL_US         1000
+
+/* Common registers */
+#define C_MR        0x00
+#define C_GAR       0x01
+#define C_SUBR      0x05
+#define C_SIPR      0x0F
+#define C_IR        0x15
+#define C_IMR       0x16
+#define C_SIR       0x17
+#define C_SIMR      0x18
+#define C_RTR       0x19
+#define C_RCR       0x1B
+#define C_PHYCFGR   0x2E
+#define C_VERSIONR  0x39
+
+/* Socket registers */
+#define S_MR        0x00
+#define S_CR        0x01
+#define S_IR        0x02
+#define S_SR        0x03
+#define S_PORT      0x04
+#define S_DHAR      0x06
+#define S_DIPR      0x0C
+#define S_DPORT     0x10
+#define S_TTL       0x16
+#define S_RXBUF     0x1E
+#define S_TXBUF     0x1F
+#define S_TX_FSR    0x20
+#define S_TX_RD     0x22
+#define S_TX_WR     0x24
+#define S_RX_RSR    0x26
+#define S_RX_RD     0x28
+#define S_RX_WR     0x2A
+#define S_IMR       0x2C
+#define S_FRAG      0x2D
+
+/* Sn_MR protocol, Sn_CR commands, Sn_IR bits, Sn_SR states */
+#define MR_TCP      0x01
+#define MR_UDP      0x02
+#define MR_IPRAW    0x03
+#define MR_MACRAW   0x04
+#define MR_MULTI    0x80
+
+#define CR_OPEN     0x01
+#define CR_LISTEN   0x02
+#define CR_CONNECT  0x04
+#define CR_DISCON   0x08
+#define CR_CLOSE    0x10
+#define CR_SEND     0x20
+#define CR_SEND_MAC 0x21
+#define CR_SEND_KEEP 0x22
+#define CR_RECV     0x40
+
+#define IR_CON      0x01
+#define IR_DISCON   0x02
+#define IR_RECV     0x04
+#define IR_TIMEOUT  0x08
+#define IR_SENDOK   0x10
+
+#define SR_CLOSED       0x00
+#define SR_INIT         0x13
+#define SR_LISTEN       0x14
+#define SR_SYNSENT      0x15
+#define SR_ESTABLISHED  0x17
+#define SR_CLOSE_WAIT   0x1C
+#define SR_UDP          0x22
+#define SR_IPRAW        0x32
+#define SR_MACRAW       0x42
+
+typedef struct {
+    uint8_t reg[SIM_SOCKET_SIZE];
+    uint8_t tx[SIM_BUF_MAX];
+    uint8_t rx[SIM_BUF_MAX];
+    int fd;                     /**< Host socket (UDP, or connected TCP) */
+    int listen_fd;              /**< Host listening socket while in LISTEN */
+} sim_socket_t;
+
+static uint8_t sim_common[SIM_COMMON_SIZE];
+static sim_socket_t sim_sock[SIM_SOCKETS];
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t sim_thread;
+static bool sim_selected = false;
+static uint32_t sim_port_offset = W5500_SIM_PORT_OFFSET;
+static const char *sim_peer = NULL;
+
+/* Current SPI frame */
+static uint8_t sim_frame_pos;
+static uint16_t sim_frame_addr;
+static uint8_t sim_frame_ctrl;
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void set16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint16_t sim_buf_size(uint8_t kb) {
+    return (kb <= 16) ? (uint16_t)(kb * 1024U) : 0;
+}
+
+static uint16_t sim_tx_free(const sim_socket_t *s) {
+    uint16_t size = sim_buf_size(s->reg[S_TXBUF]);
+    uint16_t used = (uint16_t)(get16(&s->reg[S_TX_WR]) - get16(&s->reg[S_TX_RD]));
+    return used <= size ? (uint16_t)(size - used) : 0;
+}
+
+static uint16_t sim_rx_used(const sim_socket_t *s) {
+    return (uint16_t)(get16(&s->reg[S_RX_WR]) - get16(&s->reg[S_RX_RD]));
+}
+
+static void sim_close_host(sim_socket_t *s) {
+    if (s->fd >= 0) close(s->fd);
+    if (s->listen_fd >= 0) close(s->listen_fd);
+    s->fd = -1;
+    s->listen_fd = -1;
+}
+
+static void sim_reset_locked(void) {
+    memset(sim_common, 0, sizeof(sim_common));
+    set16(&sim_common[C_RTR], 0x07D0);
+    sim_common[C_RCR] = 0x08;
+    sim_common[C_PHYCFGR] = 0xBF;           /* Auto-negotiated 100BASE-TX full duplex, link up */
+    sim_common[C_VERSIONR] = 0x04;
+
+    for (uint8_t n = 0; n < SIM_SOCKETS; n++) {
+        sim_socket_t *s = &sim_sock[n];
+        sim_close_host(s);
+        memset(s->reg, 0, sizeof(s->reg));
+        memset(&s->reg[S_DHAR], 0xFF, 6);
+        s->reg[S_TTL] = 0x80;
+        s->reg[S_RXBUF] = 2;
+        s->reg[S_TXBUF] = 2;
+        s->reg[S_IMR] = 0xFF;
+        set16(&s->reg[S_FRAG], 0x4000);
+    }
+}
+
+// ============================================================================
+// ADDRESS MAPPING
+// ============================================================================
+
+static uint16_t sim_host_port(uint16_t port) {
+    return (port < 1024) ? (uint16_t)(port + sim_port_offset) : port;
+}
+
+/* Destination as seen by the host network stack */
+static struct sockaddr_in sim_dest(const sim_socket_t *s) {
+    struct sockaddr_in a;
+    uint32_t dip, sip, mask;
+
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(get16(&s->reg[S_DPORT]));
+    memcpy(&dip, &s->reg[S_DIPR], 4);
+    memcpy(&sip, &sim_common[C_SIPR], 4);
+    memcpy(&mask, &sim_common[C_SUBR], 4);
+
+    bool multicast = (s->reg[S_DIPR] & 0xF0) == 0xE0;
+    bool local = ((dip ^ sip) & mask) == 0 || dip == 0xFFFFFFFFU || dip == (sip | ~mask);
+    if (sim_peer != NULL && !multicast) {
+        inet_pton(AF_INET, sim_peer, &a.sin_addr);
+    } else if (local && !multicast) {
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    } else {
+        memcpy(&a.sin_addr.s_addr, &s->reg[S_DIPR], 4);
+    }
+    return a;
+}
+
+static void sim_set_peer(sim_socket_t *s, const struct sockaddr_in *a) {
+    memcpy(&s->reg[S_DIPR], &a->sin_addr.s_addr, 4);
+    set16(&s->reg[S_DPORT], ntohs(a->sin_port));
+}
+
+static int sim_bind(int type, uint16_t port) {
+    /* Close on exec: NVIC_SystemReset() re-executes, and a stale copy would
+     * share the port through SO_REUSEPORT and swallow datagrams */
+    int fd = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    /* Several W5500 sockets may listen on one port (e.g. two Modbus masters) */
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    if (type == SOCK_DGRAM) setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(sim_host_port(port));
+    a.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&a, sizeof(a)) != 0) {
+        fprintf(stderr, "W5500 sim: bind port %u: %s\n", sim_host_port(port), strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// ============================================================================
+// BUFFERS
+// ============================================================================
+
+static void sim_rx_put(sim_socket_t *s, const uint8_t *data, uint16_t len) {
+    uint16_t mask = (uint16_t)(sim_buf_size(s->reg[S_RXBUF]) - 1U);
+    uint16_t wr = get16(&s->reg[S_RX_WR]);
+    for (uint16_t i = 0; i < len; i++) s->rx[(uint16_t)(wr + i) & mask] = data[i];
+    set16(&s->reg[S_RX_WR], (uint16_t)(wr + len));
+}
+
+static uint16_t sim_tx_take(sim_socket_t *s, uint8_t *out) {
+    uint16_t size = sim_buf_size(s->reg[S_TXBUF]);
+    uint16_t rd = get16(&s->reg[S_TX_RD]);
+    uint16_t len = (uint16_t)(get16(&s->reg[S_TX_WR]) - rd);
+    if (len > size) len = size;
+    for (uint16_t i = 0; i < len; i++) out[i] = s->tx[(uint16_t)(rd + i) & (size - 1U)];
+    set16(&s->reg[S_TX_RD], (uint16_t)(rd + len));
+    return len;
+}
+
+// ============================================================================
+// COMMANDS
+// ============================================================================
+
+static void sim_cmd_open(sim_socket_t *s) {
+    sim_close_host(s);
+    memset(&s->reg[S_TX_RD], 0, S_IMR - S_TX_RD);    /* TX_RD .. RX_WR */
+    s->reg[S_IR] = 0;
+
+    switch (s->reg[S_MR] & 0x0F) {
+    case MR_TCP:
+        s->reg[S_SR] = SR_INIT;
+        break;
+    case MR_UDP:
+        s->fd = sim_bind(SOCK_DGRAM, get16(&s->reg[S_PORT]));
+        if (s->fd >= 0 && (s->reg[S_MR] & MR_MULTI)) {
+            struct ip_mreq mreq;
+            memcpy(&mreq.imr_multiaddr.s_addr, &s->reg[S_DIPR], 4);
+            mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+            setsockopt(s->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+        }
+        s->reg[S_SR] = (s->fd >= 0) ? SR_UDP : SR_CLOSED;
+        break;
+    case MR_IPRAW:
+        s->reg[S_SR] = SR_IPRAW;
+        break;
+    case MR_MACRAW:
+        s->reg[S_SR] = SR_MACRAW;
+        break;
+    default:
+        break;
+    }
+}
+
+static void sim_cmd_listen(sim_socket_t *s) {
+    if (s->reg[S_SR] != SR_INIT) return;
+    s->listen_fd = sim_bind(SOCK_STREAM, get16(&s->reg[S_PORT]));
+    if (s->listen_fd >= 0 && listen(s->listen_fd, 1) == 0) {
+        s->reg[S_SR] = SR_LISTEN;
+    } else {
+        sim_close_host(s);
+        s->reg[S_SR] = SR_CLOSED;
+    }
+}
+
+static void sim_cmd_connect(sim_socket_t *s) {
+    if (s->reg[S_SR] != SR_INIT) return;
+    s->fd = sim_bind(SOCK_STREAM, get16(&s->reg[S_PORT]));
+    struct sockaddr_in a = sim_dest(s);
+    if (s->fd >= 0 && (connect(s->fd, (struct sockaddr *)&a, sizeof(a)) == 0 || errno == EINPROGRESS)) {
+        s->reg[S_SR] = SR_SYNSENT;          /* Completed by the network thread */
+    } else {
+        sim_close_host(s);
+        s->reg[S_SR] = SR_CLOSED;
+        s->reg[S_IR] |= IR_TIMEOUT;
+    }
+}
+
+static void sim_cmd_send(sim_socket_t *s) {
+    static uint8_t payload[SIM_BUF_MAX];
+    uint16_t len = sim_tx_take(s, payload);
+    ssize_t sent = -1;
+
+    if (s->fd >= 0 && s->reg[S_SR] == SR_UDP) {
+        struct sockaddr_in a = sim_dest(s);
+        sent = sendto(s->fd, payload, len, 0, (struct sockaddr *)&a, sizeof(a));
+    } else if (s->fd >= 0 && (s->reg[S_SR] == SR_ESTABLISHED || s->reg[S_SR] == SR_CLOSE_WAIT)) {
+        /* Blocking, like waiting for the ACK before SENDOK */
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = send(s->fd, payload + done, len - done, MSG_NOSIGNAL);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                struct pollfd p = { .fd = s->fd, .events = POLLOUT };
+                poll(&p, 1, 100);
+                continue;
+            }
+            if (n <= 0) break;
+            done += (size_t)n;
+        }
+        sent = (done == len) ? (ssize_t)done : -1;
+    } else if (s->reg[S_SR] == SR_IPRAW || s->reg[S_SR] == SR_MACRAW) {
+        sent = len;                         /* Swallowed */
+    }
+
+    s->reg[S_IR] |= (sent == (ssize_t)len) ? IR_SENDOK : IR_TIMEOUT;
+}
+
+static void sim_command(sim_socket_t *s, uint8_t cmd) {
+    switch (cmd) {
+    case CR_OPEN:      sim_cmd_open(s); break;
+    case CR_LISTEN:    sim_cmd_listen(s); break;
+    case CR_CONNECT:   sim_cmd_connect(s); break;
+    case CR_DISCON:
+        sim_close_host(s);
+        s->reg[S_SR] = SR_CLOSED;
+        s->reg[S_IR] |= IR_DISCON;
+        break;
+    case CR_CLOSE:
+        sim_close_host(s);
+        s->reg[S_SR] = SR_CLOSED;
+        break;
+    case CR_SEND:
+    case CR_SEND_MAC:
+    case CR_SEND_KEEP:
+        sim_cmd_send(s);
+        break;
+    case CR_RECV:
+        break;                              /* RX_RD was already moved by the host */
+    default:
+        break;
+    }
+    s->reg[S_CR] = 0;
+}
+
+// ============================================================================
+// NETWORK THREAD
+// ============================================================================
+
+static void sim_poll_socket(sim_socket_t *s) {
+    static uint8_t buf[65536];
+
+    switch (s->reg[S_SR]) {
+    case SR_UDP: {
+        for (;;) {
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ssize_t n = recvfrom(s->fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+            if (n < 0) break;
+            uint16_t size = sim_buf_size(s->reg[S_RXBUF]);
+            if ((size_t)n + 8 > (size_t)(size - sim_rx_used(s))) continue;   /* No room: dropped */
+            uint8_t hdr[8];
+            memcpy(hdr, &from.sin_addr.s_addr, 4);
+            set16(&hdr[4], ntohs(from.sin_port));
+            set16(&hdr[6], (uint16_t)n);
+            sim_rx_put(s, hdr, 8);
+            sim_rx_put(s, buf, (uint16_t)n);
+            s->reg[S_IR] |= IR_RECV;
+        }
+        break;
+    }
+    case SR_LISTEN: {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int fd = accept(s->listen_fd, (struct sockaddr *)&from, &from_len);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            close(s->listen_fd);
+            s->listen_fd = -1;
+            s->fd = fd;
+            sim_set_peer(s, &from);
+            s->reg[S_SR] = SR_ESTABLISHED;
+            s->reg[S_IR] |= IR_CON;
+        }
+        break;
+    }
+    case SR_SYNSENT: {
+        struct pollfd p = { .fd = s->fd, .events = POLLOUT };
+        if (poll(&p, 1, 0) == 1) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err == 0) {
+                s->reg[S_SR] = SR_ESTABLISHED;
+                s->reg[S_IR] |= IR_CON;
+            } else {
+                sim_close_host(s);
+                s->reg[S_SR] = SR_CLOSED;
+                s->reg[S_IR] |= IR_TIMEOUT;
+            }
+        }
+        break;
+    }
+    case SR_ESTABLISHED: {
+        uint16_t room = (uint16_t)(sim_buf_size(s->reg[S_RXBUF]) - sim_rx_used(s));
+        if (room == 0) break;               /* Window closed until the firmware reads */
+        ssize_t n = recv(s->fd, buf, room, 0);
+        if (n > 0) {
+            sim_rx_put(s, buf, (uint16_t)n);
+            s->reg[S_IR] |= IR_RECV;
+        } else if (n == 0) {
+            s->reg[S_SR] = SR_CLOSE_WAIT;
+            s->reg[S_IR] |= IR_DISCON;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            sim_close_host(s);
+            s->reg[S_SR] = SR_CLOSED;
+            s->reg[S_IR] |= IR_TIMEOUT;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void *sim_network_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&sim_lock);
+        for (uint8_t n = 0; n < SIM_SOCKETS; n++) sim_poll_socket(&sim_sock[n]);
+        pthread_mutex_unlock(&sim_lock);
+        usleep(SIM_POLL_US);
+    }
+    return NULL;
+}
+
+// ============================================================================
+// REGISTER ACCESS
+// ============================================================================
+
+static uint8_t sim_sir(void) {
+    uint8_t sir = 0;
+    for (uint8_t n = 0; n < SIM_SOCKETS; n++) {
+        if (sim_sock[n].reg[S_IR] & sim_sock[n].reg[S_IMR]) sir |= (uint8_t)(1U << n);
+    }
+    return sir;
+}
+
+static uint8_t sim_read(uint8_t bsb, uint16_t addr) {
+    if (bsb == 0) {
+        if (addr == C_SIR) return sim_sir();
+        return addr < SIM_COMMON_SIZE ? sim_common[addr] : 0;
+    }
+
+    uint8_t n = (uint8_t)((bsb - 1) >> 2);
+    sim_socket_t *s = &sim_sock[n & 7];
+    switch ((bsb - 1) & 3) {
+    case 0: {
+        uint16_t v;
+        if (addr == S_TX_FSR || addr == S_TX_FSR + 1) {
+            v = sim_tx_free(s);
+            return (addr == S_TX_FSR) ? (uint8_t)(v >> 8) : (uint8_t)v;
+        }
+        if (addr == S_RX_RSR || addr == S_RX_RSR + 1) {
+            v = sim_rx_used(s);
+            return (addr == S_RX_RSR) ? (uint8_t)(v >> 8) : (uint8_t)v;
+        }
+        return addr < SIM_SOCKET_SIZE ? s->reg[addr] : 0;
+    }
+    case 1: {
+        uint16_t size = sim_buf_size(s->reg[S_TXBUF]);
+        return size ? s->tx[addr & (size - 1U)] : 0;
+    }
+    case 2: {
+        uint16_t size = sim_buf_size(s->reg[S_RXBUF]);
+        return size ? s->rx[addr & (size - 1U)] : 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+static void sim_write(uint8_t bsb, uint16_t addr, uint8_t value) {
+    if (bsb == 0) {
+        if (addr == C_MR && (value & 0x80)) {
+            sim_reset_locked();
+        } else if (addr == C_IR) {
+            sim_common[C_IR] &= (uint8_t)~value;
+        } else if (addr < SIM_COMMON_SIZE && addr != C_SIR && addr != C_VERSIONR) {
+            sim_common[addr] = value;
+        }
+        return;
+    }
+
+    uint8_t n = (uint8_t)((bsb - 1) >> 2);
+    sim_socket_t *s = &sim_sock[n & 7];
+    switch ((bsb - 1) & 3) {
+    case 0:
+        if (addr == S_CR) {
+            sim_command(s, value);
+        } else if (addr == S_IR) {
+            s->reg[S_IR] &= (uint8_t)~value;
+        } else if (addr < SIM_SOCKET_SIZE && addr != S_SR && addr != S_TX_FSR && addr != S_TX_FSR + 1 &&
+                   addr != S_RX_RSR && addr != S_RX_RSR + 1) {
+            s->reg[addr] = value;
+        }
+        break;
+    case 1: {
+        uint16_t size = sim_buf_size(s->reg[S_TXBUF]);
+        if (size) s->tx[addr & (size - 1U)] = value;
+        break;
+    }
+    case 2: {
+        uint16_t size = sim_buf_size(s->reg[S_RXBUF]);
+        if (size) s->rx[addr & (size - 1U)] = value;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// ============================================================================
+// SPI INTERFACE
+// ============================================================================
+
+bool w5500_sim_init(void) {
+    const char *offset = getenv("W5500_SIM_PORT_OFFSET");
+    if (offset != NULL) sim_port_offset = (uint32_t)strtoul(offset, NULL, 0);
+    sim_peer = getenv("W5500_SIM_PEER");
+
+    for (uint8_t n = 0; n < SIM_SOCKETS; n++) {
+        sim_sock[n].fd = -1;
+        sim_sock[n].listen_fd = -1;
+    }
+    pthread_mutex_lock(&sim_lock);
+    sim_reset_locked();
+    pthread_mutex_unlock(&sim_lock);
+
+    if (pthread_create(&sim_thread, NULL, sim_network_thread, NULL) != 0) return false;
+    printf("W5500 sim: privileged ports +%u, peer %s\n", sim_port_offset, sim_peer ? sim_peer : "127.0.0.1");
+    return true;
+}
+
+void w5500_sim_reset(void) {
+    pthread_mutex_lock(&sim_lock);
+    sim_reset_locked();
+    pthread_mutex_unlock(&sim_lock);
+}
+
+bool w5500_sim_irq_pending(void) {
+    pthread_mutex_lock(&sim_lock);
+    bool pending = (sim_sir() & sim_common[C_SIMR]) || (sim_common[C_IR] & sim_common[C_IMR]);
+    pthread_mutex_unlock(&sim_lock);
+    return pending;
+}
+
+void w5500_sim_select(bool selected) {
+    if (selected == sim_selected) return;
+
+    if (selected) {
+        pthread_mutex_lock(&sim_lock);
+        sim_selected = true;
+        sim_frame_pos = 0;
+    } else {
+        sim_selected = false;
+        pthread_mutex_unlock(&sim_lock);
+    }
+}
+
+uint8_t w5500_sim_exchange(uint8_t mosi) {
+    if (!sim_selected) return 0xFF;
+
+    /* Address phase, then control phase; the chip shifts out 0x01 0x02 0x03 */
+    switch (sim_frame_pos) {
+    case 0:
+        sim_frame_addr = (uint16_t)(mosi << 8);
+        sim_frame_pos++;
+        return 0x01;
+    case 1:
+        sim_frame_addr |= mosi;
+        sim_frame_pos++;
+        return 0x02;
+    case 2:
+        sim_frame_ctrl = mosi;
+        sim_frame_pos++;
+        return 0x03;
+    default:
+        break;
+    }
+
+    uint8_t bsb = (uint8_t)(sim_frame_ctrl >> 3);
+    uint16_t addr = sim_frame_addr++;
+    if (sim_frame_ctrl & 0x04) {
+        sim_write(bsb, addr, mosi);
+        return 0x00;
+    }
+    return sim_read(bsb, addr);
+}
@@ -0,0 +1,53 @@
+/**
+ * @file w5500_sim.h
+ * @brief W5500 Ethernet controller simulator for the host-native build
+ *
+ * @details Models the W5500 at the SPI frame level (address, control byte,
+ *          data) so the unmodified ioLibrary and w5500_spi.c run on top of it.
+ *          The eight hardware sockets are backed by host BSD sockets:
+ *
+ *          - UDP/TCP local ports below 1024 are bound at port + offset
+ *            (env W5500_SIM_PORT_OFFSET, default 10000), e.g. Modbus on 10502.
+ *          - Traffic to the device's own subnet or broadcast goes to 127.0.0.1,
+ *            or to env W5500_SIM_PEER if set; other addresses are used as is.
+ *          - A background thread moves received data into the socket RX
+ *            buffers (with the 8-byte UDP header) and raises Sn_IR/SIR.
+ *
+ *          PHY link is always up; MACRAW/IPRAW sockets open but never receive.
+ */
+
+#ifndef W5500_SIM_H
+#define W5500_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define W5500_SIM_PORT_OFFSET   10000   /**< Default shift for privileged ports */
+
+/**
+ * @brief Reset the model and start the network thread
+ * @return false if the thread cannot be started
+ */
+bool w5500_sim_init(void);
+
+/**
+ * @brief Hardware reset (RSTn low), closes every host socket
+ */
+void w5500_sim_reset(void);
+
+/**
+ * @brief Chip select (true = SCSn low); a frame ends on deselect
+ */
+void w5500_sim_select(bool selected);
+
+/**
+ * @brief Clock one byte in, return the byte clocked out
+ */
+uint8_t w5500_sim_exchange(uint8_t mosi);
+
+/**
+ * @brief State of the INTn output: true while an unmasked interrupt is pending
+ */
+bool w5500_sim_irq_pending(void);
+
+#endif // W5500_SIM_H
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+STM32 Log Collector
+-------------------
+Minimal syslog-over-TCP receiver for the flash log shipper (Core/Src/log_ship.c).
+Accepts RFC 5424 messages with octet-counting framing (RFC 6587), drops the
+repeats a replay after a dropped connection produces (same sequenceId from
+the same host), reports gaps and appends each new record as one line.
+
+Any RFC 6587 receiver works as well, e.g. rsyslog with
+  module(load="imtcp") input(type="imtcp" port="601")
+
+Usage:
+python log_collect.py                            # listen on TCP 601, print records
+python log_collect.py -o fleet.log               # also append records to fleet.log
+python log_collect.py --expect 50 --timeout 30   # exit 1 unless 50 records arrive
+
+Dependencies:
+- Python 3.x
+"""
+
+import socket
+import selectors
+import re
+import sys
+import time
+import argparse
+
+LOG_PORT = 601
+SEVERITIES = ["emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"]
+MESSAGE = re.compile(rb'^<(\d+)>1 (\S+) (\S+) (\S+) (\S+) (\S+) (\[.*?\]|-) ?(.*)$', re.S)
+SEQUENCE_ID = re.compile(rb'sequenceId="(\d+)"')
+UPTIME = re.compile(rb'sysUpTime="(\d+)"')
+
+
+class Host:
+    """Per-device dedup state"""
+
+    def __init__(self):
+        self.last_seq = None
+        self.records = 0
+        self.repeats = 0
+        self.gaps = 0
+
+
+def parse_frames(buf):
+    """Split octet-counted frames off buf; return (frames, rest)"""
+    frames = []
+    while True:
+        space = buf.find(b" ")
+        if space <= 0 or not buf[:space].isdigit():
+            break
+        n = int(buf[:space])
+        if len(buf) < space + 1 + n:
+            break
+        frames.append(buf[space + 1:space + 1 + n])
+        buf = buf[space + 1 + n:]
+    return frames, buf
+
+
+def handle_message(hosts, peer, frame, out):
+    """Dedup one message; return True if it was new"""
+    m = MESSAGE.match(frame)
+    if not m:
+        print(f"[{peer}] unparsed: {frame[:60]!r}")
+        return False
+    pri, hostname, app, sd, msg = int(m.group(1)), m.group(3).decode(), m.group(4).decode(), m.group(7), m.group(8)
+    seq_match = SEQUENCE_ID.search(sd)
+    seq = int(seq_match.group(1)) if seq_match else None
+    uptime = UPTIME.search(sd)
+    host = hosts.setdefault(hostname, Host())
+
+    if seq is not None and host.last_seq is not None and seq <= host.last_seq:
+        host.repeats += 1
+        return False
+    if seq is not None and host.last_seq is not None and seq > host.last_seq + 1:
+        host.gaps += seq - host.last_seq - 1
+        print(f"[{hostname}] gap: records {host.last_seq + 1}..{seq - 1} missing")
+    if seq is not None:
+        host.last_seq = seq
+    host.records += 1
+
+    t = f"{int(uptime.group(1)) / 100:.2f}s" if uptime else "-"
+    line = f"{hostname} {seq if seq is not None else '-'} {t} {app} {SEVERITIES[pri & 7]}: {msg.decode(errors='replace')}"
+    print(line)
+    if out:
+        out.write(line + "\n")
+        out.flush()
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Receive the shipped flash log")
+    parser.add_argument("--port", type=int, default=LOG_PORT, help=f"TCP port (default: {LOG_PORT})")
+    parser.add_argument("-o", "--output", help="Append records to this file")
+    parser.add_argument("--expect", type=int, default=0, help="Exit once this many new records arrived")
+    parser.add_argument("--timeout", type=float, default=0, help="Give up after this many seconds")
+    args = parser.parse_args()
+
+    listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(("0.0.0.0", args.port))
+    listener.listen(8)
+    sel = selectors.DefaultSelector()
+    sel.register(listener, selectors.EVENT_READ)
+
+    out = open(args.output, "a") if args.output else None
+    hosts = {}
+    buffers = {}
+    received = 0
+    deadline = time.monotonic() + args.timeout if args.timeout else None
+    try:
+        while not (args.expect and received >= args.expect):
+            remaining = None if deadline is None else deadline - time.monotonic()
+            if remaining is not None and remaining <= 0:
+                break
+            for key, _ in sel.select(remaining):
+                if key.fileobj is listener:
+                    conn, addr = listener.accept()
+                    print(f"[{addr[0]}:{addr[1]}] connected")
+                    sel.register(conn, selectors.EVENT_READ)
+                    buffers[conn] = b""
+                    continue
+                conn = key.fileobj
+                data = conn.recv(4096)
+                if not data:
+                    sel.unregister(conn)
+                    buffers.pop(conn, None)
+                    conn.close()
+                    continue
+                frames, buffers[conn] = parse_frames(buffers[conn] + data)
+                peer = conn.getpeername()[0]
+                received += sum(handle_message(hosts, peer, f, out) for f in frames)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if out:
+            out.close()
+
+    for name, h in sorted(hosts.items()):
+        print(f"{name}: {h.records} records, {h.repeats} repeats dropped, {h.gaps} missing, last {h.last_seq}")
+    sys.exit(1 if args.expect and received < args.expect else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""
+STM32 RAM Budget Report
+-----------------------
+Reads a firmware ELF with the ARM binutils and shows where the 20 KB of SRAM
+goes: code copied to RAM (.ramfunc, see Core/Inc/ramfunc.h), .data, .bss and
+the heap/stack reserve, plus every function placed in .ramfunc.
+
+Usage:
+python ram_budget.py Debug/stm32f103_w5500.elf
+python ram_budget.py firmware.elf --save ram.json         # store as baseline
+python ram_budget.py firmware.elf --baseline ram.json --max-ramfunc 2048
+
+The exit code is 1 if .ramfunc is larger than --max-ramfunc or the sections
+do not fit in RAM, so the script can gate a change that moves code to RAM.
+
+Dependencies:
+- Python 3.x
+- arm-none-eabi-nm and arm-none-eabi-size (see --prefix)
+"""
+
+import subprocess
+import json
+import sys
+import argparse
+
+RAM_SIZE = 20 * 1024
+RAM_SECTIONS = (".ramfunc", ".data", ".bss", "._user_heap_stack")
+
+
+def run_tool(prefix, tool, args):
+    """Run one binutils tool and return its stdout"""
+    try:
+        return subprocess.run([prefix + tool] + args, check=True,
+                              capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        print(f"Cannot run {prefix + tool}: {e}")
+        sys.exit(2)
+
+
+def section_sizes(prefix, elf):
+    """Sizes of the RAM sections, from size -A"""
+    sizes = {name: 0 for name in RAM_SECTIONS}
+    for line in run_tool(prefix, "size", ["-A", elf]).splitlines():
+        fields = line.split()
+        if len(fields) >= 3 and fields[0] in sizes:
+            sizes[fields[0]] = int(fields[1])
+    return sizes
+
+
+def ramfunc_symbols(prefix, elf):
+    """Functions inside .ramfunc as {name: size}, from nm -S"""
+    bounds = {}
+    symbols = []
+    for line in run_tool(prefix, "nm", ["-S", "-C", elf]).splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[2] in ("_sramfunc", "_eramfunc"):
+            bounds[fields[2]] = int(fields[0], 16)
+        elif len(fields) == 4 and fields[2] in "tT":
+            symbols.append((int(fields[0], 16), int(fields[1], 16), fields[3]))
+
+    start, end = bounds.get("_sramfunc"), bounds.get("_eramfunc")
+    if start is None or end is None:
+        return {}
+    # Thumb function addresses have bit 0 set
+    return {name: size for addr, size, name in symbols if start <= (addr & ~1) < end}
+
+
+def print_report(report, baseline=None):
+    """Print the section table and the .ramfunc contents"""
+    base = baseline["sections"] if baseline else {}
+
+    print(f"{'section':<20}{'bytes':>8}{'% RAM':>8}{'vs base':>10}")
+    print("-" * 46)
+    for name, size in report["sections"].items():
+        delta = f"{size - base[name]:+d}" if name in base else ""
+        print(f"{name:<20}{size:>8}{size * 100.0 / RAM_SIZE:>8.1f}{delta:>10}")
+    print(f"{'total':<20}{report['used']:>8}{report['used'] * 100.0 / RAM_SIZE:>8.1f}")
+    print(f"{'free':<20}{RAM_SIZE - report['used']:>8}")
+
+    print("\n.ramfunc contents")
+    base_funcs = baseline.get("ramfunc", {}) if baseline else {}
+    for name, size in sorted(report["ramfunc"].items(), key=lambda f: -f[1]):
+        mark = "" if not baseline or name in base_funcs else "  (new)"
+        print(f"  {name:<32}{size:>6}{mark}")
+    for name in sorted(set(base_funcs) - set(report["ramfunc"])):
+        print(f"  {name:<32}{'-':>6}  (removed)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="STM32 RAM budget report")
+    parser.add_argument("elf", help="Firmware ELF file")
+    parser.add_argument("--prefix", default="arm-none-eabi-", help="Binutils prefix")
+    parser.add_argument("--save", metavar="FILE", help="Store this report as a baseline")
+    parser.add_argument("--baseline", metavar="FILE", help="Compare against a stored baseline")
+    parser.add_argument("--max-ramfunc", type=int, metavar="BYTES", help="Largest allowed .ramfunc")
+    args = parser.parse_args()
+
+    sections = section_sizes(args.prefix, args.elf)
+    report = {
+        "sections": sections,
+        "used": sum(sections.values()),
+        "ramfunc": ramfunc_symbols(args.prefix, args.elf),
+    }
+
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    print_report(report, baseline)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(report, f, indent=2)
+        print(f"\nBaseline saved to {args.save}")
+
+    failed = False
+    if report["used"] > RAM_SIZE:
+        print(f"\nRAM overrun: {report['used']} of {RAM_SIZE} bytes")
+        failed = True
+    if args.max_ramfunc is not None and sections[".ramfunc"] > args.max_ramfunc:
+        print(f"\n.ramfunc is {sections['.ramfunc']} bytes, limit {args.max_ramfunc}")
+        failed = True
+    if failed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,90 @@
+//
+// ITM stimulus port console for Renode
+//
+// Core/Src/itm_console.c routes printf to ITM port 0. Renode's STM32F103
+// platform has no ITM, so this stub accepts the init writes, reports the port
+// as always ready and prints each completed line to the log, where the
+// scenario runner picks up the firmware's own banners.
+//
+using System.Text;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Peripherals.Bus;
+
+namespace Antmicro.Renode.Peripherals.Miscellaneous
+{
+    public class ItmConsole : IDoubleWordPeripheral, IBytePeripheral, IKnownSize
+    {
+        public void Reset()
+        {
+            line.Clear();
+            tcr = 0;
+            ter = 0;
+        }
+
+        public uint ReadDoubleWord(long offset)
+        {
+            switch(offset)
+            {
+            case TerOffset:
+                return ter;
+            case TcrOffset:
+                return tcr;
+            default:
+                return offset < PortCount * 4 ? 1u : 0u;  // FIFO ready
+            }
+        }
+
+        public void WriteDoubleWord(long offset, uint value)
+        {
+            switch(offset)
+            {
+            case TerOffset:
+                ter = value;
+                break;
+            case TcrOffset:
+                tcr = value;
+                break;
+            case 0:
+                Put((byte)value);
+                break;
+            }
+        }
+
+        public byte ReadByte(long offset)
+        {
+            return (byte)(ReadDoubleWord(offset & ~3) >> (int)(8 * (offset & 3)));
+        }
+
+        public void WriteByte(long offset, byte value)
+        {
+            if(offset == 0)
+            {
+                Put(value);
+            }
+        }
+
+        public long Size => 0x1000;
+
+        private void Put(byte value)
+        {
+            if(value == '\n')
+            {
+                this.Log(LogLevel.Info, "ITM: {0}", line.ToString().TrimEnd('\r'));
+                line.Clear();
+            }
+            else
+            {
+                line.Append((char)value);
+            }
+        }
+
+        private readonly StringBuilder line = new StringBuilder();
+        private uint tcr;
+        private uint ter;
+
+        private const int PortCount = 32;
+        private const long TerOffset = 0xE00;
+        private const long TcrOffset = 0xE80;
+    }
+}
@@ -0,0 +1,316 @@
+//
+// W25Q128JV SPI flash model for Renode
+//
+// Same command set and behaviour as Tools/host/sim/w25q128_sim.c. Program and
+// erase keep BUSY set for the datasheet typical times in virtual time, so
+// polling loops in w25q128.c cost what they cost on the board. Commands other
+// than status reads are ignored while busy, and only 0xAB is accepted in
+// power-down, as on the chip.
+//
+// /CS is GPIO input 0. LoadImage/SaveImage back the array with a file, so
+// scenarios can start from a known layout.
+//
+using System;
+using System.IO;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+using Antmicro.Renode.Time;
+
+namespace Antmicro.Renode.Peripherals.SPI
+{
+    public class W25Q128 : ISPIPeripheral, IGPIOReceiver
+    {
+        public W25Q128(IMachine machine)
+        {
+            this.machine = machine;
+            memory = new byte[Size];
+            for(var i = 0; i < Size; i++)
+            {
+                memory[i] = 0xFF;
+            }
+            Reset();
+        }
+
+        public void Reset()
+        {
+            selected = false;
+            writeEnabled = false;
+            powerDown = false;
+            busyUntil = TimeInterval.Empty;
+        }
+
+        public void OnGPIO(int number, bool value)
+        {
+            if(number != 0)
+            {
+                return;
+            }
+            if(!value)
+            {
+                selected = true;
+                phase = Phase.Opcode;
+                address = 0;
+                dataCount = 0;
+            }
+            else if(selected)
+            {
+                Complete();
+                selected = false;
+                opcode = 0;
+            }
+        }
+
+        public byte Transmit(byte data)
+        {
+            if(!selected)
+            {
+                return 0xFF;
+            }
+            bytesTransferred++;
+
+            switch(phase)
+            {
+            case Phase.Opcode:
+                Start(data);
+                return 0xFF;
+            case Phase.Address:
+                address = (address << 8) | data;
+                if(--addressBytes == 0)
+                {
+                    phase = Phase.Data;
+                }
+                return 0xFF;
+            default:
+                return opcode != 0 ? Data(data) : (byte)0xFF;
+            }
+        }
+
+        public void FinishTransmission()
+        {
+            // Commands are delimited by /CS, not by the controller
+        }
+
+        public void LoadImage(string path)
+        {
+            var data = File.ReadAllBytes(path);
+            Array.Copy(data, memory, Math.Min(data.Length, Size));
+        }
+
+        public void SaveImage(string path)
+        {
+            File.WriteAllBytes(path, memory);
+        }
+
+        public string GetStats()
+        {
+            return string.Format("STATS w25q128 spi_bytes={0} page_programs={1} sector_erases={2} block_erases={3} busy_polls={4} ignored_busy={5}",
+                bytesTransferred, pagePrograms, sectorErases, blockErases, busyPolls, ignoredWhileBusy);
+        }
+
+        private bool Busy => machine.LocalTimeSource.ElapsedVirtualTime < busyUntil;
+
+        private void SetBusy(ulong microseconds)
+        {
+            busyUntil = machine.LocalTimeSource.ElapsedVirtualTime + TimeInterval.FromMicroseconds(microseconds);
+        }
+
+        private void Start(byte code)
+        {
+            opcode = code;
+            addressBytes = 0;
+
+            if(powerDown && code != 0xAB)
+            {
+                opcode = 0;
+                return;
+            }
+            if(Busy && code != 0x05 && code != 0x35 && code != 0x15)
+            {
+                this.Log(LogLevel.Warning, "Opcode 0x{0:X2} ignored while busy", code);
+                ignoredWhileBusy++;
+                opcode = 0;
+                return;
+            }
+
+            switch(code)
+            {
+            case 0x06:
+                writeEnabled = true;
+                break;
+            case 0x04:
+                writeEnabled = false;
+                break;
+            case 0xB9:
+                powerDown = true;
+                break;
+            case 0xAB:
+                powerDown = false;
+                addressBytes = 3;               // Three dummies, then the device ID
+                break;
+            case 0x90:
+            case 0x03:
+            case 0x0B:
+                addressBytes = 3;
+                break;
+            case 0x02:
+            case 0x20:
+            case 0x52:
+            case 0xD8:
+                if(!writeEnabled)
+                {
+                    opcode = 0;                 // Program/erase without WREN is ignored
+                    return;
+                }
+                addressBytes = 3;
+                Array.Clear(pageUsed, 0, pageUsed.Length);
+                break;
+            case 0xC7:
+            case 0x60:
+                if(!writeEnabled)
+                {
+                    opcode = 0;
+                }
+                break;
+            }
+            phase = addressBytes > 0 ? Phase.Address : Phase.Data;
+        }
+
+        private byte Data(byte mosi)
+        {
+            var n = dataCount++;
+            switch(opcode)
+            {
+            case 0x9F:
+                return n < 3 ? JedecId[n] : (byte)0xFF;
+            case 0x90:
+                return (n & 1) != 0 ? (byte)0x17 : (byte)0xEF;
+            case 0xAB:
+                return 0x17;
+            case 0x05:
+                busyPolls++;
+                return (byte)((Busy ? 0x01 : 0x00) | (writeEnabled ? 0x02 : 0x00));
+            case 0x35:
+                return 0x02;
+            case 0x15:
+                return 0x00;
+            case 0x03:
+                return memory[(address + n) & (Size - 1)];
+            case 0x0B:
+                return n == 0 ? (byte)0xFF : memory[(address + n - 1) & (Size - 1)];
+            case 0x02:
+                var offset = (address + n) & (PageSize - 1);
+                pageBuffer[offset] = mosi;
+                pageUsed[offset] = true;
+                return 0xFF;
+            default:
+                return 0xFF;
+            }
+        }
+
+        private void Complete()
+        {
+            var addressed = phase == Phase.Data;
+            switch(opcode)
+            {
+            case 0x02:
+                if(dataCount > 0)
+                {
+                    var page = address & ~(PageSize - 1);
+                    for(var i = 0; i < PageSize; i++)
+                    {
+                        if(pageUsed[i])
+                        {
+                            memory[page + i] &= pageBuffer[i];
+                        }
+                    }
+                    pagePrograms++;
+                    Finish(TimePageProgramUs);
+                }
+                break;
+            case 0x20:
+                if(addressed)
+                {
+                    Erase(0x1000, TimeSectorEraseUs);
+                    sectorErases++;
+                }
+                break;
+            case 0x52:
+                if(addressed)
+                {
+                    Erase(0x8000, TimeBlock32EraseUs);
+                    blockErases++;
+                }
+                break;
+            case 0xD8:
+                if(addressed)
+                {
+                    Erase(0x10000, TimeBlock64EraseUs);
+                    blockErases++;
+                }
+                break;
+            case 0xC7:
+            case 0x60:
+                address = 0;
+                Erase(Size, TimeChipEraseUs);
+                break;
+            }
+        }
+
+        private void Erase(int size, ulong microseconds)
+        {
+            var start = address & ~(size - 1);
+            for(var i = 0; i < size; i++)
+            {
+                memory[start + i] = 0xFF;
+            }
+            Finish(microseconds);
+        }
+
+        private void Finish(ulong microseconds)
+        {
+            writeEnabled = false;
+            SetBusy(microseconds);
+        }
+
+        private enum Phase
+        {
+            Opcode,
+            Address,
+            Data
+        }
+
+        private readonly IMachine machine;
+        private readonly byte[] memory;
+        private readonly byte[] pageBuffer = new byte[PageSize];
+        private readonly bool[] pageUsed = new bool[PageSize];
+
+        private bool selected;
+        private bool writeEnabled;
+        private bool powerDown;
+        private TimeInterval busyUntil;
+        private Phase phase;
+        private byte opcode;
+        private int addressBytes;
+        private int address;
+        private int dataCount;
+
+        private ulong bytesTransferred;
+        private ulong pagePrograms;
+        private ulong sectorErases;
+        private ulong blockErases;
+        private ulong busyPolls;
+        private ulong ignoredWhileBusy;
+
+        private static readonly byte[] JedecId = { 0xEF, 0x40, 0x18 };
+
+        private const int Size = 0x1000000;
+        private const int PageSize = 256;
+
+        // Datasheet typical timings
+        private const ulong TimePageProgramUs = 400;
+        private const ulong TimeSectorEraseUs = 45000;
+        private const ulong TimeBlock32EraseUs = 120000;
+        private const ulong TimeBlock64EraseUs = 150000;
+        private const ulong TimeChipEraseUs = 40000000;
+    }
+}
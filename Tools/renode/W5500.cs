@@ -0,0 +1,666 @@
+//
+// W5500 Ethernet controller model for Renode
+//
+// Same behaviour as Tools/host/sim/w5500_sim.c, as a Renode SPI peripheral:
+// SPI frames (address, control byte, data) are decoded against the common
+// and socket register blocks, and the eight hardware sockets are backed by
+// host UDP/TCP sockets, so real host tools can talk to the emulated board.
+//
+// - Local ports below 1024 are bound at port + portOffset (Modbus on 10502).
+// - Traffic to the device's subnet or broadcast goes to 'peer' (127.0.0.1).
+// - SCSn is GPIO input 0, RSTn is GPIO input 1, INTn is the IRQ output.
+//
+// Loaded by board.resc with 'include @Tools/renode/W5500.cs'.
+//
+using System;
+using System.Net;
+using System.Net.Sockets;
+using System.Threading;
+using Antmicro.Renode.Core;
+using Antmicro.Renode.Logging;
+
+namespace Antmicro.Renode.Peripherals.SPI
+{
+    public class W5500 : ISPIPeripheral, IGPIOReceiver
+    {
+        public W5500(int portOffset = 10000, string peer = "127.0.0.1")
+        {
+            this.portOffset = portOffset;
+            this.peer = IPAddress.Parse(peer);
+            IRQ = new GPIO();
+            for(var n = 0; n < SocketCount; n++)
+            {
+                sockets[n] = new SocketState();
+            }
+            Reset();
+
+            poller = new Thread(PollLoop) { IsBackground = true, Name = "W5500 network" };
+            poller.Start();
+        }
+
+        public void Reset()
+        {
+            lock(sync)
+            {
+                Array.Clear(common, 0, common.Length);
+                common[CommonRtr] = 0x07;
+                common[CommonRtr + 1] = 0xD0;
+                common[CommonRcr] = 0x08;
+                common[CommonPhyCfgr] = 0xBF;   // Auto-negotiated 100BASE-TX full duplex, link up
+                common[CommonVersion] = 0x04;
+
+                foreach(var s in sockets)
+                {
+                    s.CloseHost();
+                    Array.Clear(s.Reg, 0, s.Reg.Length);
+                    for(var i = 0; i < 6; i++)
+                    {
+                        s.Reg[SnDhar + i] = 0xFF;
+                    }
+                    s.Reg[SnTtl] = 0x80;
+                    s.Reg[SnRxBufSize] = 2;
+                    s.Reg[SnTxBufSize] = 2;
+                    s.Reg[SnImr] = 0xFF;
+                    s.Reg[SnFrag] = 0x40;
+                }
+                framePosition = 0;
+                UpdateIrq();
+            }
+        }
+
+        public void OnGPIO(int number, bool value)
+        {
+            if(number == 0)
+            {
+                lock(sync)
+                {
+                    if(value && framePosition > 0)
+                    {
+                        spiFrames++;            // SCSn high ends the frame
+                    }
+                    framePosition = 0;
+                }
+            }
+            else if(number == 1 && !value)
+            {
+                Reset();                        // RSTn low
+            }
+        }
+
+        public byte Transmit(byte data)
+        {
+            lock(sync)
+            {
+                spiBytes++;
+                switch(framePosition)
+                {
+                case 0:
+                    frameAddress = (ushort)(data << 8);
+                    framePosition++;
+                    return 0x01;
+                case 1:
+                    frameAddress |= data;
+                    framePosition++;
+                    return 0x02;
+                case 2:
+                    frameControl = data;
+                    framePosition++;
+                    return 0x03;
+                }
+
+                var bsb = frameControl >> 3;
+                var address = frameAddress++;
+                byte result = 0;
+                if((frameControl & 0x04) != 0)
+                {
+                    Write(bsb, address, data);
+                }
+                else
+                {
+                    result = Read(bsb, address);
+                }
+                UpdateIrq();
+                return result;
+            }
+        }
+
+        public void FinishTransmission()
+        {
+            // Frames are delimited by SCSn, not by the controller
+        }
+
+        public string GetStats()
+        {
+            lock(sync)
+            {
+                return string.Format("STATS w5500 spi_frames={0} spi_bytes={1} tx_packets={2} tx_bytes={3} rx_packets={4} rx_bytes={5} rx_dropped={6}",
+                    spiFrames, spiBytes, txPackets, txBytes, rxPackets, rxBytes, rxDropped);
+            }
+        }
+
+        public void ResetStats()
+        {
+            lock(sync)
+            {
+                spiFrames = spiBytes = txPackets = txBytes = rxPackets = rxBytes = rxDropped = 0;
+            }
+        }
+
+        public GPIO IRQ { get; }
+
+        // ====================================================================
+        // REGISTER ACCESS
+        // ====================================================================
+
+        private byte Read(int bsb, ushort address)
+        {
+            if(bsb == 0)
+            {
+                if(address == CommonSir)
+                {
+                    return SocketInterrupts();
+                }
+                return address < common.Length ? common[address] : (byte)0;
+            }
+
+            var s = sockets[((bsb - 1) >> 2) & 7];
+            switch((bsb - 1) & 3)
+            {
+            case 0:
+                if(address == SnTxFsr || address == SnTxFsr + 1)
+                {
+                    return HalfOf(s.TxFree, address == SnTxFsr);
+                }
+                if(address == SnRxRsr || address == SnRxRsr + 1)
+                {
+                    return HalfOf(s.RxUsed, address == SnRxRsr);
+                }
+                return address < s.Reg.Length ? s.Reg[address] : (byte)0;
+            case 1:
+                return s.TxSize > 0 ? s.Tx[address & (s.TxSize - 1)] : (byte)0;
+            case 2:
+                return s.RxSize > 0 ? s.Rx[address & (s.RxSize - 1)] : (byte)0;
+            default:
+                return 0;
+            }
+        }
+
+        private void Write(int bsb, ushort address, byte value)
+        {
+            if(bsb == 0)
+            {
+                if(address == CommonMr && (value & 0x80) != 0)
+                {
+                    Reset();
+                }
+                else if(address == CommonIr)
+                {
+                    common[CommonIr] &= (byte)~value;
+                }
+                else if(address < common.Length && address != CommonSir && address != CommonVersion)
+                {
+                    common[address] = value;
+                }
+                return;
+            }
+
+            var s = sockets[((bsb - 1) >> 2) & 7];
+            switch((bsb - 1) & 3)
+            {
+            case 0:
+                if(address == SnCr)
+                {
+                    Command(s, value);
+                }
+                else if(address == SnIr)
+                {
+                    s.Reg[SnIr] &= (byte)~value;
+                }
+                else if(address < s.Reg.Length && address != SnSr && (address < SnTxFsr || address > SnTxFsr + 1)
+                        && (address < SnRxRsr || address > SnRxRsr + 1))
+                {
+                    s.Reg[address] = value;
+                }
+                break;
+            case 1:
+                if(s.TxSize > 0)
+                {
+                    s.Tx[address & (s.TxSize - 1)] = value;
+                }
+                break;
+            case 2:
+                if(s.RxSize > 0)
+                {
+                    s.Rx[address & (s.RxSize - 1)] = value;
+                }
+                break;
+            }
+        }
+
+        private byte SocketInterrupts()
+        {
+            byte sir = 0;
+            for(var n = 0; n < SocketCount; n++)
+            {
+                if((sockets[n].Reg[SnIr] & sockets[n].Reg[SnImr]) != 0)
+                {
+                    sir |= (byte)(1 << n);
+                }
+            }
+            return sir;
+        }
+
+        private void UpdateIrq()
+        {
+            var pending = (SocketInterrupts() & common[CommonSimr]) != 0 || (common[CommonIr] & common[CommonImr]) != 0;
+            IRQ.Set(!pending);                  // INTn is active low
+        }
+
+        private static byte HalfOf(int value, bool high)
+        {
+            return high ? (byte)(value >> 8) : (byte)value;
+        }
+
+        // ====================================================================
+        // COMMANDS
+        // ====================================================================
+
+        private void Command(SocketState s, byte command)
+        {
+            switch(command)
+            {
+            case CrOpen:
+                s.CloseHost();
+                Array.Clear(s.Reg, SnTxRd, SnImr - SnTxRd);
+                s.Reg[SnIr] = 0;
+                switch(s.Reg[SnMr] & 0x0F)
+                {
+                case MrTcp:
+                    s.Reg[SnSr] = SrInit;
+                    break;
+                case MrUdp:
+                    s.Host = Bind(SocketType.Dgram, ProtocolType.Udp, s.Port);
+                    if(s.Host != null && (s.Reg[SnMr] & MrMulti) != 0)
+                    {
+                        s.Host.SetSocketOption(SocketOptionLevel.IP, SocketOptionName.AddMembership,
+                            new MulticastOption(new IPAddress(s.DestinationBytes)));
+                    }
+                    s.Reg[SnSr] = s.Host != null ? SrUdp : SrClosed;
+                    break;
+                case MrIpRaw:
+                    s.Reg[SnSr] = SrIpRaw;
+                    break;
+                case MrMacRaw:
+                    s.Reg[SnSr] = SrMacRaw;
+                    break;
+                }
+                break;
+            case CrListen:
+                if(s.Reg[SnSr] == SrInit)
+                {
+                    s.Listener = Bind(SocketType.Stream, ProtocolType.Tcp, s.Port);
+                    if(s.Listener != null)
+                    {
+                        s.Listener.Listen(1);
+                        s.Reg[SnSr] = SrListen;
+                    }
+                    else
+                    {
+                        s.Reg[SnSr] = SrClosed;
+                    }
+                }
+                break;
+            case CrConnect:
+                if(s.Reg[SnSr] == SrInit)
+                {
+                    s.Host = Bind(SocketType.Stream, ProtocolType.Tcp, s.Port);
+                    try
+                    {
+                        s.Host.Blocking = true;
+                        s.Host.Connect(Destination(s));
+                        s.Host.Blocking = false;
+                        s.Reg[SnSr] = SrEstablished;
+                        s.Reg[SnIr] |= IrCon;
+                    }
+                    catch(Exception)
+                    {
+                        s.CloseHost();
+                        s.Reg[SnSr] = SrClosed;
+                        s.Reg[SnIr] |= IrTimeout;
+                    }
+                }
+                break;
+            case CrDiscon:
+                s.CloseHost();
+                s.Reg[SnSr] = SrClosed;
+                s.Reg[SnIr] |= IrDiscon;
+                break;
+            case CrClose:
+                s.CloseHost();
+                s.Reg[SnSr] = SrClosed;
+                break;
+            case CrSend:
+            case CrSendMac:
+            case CrSendKeep:
+                Send(s);
+                break;
+            }
+            s.Reg[SnCr] = 0;
+        }
+
+        private void Send(SocketState s)
+        {
+            var payload = s.TakeTx();
+            var ok = false;
+            try
+            {
+                if(s.Host != null && s.Reg[SnSr] == SrUdp)
+                {
+                    ok = s.Host.SendTo(payload, Destination(s)) == payload.Length;
+                }
+                else if(s.Host != null && (s.Reg[SnSr] == SrEstablished || s.Reg[SnSr] == SrCloseWait))
+                {
+                    ok = s.Host.Send(payload) == payload.Length;
+                }
+                else if(s.Reg[SnSr] == SrIpRaw || s.Reg[SnSr] == SrMacRaw)
+                {
+                    ok = true;
+                }
+            }
+            catch(SocketException e)
+            {
+                this.Log(LogLevel.Warning, "Send failed: {0}", e.Message);
+            }
+            if(ok)
+            {
+                txPackets++;
+                txBytes += (ulong)payload.Length;
+            }
+            s.Reg[SnIr] |= ok ? IrSendOk : IrTimeout;
+        }
+
+        // ====================================================================
+        // HOST NETWORK
+        // ====================================================================
+
+        private Socket Bind(SocketType type, ProtocolType protocol, int port)
+        {
+            var host = port < 1024 ? port + portOffset : port;
+            var socket = new Socket(AddressFamily.InterNetwork, type, protocol);
+            try
+            {
+                socket.SetSocketOption(SocketOptionLevel.Socket, SocketOptionName.ReuseAddress, true);
+                if(type == SocketType.Dgram)
+                {
+                    socket.EnableBroadcast = true;
+                }
+                socket.Bind(new IPEndPoint(IPAddress.Any, host));
+                socket.Blocking = false;
+                return socket;
+            }
+            catch(SocketException e)
+            {
+                this.Log(LogLevel.Warning, "Bind port {0} failed: {1}", host, e.Message);
+                socket.Close();
+                return null;
+            }
+        }
+
+        private IPEndPoint Destination(SocketState s)
+        {
+            var dip = s.DestinationBytes;
+            var multicast = (dip[0] & 0xF0) == 0xE0;
+            var local = true;
+            var broadcast = true;
+            for(var i = 0; i < 4; i++)
+            {
+                local &= ((dip[i] ^ common[CommonSipr + i]) & common[CommonSubr + i]) == 0;
+                broadcast &= dip[i] == (byte)(common[CommonSipr + i] | ~common[CommonSubr + i]) || dip[i] == 0xFF;
+            }
+            var address = (!multicast && (local || broadcast)) ? peer : new IPAddress(dip);
+            return new IPEndPoint(address, s.DestinationPort);
+        }
+
+        private void PollLoop()
+        {
+            var buffer = new byte[65536];
+            while(true)
+            {
+                lock(sync)
+                {
+                    foreach(var s in sockets)
+                    {
+                        try
+                        {
+                            Poll(s, buffer);
+                        }
+                        catch(SocketException)
+                        {
+                            s.CloseHost();
+                            s.Reg[SnSr] = SrClosed;
+                            s.Reg[SnIr] |= IrTimeout;
+                        }
+                    }
+                    UpdateIrq();
+                }
+                Thread.Sleep(1);
+            }
+        }
+
+        private void Poll(SocketState s, byte[] buffer)
+        {
+            switch(s.Reg[SnSr])
+            {
+            case SrUdp:
+                while(s.Host.Available > 0)
+                {
+                    EndPoint from = new IPEndPoint(IPAddress.Any, 0);
+                    var n = s.Host.ReceiveFrom(buffer, ref from);
+                    if(n + 8 > s.RxSize - s.RxUsed)
+                    {
+                        rxDropped++;                    // No room: dropped, as on the chip
+                        continue;
+                    }
+                    var endpoint = (IPEndPoint)from;
+                    var header = new byte[8];
+                    Array.Copy(endpoint.Address.GetAddressBytes(), header, 4);
+                    header[4] = (byte)(endpoint.Port >> 8);
+                    header[5] = (byte)endpoint.Port;
+                    header[6] = (byte)(n >> 8);
+                    header[7] = (byte)n;
+                    s.PutRx(header, 8);
+                    s.PutRx(buffer, n);
+                    s.Reg[SnIr] |= IrRecv;
+                    rxPackets++;
+                    rxBytes += (ulong)n;
+                }
+                break;
+            case SrListen:
+                if(s.Listener.Poll(0, SelectMode.SelectRead))
+                {
+                    s.Host = s.Listener.Accept();
+                    s.Host.Blocking = false;
+                    s.Listener.Close();
+                    s.Listener = null;
+                    var remote = (IPEndPoint)s.Host.RemoteEndPoint;
+                    Array.Copy(remote.Address.GetAddressBytes(), 0, s.Reg, SnDipr, 4);
+                    s.Reg[SnDport] = (byte)(remote.Port >> 8);
+                    s.Reg[SnDport + 1] = (byte)remote.Port;
+                    s.Reg[SnSr] = SrEstablished;
+                    s.Reg[SnIr] |= IrCon;
+                }
+                break;
+            case SrEstablished:
+                var room = s.RxSize - s.RxUsed;
+                if(room > 0 && s.Host.Poll(0, SelectMode.SelectRead))
+                {
+                    var n = s.Host.Receive(buffer, Math.Min(room, buffer.Length), SocketFlags.None);
+                    if(n > 0)
+                    {
+                        s.PutRx(buffer, n);
+                        s.Reg[SnIr] |= IrRecv;
+                        rxPackets++;
+                        rxBytes += (ulong)n;
+                    }
+                    else
+                    {
+                        s.Reg[SnSr] = SrCloseWait;      // Peer closed
+                        s.Reg[SnIr] |= IrDiscon;
+                    }
+                }
+                break;
+            }
+        }
+
+        private class SocketState
+        {
+            public readonly byte[] Reg = new byte[0x30];
+            public readonly byte[] Tx = new byte[16384];
+            public readonly byte[] Rx = new byte[16384];
+            public Socket Host;
+            public Socket Listener;
+
+            public int TxSize => Reg[SnTxBufSize] <= 16 ? Reg[SnTxBufSize] * 1024 : 0;
+            public int RxSize => Reg[SnRxBufSize] <= 16 ? Reg[SnRxBufSize] * 1024 : 0;
+            public int Port => Get16(SnPort);
+            public int DestinationPort => Get16(SnDport);
+            public byte[] DestinationBytes => new[] { Reg[SnDipr], Reg[SnDipr + 1], Reg[SnDipr + 2], Reg[SnDipr + 3] };
+
+            public int TxFree
+            {
+                get
+                {
+                    var used = (ushort)(Get16(SnTxWr) - Get16(SnTxRd));
+                    return used <= TxSize ? TxSize - used : 0;
+                }
+            }
+
+            public int RxUsed => (ushort)(Get16(SnRxWr) - Get16(SnRxRd));
+
+            public void PutRx(byte[] data, int length)
+            {
+                var wr = Get16(SnRxWr);
+                for(var i = 0; i < length; i++)
+                {
+                    Rx[(wr + i) & (RxSize - 1)] = data[i];
+                }
+                Set16(SnRxWr, wr + length);
+            }
+
+            public byte[] TakeTx()
+            {
+                var rd = Get16(SnTxRd);
+                var length = Math.Min((ushort)(Get16(SnTxWr) - rd), TxSize);
+                var data = new byte[length];
+                for(var i = 0; i < length; i++)
+                {
+                    data[i] = Tx[(rd + i) & (TxSize - 1)];
+                }
+                Set16(SnTxRd, rd + length);
+                return data;
+            }
+
+            public void CloseHost()
+            {
+                Host?.Close();
+                Listener?.Close();
+                Host = null;
+                Listener = null;
+            }
+
+            private int Get16(int offset)
+            {
+                return (Reg[offset] << 8) | Reg[offset + 1];
+            }
+
+            private void Set16(int offset, int value)
+            {
+                Reg[offset] = (byte)(value >> 8);
+                Reg[offset + 1] = (byte)value;
+            }
+        }
+
+        private readonly object sync = new object();
+        private readonly byte[] common = new byte[0x40];
+        private readonly SocketState[] sockets = new SocketState[SocketCount];
+        private readonly int portOffset;
+        private readonly IPAddress peer;
+        private readonly Thread poller;
+
+        private int framePosition;
+        private ushort frameAddress;
+        private byte frameControl;
+
+        private ulong spiFrames;
+        private ulong spiBytes;
+        private ulong txPackets;
+        private ulong txBytes;
+        private ulong rxPackets;
+        private ulong rxBytes;
+        private ulong rxDropped;
+
+        private const int SocketCount = 8;
+
+        private const int CommonMr = 0x00;
+        private const int CommonSubr = 0x05;
+        private const int CommonSipr = 0x0F;
+        private const int CommonIr = 0x15;
+        private const int CommonImr = 0x16;
+        private const int CommonSir = 0x17;
+        private const int CommonSimr = 0x18;
+        private const int CommonRtr = 0x19;
+        private const int CommonRcr = 0x1B;
+        private const int CommonPhyCfgr = 0x2E;
+        private const int CommonVersion = 0x39;
+
+        private const int SnMr = 0x00;
+        private const int SnCr = 0x01;
+        private const int SnIr = 0x02;
+        private const int SnSr = 0x03;
+        private const int SnPort = 0x04;
+        private const int SnDhar = 0x06;
+        private const int SnDipr = 0x0C;
+        private const int SnDport = 0x10;
+        private const int SnTtl = 0x16;
+        private const int SnRxBufSize = 0x1E;
+        private const int SnTxBufSize = 0x1F;
+        private const int SnTxFsr = 0x20;
+        private const int SnTxRd = 0x22;
+        private const int SnTxWr = 0x24;
+        private const int SnRxRsr = 0x26;
+        private const int SnRxRd = 0x28;
+        private const int SnRxWr = 0x2A;
+        private const int SnImr = 0x2C;
+        private const int SnFrag = 0x2D;
+
+        private const int MrTcp = 0x01;
+        private const int MrUdp = 0x02;
+        private const int MrIpRaw = 0x03;
+        private const int MrMacRaw = 0x04;
+        private const int MrMulti = 0x80;
+
+        private const byte CrOpen = 0x01;
+        private const byte CrListen = 0x02;
+        private const byte CrConnect = 0x04;
+        private const byte CrDiscon = 0x08;
+        private const byte CrClose = 0x10;
+        private const byte CrSend = 0x20;
+        private const byte CrSendMac = 0x21;
+        private const byte CrSendKeep = 0x22;
+
+        private const byte IrCon = 0x01;
+        private const byte IrDiscon = 0x02;
+        private const byte IrRecv = 0x04;
+        private const byte IrTimeout = 0x08;
+        private const byte IrSendOk = 0x10;
+
+        private const byte SrClosed = 0x00;
+        private const byte SrInit = 0x13;
+        private const byte SrListen = 0x14;
+        private const byte SrEstablished = 0x17;
+        private const byte SrCloseWait = 0x1C;
+        private const byte SrUdp = 0x22;
+        private const byte SrIpRaw = 0x32;
+        private const byte SrMacRaw = 0x42;
+    }
+}
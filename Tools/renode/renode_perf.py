@@ -0,0 +1,423 @@
+#!/usr/bin/env python3
+"""
+Renode Performance Scenarios
+----------------------------
+Boots the firmware ELF in Renode on the STM32F103C8 platform with the W5500
+and W25Q128 models (board.resc), drives traffic at it from the host and
+reports, per scenario, the request rate in virtual time and the SPI work done
+by w5500_spi.c and w25q128.c. With --profile, Renode's collapsed-stack
+profiler adds instructions per request for the driver and task functions.
+
+Runs are deterministic in virtual time, so two reports taken on the same
+host before and after a change to w5500_spi.c, w25q128.c or freertos.c can
+be compared directly; --baseline exits 1 on a regression.
+
+Scenarios:
+idle     no traffic; the cost of the polling loops alone
+rpc      RPC pings on UDP 5005
+flash    RPC flash reads and page writes in USER_DATA; needs a build with
+         FLASH_DRIVER_ENABLED=1 and is reported as skipped otherwise
+modbus   Modbus TCP reads of holding registers (port 502 -> 10502)
+bench    collect a BENCH_ENABLED=1 build's results (Core/Src/bench.c)
+
+Usage:
+python Tools/renode/renode_perf.py --elf Debug/stm32f103_w5500.elf
+python Tools/renode/renode_perf.py --elf fw.elf --scenarios rpc,flash --save before.json
+python Tools/renode/renode_perf.py --elf fw.elf --baseline before.json --threshold 5
+
+Run from the repository root (board.resc includes its files by path).
+
+Dependencies:
+- Python 3.x
+- Renode 1.14 or newer in PATH (or --renode)
+"""
+
+import socket
+import struct
+import subprocess
+import threading
+import argparse
+import json
+import time
+import re
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import rpc_client      # noqa: E402
+import bench_collect   # noqa: E402
+
+MONITOR_PORT = 33334
+MODBUS_PORT = 10502
+SLICE_S = 0.05         # virtual time per RunFor; traffic is served between slices
+PROMPT = re.compile(rb"\([\w-]+\) $")
+ANSI = re.compile(rb"\x1b\[[0-9;]*[A-Za-z]|\xff[\xfb-\xfe].|\xff[\xf0-\xfa]")
+USER_DATA = 0x480000
+
+# Functions whose inclusive instruction count is reported with --profile
+PROFILED = ("w5500_spi_", "w5500_socket_", "w25q128_", "StartTask")
+
+
+class Monitor:
+    """Line-oriented client for the Renode monitor on its telnet port"""
+
+    def __init__(self, port, timeout=120):
+        deadline = time.time() + timeout
+        while True:
+            try:
+                self.sock = socket.create_connection(("127.0.0.1", port), timeout=timeout)
+                break
+            except OSError:
+                if time.time() > deadline:
+                    raise
+                time.sleep(0.5)
+        self.buffer = b""
+        self.read_prompt()
+
+    def read_prompt(self):
+        while True:
+            clean = ANSI.sub(b"", self.buffer)
+            match = PROMPT.search(clean)
+            if match:
+                self.buffer = b""
+                return clean[:match.start()].decode(errors="replace")
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError("Renode monitor closed")
+            self.buffer += chunk
+
+    def command(self, text):
+        self.sock.sendall(text.encode() + b"\n")
+        out = self.read_prompt()
+        # Drop the echoed command line
+        lines = [l for l in out.replace("\r", "").split("\n") if l.strip() and l.strip() != text]
+        return "\n".join(lines)
+
+    def run_for(self, seconds):
+        self.command(f'emulation RunFor "{seconds_to_interval(seconds)}"')
+
+    def close(self):
+        try:
+            self.sock.sendall(b"quit\n")
+        except OSError:
+            pass
+        self.sock.close()
+
+
+def seconds_to_interval(seconds):
+    whole = int(seconds)
+    micros = int(round((seconds - whole) * 1e6))
+    return f"{whole // 3600:02}:{whole // 60 % 60:02}:{whole % 60:02}.{micros:06}"
+
+
+def parse_stats(text):
+    """'STATS name k=v ...' lines from the models' GetStats into a flat dict"""
+    stats = {}
+    for line in text.splitlines():
+        parts = line.split()
+        if len(parts) < 2 or parts[0] != "STATS":
+            continue
+        for kv in parts[2:]:
+            key, _, value = kv.partition("=")
+            stats[f"{parts[1]}.{key}"] = int(value)
+    return stats
+
+
+def snapshot(mon):
+    """Instruction count and model counters at this point in virtual time"""
+    stats = parse_stats(mon.command("sysbus.spi2.w5500 GetStats"))
+    stats.update(parse_stats(mon.command("sysbus.spi1.w25q128 GetStats")))
+    digits = re.findall(r"\d+", mon.command("sysbus.cpu ExecutedInstructions"))
+    stats["instructions"] = int(digits[-1]) if digits else 0
+    return stats
+
+
+# ---------------------------------------------------------------------------
+# Traffic generators: run on a thread while the emulation advances in slices
+# ---------------------------------------------------------------------------
+
+class Traffic(threading.Thread):
+    def __init__(self):
+        super().__init__(daemon=True)
+        self.stop = threading.Event()
+        self.ok = 0
+        self.failed = 0
+
+    def run(self):
+        while not self.stop.is_set():
+            try:
+                self.once()
+                self.ok += 1
+            except (rpc_client.RpcError, OSError):
+                self.failed += 1
+
+
+class RpcPing(Traffic):
+    def __init__(self, schema):
+        super().__init__()
+        self.client = rpc_client.RpcClient(schema, "127.0.0.1", timeout=2.0, retries=0)
+
+    def once(self):
+        self.client.call("ping")
+
+
+class FlashTraffic(Traffic):
+    """Programs 64 bytes into the next page of one USER_DATA sector and reads them back"""
+
+    def __init__(self, schema):
+        super().__init__()
+        self.client = rpc_client.RpcClient(schema, "127.0.0.1", timeout=2.0, retries=0)
+        self.page = 0
+        self.unsupported = False
+
+    def once(self):
+        try:
+            if self.page % 16 == 0:
+                self.client.call("flash_erase", addr=USER_DATA)
+            addr = USER_DATA + (self.page % 16) * 256
+            self.client.call("flash_write", addr=addr, data=bytes(range(64)))
+            self.client.call("flash_read", addr=addr, len=64)
+        except rpc_client.RpcError as e:
+            # A FLASH_DRIVER_ENABLED=0 build answers every flash op with a stub
+            if str(e) == "unsupported":
+                self.unsupported = True
+                self.stop.set()
+            raise
+        self.page += 1
+
+
+class ModbusRead(Traffic):
+    """FC03 reads of ten holding registers over one connection"""
+
+    def __init__(self):
+        super().__init__()
+        self.sock = None
+        self.tid = 0
+
+    def once(self):
+        if self.sock is None:
+            self.sock = socket.create_connection(("127.0.0.1", MODBUS_PORT), timeout=2.0)
+        self.tid = (self.tid + 1) & 0xFFFF
+        self.sock.sendall(struct.pack(">HHHBBHH", self.tid, 0, 6, 1, 3, 0, 10))
+        reply = self.sock.recv(260)
+        if len(reply) < 9 or struct.unpack_from(">H", reply)[0] != self.tid:
+            self.sock.close()
+            self.sock = None
+            raise OSError("bad Modbus reply")
+
+
+class BenchListen(Traffic):
+    """Not a load: waits for one bench.c run while the board produces it"""
+
+    def __init__(self, timeout):
+        super().__init__()
+        self.timeout = timeout
+        self.result = None
+
+    def run(self):
+        self.result = bench_collect.collect(bench_collect.BENCH_PORT, self.timeout)
+        self.ok = 1 if self.result else 0
+
+
+def make_traffic(name, schema, duration):
+    if name == "idle":
+        return None
+    if name == "rpc":
+        return RpcPing(schema)
+    if name == "flash":
+        return FlashTraffic(schema)
+    if name == "modbus":
+        return ModbusRead()
+    if name == "bench":
+        return BenchListen(timeout=max(60.0, duration * 20))
+    raise ValueError(name)
+
+
+# ---------------------------------------------------------------------------
+# Profiler output
+# ---------------------------------------------------------------------------
+
+def profile_totals(path):
+    """Inclusive instruction counts per function from a collapsed-stack file"""
+    totals = {}
+    if not os.path.exists(path):
+        return totals
+    with open(path) as f:
+        for line in f:
+            stack, _, count = line.rstrip().rpartition(" ")
+            if not stack or not count.isdigit():
+                continue
+            for fn in set(stack.split(";")):
+                if fn.startswith(PROFILED):
+                    totals[fn] = totals.get(fn, 0) + int(count)
+    return totals
+
+
+# ---------------------------------------------------------------------------
+# Scenario runner
+# ---------------------------------------------------------------------------
+
+def run_scenario(mon, name, schema, duration, profile_dir):
+    traffic = make_traffic(name, schema, duration)
+    profile_path = None
+    if profile_dir:
+        profile_path = os.path.abspath(os.path.join(profile_dir, f"{name}.folded"))
+        if os.path.exists(profile_path):
+            os.remove(profile_path)
+        mon.command(f"sysbus.cpu EnableProfiler CollapsedStack @{profile_path} true")
+
+    before = snapshot(mon)
+    if traffic:
+        traffic.start()
+
+    elapsed = 0.0
+    while elapsed < duration or (name == "bench" and traffic.is_alive() and elapsed < duration * 20):
+        if getattr(traffic, "unsupported", False):
+            break
+        mon.run_for(SLICE_S)
+        elapsed += SLICE_S
+
+    if traffic:
+        traffic.stop.set()
+        traffic.join(timeout=5)
+    after = snapshot(mon)
+
+    if profile_path:
+        mon.command("sysbus.cpu DisableProfiler")
+
+    if getattr(traffic, "unsupported", False):
+        reason = "firmware built without FLASH_DRIVER_ENABLED=1"
+        print(f"Skipping {name}: {reason}")
+        return {"skipped": reason}
+
+    delta = {key: after[key] - before.get(key, 0) for key in after}
+    ops = traffic.ok if traffic else 0
+    result = {
+        "virtual_s": round(elapsed, 3),
+        "ops": ops,
+        "failed": traffic.failed if traffic else 0,
+        "ops_per_s": round(ops / elapsed, 2) if elapsed else 0.0,
+        "counters": delta,
+    }
+    if ops:
+        result["per_op"] = {
+            "instructions": round(delta["instructions"] / ops),
+            "w5500_spi_bytes": round(delta.get("w5500.spi_bytes", 0) / ops, 1),
+            "w25q128_spi_bytes": round(delta.get("w25q128.spi_bytes", 0) / ops, 1),
+        }
+    if profile_path:
+        totals = profile_totals(profile_path)
+        result["profile"] = {fn: round(count / max(ops, 1)) for fn, count in
+                             sorted(totals.items(), key=lambda kv: -kv[1])}
+    if name == "bench" and traffic.result:
+        result["bench"] = traffic.result
+    return result
+
+
+def print_report(report, baseline=None):
+    base = baseline["scenarios"] if baseline else {}
+    print(f"\n{'scenario':<10}{'ops':>8}{'ops/s':>10}{'instr/op':>12}{'w5500 B/op':>12}"
+          f"{'flash B/op':>12}{'vs base':>10}")
+    print("-" * 74)
+    for name, r in report["scenarios"].items():
+        if "skipped" in r:
+            print(f"{name:<10}skipped: {r['skipped']}")
+            continue
+        per = r.get("per_op", {})
+        delta = ""
+        ref = base.get(name)
+        if ref and ref.get("ops_per_s"):
+            delta = f"{(r['ops_per_s'] - ref['ops_per_s']) * 100.0 / ref['ops_per_s']:+.1f}%"
+        print(f"{name:<10}{r['ops']:>8}{r['ops_per_s']:>10.1f}{per.get('instructions', '-'):>12}"
+              f"{per.get('w5500_spi_bytes', '-'):>12}{per.get('w25q128_spi_bytes', '-'):>12}{delta:>10}")
+        for fn, count in list(r.get("profile", {}).items())[:8]:
+            print(f"    {fn:<36}{count:>12} instr/op")
+        if "bench" in r:
+            bench_collect.print_run(r["bench"], base.get(name, {}).get("bench"))
+
+
+def regressions(report, baseline, threshold):
+    """Scenarios whose rate dropped, or whose per-request work grew, by more than threshold percent"""
+    worse = []
+    for name, r in report["scenarios"].items():
+        ref = baseline["scenarios"].get(name)
+        if not ref or "skipped" in ref:
+            continue
+        if "skipped" in r:
+            worse.append(f"{name}: skipped")
+            continue
+        if ref["ops_per_s"] and (ref["ops_per_s"] - r["ops_per_s"]) * 100.0 / ref["ops_per_s"] > threshold:
+            worse.append(f"{name}: ops/s")
+        for key, value in r.get("per_op", {}).items():
+            old = ref.get("per_op", {}).get(key)
+            if old and (value - old) * 100.0 / old > threshold:
+                worse.append(f"{name}: {key}/op")
+        for fn, value in r.get("profile", {}).items():
+            old = ref.get("profile", {}).get(fn)
+            if old and (value - old) * 100.0 / old > threshold:
+                worse.append(f"{name}: {fn}")
+        if "bench" in r and "bench" in ref:
+            worse += [f"bench: {k}" for k in bench_collect.regressions(r["bench"], ref["bench"], threshold)]
+    return worse
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Renode performance scenarios")
+    parser.add_argument("--elf", required=True, help="Firmware ELF to boot")
+    parser.add_argument("--renode", default="renode", help="Renode executable")
+    parser.add_argument("--scenarios", default="idle,rpc,flash,modbus",
+                        help="Comma-separated list (idle,rpc,flash,modbus,bench)")
+    parser.add_argument("--duration", type=float, default=2.0, help="Virtual seconds per scenario")
+    parser.add_argument("--boot", type=float, default=1.0, help="Virtual seconds to boot before the first scenario")
+    parser.add_argument("--image", help="W25Q128 image to load before boot")
+    parser.add_argument("--profile", metavar="DIR", help="Enable the collapsed-stack profiler, output in DIR")
+    parser.add_argument("--port", type=int, default=MONITOR_PORT, help="Renode monitor telnet port")
+    parser.add_argument("--save", metavar="FILE", help="Store this report as a baseline")
+    parser.add_argument("--baseline", metavar="FILE", help="Compare against a stored baseline")
+    parser.add_argument("--threshold", type=float, default=5.0, help="Allowed regression in percent")
+    args = parser.parse_args()
+
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    if args.profile:
+        os.makedirs(args.profile, exist_ok=True)
+
+    schema = rpc_client.load_schema()
+    renode = subprocess.Popen([args.renode, "--disable-xwt", "--plain", "-P", str(args.port)],
+                              stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    report = {"elf": os.path.abspath(args.elf), "scenarios": {}}
+    try:
+        mon = Monitor(args.port)
+        mon.command(f"$elf=@{os.path.abspath(args.elf)}")
+        print(mon.command("include @Tools/renode/board.resc"))
+        if args.image:
+            mon.command(f"sysbus.spi1.w25q128 LoadImage @{os.path.abspath(args.image)}")
+        mon.run_for(args.boot)
+
+        for name in args.scenarios.split(","):
+            print(f"Running {name} for {args.duration} virtual seconds...")
+            report["scenarios"][name] = run_scenario(mon, name, schema, args.duration, args.profile)
+        mon.close()
+    finally:
+        renode.terminate()
+        renode.wait(timeout=10)
+
+    print_report(report, baseline)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(report, f, indent=2)
+        print(f"\nBaseline saved to {args.save}")
+
+    if baseline:
+        worse = regressions(report, baseline, args.threshold)
+        if worse:
+            print(f"\nWorse than baseline by more than {args.threshold}%: {', '.join(worse)}")
+            sys.exit(1)
+        print(f"\nNothing worse than baseline by more than {args.threshold}%")
+
+
+if __name__ == "__main__":
+    main()
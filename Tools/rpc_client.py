@@ -0,0 +1,420 @@
+#!/usr/bin/env python3
+"""
+STM32 RPC Client
+----------------
+Command-line client for the binary UDP RPC channel (Core/Src/rpc_server.c).
+Opcodes, payload layouts and configuration keys are read from rpc_schema.json,
+the same file the firmware tables are generated from (see rpc_gen.py).
+
+Requests are retried with the same request ID, so state-changing operations
+(set, erase, write, reboot) execute at most once even if a reply is lost.
+Several comma-separated hosts can be given at once; they are queried concurrently.
+
+Usage:
+python rpc_client.py 192.168.1.100 ping
+python rpc_client.py 192.168.1.100,192.168.1.101 metrics
+python rpc_client.py 192.168.1.100 get net_ip
+python rpc_client.py 192.168.1.100 set task02_period_ms 50
+python rpc_client.py 192.168.1.100 flash-read 0x380000 64
+python rpc_client.py 192.168.1.100 flash-erase 0x480000
+python rpc_client.py 192.168.1.100 flash-write 0x480000 deadbeef
+python rpc_client.py 192.168.1.100 flash-power
+python rpc_client.py 192.168.1.100 partitions
+python rpc_client.py 192.168.1.100 wear
+python rpc_client.py 192.168.1.100 partition-grow log 0x140000   # migrates at the reboot that follows
+python rpc_client.py 192.168.1.100 boot
+python rpc_client.py 192.168.1.100 iperf udp-rx                   # then: iperf -c <device> -u -b 2M
+python rpc_client.py 192.168.1.100 iperf tcp-tx 192.168.1.10 -t 10 --wait   # against: iperf -s
+python rpc_client.py 192.168.1.100 iperf tcp-rx --flash           # OTA path: stream into the RESERVED scratch
+python rpc_client.py 192.168.1.100 iperf-stats
+python rpc_client.py 192.168.1.101,192.168.1.102 sync node
+python rpc_client.py 192.168.1.100 sync master 192.168.1.10     # DATA to Tools/sync_collect.py
+python rpc_client.py 192.168.1.100 sync-start -p 1000 -n 5000
+python rpc_client.py 192.168.1.100,192.168.1.101 sync-stats
+python rpc_client.py 192.168.1.100 trace udp 192.168.1.10        # to Tools/trace_collect.py (TRACE_ENABLED=1 builds)
+python rpc_client.py 192.168.1.100 trace itm                     # SWO stimulus ports 1 and 2
+python rpc_client.py 192.168.1.100 trace-stats
+python rpc_client.py 192.168.1.100 reboot
+
+Dependencies:
+- Python 3.x
+"""
+
+import socket
+import struct
+import json
+import os
+import random
+import sys
+import threading
+import time
+import argparse
+
+SCHEMA_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "rpc_schema.json")
+TIMEOUT = 0.5  # seconds per attempt
+RETRIES = 4
+
+FIXED_TYPES = {"u8": ">B", "u16": ">H", "u32": ">I"}
+
+# Core/Inc/iperf.h: iperf_mode_t, iperf_state_t and IPERF_FLAG_xxx
+IPERF_MODES = ["off", "tcp-rx", "udp-rx", "tcp-tx", "udp-tx"]
+IPERF_STATES = ["idle", "connecting", "running", "finishing", "done", "failed"]
+IPERF_FLAG_SPI_PAYLOAD = 0x01
+IPERF_FLAG_FLASH_PAYLOAD = 0x02
+
+# Core/Inc/sync_sample.h: sync_role_t and sync_state_t
+SYNC_ROLES = ["off", "node", "master"]
+SYNC_STATES = ["idle", "pending", "sampling", "done", "missed"]
+
+# Core/Inc/trace.h: TRACE_OUT_UDP | TRACE_OUT_ITM, by index
+TRACE_OUTPUTS = ["off", "udp", "itm", "both"]
+
+# Core/Inc/flash_config.h: flash_part_id_t
+PARTITIONS = ["boot", "fw_a", "fw_b", "fw_c", "meta", "config", "eeprom", "log", "user_data", "reserved"]
+
+print_lock = threading.Lock()
+
+
+class RpcError(Exception):
+    """Raised when the device answers with a non-OK status or does not answer"""
+
+
+def load_schema(path=SCHEMA_PATH):
+    """Load the schema and build name lookup tables"""
+    with open(path) as f:
+        schema = json.load(f)
+    schema["ops_by_name"] = {op["name"]: op for op in schema["ops"]}
+    schema["keys_by_name"] = {key["name"]: key for key in schema["config_keys"]}
+    schema["keys_by_id"] = {key["id"]: key for key in schema["config_keys"]}
+    schema["status_by_id"] = {s["id"]: s["name"] for s in schema["status"]}
+    return schema
+
+
+def encode_fields(fields, values):
+    """Encode request values according to the schema field list"""
+    out = b""
+    for field in fields:
+        value = values[field["name"]]
+        if field["type"] in FIXED_TYPES:
+            out += struct.pack(FIXED_TYPES[field["type"]], value)
+        else:
+            out += bytes(value)
+    return out
+
+
+def decode_fields(fields, payload):
+    """Decode a reply payload according to the schema field list"""
+    result = {}
+    offset = 0
+    for field in fields:
+        if field["type"] in FIXED_TYPES:
+            fmt = FIXED_TYPES[field["type"]]
+            result[field["name"]] = struct.unpack_from(fmt, payload, offset)[0]
+            offset += struct.calcsize(fmt)
+        else:
+            result[field["name"]] = payload[offset:]
+            offset = len(payload)
+    return result
+
+
+def encode_key_value(key, text):
+    """Convert a command-line value into the raw bytes of a config key"""
+    if key["type"] == "ip":
+        return socket.inet_aton(text)
+    if key["type"] == "mac":
+        return bytes(int(part, 16) for part in text.split(":"))
+    return struct.pack(FIXED_TYPES[key["type"]], int(text, 0))
+
+
+def format_key_value(key, raw):
+    """Convert the raw bytes of a config key into text"""
+    if key["type"] == "ip":
+        return socket.inet_ntoa(raw)
+    if key["type"] == "mac":
+        return ":".join(f"{b:02X}" for b in raw)
+    return str(struct.unpack(FIXED_TYPES[key["type"]], raw)[0])
+
+
+class RpcClient:
+    """One device; request IDs are unique per client instance"""
+
+    def __init__(self, schema, host, port=None, timeout=TIMEOUT, retries=RETRIES):
+        self.schema = schema
+        self.addr = (host, port or schema["port"])
+        self.timeout = timeout
+        self.retries = retries
+        self.next_id = random.getrandbits(32)
+
+    def call(self, op_name, **values):
+        op = self.schema["ops_by_name"][op_name]
+        request_id = self.next_id
+        self.next_id = (self.next_id + 1) & 0xFFFFFFFF
+
+        header = struct.pack(">BBBBI", self.schema["magic"], self.schema["version"], op["id"], 0, request_id)
+        datagram = header + encode_fields(op["request"], values)
+
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.settimeout(self.timeout)
+        try:
+            for _ in range(self.retries + 1):
+                sock.sendto(datagram, self.addr)
+                try:
+                    while True:
+                        reply, _ = sock.recvfrom(1024)
+                        if len(reply) < 8:
+                            continue
+                        magic, version, rop, status, rid = struct.unpack_from(">BBBBI", reply)
+                        if rid == request_id and rop == op["id"]:
+                            break
+                except socket.timeout:
+                    continue
+                if status != 0:
+                    raise RpcError(self.schema["status_by_id"].get(status, f"status {status}"))
+                return decode_fields(op["reply"], reply[8:])
+        finally:
+            sock.close()
+        raise RpcError("no reply")
+
+
+def format_iperf_stats(stats):
+    """Text for a get_iperf reply"""
+    lines = [f"  {'mode':<18} {IPERF_MODES[stats['mode']]}",
+             f"  {'state':<18} {IPERF_STATES[stats['state']]}",
+             f"  {'payload over SPI':<18} {'yes' if stats['flags'] & IPERF_FLAG_SPI_PAYLOAD else 'no'}",
+             f"  {'payload in flash':<18} {'yes' if stats['flags'] & IPERF_FLAG_FLASH_PAYLOAD else 'no'}"]
+    for name in ("bytes", "elapsed_ms", "kbps", "datagrams", "lost", "out_of_order", "jitter_us", "runs"):
+        lines.append(f"  {name:<18} {stats[name]}")
+    return "\n".join(lines)
+
+
+def format_sync_stats(stats):
+    """Text for a get_sync reply"""
+    signed = lambda v: v - (1 << 32) if v & 0x80000000 else v
+    lines = [f"  {'role':<18} {SYNC_ROLES[stats['role']]}",
+             f"  {'state':<18} {SYNC_STATES[stats['state']]}",
+             f"  {'synced':<18} {'yes' if stats['synced'] else 'no'}",
+             f"  {'rate_ppb':<18} {signed(stats['rate_ppb'])}",
+             f"  {'error_us':<18} {signed(stats['error_us'])}"]
+    for name in ("run_id", "syncs", "outliers", "max_error_us", "samples", "blocks", "overruns"):
+        lines.append(f"  {name:<18} {stats[name]}")
+    return "\n".join(lines)
+
+
+def run_command(client, args):
+    """Execute one CLI command against one device and return the output text"""
+    schema = client.schema
+    if args.command == "ping":
+        return f"uptime {client.call('ping')['uptime_ms']} ms"
+
+    if args.command == "metrics":
+        metrics = client.call("get_metrics")
+        return "\n".join(f"  {name:<18} {value}" for name, value in metrics.items())
+
+    if args.command == "get":
+        keys = [schema["keys_by_name"][args.key]] if args.key else schema["config_keys"]
+        lines = []
+        for key in keys:
+            reply = client.call("get_config", key=key["id"])
+            lines.append(f"  {key['name']:<18} {format_key_value(key, reply['value'])}")
+        return "\n".join(lines)
+
+    if args.command == "set":
+        key = schema["keys_by_name"][args.key]
+        client.call("set_config", key=key["id"], value=encode_key_value(key, args.value))
+        return f"{key['name']} = {args.value}"
+
+    if args.command == "flash-read":
+        data = client.call("flash_read", addr=int(args.addr, 0), len=args.length)["data"]
+        return data.hex()
+
+    if args.command == "flash-erase":
+        client.call("flash_erase", addr=int(args.addr, 0))
+        return "sector erased"
+
+    if args.command == "flash-write":
+        client.call("flash_write", addr=int(args.addr, 0), data=bytes.fromhex(args.data))
+        return "page written"
+
+    if args.command == "flash-power":
+        stats = client.call("get_flash_power")
+        lines = [f"  {'state':<18} {'deep power-down' if stats['powered_down'] else 'standby'}"]
+        for name in ("power_downs", "wakeups", "resume_us", "resume_max_us", "down_ms"):
+            lines.append(f"  {name:<18} {stats[name]}")
+        return "\n".join(lines)
+
+    if args.command == "partitions":
+        lines = []
+        for i, name in enumerate(PARTITIONS):
+            part = client.call("get_partition", id=i)
+            flags = ",".join(f for bit, f in ((1, "fixed"), (2, "growable")) if part["flags"] & bit)
+            lines.append(f"  {name:<10} 0x{part['base']:08X} {part['size'] // 1024:>8} KB  {flags}")
+        return "\n".join(lines)
+
+    if args.command == "partition-grow":
+        client.call("grow_partition", id=PARTITIONS.index(args.name), size=int(args.size, 0))
+        return "partition table updated, rebooting to move the data"
+
+    if args.command == "wear":
+        wear = client.call("get_wear")
+        life = wear["life_hours"]
+        lines = [f"  {'total_erases':<18} {wear['total_erases']}",
+                 f"  {'power_on':<18} {wear['power_on_s'] / 3600:.1f} h",
+                 f"  {'hottest':<18} 0x{wear['hottest_addr']:08X}, {wear['max_count']} erases",
+                 f"  {'mean':<18} {wear['mean_count']} erases",
+                 f"  {'projected_life':<18} {'-' if life == 0xFFFFFFFF else f'{life} h ({life / 8760:.1f} years)'}",
+                 f"  {'flushes':<18} {wear['flushes']}",
+                 f"  {'dropped':<18} {wear['dropped']}",
+                 "  sectors by erase count:"]
+        for name in ("0", "1_9", "10_99", "100_999", "1k_10k", "10k_50k", "50k_100k", "100k_up"):
+            lines.append(f"    {name.replace('_', '-'):<16} {wear['sectors_' + name]}")
+        return "\n".join(lines)
+
+    if args.command == "boot":
+        profile = client.call("get_boot_profile")
+        return "\n".join(f"  {name:<18} {f'{us} us' if us else '-'}" for name, us in profile.items())
+
+    if args.command == "iperf":
+        if args.mode.endswith("-tx") and not args.target:
+            raise RpcError("tx modes need the address of a host running iperf -s")
+        client.call("iperf", mode=IPERF_MODES.index(args.mode),
+                    flags=(IPERF_FLAG_SPI_PAYLOAD if args.spi else 0) |
+                          (IPERF_FLAG_FLASH_PAYLOAD if args.flash else 0),
+                    port=args.iperf_port, duration_s=args.time, len=args.length, rate_kbps=args.rate,
+                    ip=socket.inet_aton(args.target) if args.target else b"")
+        if not (args.wait and args.mode.endswith("-tx")):
+            return f"iperf {args.mode} started"
+        while True:
+            time.sleep(0.5)
+            stats = client.call("get_iperf")
+            if IPERF_STATES[stats["state"]] in ("done", "failed"):
+                return format_iperf_stats(stats)
+
+    if args.command == "iperf-stats":
+        return format_iperf_stats(client.call("get_iperf"))
+
+    if args.command == "sync":
+        client.call("sync", role=SYNC_ROLES.index(args.role), sync_ms=args.interval,
+                    collector_port=args.collector_port,
+                    ip=socket.inet_aton(args.collector) if args.collector else b"")
+        return f"sync {args.role}"
+
+    if args.command == "sync-start":
+        run_id = client.call("sync_start", delay_ms=args.delay, period_us=args.period, count=args.count)["run_id"]
+        return f"run {run_id} started"
+
+    if args.command == "sync-stop":
+        run_id = client.call("sync_start", delay_ms=0, period_us=0, count=0)["run_id"]
+        return f"run {run_id} stopped"
+
+    if args.command == "sync-stats":
+        return format_sync_stats(client.call("get_sync"))
+
+    if args.command == "trace":
+        out = TRACE_OUTPUTS.index(args.output)
+        if (out & 0x01) and not args.collector:
+            raise RpcError("udp output needs the address of the host running trace_collect.py")
+        client.call("trace", out=out, port=args.collector_port,
+                    ip=socket.inet_aton(args.collector) if args.collector else b"")
+        return f"trace {args.output}"
+
+    if args.command == "trace-stats":
+        stats = client.call("get_trace")
+        lines = [f"  {'output':<18} {TRACE_OUTPUTS[stats['out']]}"]
+        for name in ("recorded", "dropped", "sent", "datagrams"):
+            lines.append(f"  {name:<18} {stats[name]}")
+        return "\n".join(lines)
+
+    if args.command == "reboot":
+        client.call("reboot")
+        return "rebooting"
+
+    raise ValueError(args.command)
+
+
+def worker(schema, host, args, failures):
+    client = RpcClient(schema, host, args.port, args.timeout, args.retries)
+    try:
+        text = run_command(client, args)
+    except RpcError as e:
+        text = f"ERROR: {e}"
+        failures.append(host)
+    with print_lock:
+        print(f"[{host}] {text}" if "\n" not in text else f"[{host}]\n{text}")
+
+
+def main():
+    schema = load_schema()
+
+    parser = argparse.ArgumentParser(description="STM32 RPC client")
+    parser.add_argument("hosts", help="Device IP address(es), comma-separated")
+    parser.add_argument("--port", type=int, default=None, help=f"UDP port (default: {schema['port']})")
+    parser.add_argument("--timeout", type=float, default=TIMEOUT, help="Seconds per attempt")
+    parser.add_argument("--retries", type=int, default=RETRIES, help="Retries with the same request ID")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    sub.add_parser("ping", help="Check the device is alive")
+    sub.add_parser("metrics", help="Read runtime counters")
+    p = sub.add_parser("get", help="Read one or all configuration keys")
+    p.add_argument("key", nargs="?", choices=list(schema["keys_by_name"]))
+    p = sub.add_parser("set", help="Write a configuration key")
+    p.add_argument("key", choices=list(schema["keys_by_name"]))
+    p.add_argument("value")
+    p = sub.add_parser("flash-read", help="Read external flash")
+    p.add_argument("addr")
+    p.add_argument("length", type=int)
+    p = sub.add_parser("flash-erase", help="Erase a 4KB flash sector (FW slots B/C, USER_DATA)")
+    p.add_argument("addr")
+    p = sub.add_parser("flash-write", help="Program bytes within one flash page (FW slots B/C, USER_DATA)")
+    p.add_argument("addr")
+    p.add_argument("data", help="Hex string")
+    sub.add_parser("flash-power", help="Read flash deep power-down counters")
+    sub.add_parser("partitions", help="Read the flash partition table")
+    p = sub.add_parser("partition-grow", help="Grow a flash partition into the reserved area (reboots)")
+    p.add_argument("name", choices=PARTITIONS)
+    p.add_argument("size", help="New size in bytes, a multiple of 4096")
+    sub.add_parser("wear", help="Read the flash erase-count histogram and projected lifetime")
+    sub.add_parser("boot", help="Read the boot profile (us since main per phase)")
+    p = sub.add_parser("iperf", help="Switch the iperf server mode or start a client run")
+    p.add_argument("mode", choices=IPERF_MODES)
+    p.add_argument("target", nargs="?", help="Host running iperf -s (tx modes)")
+    p.add_argument("-t", "--time", type=int, default=0, help="Run length in seconds (tx modes)")
+    p.add_argument("-l", "--length", type=int, default=0, help="UDP datagram size (udp-tx)")
+    p.add_argument("-b", "--rate", type=int, default=0, help="Rate in kbit/s, 0 for no limit (udp-tx)")
+    p.add_argument("--iperf-port", type=int, default=0, help="iperf port (default: 5001)")
+    p.add_argument("--spi", action="store_true", help="Move payload over SPI instead of in place")
+    p.add_argument("--flash", action="store_true",
+                   help="tcp-rx: program payload into the RESERVED scratch area; tcp-tx: send it back")
+    p.add_argument("--wait", action="store_true", help="Wait for a tx run and print its results")
+    sub.add_parser("iperf-stats", help="Read the results of the current or last iperf run")
+    p = sub.add_parser("sync", help="Set the synchronised sampling role")
+    p.add_argument("role", choices=SYNC_ROLES)
+    p.add_argument("collector", nargs="?", help="Host running sync_collect.py (default: unchanged)")
+    p.add_argument("--collector-port", type=int, default=0, help="Collector port (default: unchanged)")
+    p.add_argument("--interval", type=int, default=0, help="Master SYNC interval in ms (default: 1000)")
+    p = sub.add_parser("sync-start", help="Start a synchronised run on all nodes (master)")
+    p.add_argument("-p", "--period", type=int, required=True, help="Sample period in us (100-65536)")
+    p.add_argument("-n", "--count", type=int, default=0, help="Samples per node, 0 until stopped")
+    p.add_argument("-d", "--delay", type=int, default=0, help="Lead time in ms (default: 500)")
+    sub.add_parser("sync-stop", help="Stop the current synchronised run (master)")
+    sub.add_parser("sync-stats", help="Read the sampling role, clock alignment and run counters")
+    p = sub.add_parser("trace", help="Stream scheduler and ISR events, or stop with off")
+    p.add_argument("output", choices=TRACE_OUTPUTS)
+    p.add_argument("collector", nargs="?", help="Host running trace_collect.py (udp)")
+    p.add_argument("--collector-port", type=int, default=0, help="Collector port (default: 8003)")
+    sub.add_parser("trace-stats", help="Read the trace recorder counters")
+    sub.add_parser("reboot", help="Reset the device")
+
+    args = parser.parse_args()
+    args.hosts = [h for h in args.hosts.split(",") if h]
+
+    failures = []
+    threads = [threading.Thread(target=worker, args=(schema, host, args, failures)) for host in args.hosts]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""
+RPC Schema Code Generator
+-------------------------
+Generates the firmware side of the binary RPC channel from rpc_schema.json:
+- Core/Inc/rpc_schema.h   : opcodes, status codes, config keys, handler prototypes
+- Core/Src/rpc_dispatch.c : handler jump table indexed by opcode
+
+The Python client (rpc_client.py) loads the same JSON at runtime, so the
+device and the host can never disagree on the wire format.
+
+Usage:
+python rpc_gen.py            # regenerate
+python rpc_gen.py --check    # fail if generated files are stale
+
+Dependencies:
+- Python 3.x
+"""
+
+import argparse
+import json
+import os
+import sys
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+REPO_DIR = os.path.dirname(TOOLS_DIR)
+SCHEMA_PATH = os.path.join(TOOLS_DIR, "rpc_schema.json")
+HEADER_PATH = os.path.join(REPO_DIR, "Core", "Inc", "rpc_schema.h")
+DISPATCH_PATH = os.path.join(REPO_DIR, "Core", "Src", "rpc_dispatch.c")
+
+BANNER = "/* Generated by Tools/rpc_gen.py from Tools/rpc_schema.json - do not edit */\n"
+
+
+def load_schema(path=SCHEMA_PATH):
+    """Load and sanity-check the schema"""
+    with open(path) as f:
+        schema = json.load(f)
+    for table in ("status", "ops", "config_keys"):
+        ids = [entry["id"] for entry in schema[table]]
+        if ids != list(range(len(ids))):
+            raise ValueError(f"{table}: ids must be dense and start at 0")
+    return schema
+
+
+def render_header(schema):
+    """Render rpc_schema.h"""
+    out = [BANNER,
+           "#ifndef RPC_SCHEMA_H\n#define RPC_SCHEMA_H\n\n",
+           "#include <stdint.h>\n\n",
+           f"#define RPC_SCHEMA_VERSION      {schema['version']}\n",
+           f"#define RPC_MAGIC               0x{schema['magic']:02X}\n",
+           f"#define RPC_PORT                {schema['port']}\n",
+           "#define RPC_HEADER_SIZE         8\n",
+           f"#define RPC_MAX_PAYLOAD         {schema['max_payload']}\n\n",
+           "/* Status codes */\n"]
+    for st in schema["status"]:
+        out.append(f"#define RPC_STATUS_{st['name'].upper():<16} {st['id']}\n")
+
+    out.append("\n/* Opcodes */\ntypedef enum {\n")
+    for op in schema["ops"]:
+        out.append(f"    RPC_OP_{op['name'].upper()} = {op['id']},\n")
+    out.append("    RPC_OP_COUNT\n} rpc_op_t;\n\n")
+
+    out.append("/* Configuration keys: X(id, name, size) */\n#define RPC_CONFIG_KEY_TABLE(X) \\\n")
+    keys = schema["config_keys"]
+    for i, key in enumerate(keys):
+        sep = " \\" if i < len(keys) - 1 else ""
+        out.append(f"    X({key['id']}, {key['name']}, {key['size']}){sep}\n")
+    out.append("\ntypedef enum {\n")
+    for key in keys:
+        out.append(f"    RPC_KEY_{key['name'].upper()} = {key['id']},\n")
+    out.append("    RPC_KEY_COUNT\n} rpc_config_key_t;\n\n")
+
+    out.append("/* Operation flags */\n#define RPC_FLAG_CACHED         0x01    /**< Reply cached so retries are not re-executed */\n\n")
+    out.append("/**\n * @brief RPC handler\n"
+               " * @param req Request payload (after the header)\n"
+               " * @param req_len Request payload length\n"
+               " * @param reply Reply payload buffer (RPC_MAX_PAYLOAD bytes)\n"
+               " * @return Reply payload length, or -RPC_STATUS_x on error\n */\n")
+    out.append("typedef int16_t (*rpc_handler_t)(const uint8_t *req, uint16_t req_len, uint8_t *reply);\n\n")
+    out.append("typedef struct {\n    rpc_handler_t handler;\n    uint8_t flags;\n} rpc_op_entry_t;\n\n")
+    out.append("/* Handlers implemented in rpc_server.c */\n")
+    for op in schema["ops"]:
+        out.append(f"int16_t rpc_handle_{op['name']}(const uint8_t *req, uint16_t req_len, uint8_t *reply);\n")
+    out.append("\n/* Jump table indexed by opcode (rpc_dispatch.c) */\n")
+    out.append("extern const rpc_op_entry_t rpc_op_table[RPC_OP_COUNT];\n\n")
+    out.append("#endif /* RPC_SCHEMA_H */\n")
+    return "".join(out)
+
+
+def render_dispatch(schema):
+    """Render rpc_dispatch.c"""
+    out = [BANNER, "\n#include \"rpc_schema.h\"\n\n",
+           "const rpc_op_entry_t rpc_op_table[RPC_OP_COUNT] = {\n"]
+    for op in schema["ops"]:
+        flags = "RPC_FLAG_CACHED" if op.get("cached") else "0"
+        out.append(f"    [RPC_OP_{op['name'].upper()}] = {{ rpc_handle_{op['name']}, {flags} }},\n")
+    out.append("};\n")
+    return "".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate RPC firmware sources from rpc_schema.json")
+    parser.add_argument("--check", action="store_true", help="verify generated files are up to date")
+    args = parser.parse_args()
+
+    schema = load_schema()
+    outputs = {HEADER_PATH: render_header(schema), DISPATCH_PATH: render_dispatch(schema)}
+
+    stale = False
+    for path, text in outputs.items():
+        current = open(path).read() if os.path.exists(path) else None
+        if current == text:
+            continue
+        if args.check:
+            print(f"stale: {os.path.relpath(path, REPO_DIR)}")
+            stale = True
+        else:
+            with open(path, "w") as f:
+                f.write(text)
+            print(f"wrote {os.path.relpath(path, REPO_DIR)}")
+    sys.exit(1 if stale else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,519 @@
+#!/usr/bin/env python3
+"""
+STM32 Soak Test Harness
+-----------------------
+Drives a device (or the host build in Tools/host) with sustained mixed
+traffic for hours or days. It records loss and latency percentiles per
+traffic class and samples the device metrics over RPC, then writes a report
+that can be compared with an earlier run.
+
+Traffic classes, each running in its own thread:
+  rpc      RPC pings at a fixed rate, one attempt each (latency, loss)
+  modbus   FC03 reads over TCP, reconnecting every N requests (connection churn)
+  flood    UDP datagrams with a packet-size mix to the iperf UDP server; the
+           device's own loss count comes back in the iperf server report
+  storm    periodic bursts of broadcast datagrams the device has to drop
+
+Every --interval seconds one line is printed and stored: requests, loss and
+p50/p99/max latency per class for that interval, plus the device free heap,
+task counters and Modbus/RPC counters. A reboot shows up as uptime going
+backwards. A stall shows up as a task counter that stops advancing. RPC and
+Modbus percentiles are also split by whether a storm burst was in progress.
+
+Usage:
+python soak_test.py 192.168.100.151 --duration 8h --save soak.json
+python soak_test.py 127.0.0.1 --modbus-port 10502 --duration 10m      # host build
+python soak_test.py 192.168.100.151 --duration 24h --baseline soak.json
+python soak_test.py 192.168.100.151 --flood-rate 500 --flood-sizes 64:60,1470:40 --no-storm
+
+The exit code is 1 if the device rebooted or stalled, if its free heap fell by
+more than --heap-drop bytes, if loss is above --max-loss percent, or (with
+--baseline) if a p99 latency rose by more than --threshold percent.
+
+Dependencies:
+- Python 3.x
+- rpc_client.py and rpc_schema.json (same directory)
+"""
+
+import socket
+import struct
+import json
+import math
+import random
+import sys
+import threading
+import time
+import argparse
+from datetime import datetime, timezone
+
+from rpc_client import RpcClient, RpcError, load_schema
+
+REPORT_VERSION = 1
+IPERF_PORT = 5001
+IPERF_MODE_TCP_RX = 1
+IPERF_MODE_UDP_RX = 2
+MODBUS_READ_ADDR = 0
+MODBUS_READ_COUNT = 14  # Uptime, task and Modbus counters (Core/Inc/modbus_map.h)
+HIST_BASE = 1.05  # Latency histogram: 5% wide log buckets
+PERCENTILES = (50, 90, 99, 99.9)
+TASK_COUNTERS = ("task00", "task01", "task02", "task03")
+
+
+def parse_duration(text):
+    """'90', '90s', '10m', '8h' or '2d' in seconds"""
+    units = {"s": 1, "m": 60, "h": 3600, "d": 86400}
+    if text[-1] in units:
+        return float(text[:-1]) * units[text[-1]]
+    return float(text)
+
+
+def parse_sizes(text):
+    """'64:50,512:30,1470:20' as ([sizes], [weights])"""
+    sizes, weights = [], []
+    for item in text.split(","):
+        size, _, weight = item.partition(":")
+        sizes.append(int(size))
+        weights.append(float(weight or 1))
+    return sizes, weights
+
+
+def paced(rate, stop):
+    """Yield rate times per second until stop is set; slots missed by more
+    than a second are dropped rather than sent in a burst"""
+    interval = 1.0 / rate
+    next_t = time.monotonic()
+    while not stop.is_set():
+        now = time.monotonic()
+        if now < next_t:
+            stop.wait(next_t - now)
+            continue
+        yield
+        next_t += interval
+        if next_t < now - 1.0:
+            next_t = now
+
+
+class LatencyStats:
+    """Request/reply counters with a log histogram for the whole run and raw
+    samples for the current interval; split by storm state"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.total = self._empty()
+        self.storm = self._empty()
+        self.window = self._empty()
+        self.samples = []
+
+    @staticmethod
+    def _empty():
+        return {"sent": 0, "lost": 0, "hist": {}, "max": 0.0}
+
+    def _add(self, bucket, seconds):
+        bucket["sent"] += 1
+        if seconds is None:
+            bucket["lost"] += 1
+            return
+        us = max(seconds * 1e6, 1.0)
+        index = int(math.log(us) / math.log(HIST_BASE))
+        bucket["hist"][index] = bucket["hist"].get(index, 0) + 1
+        bucket["max"] = max(bucket["max"], seconds * 1e3)
+
+    def record(self, seconds, in_storm=False):
+        """One request: round-trip time in seconds, or None if it was lost"""
+        with self.lock:
+            self._add(self.total, seconds)
+            self._add(self.window, seconds)
+            if in_storm:
+                self._add(self.storm, seconds)
+            if seconds is not None:
+                self.samples.append(seconds * 1e3)
+
+    def take_window(self):
+        """Counters and exact percentiles of the interval just ended"""
+        with self.lock:
+            window, samples = self.window, sorted(self.samples)
+            self.window, self.samples = self._empty(), []
+        result = {"sent": window["sent"], "lost": window["lost"]}
+        if samples:
+            result["p50_ms"] = round(samples[len(samples) // 2], 3)
+            result["p99_ms"] = round(samples[min(len(samples) - 1, int(len(samples) * 0.99))], 3)
+            result["max_ms"] = round(samples[-1], 3)
+        return result
+
+    @staticmethod
+    def summarize(bucket):
+        """Loss and histogram percentiles (within one bucket width, 5%)"""
+        result = {"sent": bucket["sent"], "lost": bucket["lost"],
+                  "loss_pct": round(100.0 * bucket["lost"] / bucket["sent"], 3) if bucket["sent"] else 0.0}
+        received = bucket["sent"] - bucket["lost"]
+        if received:
+            ordered = sorted(bucket["hist"].items())
+            for p in PERCENTILES:
+                rank, seen = received * p / 100.0, 0
+                for index, count in ordered:
+                    seen += count
+                    if seen >= rank:
+                        result[f"p{p:g}_ms"] = round(HIST_BASE ** (index + 0.5) / 1e3, 3)
+                        break
+            result["max_ms"] = round(bucket["max"], 3)
+        return result
+
+    def summary(self):
+        with self.lock:
+            result = self.summarize(self.total)
+            result["during_storm"] = self.summarize(self.storm)
+        return result
+
+
+class Soak:
+    """Shared state of one run"""
+
+    def __init__(self, args, schema):
+        self.args = args
+        self.schema = schema
+        self.stop = threading.Event()
+        self.storm_active = threading.Event()
+        self.rpc = LatencyStats()
+        self.modbus = LatencyStats()
+        self.counters = {"modbus_connects": 0, "modbus_connect_failures": 0,
+                         "flood_sent": 0, "flood_bytes": 0, "flood_errors": 0,
+                         "storm_sent": 0, "storm_bursts": 0}
+        self.counter_lock = threading.Lock()
+        self.flood_report = None
+
+    def count(self, name, n=1):
+        with self.counter_lock:
+            self.counters[name] += n
+
+    # ---- traffic generators ----
+
+    def rpc_worker(self):
+        """RPC pings without retries: a missing reply is a lost request"""
+        op = self.schema["ops_by_name"]["ping"]
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        addr = (self.args.host, self.schema["port"])
+        request_id = random.getrandbits(32)
+        for _ in paced(self.args.rpc_rate, self.stop):
+            request_id = (request_id + 1) & 0xFFFFFFFF
+            datagram = struct.pack(">BBBBI", self.schema["magic"], self.schema["version"], op["id"], 0, request_id)
+            in_storm = self.storm_active.is_set()
+            start = time.perf_counter()
+            sock.sendto(datagram, addr)
+            deadline = start + self.args.timeout
+            rtt = None
+            while rtt is None and time.perf_counter() < deadline:
+                sock.settimeout(max(deadline - time.perf_counter(), 0.001))
+                try:
+                    reply, _ = sock.recvfrom(1024)
+                except socket.timeout:
+                    break
+                if len(reply) >= 8 and struct.unpack_from(">I", reply, 4)[0] == request_id:
+                    rtt = time.perf_counter() - start
+            self.rpc.record(rtt, in_storm)
+        sock.close()
+
+    def modbus_worker(self):
+        """FC03 reads; --modbus-churn requests per connection (0: one connection)"""
+        sock, tid, used = None, 0, 0
+        expect = 9 + 2 * MODBUS_READ_COUNT
+        for _ in paced(self.args.modbus_rate, self.stop):
+            if sock is not None and self.args.modbus_churn and used >= self.args.modbus_churn:
+                sock.close()
+                sock = None
+            if sock is None:
+                try:
+                    sock = socket.create_connection((self.args.host, self.args.modbus_port), self.args.timeout)
+                    self.count("modbus_connects")
+                    used = 0
+                except OSError:
+                    self.count("modbus_connect_failures")
+                    self.modbus.record(None, self.storm_active.is_set())
+                    sock = None
+                    continue
+
+            tid = (tid + 1) & 0xFFFF
+            request = struct.pack(">HHHBBHH", tid, 0, 6, 1, 0x03, MODBUS_READ_ADDR, MODBUS_READ_COUNT)
+            in_storm = self.storm_active.is_set()
+            start = time.perf_counter()
+            try:
+                sock.settimeout(self.args.timeout)
+                sock.sendall(request)
+                reply = b""
+                while len(reply) < expect:
+                    chunk = sock.recv(expect - len(reply))
+                    if not chunk:
+                        raise OSError("closed by device")
+                    reply += chunk
+                if struct.unpack_from(">H", reply)[0] != tid or reply[7] != 0x03:
+                    raise OSError("bad reply")
+                self.modbus.record(time.perf_counter() - start, in_storm)
+                used += 1
+            except OSError:
+                self.modbus.record(None, in_storm)
+                sock.close()
+                sock = None
+        if sock is not None:
+            sock.close()
+
+    def flood_worker(self):
+        """iperf2-framed UDP datagrams (id, tv_sec, tv_usec, id2) with the size
+        mix; the final datagram asks the device for its loss count"""
+        sizes, weights = parse_sizes(self.args.flood_sizes)
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        addr = (self.args.host, self.args.iperf_port)
+        padding = bytes(max(sizes))
+        seq = 0
+        for _ in paced(self.args.flood_rate, self.stop):
+            size = random.choices(sizes, weights)[0]
+            now = time.time()
+            header = struct.pack(">iIII", seq, int(now), int((now % 1) * 1e6), 0)
+            try:
+                sock.sendto(header + padding[:size - len(header)], addr)
+                self.count("flood_sent")
+                self.count("flood_bytes", size)
+            except OSError:
+                self.count("flood_errors")
+            seq += 1
+
+        sock.settimeout(0.25)
+        for _ in range(10):
+            now = time.time()
+            sock.sendto(struct.pack(">iIII", -seq, int(now), int((now % 1) * 1e6), 0) + bytes(48), addr)
+            try:
+                reply, _ = sock.recvfrom(2048)
+            except socket.timeout:
+                continue
+            if len(reply) >= 56:
+                flags, _, total, stop_s, stop_us, lost, ooo, datagrams, jit_s, jit_us = \
+                    struct.unpack_from(">10I", reply, 16)
+                if flags & 0x80000000:
+                    self.flood_report = {"device_bytes": total, "device_lost": lost,
+                                         "device_out_of_order": ooo, "device_datagrams": datagrams,
+                                         "device_jitter_us": jit_s * 1000000 + jit_us,
+                                         "device_loss_pct": round(100.0 * lost / datagrams, 3) if datagrams else 0.0}
+                    break
+        sock.close()
+
+    def storm_worker(self):
+        """Bursts of junk broadcasts (wrong RPC magic) at --storm-rate"""
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+        addr = (self.args.broadcast, self.args.storm_port)
+        payload = bytes([0xFF]) + bytes(self.args.storm_size - 1)
+        while not self.stop.wait(self.args.storm_period):
+            self.storm_active.set()
+            self.count("storm_bursts")
+            end = time.monotonic() + self.args.storm_burst
+            for _ in paced(self.args.storm_rate, self.stop):
+                if time.monotonic() >= end:
+                    break
+                try:
+                    sock.sendto(payload, addr)
+                    self.count("storm_sent")
+                except OSError:
+                    pass
+            self.storm_active.clear()
+        sock.close()
+
+    # ---- device metrics ----
+
+    def device_call(self, op, **values):
+        client = RpcClient(self.schema, self.args.host, timeout=self.args.timeout)
+        try:
+            return client.call(op, **values)
+        except RpcError:
+            return None
+
+    def set_iperf_mode(self, mode):
+        return self.device_call("iperf", mode=mode, flags=0, port=self.args.iperf_port, duration_s=0,
+                                len=0, rate_kbps=0, ip=b"") is not None
+
+
+def check_device(samples):
+    """Reboots (uptime going backwards) and stalls (task counter not advancing)"""
+    reboots, stalls = 0, []
+    previous = None
+    for sample in samples:
+        metrics = sample.get("device")
+        if not metrics:
+            continue
+        if previous:
+            if metrics["uptime_ms"] < previous["uptime_ms"]:
+                reboots += 1
+            else:
+                stalls += [f"{name} at {sample['t']:.0f} s" for name in TASK_COUNTERS
+                           if metrics[name] == previous[name]]
+        previous = metrics
+    return reboots, stalls
+
+
+def print_summary(report, baseline=None):
+    """Final table, with the baseline p99 where one is given"""
+    base = baseline["summary"] if baseline else {}
+    print(f"\n{'class':<16}{'sent':>10}{'loss %':>9}{'p50 ms':>9}{'p90 ms':>9}{'p99 ms':>9}"
+          f"{'p99.9 ms':>10}{'max ms':>9}{'base p99':>10}")
+    print("-" * 91)
+    for name in ("rpc", "modbus"):
+        for label, stats, prior in ((name, report["summary"][name], base.get(name, {})),
+                                    (f"{name} (storm)", report["summary"][name]["during_storm"],
+                                     base.get(name, {}).get("during_storm", {}))):
+            if not stats["sent"]:
+                continue
+            cols = "".join(f"{stats.get(k, '-'):>9}" for k in ("p50_ms", "p90_ms", "p99_ms"))
+            print(f"{label:<16}{stats['sent']:>10}{stats['loss_pct']:>9}{cols}"
+                  f"{stats.get('p99.9_ms', '-'):>10}{stats.get('max_ms', '-'):>9}{prior.get('p99_ms', ''):>10}")
+
+    counters = report["summary"]["counters"]
+    print(f"\nmodbus connects {counters['modbus_connects']}, failures {counters['modbus_connect_failures']}")
+    print(f"flood sent {counters['flood_sent']} datagrams / {counters['flood_bytes']} bytes, "
+          f"storm {counters['storm_sent']} broadcasts in {counters['storm_bursts']} bursts")
+    if report["summary"].get("flood"):
+        flood = report["summary"]["flood"]
+        print(f"flood seen by device: {flood['device_lost']}/{flood['device_datagrams']} lost "
+              f"({flood['device_loss_pct']} %), jitter {flood['device_jitter_us']} us")
+
+    device = report["summary"]["device"]
+    print(f"device: {device['reboots']} reboots, {len(device['stalls'])} stalls, free heap "
+          f"{device.get('free_heap_first', '-')} -> {device.get('free_heap_last', '-')} "
+          f"(min {device.get('free_heap_min', '-')})")
+
+
+def failures(report, baseline, args):
+    """Reasons to fail the run"""
+    reasons = []
+    summary = report["summary"]
+    device = summary["device"]
+    if device["reboots"]:
+        reasons.append(f"device rebooted {device['reboots']} times")
+    if device["stalls"]:
+        reasons.append(f"task stalled: {', '.join(device['stalls'][:4])}")
+    if "free_heap_min" in device and device["free_heap_first"] - device["free_heap_min"] > args.heap_drop:
+        reasons.append(f"free heap fell from {device['free_heap_first']} to {device['free_heap_min']}")
+    for name in ("rpc", "modbus"):
+        if summary[name]["loss_pct"] > args.max_loss:
+            reasons.append(f"{name} loss {summary[name]['loss_pct']} % > {args.max_loss} %")
+        if baseline and "p99_ms" in summary[name] and "p99_ms" in baseline["summary"].get(name, {}):
+            before, after = baseline["summary"][name]["p99_ms"], summary[name]["p99_ms"]
+            if after > before * (1 + args.threshold / 100.0):
+                reasons.append(f"{name} p99 {after} ms, baseline {before} ms")
+    return reasons
+
+
+def main():
+    parser = argparse.ArgumentParser(description="STM32 soak test harness")
+    parser.add_argument("host", help="Device IP address")
+    parser.add_argument("--duration", default="10m", help="Run length: 90s, 10m, 8h, 2d (default: 10m)")
+    parser.add_argument("--interval", type=float, default=10.0, help="Seconds per report line / metrics sample")
+    parser.add_argument("--timeout", type=float, default=0.5, help="Seconds before a request counts as lost")
+    parser.add_argument("--rpc-rate", type=float, default=20.0, help="RPC pings per second, 0 to disable")
+    parser.add_argument("--modbus-rate", type=float, default=20.0, help="Modbus reads per second, 0 to disable")
+    parser.add_argument("--modbus-port", type=int, default=502, help="Modbus port (host build: 10502)")
+    parser.add_argument("--modbus-churn", type=int, default=50, help="Requests per connection, 0 for one connection")
+    parser.add_argument("--flood-rate", type=float, default=100.0, help="UDP datagrams per second, 0 to disable")
+    parser.add_argument("--flood-sizes", default="64:50,512:30,1470:20", help="size:weight list")
+    parser.add_argument("--iperf-port", type=int, default=IPERF_PORT, help="iperf UDP server port")
+    parser.add_argument("--no-storm", action="store_true", help="No broadcast storms")
+    parser.add_argument("--broadcast", default="255.255.255.255", help="Storm destination")
+    parser.add_argument("--storm-port", type=int, default=None, help="Storm port (default: the RPC port)")
+    parser.add_argument("--storm-rate", type=float, default=2000.0, help="Broadcasts per second in a burst")
+    parser.add_argument("--storm-size", type=int, default=256, help="Broadcast size")
+    parser.add_argument("--storm-burst", type=float, default=5.0, help="Burst length in seconds")
+    parser.add_argument("--storm-period", type=float, default=60.0, help="Seconds between bursts")
+    parser.add_argument("--save", metavar="FILE", help="Write the report as JSON")
+    parser.add_argument("--baseline", metavar="FILE", help="Compare against an earlier report")
+    parser.add_argument("--threshold", type=float, default=20.0, help="Allowed p99 increase in percent")
+    parser.add_argument("--max-loss", type=float, default=0.1, help="Allowed RPC/Modbus loss in percent")
+    parser.add_argument("--heap-drop", type=int, default=0, help="Allowed free heap decrease in bytes")
+    args = parser.parse_args()
+
+    schema = load_schema()
+    if args.storm_port is None:
+        args.storm_port = schema["port"]
+    duration = parse_duration(args.duration)
+    soak = Soak(args, schema)
+
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    if soak.device_call("ping") is None:
+        print(f"No RPC reply from {args.host}")
+        sys.exit(2)
+    flood = args.flood_rate > 0 and soak.set_iperf_mode(IPERF_MODE_UDP_RX)
+    if args.flood_rate > 0 and not flood:
+        print("Device has no iperf server, flood disabled")
+
+    workers = []
+    if args.rpc_rate > 0:
+        workers.append(soak.rpc_worker)
+    if args.modbus_rate > 0:
+        workers.append(soak.modbus_worker)
+    if flood:
+        workers.append(soak.flood_worker)
+    if not args.no_storm:
+        workers.append(soak.storm_worker)
+    threads = [threading.Thread(target=w, daemon=True) for w in workers]
+
+    started = datetime.now(timezone.utc)
+    start = time.monotonic()
+    for t in threads:
+        t.start()
+
+    print(f"Soak test of {args.host} for {args.duration}, one line every {args.interval:g} s")
+    print(f"{'t s':>8}{'rpc sent/lost':>15}{'p99 ms':>9}{'mb sent/lost':>14}{'p99 ms':>9}{'heap':>8}{'uptime s':>10}")
+    samples = []
+    try:
+        while time.monotonic() - start < duration:
+            time.sleep(min(args.interval, max(duration - (time.monotonic() - start), 0.1)))
+            metrics = soak.device_call("get_metrics")
+            sample = {"t": round(time.monotonic() - start, 1), "rpc": soak.rpc.take_window(),
+                      "modbus": soak.modbus.take_window(), "storm": soak.storm_active.is_set(),
+                      "device": metrics}
+            samples.append(sample)
+            rpc, mb = sample["rpc"], sample["modbus"]
+            print(f"{sample['t']:>8.0f}{rpc['sent']:>9}/{rpc['lost']:<5}{rpc.get('p99_ms', '-'):>9}"
+                  f"{mb['sent']:>8}/{mb['lost']:<5}{mb.get('p99_ms', '-'):>9}"
+                  f"{metrics['free_heap'] if metrics else '?':>8}"
+                  f"{metrics['uptime_ms'] // 1000 if metrics else '?':>10}{'  storm' if sample['storm'] else ''}")
+    except KeyboardInterrupt:
+        print("Interrupted, writing the report")
+
+    soak.stop.set()
+    for t in threads:
+        t.join(timeout=5)
+    if flood:
+        soak.set_iperf_mode(IPERF_MODE_TCP_RX)
+
+    reboots, stalls = check_device(samples)
+    heap = [s["device"]["free_heap"] for s in samples if s["device"]]
+    device = {"reboots": reboots, "stalls": stalls,
+              "samples": len(samples), "missed_samples": sum(1 for s in samples if not s["device"])}
+    if heap:
+        device.update(free_heap_first=heap[0], free_heap_last=heap[-1], free_heap_min=min(heap))
+
+    report = {
+        "version": REPORT_VERSION,
+        "host": args.host,
+        "started": started.isoformat(),
+        "duration_s": round(time.monotonic() - start, 1),
+        "config": {k: v for k, v in vars(args).items() if k not in ("save", "baseline")},
+        "summary": {"rpc": soak.rpc.summary(), "modbus": soak.modbus.summary(), "counters": soak.counters,
+                    "flood": soak.flood_report, "device": device},
+        "intervals": samples,
+    }
+
+    print_summary(report, baseline)
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(report, f, indent=2)
+        print(f"\nReport saved to {args.save}")
+
+    reasons = failures(report, baseline, args)
+    for reason in reasons:
+        print(f"FAIL: {reason}")
+    sys.exit(1 if reasons else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""
+STM32 Synchronised Sampling Collector
+-------------------------------------
+Receives the DATA datagrams of a synchronised run (Core/Src/sync_sample.c),
+aligns the nodes by sample index and writes one CSV row per grid instant with
+the ADC1/ADC2 readings of every node. Sample i of every node was taken at
+network time first_us + i * period_us, so a row holds simultaneous readings.
+
+With --master the run is started over RPC first; otherwise the collector
+takes the first run it hears. Collection ends when every node has sent its
+last block, or after --timeout seconds without data.
+
+Usage:
+python sync_collect.py --master 192.168.1.100 -p 1000 -n 5000 -o run.csv
+python sync_collect.py --nodes 3 -o run.csv          # run started elsewhere
+python sync_collect.py --master 192.168.1.100 -p 500 -n 2000 --max-error 20
+
+With --max-error the exit code is 1 if any node reported a clock error above
+the limit (us) or lost samples, so the script can gate a timing change.
+
+Dependencies:
+- Python 3.x
+"""
+
+import socket
+import struct
+import csv
+import sys
+import argparse
+
+from rpc_client import RpcClient, RpcError, load_schema
+import gorilla
+
+SYNC_PORT = 8004
+SYNC_MAGIC = 0x53
+MSG_DATA = 4
+HEADER = struct.Struct(">BBBBHHIIIQ")
+FLAG_OVERRUN = 0x01
+FLAG_LAST = 0x02
+FLAG_PACKED = 0x04
+
+
+def parse_packet(data):
+    """Decode one DATA datagram into (header dict, [(adc1, adc2), ...])"""
+    if len(data) < HEADER.size:
+        return None
+    magic, msg, flags, channels, n, error_us, run_id, first_index, period_us, first_us = HEADER.unpack_from(data)
+    if magic != SYNC_MAGIC or msg != MSG_DATA:
+        return None
+    if flags & FLAG_PACKED:
+        try:
+            records = gorilla.decode(data[HEADER.size:], channels, n)
+        except ValueError:
+            return None
+        samples = [tuple(values[:2]) for _, values in records]
+    else:
+        if len(data) < HEADER.size + n * 4:
+            return None
+        words = struct.unpack_from(f"<{n}I", data, HEADER.size)
+        samples = [(w & 0xFFF, (w >> 16) & 0xFFF) for w in words]
+    header = {"flags": flags, "channels": channels, "error_us": error_us, "run_id": run_id,
+              "first_index": first_index, "period_us": period_us, "first_us": first_us}
+    return header, samples
+
+
+class Node:
+    """Samples and counters of one node in the run"""
+
+    def __init__(self):
+        self.samples = {}
+        self.blocks = 0
+        self.overruns = 0
+        self.max_error_us = 0
+        self.last = False
+        self.period_us = 0
+        self.start_us = None
+
+    def add(self, header, samples):
+        self.blocks += 1
+        self.period_us = header["period_us"]
+        if header["flags"] & FLAG_OVERRUN:
+            self.overruns += 1
+        if header["flags"] & FLAG_LAST:
+            self.last = True
+        self.max_error_us = max(self.max_error_us, header["error_us"])
+        start = header["first_us"] - header["first_index"] * header["period_us"]
+        if self.start_us is None:
+            self.start_us = start
+        for i, sample in enumerate(samples):
+            self.samples[header["first_index"] + i] = sample
+
+    def gaps(self):
+        """Missing indices between the first and last sample received"""
+        if not self.samples:
+            return 0
+        return max(self.samples) - min(self.samples) + 1 - len(self.samples)
+
+
+def collect(sock, nodes_expected, run_id, timeout):
+    """Receive DATA datagrams until every node sent LAST; return (run_id, {ip: Node})"""
+    nodes = {}
+    sock.settimeout(timeout)
+    while True:
+        try:
+            data, (ip, _) = sock.recvfrom(2048)
+        except socket.timeout:
+            break
+        parsed = parse_packet(data)
+        if parsed is None:
+            continue
+        header, samples = parsed
+        if run_id is None:
+            run_id = header["run_id"]
+        if header["run_id"] != run_id:
+            continue
+        nodes.setdefault(ip, Node()).add(header, samples)
+        done = [n for n in nodes.values() if n.last]
+        if len(done) == len(nodes) and (nodes_expected == 0 or len(done) >= nodes_expected):
+            break
+    return run_id, nodes
+
+
+def write_csv(path, nodes):
+    """One row per grid index present on any node: index, time_us, then ADC1/ADC2 per node"""
+    ips = sorted(nodes)
+    indices = sorted(set().union(*(n.samples for n in nodes.values())))
+    ref = nodes[ips[0]]
+    with open(path, "w", newline="") as f:
+        w = csv.writer(f)
+        w.writerow(["index", "time_us"] + [f"{ip}_{ch}" for ip in ips for ch in ("adc1", "adc2")])
+        for i in indices:
+            row = [i, ref.start_us + i * ref.period_us]
+            for ip in ips:
+                sample = nodes[ip].samples.get(i)
+                row += list(sample) if sample else ["", ""]
+            w.writerow(row)
+    return len(indices)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Collect a synchronised sampling run")
+    parser.add_argument("--master", help="Start the run on this device (must be in the master role)")
+    parser.add_argument("-p", "--period", type=int, default=1000, help="Sample period in us (with --master)")
+    parser.add_argument("-n", "--count", type=int, default=1000, help="Samples per node (with --master)")
+    parser.add_argument("-d", "--delay", type=int, default=0, help="Lead time in ms (with --master)")
+    parser.add_argument("--nodes", type=int, default=0, help="Wait for this many nodes to finish")
+    parser.add_argument("--port", type=int, default=SYNC_PORT, help="UDP port to listen on")
+    parser.add_argument("--timeout", type=float, default=5.0, help="Seconds without data before giving up")
+    parser.add_argument("-o", "--output", help="CSV file for the aligned samples")
+    parser.add_argument("--max-error", type=int, default=None, help="Fail above this clock error (us)")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    sock.bind(("0.0.0.0", args.port))
+
+    run_id = None
+    if args.master:
+        try:
+            client = RpcClient(load_schema(), args.master)
+            run_id = client.call("sync_start", delay_ms=args.delay, period_us=args.period,
+                                 count=args.count)["run_id"]
+        except RpcError as e:
+            print(f"ERROR: {args.master}: {e}")
+            sys.exit(1)
+        print(f"Run {run_id} started on {args.master}: {args.count} samples every {args.period} us")
+
+    run_id, nodes = collect(sock, args.nodes, run_id, args.timeout)
+    sock.close()
+    if not nodes:
+        print("No data received")
+        sys.exit(1)
+
+    print(f"Run {run_id}: {len(nodes)} node(s)")
+    print(f"  {'node':<16} {'samples':>8} {'blocks':>7} {'gaps':>6} {'overruns':>9} {'max_err_us':>11} {'complete':>9}")
+    failed = False
+    for ip in sorted(nodes):
+        n = nodes[ip]
+        print(f"  {ip:<16} {len(n.samples):>8} {n.blocks:>7} {n.gaps():>6} {n.overruns:>9} "
+              f"{n.max_error_us:>11} {'yes' if n.last else 'no':>9}")
+        if args.max_error is not None and (n.max_error_us > args.max_error or n.overruns or n.gaps() or not n.last):
+            failed = True
+    starts = {n.start_us for n in nodes.values()}
+    if len(starts) > 1:
+        print("  WARNING: nodes disagree on the run start time")
+        failed = True
+    common = set.intersection(*(set(n.samples) for n in nodes.values()))
+    print(f"  {len(common)} indices sampled by every node")
+
+    if args.output:
+        rows = write_csv(args.output, nodes)
+        print(f"Wrote {rows} rows to {args.output}")
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,355 @@
+#!/usr/bin/env python3
+"""
+STM32 Trace Collector
+---------------------
+Receives the event stream of the trace recorder (Core/Src/trace.c, built with
+TRACE_ENABLED=1) and converts it to Chrome trace JSON, which chrome://tracing
+and https://ui.perfetto.dev open directly.
+
+The device sends UDP datagrams once streaming is switched on over RPC
+(rpc_client.py <device> trace udp <this host>, or --device here). With --itm
+the input is a raw SWO capture instead (stimulus ports 1 and 2, e.g. from
+"openocd -c 'tpiu config internal swo.bin uart off 72000000'").
+
+The trace shows one track with the task running on the CPU, where each slice
+carries the ready-to-running latency of that run, one track of ISRs by IRQ,
+and one track per task with the waits it spent in flash, SPI DMA or W5500
+spans. Events the device dropped with its ring full appear as instant
+markers. A summary of CPU share, worst ready latency and worst ISR time is
+printed at the end.
+
+Usage:
+python trace_collect.py --device 192.168.1.100 -t 5 -o trace.json
+python trace_collect.py -o trace.json                # stream started elsewhere, Ctrl-C to stop
+python trace_collect.py --itm swo.bin -o trace.json
+
+Dependencies:
+- Python 3.x
+"""
+
+import socket
+import struct
+import json
+import sys
+import time
+import argparse
+
+from rpc_client import RpcClient, RpcError, load_schema
+
+TRACE_PORT = 8003
+TRACE_MAGIC = 0x54
+TRACE_VERSION = 1
+HEADER = struct.Struct(">BBBBIII")
+EVENT = struct.Struct(">IBBH")
+FLAG_NAMES = 0x01
+NAME_ENTRY = 16
+ITM_PORT = 1
+ITM_NAME_PORT = 2
+
+# Core/Inc/trace.h: trace_event_t and trace_span_t
+EV_TASK_IN, EV_TASK_READY, EV_ISR_ENTER, EV_ISR_EXIT, EV_SPAN_BEGIN, EV_SPAN_END, EV_DROPPED = range(7)
+SPANS = ["flash busy", "flash lock", "SPI DMA", "W5500 send"]
+
+# Exception numbers (IPSR) of the instrumented handlers; IRQ n is exception 16 + n
+EXCEPTIONS = {11: "SVCall", 14: "PendSV", 15: "SysTick", 16 + 23: "EXTI9_5 (W5500 INT)", 16 + 29: "TIM3 (HAL tick)"}
+
+TID_CPU = 1
+TID_ISR = 2
+TID_TASK = 100      # + task number
+
+
+def parse_datagram(data):
+    """Decode one datagram into (header dict, names dict or None, events list)"""
+    if len(data) < HEADER.size:
+        return None
+    magic, version, count, flags, seq, clock_hz, dropped = HEADER.unpack_from(data)
+    if magic != TRACE_MAGIC or version != TRACE_VERSION:
+        return None
+    header = {"seq": seq, "clock_hz": clock_hz, "dropped": dropped}
+    if flags & FLAG_NAMES:
+        names = {}
+        for i in range(count):
+            entry = data[HEADER.size + i * NAME_ENTRY:HEADER.size + (i + 1) * NAME_ENTRY]
+            if len(entry) == NAME_ENTRY:
+                names[entry[0]] = entry[1:].split(b"\0")[0].decode(errors="replace")
+        return header, names, []
+    if len(data) < HEADER.size + count * EVENT.size:
+        return None
+    events = [EVENT.unpack_from(data, HEADER.size + i * EVENT.size) for i in range(count)]
+    return header, None, events
+
+
+def parse_swo(data):
+    """Split an SWO capture into the byte streams of the ITM stimulus ports"""
+    ports = {}
+    overflows = 0
+    i = 0
+
+    def skip_continuation(i):
+        while i < len(data):
+            i += 1
+            if not data[i - 1] & 0x80:
+                break
+        return i
+
+    while i < len(data):
+        b = data[i]
+        i += 1
+        if b in (0x00, 0x80):               # Synchronisation
+            continue
+        if b == 0x70:
+            overflows += 1
+            continue
+        size = b & 0x03
+        if size:
+            n = {1: 1, 2: 2, 3: 4}[size]
+            payload = data[i:i + n]
+            i += n
+            if not b & 0x04:                # Software source: ITM stimulus port
+                ports.setdefault(b >> 3, bytearray()).extend(payload)
+            continue
+        if (b & 0x0F) == 0:                 # Local timestamp
+            if b & 0x80:
+                i = skip_continuation(i)
+        elif b in (0x94, 0xB4):             # Global timestamp
+            i = skip_continuation(i)
+        elif (b & 0x0B) == 0x08 and b & 0x80:  # Extension
+            i = skip_continuation(i)
+    return ports, overflows
+
+
+def read_itm(path):
+    """Events, task names and clock from an SWO capture"""
+    with open(path, "rb") as f:
+        ports, overflows = parse_swo(f.read())
+    words = ports.get(ITM_PORT, b"")
+    events = []
+    for off in range(0, len(words) - 7, 8):
+        cycles, packed = struct.unpack_from("<II", words, off)
+        events.append((cycles, packed & 0xFF, (packed >> 8) & 0xFF, packed >> 16))
+    names = {}
+    clock_hz = 72000000
+    for line in ports.get(ITM_NAME_PORT, b"").decode(errors="replace").splitlines():
+        if line.startswith("C") and line[1:].isdigit():
+            clock_hz = int(line[1:])
+        elif line.startswith("T") and " " in line:
+            num, name = line[1:].split(" ", 1)
+            if num.isdigit():
+                names[int(num)] = name
+    if overflows:
+        print(f"WARNING: {overflows} ITM overflow packet(s), events were lost in the SWO FIFO")
+    return events, names, clock_hz
+
+
+class TraceBuilder:
+    """Turns device events into Chrome trace events and keeps latency figures"""
+
+    def __init__(self, clock_hz):
+        self.clock_hz = clock_hz
+        self.last_cycles = None
+        self.time = 0                   # Unwrapped cycles since the first event
+        self.names = {}
+        self.out = []
+        self.running = None             # (task, start_us, ready_latency_us)
+        self.ready_at = {}
+        self.isr_stack = []
+        self.spans = {}
+        self.cpu_us = {}
+        self.ready_max_us = {}
+        self.isr_max_us = {}
+        self.events = 0
+        self.dropped = 0
+        self.first_us = None
+        self.last_us = 0.0
+
+    def task_name(self, task):
+        return self.names.get(task, f"task {task}") if task is not None else "no task"
+
+    def now_us(self, cycles):
+        if self.last_cycles is not None:
+            self.time += (cycles - self.last_cycles) & 0xFFFFFFFF
+        self.last_cycles = cycles
+        return self.time * 1e6 / self.clock_hz
+
+    def slice(self, name, tid, start_us, end_us, args=None, cat="task"):
+        event = {"name": name, "cat": cat, "ph": "X", "pid": 1, "tid": tid,
+                 "ts": round(start_us, 3), "dur": round(end_us - start_us, 3)}
+        if args:
+            event["args"] = args
+        self.out.append(event)
+
+    def end_run(self, now):
+        if self.running is None:
+            return
+        task, start, latency = self.running
+        args = {"ready_latency_us": round(latency, 2)} if latency is not None else None
+        self.slice(self.task_name(task), TID_CPU, start, now, args)
+        self.cpu_us[task] = self.cpu_us.get(task, 0.0) + now - start
+        self.running = None
+
+    def add(self, cycles, kind, ident, arg):
+        now = self.now_us(cycles)
+        self.events += 1
+        if self.first_us is None:
+            self.first_us = now
+        self.last_us = now
+
+        if kind == EV_TASK_IN:
+            self.end_run(now)
+            ready = self.ready_at.pop(ident, None)
+            latency = now - ready if ready is not None else None
+            if latency is not None:
+                self.ready_max_us[ident] = max(self.ready_max_us.get(ident, 0.0), latency)
+            self.running = (ident, now, latency)
+        elif kind == EV_TASK_READY:
+            self.ready_at.setdefault(ident, now)
+        elif kind == EV_ISR_ENTER:
+            self.isr_stack.append((ident, now))
+        elif kind == EV_ISR_EXIT:
+            if self.isr_stack and self.isr_stack[-1][0] == ident:
+                _, start = self.isr_stack.pop()
+                name = EXCEPTIONS.get(ident, f"IRQ {ident - 16}")
+                self.slice(name, TID_ISR, start, now, cat="isr")
+                self.isr_max_us[name] = max(self.isr_max_us.get(name, 0.0), now - start)
+        elif kind == EV_SPAN_BEGIN:
+            task = self.running[0] if self.running else None
+            self.spans[(ident, arg)] = (now, task)
+        elif kind == EV_SPAN_END:
+            begun = self.spans.pop((ident, arg), None)
+            if begun is not None:
+                start, task = begun
+                name = SPANS[ident] if ident < len(SPANS) else f"span {ident}"
+                if ident == 2:
+                    name += f" SPI{arg}"
+                elif ident == 3:
+                    name += f" socket {arg}"
+                self.slice(name, TID_TASK + (task or 0), start, now, cat="span")
+        elif kind == EV_DROPPED:
+            self.dropped += arg
+            self.out.append({"name": f"{arg} events dropped", "cat": "trace", "ph": "i", "s": "g",
+                             "pid": 1, "tid": TID_CPU, "ts": round(now, 3)})
+
+    def finish(self, device):
+        self.end_run(self.last_us)
+        meta = [{"name": "process_name", "ph": "M", "pid": 1, "args": {"name": device}},
+                {"name": "thread_name", "ph": "M", "pid": 1, "tid": TID_CPU, "args": {"name": "CPU"}},
+                {"name": "thread_name", "ph": "M", "pid": 1, "tid": TID_ISR, "args": {"name": "ISR"}}]
+        tids = {e["tid"] for e in self.out} - {TID_CPU, TID_ISR}
+        for tid in sorted(tids):
+            task = tid - TID_TASK
+            meta.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid,
+                         "args": {"name": self.task_name(task if task else None)}})
+        return {"traceEvents": meta + self.out, "displayTimeUnit": "ns",
+                "otherData": {"device": device, "clock_hz": self.clock_hz}}
+
+    def summary(self):
+        span = (self.last_us - self.first_us) if self.first_us is not None else 0.0
+        lines = [f"{self.events} events over {span / 1000:.1f} ms, {self.dropped} dropped on the device"]
+        if self.cpu_us:
+            lines.append(f"  {'task':<18} {'cpu %':>7} {'max ready->run us':>18}")
+            for task in sorted(self.cpu_us, key=lambda t: -self.cpu_us[t]):
+                share = 100.0 * self.cpu_us[task] / span if span else 0.0
+                ready = self.ready_max_us.get(task)
+                lines.append(f"  {self.task_name(task):<18} {share:>7.2f} {'-' if ready is None else f'{ready:.1f}':>18}")
+        for name, worst in sorted(self.isr_max_us.items()):
+            lines.append(f"  ISR {name:<26} max {worst:.1f} us")
+        return "\n".join(lines)
+
+
+def collect_udp(sock, duration, timeout):
+    """Datagrams until duration has passed, timeout without data or Ctrl-C"""
+    datagrams = []
+    start = time.monotonic()
+    sock.settimeout(0.2)
+    last_rx = None
+    try:
+        while duration is None or time.monotonic() - start < duration:
+            try:
+                data, peer = sock.recvfrom(2048)
+            except socket.timeout:
+                if last_rx is not None and time.monotonic() - last_rx > timeout:
+                    break
+                continue
+            last_rx = time.monotonic()
+            parsed = parse_datagram(data)
+            if parsed:
+                datagrams.append((peer[0], parsed))
+    except KeyboardInterrupt:
+        pass
+    return datagrams
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Collect a scheduler trace and write Chrome trace JSON")
+    parser.add_argument("--device", help="Start streaming to this host over RPC first, stop it at the end")
+    parser.add_argument("--collector", help="Address the device sends to (with --device, default: route to it)")
+    parser.add_argument("--port", type=int, default=TRACE_PORT, help="UDP port to listen on")
+    parser.add_argument("-t", "--duration", type=float, default=None, help="Seconds to record (default: until Ctrl-C)")
+    parser.add_argument("--timeout", type=float, default=3.0, help="Seconds without data before stopping")
+    parser.add_argument("--itm", help="Convert an SWO capture file instead of listening")
+    parser.add_argument("-o", "--output", default="trace.json", help="Chrome trace JSON file")
+    args = parser.parse_args()
+
+    if args.itm:
+        events, names, clock_hz = read_itm(args.itm)
+        device = f"STM32 ({args.itm})"
+        gaps = 0
+    else:
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+        sock.bind(("0.0.0.0", args.port))
+        client = None
+        if args.device:
+            collector = args.collector
+            if collector is None:
+                probe = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+                probe.connect((args.device, 9))
+                collector = probe.getsockname()[0]
+                probe.close()
+            try:
+                client = RpcClient(load_schema(), args.device)
+                client.call("trace", out=1, port=args.port, ip=socket.inet_aton(collector))
+            except RpcError as e:
+                print(f"ERROR: {args.device}: {e}")
+                sys.exit(1)
+            print(f"Tracing {args.device} to {collector}:{args.port}")
+        datagrams = collect_udp(sock, args.duration, args.timeout)
+        if client is not None:
+            try:
+                client.call("trace", out=0, port=0, ip=b"")
+            except RpcError as e:
+                print(f"WARNING: could not stop the trace: {e}")
+        sock.close()
+        if not datagrams:
+            print("No data received")
+            sys.exit(1)
+
+        # One device per trace: the first one heard
+        device = datagrams[0][0]
+        events, names, clock_hz, gaps, last_seq = [], {}, 72000000, 0, None
+        for peer, (header, dgram_names, dgram_events) in datagrams:
+            if peer != device:
+                continue
+            if last_seq is not None and header["seq"] != (last_seq + 1) & 0xFFFFFFFF:
+                gaps += (header["seq"] - last_seq - 1) & 0xFFFFFFFF
+            last_seq = header["seq"]
+            clock_hz = header["clock_hz"] or clock_hz
+            if dgram_names is not None:
+                names.update(dgram_names)
+            events.extend(dgram_events)
+
+    builder = TraceBuilder(clock_hz)
+    builder.names = names
+    for event in events:
+        builder.add(*event)
+    with open(args.output, "w") as f:
+        json.dump(builder.finish(device), f)
+
+    print(builder.summary())
+    if gaps:
+        print(f"WARNING: {gaps} datagram(s) lost in the network")
+    print(f"Wrote {len(builder.out)} trace events to {args.output}")
+
+
+if __name__ == "__main__":
+    main()